@@ -23,8 +23,9 @@ public:
         m_typeSize = typeSize;
         m_ticket = 0;
         // m_pool = (char*)memalign(m_typeSize, totalBytes);
-        m_pool = (char*)mmap(0, totalBytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
-        if(m_pool==nullptr){
+        // reserve only; pages are backed as threads bump into them
+        m_pool = (char*)mmap(0, totalBytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+        if(m_pool==(char*)MAP_FAILED){
             printf("map failed failed %d\n", errno);
             exit(1);
         }
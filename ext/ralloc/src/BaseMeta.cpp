@@ -12,10 +12,16 @@
  */
 
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
 
+#include <cerrno>
 #include <string>
+#include <algorithm>
 #include <chrono> 
 #include <iostream>
+#include <thread>
 
 #include "BaseMeta.hpp"
 
@@ -27,6 +33,8 @@ using namespace std;
 using namespace ralloc;
 using namespace std::chrono;
 
+NumaLayout ralloc::numa;
+
 template<class T, RegionIndex idx>
 CrossPtr<T,idx>::CrossPtr(Regions* _rgs, T* real_ptr) noexcept{
     if(UNLIKELY(real_ptr == nullptr)){
@@ -195,10 +203,13 @@ void BaseMeta::set_clean(){
 BaseMeta::BaseMeta(Regions* r) noexcept
 : 
     _rgs(r),
+    numa_num(std::min(std::max(ralloc::numa.num, 1), MAX_NUMA_NODES)),
     avail_sb(),
+    large_free(),
     heaps()
     // thread_num(thd_num) {
 {
+    load_numa_layout();
     /* allocate these persistent data into specific memory address */
     pthread_mutexattr_init(&dirty_attr);
     pthread_mutexattr_setrobust(&dirty_attr, PTHREAD_MUTEX_ROBUST);
@@ -207,11 +218,17 @@ BaseMeta::BaseMeta(Regions* r) noexcept
     FLUSH(&dirty_attr);
     FLUSH(&dirty_mtx);
     /* heaps init */
-    for (size_t idx = 0; idx < MAX_SZ_IDX; ++idx){
-        ProcHeap& heap = heaps[idx];
-        heap.partial_list.store(_rgs, nullptr);
-        heap.sc_idx = idx;
-        FLUSH(&heaps[idx]);
+    for (int node = 0; node < MAX_NUMA_NODES; ++node){
+        for (size_t idx = 0; idx < MAX_SZ_IDX; ++idx){
+            ProcHeap& heap = heaps[node][idx];
+            heap.partial_list.store(_rgs, nullptr);
+            heap.sc_idx = idx;
+            FLUSH(&heaps[node][idx]);
+        }
+    }
+    FLUSH(&numa_num);
+    for (int node = 0; node < MAX_NUMA_NODES; ++node){
+        large_coalescing[node].store(false);
     }
 
     /* persistent roots init */
@@ -224,6 +241,7 @@ BaseMeta::BaseMeta(Regions* r) noexcept
     void* tmp_sec_start = nullptr;
     int res = 0;
     while (res == 0){
+        // desc region is created large enough for the warm-up
         res = _rgs->expand(SB_IDX,&tmp_sec_start,SBSIZE, SB_REGION_EXPAND_SIZE);
         assert(res != -1 && "warmup sb allocation fails!");
     }
@@ -232,16 +250,58 @@ BaseMeta::BaseMeta(Regions* r) noexcept
     _rgs->regions_address[SB_IDX] = (char*)tmp_sec_start;
     //we skip the first sb on purpose so that CrossPtr doesn't start from 0.
     tmp_sec_start = (char*)((uint64_t)tmp_sec_start+SBSIZE);
-    organize_sb_list(tmp_sec_start, SB_REGION_EXPAND_SIZE/SBSIZE-1);
+    // split the warmed up sbs evenly among nodes
+    uint64_t warm_sb = SB_REGION_EXPAND_SIZE/SBSIZE-1;
+    for (int node = 0; node < numa_num; node++){
+        uint64_t count = warm_sb/numa_num + (node == 0 ? warm_sb%numa_num : 0);
+        bind_sb_range(tmp_sec_start, count*SBSIZE, node);
+        organize_sb_list(tmp_sec_start, count, node);
+        tmp_sec_start = (char*)((uint64_t)tmp_sec_start+count*SBSIZE);
+    }
     FLUSHFENCE;
 }
 
-// inline void* BaseMeta::expand_sb(size_t sz){
-//     void* tmp_sec_start = nullptr;
-//     bool res = _rgs->expand(SB_IDX,&tmp_sec_start,PAGESIZE, sz);
-//     if(!res) assert(0&&"region allocation fails!");
-//     return tmp_sec_start;
-// }
+void BaseMeta::load_numa_layout(){
+    for (int node = 0; node < MAX_NUMA_NODES; node++){
+        // nodes of a heap created on a larger machine are left unbound
+        numa_os_index[node] = node < std::min(ralloc::numa.num, numa_num) ?
+            ralloc::numa.os_index[node] : -1;
+    }
+}
+
+void BaseMeta::bind_sb_range(void* start, size_t len, int node){
+    if (numa_num <= 1 || numa_os_index[node] < 0)
+        return;
+    const int MASK_BITS = 1024;
+    if (numa_os_index[node] >= MASK_BITS)
+        return;
+    unsigned long mask[MASK_BITS/(8*sizeof(unsigned long))] = {0};
+    mask[numa_os_index[node]/(8*sizeof(unsigned long))] |=
+        1UL << (numa_os_index[node]%(8*sizeof(unsigned long)));
+    // MPOL_PREFERRED rather than MPOL_BIND: a full node spills over
+    // instead of faulting. This fails harmlessly where the mapping can't
+    // carry a policy (e.g. DAX), whose placement the device decides anyway.
+    long res = syscall(SYS_mbind, start, len, MPOL_PREFERRED, mask, MASK_BITS+1, 0);
+    (void)res;
+    DBG_PRINT("mbind %p+%lu to node %d: %ld\n", start, len, numa_os_index[node], res);
+}
+
+bool BaseMeta::cover_desc(char* sb_end){
+    RegionManager* desc_region = _rgs->regions[DESC_IDX];
+    char* desc_end = reinterpret_cast<char*>(desc_lookup(sb_end - 1) + 1);
+    uint64_t size = desc_end - desc_region->base_addr;
+    return size <= desc_region->FILESIZE.load() || desc_region->__grow(size);
+}
+
+int BaseMeta::expand_sb(void** ret, size_t alignment, size_t size){
+    // descriptors of the new sbs must be mapped before curr_addr moves
+    // past them, or recovery after a crash would walk off the desc file
+    if (!cover_desc(_rgs->regions[SB_IDX]->curr_addr_ptr->load() + alignment + size)){
+        // the request is beyond the sb region cap as well
+        return -1;
+    }
+    return _rgs->expand(SB_IDX, ret, alignment, size);
+}
 
 //desc of returned sb is constructed
 // inline void* BaseMeta::expand_get_small_sb(){
@@ -258,18 +318,22 @@ BaseMeta::BaseMeta(Regions* r) noexcept
 //     return tmp_sec_start;
 // }
 
-//desc of returned sb is constructed
-inline void* BaseMeta::expand_get_large_sb(size_t sz){
+//desc of returned sb is constructed; nullptr if sb region runs out
+inline void* BaseMeta::expand_get_large_sb(size_t sz, int node){
     void* ret = nullptr;
     int res = 0;
     while(res == 0) {
-        res = _rgs->expand(SB_IDX,&ret,PAGESIZE, sz);
-        assert(res != -1 && "space runs out!");
+        res = expand_sb(&ret,PAGESIZE, sz);
+    }
+    if(res == -1){
+        // sb region can't grow by sz any more
+        return nullptr;
     }
     DBG_PRINT("expand sb space for large sb allocation\n");
+    bind_sb_range(ret, sz, node);
     
     Descriptor* desc = desc_lookup(ret);
-    new (desc) Descriptor();
+    new (desc) Descriptor(node);
     return ret;
 }
 
@@ -319,14 +383,23 @@ uint32_t BaseMeta::compute_idx(char* superblock, char* block, size_t sc_idx) {
     return idx;
 }
 
-void BaseMeta::fill_cache(size_t sc_idx, TCacheBin* cache) {
+void BaseMeta::fill_cache(size_t sc_idx, TCacheBin* cache, TCaches& t_caches) {
+    int node = t_caches.node;
     // at most cache will be filled with number of blocks equal to superblock
     size_t block_num = 0;
-    // use a *SINGLE* partial superblock to try to fill cache
-    malloc_from_partial(sc_idx, cache, block_num);
+    cache->stats.fill_num++;
+    // use a *SINGLE* partial superblock of this node to try to fill cache
+    malloc_from_partial(sc_idx, cache, block_num, node, t_caches);
     // if we obtain no blocks from partial superblocks, create a new superblock
     if (block_num == 0)
-        malloc_from_newsb(sc_idx, cache, block_num);
+        malloc_from_newsb(sc_idx, cache, block_num, t_caches);
+    // sb region is exhausted; steal a partial superblock from other nodes
+    for (int i = 1; block_num == 0 && i < numa_num; i++)
+        malloc_from_partial(sc_idx, cache, block_num, (node + i) % numa_num, t_caches);
+    if (block_num == 0){
+        printf("\n----Region Manager: out of space in mmaped file-----\nBase:%p\n",_rgs->regions[SB_IDX]->base_addr);
+        assert(0);
+    }
 
     const SizeClassData* sc = get_sizeclass_by_idx(sc_idx);
     (void)sc;
@@ -334,8 +407,7 @@ void BaseMeta::fill_cache(size_t sc_idx, TCacheBin* cache) {
     assert(block_num <= sc->cache_block_num);
 }
 
-void BaseMeta::flush_cache(size_t sc_idx, TCacheBin* cache) {
-    ProcHeap* heap = &heaps[sc_idx];
+void BaseMeta::flush_cache(size_t sc_idx, TCacheBin* cache, TCaches* t_caches) {
     const SizeClassData* sc = get_sizeclass_by_idx(sc_idx);
     uint32_t const sb_size = sc->sb_size;
     uint32_t const block_size = sc->block_size;
@@ -344,6 +416,8 @@ void BaseMeta::flush_cache(size_t sc_idx, TCacheBin* cache) {
     uint32_t const maxcount = sc->get_block_num();
     (void)maxcount; // suppress unused warning
 
+    if (cache->get_block_num() > 0)
+        cache->stats.flush_num++;
     // @todo: optimize
     // in the normal case, we should be able to return several
     //  blocks with a single CAS
@@ -410,10 +484,11 @@ void BaseMeta::flush_cache(size_t sc_idx, TCacheBin* cache) {
         if (oldanchor.state == SB_FULL) {
             if(newanchor.state == SB_EMPTY) {
                 // this sb becomes empty from full
-                small_sb_retire(superblock, SBSIZE);
+                small_sb_retire(superblock, SBSIZE, t_caches);
+                cache->stats.sb_put_num++;
             } else {
                 // this sb becomes partial from full
-                heap_push_partial(desc);
+                heap_push_partial(desc, &cache->stats);
             }
         }
     }
@@ -433,37 +508,42 @@ char* BaseMeta::sb_lookup(Descriptor* desc){
     return ret;
 }
 
-void BaseMeta::heap_push_partial(Descriptor* desc) {
+void BaseMeta::heap_push_partial(Descriptor* desc, TCacheStats* stats) {
     ProcHeap* heap = desc->heap.to_addr(_rgs);
     ptr_cnt<Descriptor> oldhead = heap->partial_list.load(_rgs);
     ptr_cnt<Descriptor> newhead;
+    uint64_t retry = 0;
     do {
         newhead.set(desc, oldhead.get_counter() + 1);
         assert(oldhead.get_ptr() != newhead.get_ptr());
         newhead.get_ptr()->next_partial.store(oldhead.get_ptr()); 
-    } while (!heap->partial_list.compare_exchange_weak(_rgs,oldhead, newhead));
+    } while (!heap->partial_list.compare_exchange_weak(_rgs,oldhead, newhead) && ++retry);
+    if (stats) stats->cas_retry_num += retry;
 }
 
-Descriptor* BaseMeta::heap_pop_partial(ProcHeap* heap) {
+Descriptor* BaseMeta::heap_pop_partial(ProcHeap* heap, TCacheStats* stats) {
     ptr_cnt<Descriptor> oldhead = heap->partial_list.load(_rgs);
     ptr_cnt<Descriptor> newhead;
+    uint64_t retry = 0;
     do {
         Descriptor* olddesc = oldhead.get_ptr();
         if (!olddesc){
+            if (stats) stats->cas_retry_num += retry;
             return nullptr;
         }
         Descriptor* desc = olddesc->next_partial.load();
         uint64_t counter = oldhead.get_counter();
         newhead.set(desc, counter);
-    } while (!heap->partial_list.compare_exchange_weak(_rgs, oldhead, newhead));
+    } while (!heap->partial_list.compare_exchange_weak(_rgs, oldhead, newhead) && ++retry);
+    if (stats) stats->cas_retry_num += retry;
     return oldhead.get_ptr();
 }
 
-void BaseMeta::malloc_from_partial(size_t sc_idx, TCacheBin* cache, size_t& block_num){
+void BaseMeta::malloc_from_partial(size_t sc_idx, TCacheBin* cache, size_t& block_num, int node, TCaches& t_caches){
 retry:
-    ProcHeap* heap = &heaps[sc_idx];
+    ProcHeap* heap = &heaps[node][sc_idx];
 
-    Descriptor* desc = heap_pop_partial(heap);
+    Descriptor* desc = heap_pop_partial(heap, &cache->stats);
     if (!desc)
         return;
 
@@ -478,7 +558,8 @@ retry:
     // due to free()
     do {
         if (oldanchor.state == SB_EMPTY) {
-            small_sb_retire(superblock, get_sizeclass(heap)->sb_size);
+            small_sb_retire(superblock, get_sizeclass(heap)->sb_size, &t_caches);
+            cache->stats.sb_put_num++;
             goto retry;
         }
 
@@ -518,16 +599,20 @@ retry:
     block_num += block_take;
 }
 
-void BaseMeta::malloc_from_newsb(size_t sc_idx, TCacheBin* cache, size_t& block_num) {
-    ProcHeap* heap = &heaps[sc_idx];
+void BaseMeta::malloc_from_newsb(size_t sc_idx, TCacheBin* cache, size_t& block_num, TCaches& t_caches) {
     const SizeClassData* sc = get_sizeclass_by_idx(sc_idx);
     uint32_t const block_size = sc->block_size;
     uint32_t const maxcount = sc->get_block_num();
 
-    char* superblock = reinterpret_cast<char*>(small_sb_alloc(sc->sb_size));
-    assert(superblock);
+    assert(sc->sb_size == SBSIZE);
+    char* superblock = reinterpret_cast<char*>(reserve_sb_alloc(t_caches));
+    if (!superblock)
+        return;
+    cache->stats.sb_get_num++;
     Descriptor* desc = desc_lookup(superblock);
 
+    // a stolen sb still returns to the partial list of its own node
+    ProcHeap* heap = &heaps[desc->node][sc_idx];
     desc->heap.assign(_rgs,heap);
     desc->block_size = block_size;
     desc->maxcount = maxcount;
@@ -563,45 +648,125 @@ void BaseMeta::malloc_from_newsb(size_t sc_idx, TCacheBin* cache, size_t& block_
 }
 
 //for sb in the free list, their desc are all constructed.
-inline void BaseMeta::organize_sb_list(void* start, uint64_t count){
-    // put (start)...(start+count-1) sbs to free_sb queue
+inline void BaseMeta::organize_sb_list(void* start, uint64_t count, int node){
+    // put (start)...(start+count-1) sbs to free_sb queue of node
     // in total it's count sbs
     Descriptor* desc_start = desc_lookup((char*)((uint64_t)start));
     Descriptor* desc = desc_start;
-    new (desc) Descriptor();
+    new (desc) Descriptor(node);
     for(uint64_t i = 1; i < count; i++){
         desc->next_free.store(desc+1);//pptr
         desc++;
-        new (desc) Descriptor();
+        new (desc) Descriptor(node);
     }
-    ptr_cnt<Descriptor> oldhead = avail_sb.load(_rgs);
+    avail_sb_push_chain(desc_start, desc, node);
+}
+
+void BaseMeta::avail_sb_push_chain(Descriptor* first, Descriptor* last, int node){
+    ptr_cnt<Descriptor> oldhead = avail_sb[node].load(_rgs);
     ptr_cnt<Descriptor> newhead;
     do{
-        desc->next_free.store(oldhead.get_ptr());
-        newhead.set(desc_start, oldhead.get_counter()+1);
-    }while(!avail_sb.compare_exchange_weak(_rgs,oldhead,newhead));
+        last->next_free.store(oldhead.get_ptr());
+        newhead.set(first, oldhead.get_counter()+1);
+    }while(!avail_sb[node].compare_exchange_weak(_rgs,oldhead,newhead));
+}
+
+void* BaseMeta::avail_sb_pop(int node){
+    ptr_cnt<Descriptor> oldhead = avail_sb[node].load(_rgs);
+    ptr_cnt<Descriptor> newhead;
+    do{
+        Descriptor* oldptr = oldhead.get_ptr();
+        if(!oldptr)
+            return nullptr;
+        newhead.set(oldptr->next_free.load(),oldhead.get_counter());
+    }while(!avail_sb[node].compare_exchange_weak(_rgs,oldhead,newhead));
+    return reinterpret_cast<void*>(sb_lookup(oldhead.get_ptr()));
+}
+
+Descriptor* BaseMeta::avail_sb_pop_chain(int node, uint32_t max, uint32_t& num){
+    ptr_cnt<Descriptor> oldhead = avail_sb[node].load(_rgs);
+    ptr_cnt<Descriptor> newhead;
+    Descriptor* last;
+    do{
+        Descriptor* first = oldhead.get_ptr();
+        if(!first){
+            num = 0;
+            return nullptr;
+        }
+        // the walk may read descs popped meanwhile, but then the CAS
+        // fails since the counter or head has changed
+        last = first;
+        num = 1;
+        for(Descriptor* next = last->next_free.load(); next && num < max;
+            next = last->next_free.load()){
+            last = next;
+            num++;
+        }
+        newhead.set(last->next_free.load(),oldhead.get_counter());
+    }while(!avail_sb[node].compare_exchange_weak(_rgs,oldhead,newhead));
+    last->next_free.store(nullptr);
+    return oldhead.get_ptr();
 }
 
-void* BaseMeta::small_sb_alloc(size_t size){
+void* BaseMeta::reserve_sb_alloc(TCaches& t_caches){
+    if(t_caches.sb_reserve_num == 0){
+        uint32_t num;
+        Descriptor* chain = avail_sb_pop_chain(t_caches.node, SB_RESERVE_BATCH, num);
+        if(!chain){
+            // free_sb of node is empty: expand sb region or steal
+            return small_sb_alloc(SBSIZE, t_caches.node);
+        }
+        t_caches.sb_reserve = chain;
+        t_caches.sb_reserve_num = num;
+    }
+    Descriptor* desc = t_caches.sb_reserve;
+    t_caches.sb_reserve = desc->next_free.load();
+    t_caches.sb_reserve_num--;
+    return reinterpret_cast<void*>(sb_lookup(desc));
+}
+
+void BaseMeta::reserve_sb_retire(Descriptor* desc, TCaches& t_caches){
+    desc->next_free.store(t_caches.sb_reserve);
+    t_caches.sb_reserve = desc;
+    if(++t_caches.sb_reserve_num > SB_RESERVE_MAX){
+        // hand a batch back so that other threads can take it
+        Descriptor* last = desc;
+        for(uint32_t i = 1; i < SB_RESERVE_BATCH; i++){
+            last = last->next_free.load();
+        }
+        t_caches.sb_reserve = last->next_free.load();
+        t_caches.sb_reserve_num -= SB_RESERVE_BATCH;
+        avail_sb_push_chain(desc, last, t_caches.node);
+    }
+}
+
+void BaseMeta::flush_sb_reserve(TCaches& t_caches){
+    if(t_caches.sb_reserve_num == 0) return;
+    Descriptor* last = t_caches.sb_reserve;
+    for(uint32_t i = 1; i < t_caches.sb_reserve_num; i++){
+        last = last->next_free.load();
+    }
+    avail_sb_push_chain(t_caches.sb_reserve, last, t_caches.node);
+    t_caches.sb_reserve = nullptr;
+    t_caches.sb_reserve_num = 0;
+}
+
+void* BaseMeta::small_sb_alloc(size_t size, int node){
     if(size != SBSIZE){
         std::cout<<"desired size: "<<size<<std::endl;
         assert(0);
     }
 
-    Descriptor* oldptr = nullptr;
-
-    ptr_cnt<Descriptor> oldhead;
     char * old_curr_addr;
     while(true){
         old_curr_addr = _rgs->regions[SB_IDX]->curr_addr_ptr->load();
-        oldhead = avail_sb.load(_rgs);
-        oldptr = oldhead.get_ptr();
-        if(oldptr) {
-            ptr_cnt<Descriptor> newhead;
-            newhead.set(oldptr->next_free.load(),oldhead.get_counter());
-            if(avail_sb.compare_exchange_strong(_rgs,oldhead,newhead)){
-                return reinterpret_cast<void*>(sb_lookup(oldptr));
-            }
+        void* sb = avail_sb_pop(node);
+        if(!sb) {
+            // carve from a free large run before growing the region
+            sb = large_free_take_sb(node);
+        }
+        if(sb) {
+            return sb;
         }
         else{
             // below is effectively _rgs->regions[SB_IDX](&tmp_sec_start,PAGESIZE, SB_REGION_EXPAND_SIZE);
@@ -616,9 +781,17 @@ void* BaseMeta::small_sb_alloc(size_t size){
             uint64_t sb_to_expand = SB_REGION_EXPAND_SIZE/SBSIZE;
             sb_to_expand /= thd_num;
             next = new_curr_addr + sb_to_expand*SBSIZE;
-            if (next > _rgs->regions[SB_IDX]->base_addr + _rgs->regions[SB_IDX]->FILESIZE){
-                printf("\n----Region Manager: out of space in mmaped file-----\nCurr:%p\nBase:%p\n",res,_rgs->regions[SB_IDX]->base_addr);
-                assert(0);
+            RegionManager* sb_region = _rgs->regions[SB_IDX];
+            if (next > sb_region->base_addr + sb_region->FILESIZE.load()){
+                if (!sb_region->__grow(next - sb_region->base_addr)){
+                    // sb region can't grow any further; fall back to other nodes
+                    break;
+                }
+                // other threads keep allocating while the region grows
+                continue;
+            }
+            if (!cover_desc(next)){
+                assert(0 && "desc region runs out!");
             }
             // if (old_curr_addr != _rgs->regions[SB_IDX]->curr_addr_ptr->load()){
             //     // someone expanded the region, retry
@@ -631,65 +804,197 @@ void* BaseMeta::small_sb_alloc(size_t size){
                 DBG_PRINT("expand sb space for small sb allocation\n");
                 FLUSH(_rgs->regions[SB_IDX]->curr_addr_ptr);
                 FLUSHFENCE;
-                organize_sb_list((char*)((uint64_t)res+SBSIZE), sb_to_expand-1);
+                // bind before any sb in the range is touched
+                bind_sb_range(res, sb_to_expand*SBSIZE, node);
+                organize_sb_list((char*)((uint64_t)res+SBSIZE), sb_to_expand-1, node);
                 Descriptor* desc = desc_lookup(res);
-                new (desc) Descriptor();
+                new (desc) Descriptor(node);
                 return (void*)res;
             }
             // CAS fails. Try to get a sb from free list again.
         }
     }
+    for(int i = 1; i < numa_num; i++){
+        void* sb = avail_sb_pop((node + i) % numa_num);
+        if(sb) return sb;
+    }
+    // a sb may have been retired to this node in the meantime
+    return avail_sb_pop(node);
 }
-inline void BaseMeta::small_sb_retire(void* sb, size_t size){
+inline void BaseMeta::small_sb_retire(void* sb, size_t size, TCaches* t_caches){
     assert(size == SBSIZE);
     Descriptor* desc = desc_lookup(sb);
-    new (desc) Descriptor(); // at this time we erase data in this desc
+    int node = desc->node;
+    new (desc) Descriptor(node); // at this time we erase data in this desc
     // no need for further flush and fence since they were called in constructor
     // FLUSH(desc);
     // FLUSHFENCE;
-    ptr_cnt<Descriptor> oldhead = avail_sb.load(_rgs);
-    ptr_cnt<Descriptor> newhead;
-    do{
-        desc->next_free.store(oldhead.get_ptr());
-        newhead.set(desc, oldhead.get_counter()+1);
-    } while (!avail_sb.compare_exchange_weak(_rgs,oldhead,newhead));
+    // the desc now reads as a free sb to recovery, wherever it's kept
+    if(t_caches && t_caches->node == node){
+        reserve_sb_retire(desc, *t_caches);
+    } else {
+        avail_sb_push_chain(desc, desc, node);
+    }
 }
 
 /* 
- * IMPORTANT: 	Large_sb_alloc is designed for very rare 
- *				large sb (>=16K) allocations. 
- *
- *				Every time sb region will be expanded by $size$
+ * Large sbs are runs of contiguous sbs. A freed run is kept whole in
+ * large_free and reused by later large allocations; the sb region is
+ * expanded by $size$ only if no free run, even after merging adjacent
+ * ones, is long enough.
  */
-inline void* BaseMeta::large_sb_alloc(size_t size){
-    // cout<<"WARNING: Allocating a large object.\n";
-    return expand_get_large_sb(size);
+inline void* BaseMeta::large_sb_alloc(size_t size, int node){
+    uint64_t len = size/SBSIZE;
+    Descriptor* desc = large_free_get(len, node);
+    if(!desc){
+        // merge runs, or wait for whoever is merging them: the buckets
+        // may have looked empty only because they were taken to merge
+        large_free_coalesce(node);
+        desc = large_free_get(len, node);
+    }
+    if(desc){
+        desc->run_len = 0;
+        return reinterpret_cast<void*>(sb_lookup(desc));
+    }
+    return expand_get_large_sb(size, node);
 }
 
 void BaseMeta::large_sb_retire(void* sb, size_t size){
-    // cout<<"WARNING: Deallocating a large object.\n";
     assert(size%SBSIZE == 0);//size must be a multiple of SBSIZE
     Descriptor* desc = desc_lookup(sb);
-    new (desc) Descriptor();
+    int node = desc->node;
+    // descs of the rest of the run were never set
+    new (desc) Descriptor(node);
     // no need for further flush and fence since they were called in constructor
     // FLUSH(desc); //flush reinitialized desc
     // FLUSHFENCE;
-    organize_sb_list(sb, size/SBSIZE);
+    large_free_push(desc, size/SBSIZE, node);
+}
+
+static inline int large_bucket(uint64_t len){
+    return len < (uint64_t)LARGE_BUCKETS ? (int)len - 1 : LARGE_BUCKETS - 1;
 }
 
-inline void* BaseMeta::alloc_large_block(size_t sz){
-    return large_sb_alloc(sz);
+void BaseMeta::large_free_push(Descriptor* desc, uint64_t len, int node){
+    desc->run_len = len;
+    AtomicCrossPtrCnt<Descriptor, DESC_IDX>& bucket = large_free[node][large_bucket(len)];
+    ptr_cnt<Descriptor> oldhead = bucket.load(_rgs);
+    ptr_cnt<Descriptor> newhead;
+    do{
+        desc->next_free.store(oldhead.get_ptr());
+        newhead.set(desc, oldhead.get_counter()+1);
+    }while(!bucket.compare_exchange_weak(_rgs,oldhead,newhead));
+}
+
+Descriptor* BaseMeta::large_free_pop(int node, int b){
+    AtomicCrossPtrCnt<Descriptor, DESC_IDX>& bucket = large_free[node][b];
+    ptr_cnt<Descriptor> oldhead = bucket.load(_rgs);
+    ptr_cnt<Descriptor> newhead;
+    do{
+        Descriptor* oldptr = oldhead.get_ptr();
+        if(!oldptr)
+            return nullptr;
+        newhead.set(oldptr->next_free.load(),oldhead.get_counter());
+    }while(!bucket.compare_exchange_weak(_rgs,oldhead,newhead));
+    return oldhead.get_ptr();
+}
+
+Descriptor* BaseMeta::large_free_get(uint64_t len, int node){
+    Descriptor* desc = nullptr;
+    for(int b = large_bucket(len); !desc && b < LARGE_BUCKETS - 1; b++){
+        desc = large_free_pop(node, b);
+    }
+    if(!desc){
+        // runs in the last bucket have various lengths; put back the
+        // ones too short after the search
+        Descriptor* short_runs = nullptr;
+        while((desc = large_free_pop(node, LARGE_BUCKETS - 1)) && desc->run_len < len){
+            desc->next_free.store(short_runs);
+            short_runs = desc;
+        }
+        while(short_runs){
+            Descriptor* next = short_runs->next_free.load();
+            large_free_push(short_runs, short_runs->run_len, node);
+            short_runs = next;
+        }
+        if(!desc) return nullptr;
+    }
+    if(desc->run_len > len){
+        // desc+len was inside the run and never set; it heads the tail now
+        new (desc + len) Descriptor(node);
+        large_free_push(desc + len, desc->run_len - len, node);
+        desc->run_len = len;
+    }
+    return desc;
+}
+
+void BaseMeta::large_free_coalesce(int node){
+    bool expected = false;
+    if(!large_coalescing[node].compare_exchange_strong(expected, true)){
+        large_free_wait(node);
+        return;
+    }
+    // take every run of node; others may push meanwhile but we won't
+    // see those until the next time
+    std::vector<Descriptor*> runs;
+    for(int b = 0; b < LARGE_BUCKETS; b++){
+        Descriptor* desc;
+        while((desc = large_free_pop(node, b))){
+            runs.push_back(desc);
+        }
+    }
+    std::sort(runs.begin(), runs.end());
+    size_t i = 0;
+    while(i < runs.size()){
+        Descriptor* head = runs[i];
+        uint64_t len = head->run_len;
+        for(i++; i < runs.size() && runs[i] == head + len; i++){
+            len += runs[i]->run_len;
+            runs[i]->run_len = 0;
+        }
+        large_free_push(head, len, node);
+    }
+    large_coalescing[node].store(false);
+}
+
+void BaseMeta::large_free_wait(int node){
+    while(large_coalescing[node].load()){
+        std::this_thread::yield();
+    }
+}
+
+void* BaseMeta::large_free_take_sb(int node){
+    // runs being merged are out of the buckets for now
+    large_free_wait(node);
+    for(int b = 0; b < LARGE_BUCKETS; b++){
+        Descriptor* desc = large_free_pop(node, b);
+        if(!desc) continue;
+        uint64_t len = desc->run_len;
+        desc->run_len = 0;
+        if(len > 1){
+            organize_sb_list(sb_lookup(desc + 1), len - 1, node);
+        }
+        return reinterpret_cast<void*>(sb_lookup(desc));
+    }
+    return nullptr;
+}
+
+inline void* BaseMeta::alloc_large_block(size_t sz, int node){
+    return large_sb_alloc(sz, node);
 }
 
 void* BaseMeta::do_malloc(size_t size, TCaches& t_caches){
     if (UNLIKELY(size > MAX_SZ)) {
         // large block allocation
         size_t sbs = round_up(size, SBSIZE);//round size up to multiple of SBSIZE
-        char* ptr = (char*)alloc_large_block(sbs);
-        assert(ptr);
+        char* ptr = (char*)alloc_large_block(sbs, t_caches.node);
+        if (UNLIKELY(!ptr)) {
+            errno = ENOMEM;
+            return nullptr;
+        }
         Descriptor* desc = desc_lookup(ptr);
 
-        desc->heap.assign(_rgs,&heaps[0]);
+        desc->heap.assign(_rgs,&heaps[desc->node][0]);
         desc->block_size = sbs;
         desc->maxcount = 1;
         desc->superblock.assign(_rgs, ptr);
@@ -703,6 +1008,9 @@ void* BaseMeta::do_malloc(size_t size, TCaches& t_caches){
         FLUSH(&desc);
         FLUSHFENCE;
 
+        // large blocks are accounted in the (otherwise unused) bin 0
+        t_caches.t_cache[0].stats.alloc_num++;
+        t_caches.t_cache[0].stats.sb_get_num += sbs / SBSIZE;
         DBG_PRINT("large, ptr: %p", ptr);
         return (void*)ptr;
     }
@@ -713,8 +1021,9 @@ void* BaseMeta::do_malloc(size_t size, TCaches& t_caches){
     TCacheBin* cache = &t_caches.t_cache[sc_idx];
     // fill cache if needed
     if (UNLIKELY(cache->get_block_num() == 0))
-        fill_cache(sc_idx, cache);
+        fill_cache(sc_idx, cache, t_caches);
 
+    cache->stats.alloc_num++;
     return cache->pop_block();
 }
 void BaseMeta::do_free(void* ptr, TCaches& t_caches){
@@ -730,189 +1039,367 @@ void BaseMeta::do_free(void* ptr, TCaches& t_caches){
     // large allocation case
     if (UNLIKELY(!sc_idx)) {
         char* superblock = desc->superblock.to_addr(_rgs);
+        t_caches.t_cache[0].stats.free_num++;
+        t_caches.t_cache[0].stats.sb_put_num += desc->block_size / SBSIZE;
         // free superblock
         large_sb_retire(superblock, desc->block_size);
         return;
     }
 
+    free_to_cache(ptr, sc_idx, t_caches);
+}
+void BaseMeta::do_free_sized(void* ptr, size_t size, TCaches& t_caches){
+    if(ptr==nullptr) return;
+    // large blocks need their descriptor anyway
+    if (UNLIKELY(size > MAX_SZ)) {
+        do_free(ptr, t_caches);
+        return;
+    }
+    assert(_rgs->in_range(SB_IDX,ptr));
+    size_t sc_idx = get_sizeclass(size);
+    assert(sc_idx == desc_lookup(ptr)->heap.to_addr(_rgs)->sc_idx);
+    free_to_cache(ptr, sc_idx, t_caches);
+}
+inline void BaseMeta::free_to_cache(void* ptr, size_t sc_idx, TCaches& t_caches){
     TCacheBin* cache = &t_caches.t_cache[sc_idx];
     const SizeClassData* sc = get_sizeclass_by_idx(sc_idx);
 
     // flush cache if need
     if (UNLIKELY(cache->get_block_num() >= sc->cache_block_num))
-        flush_cache(sc_idx, cache);
+        flush_cache(sc_idx, cache, &t_caches);
 
+    cache->stats.free_num++;
     cache->push_block((char*)ptr);
 }
 
 /*
- * function GarbageCollection::operator()
- * 
+ * class GarbageCollection
+ *
  * Description:
- *  Sequential stop-the-world garbage collection routine for Ralloc when dirty
- *  segment exists.
+ *  Parallel stop-the-world garbage collection routine for Ralloc when dirty
+ *  segment exists. Phases are separated by barriers and timed separately.
  */
-void GarbageCollection::operator() () {
-    // Wentao: commenting this out since we don't use this routine in
-    // Montage and I don't want to fix issues brought into this
-    // routine with multi-instance support...
-#if 0
-    printf("Start garbage collection...\n");
-    auto start = high_resolution_clock::now(); 
-    // Step 0: initialize all transient data
-    printf("Initializing all transient data...");
-    base_md->avail_sb.off.store(nullptr); // initialize avail_sb
-    for(int i = 0; i< MAX_SZ_IDX; i++) {
-        // initialize partial list of each heap
-        base_md->heaps[i].partial_list.off.store(nullptr);
-    }
-    printf("Initialized!\n");
+// index of the collecting thread, used to pick its task queue
+static thread_local int gc_tid = 0;
+
+GarbageCollection::GarbageCollection(BaseMeta* b, int thd) :
+    base_md(b),
+    thd_num(std::max(thd, 1)),
+    marks(nullptr),
+    pending(0){
+    Regions* _rgs = base_md->_rgs;
+    sb_base = _rgs->lookup(SB_IDX);
+    char* sb_end = _rgs->regions[SB_IDX]->curr_addr_ptr->load();
+    sb_num = (((uint64_t)sb_end)>>SB_SHIFT) - (((uint64_t)sb_base)>>SB_SHIFT);
+    head = new uint64_t[sb_num];
+    bit_off = new uint64_t[sb_num];
+    queues = new TaskQueue[thd_num];
+}
+
+GarbageCollection::~GarbageCollection(){
+    delete[] head;
+    delete[] bit_off;
+    delete[] marks;
+    delete[] queues;
+}
+
+char* GarbageCollection::mark_blk(char* ptr){
+    if(ptr < sb_base + SBSIZE || ptr >= sb_base + (sb_num<<SB_SHIFT))
+        return nullptr; // return if not in range
+    uint64_t h = head[(uint64_t)(ptr - sb_base)>>SB_SHIFT];
+    if(h == NO_SB)
+        return nullptr; // return if sb isn't in use
+    char* sb = sb_base + (h<<SB_SHIFT);
+    Descriptor* desc = base_md->desc_lookup(sb);
+    size_t sc_idx = desc->heap.to_addr(base_md->_rgs)->sc_idx;
+    uint32_t idx = 0;
+    if(sc_idx != 0) {
+        // small block; skip the leftover at the end of sb
+        if(ptr >= sb + (uint64_t)desc->maxcount*desc->block_size)
+            return nullptr;
+        idx = base_md->compute_idx(sb, ptr, sc_idx);
+    } // else large block, which owns bit 0 of its sb
+    uint64_t bit = 1ULL<<(idx%64);
+    if(marks[bit_off[h]+idx/64].fetch_or(bit) & bit)
+        return nullptr; // already marked
+    return sb + (uint64_t)idx*desc->block_size;
+}
+
+void GarbageCollection::push(const Task& t){
+    // count the task before it becomes visible so that pending never
+    // drops to 0 while any task is left
+    pending.fetch_add(1);
+    TaskQueue& q = queues[gc_tid];
+    std::lock_guard<std::mutex> lk(q.lk);
+    q.tasks.push_back(t);
+}
 
-    // Step 1: mark all accessible blocks from roots
-    printf("Marking reachable nodes...");
+bool GarbageCollection::pop(int tid, Task& t){
+    // the owner works on its latest tasks, in depth-first order
+    TaskQueue& q = queues[tid];
+    std::lock_guard<std::mutex> lk(q.lk);
+    if(q.tasks.empty()) return false;
+    t = q.tasks.back();
+    q.tasks.pop_back();
+    return true;
+}
 
-    // First mark all root nodes
+bool GarbageCollection::steal(int tid, Task& t){
+    // thieves take the oldest task, closer to the roots
+    for(int i = 1; i < thd_num; i++) {
+        TaskQueue& q = queues[(tid+i)%thd_num];
+        std::lock_guard<std::mutex> lk(q.lk);
+        if(q.tasks.empty()) continue;
+        t = q.tasks.front();
+        q.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void GarbageCollection::mark_roots(){
     for(int i = 0; i < MAX_ROOTS; i++) {
-        if(!base_md->roots[i].is_null()) {
-            ralloc::roots_filter_func[i](base_md->roots[i], *this);
+        if(base_md->roots[i].is_null()) continue;
+        if(base_md->roots_filter_func[i]) {
+            base_md->roots_filter_func[i](base_md->roots[i], *this);
+        } else {
+            // type of root i is unknown; filter it conservatively
+            mark_func(base_md->roots[i].cast_to<char>(base_md->_rgs));
         }
     }
-    while(!to_filter_node.empty()) {
-        // pop nodes from the stack and call filter function of each node
-        auto func = to_filter_func.top();
-        auto node = to_filter_node.top();
-        to_filter_node.pop();
-        to_filter_func.pop();
-        func(node,*this);
-    }
-    printf("Done!\nReachable blocks = %lu\n", marked_blk.size());
-
-    // Step 2: sweep phase, update variables.
-    printf("Reconstructing metadata...");
-    char* curr_sb = _rgs->translate(SB_IDX, reinterpret_cast<char*>(SBSIZE)); // starting from first sb
-    Descriptor* curr_desc = base_md->desc_lookup(curr_sb);
-    auto curr_marked_blk = marked_blk.begin();
-    char* sb_end = _rgs->regions[SB_IDX]->curr_addr_ptr->load();
-    Descriptor* avail_sb = nullptr; // head of new free sb list
-
-    // go through all sb in the region
-    while(curr_sb < sb_end) {
-        Anchor anchor(0, 0, SB_EMPTY);
-        char* free_blocks_head = nullptr;
-        char* last_possible_free_block = curr_sb;
-
-        // go through all curr_marked_blk that's in this sb
-        while (curr_marked_blk!=marked_blk.end() && 
-                ((uint64_t)curr_sb>>SB_SHIFT) == ((uint64_t)(*curr_marked_blk)>>SB_SHIFT)) 
-        { 
-            // curr_marked_blk doesn't reach the end of marked_blk and curr_marked_blk is in curr_sb
-
-            if(curr_desc->heap != nullptr &&
-                curr_desc->superblock.assign(_rgs, curr_sb)) {
-                // false positive shouldn't enter here
-                if(curr_desc->heap->sc_idx == 0) {
-                    // large sb that's in use
-                    // assert((*curr_marked_blk) == curr_sb); //allow large sb
-                    // to be pointed at in the middle
-                    assert(curr_desc->maxcount == 1);
-                    anchor.state = SB_FULL; // set it as full
-                } 
-                else {
-                    // small sb that's in use
-                    anchor.state = SB_PARTIAL;
-                    for(char* free_block = last_possible_free_block; 
-                        free_block < (*curr_marked_blk); free_block+=curr_desc->block_size){
-                        // put last_possible_free_block...(curr_marked_blk-1) to free blk list
-                        (*reinterpret_cast<pptr<char>*>(free_block)) = free_blocks_head;
-                        free_blocks_head = free_block;
-                        anchor.count++;
-                    }
-                    last_possible_free_block = (*curr_marked_blk)+curr_desc->block_size;
-                }
-            }
-            curr_marked_blk++;
-        }
-        if(anchor.state == SB_EMPTY) {
-            // curr_sb isn't in use
-            new (curr_desc) Descriptor();
-            curr_desc->next_free.store(avail_sb);
-            avail_sb = curr_desc;
-            curr_sb+=SBSIZE;
-            curr_desc++;
-        } else {
-            if(curr_desc->heap->sc_idx == 0) {
-                // large sb that's in use
+}
 
-                anchor.avail = 0;
-                anchor.count = 0;
-                anchor.state = SB_FULL;
+void GarbageCollection::mark_from(int tid){
+    Task t;
+    while(true) {
+        if(pop(tid, t) || steal(tid, t)) {
+            t.filter(t.blk, *this);
+            pending.fetch_sub(1);
+        } else if(pending.load() == 0) {
+            // no task is queued or being filtered
+            break;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
 
-                // set transient variables in curr_desc
-                curr_desc->next_free.store(nullptr);
-                curr_desc->next_partial.store(nullptr);
-                curr_desc->anchor.store(anchor);
+void GarbageCollection::classify_sbs(uint64_t begin, uint64_t end){
+    for(uint64_t i = begin; i < end; i++) {
+        char* sb = sb_base + (i<<SB_SHIFT);
+        Descriptor* desc = base_md->desc_lookup(sb);
+        if(desc->heap.is_null() || desc->block_size == 0 || desc->maxcount == 0 ||
+            desc->superblock.to_addr(base_md->_rgs) != sb) {
+            head[i] = NO_SB;
+        } else {
+            head[i] = i;
+        }
+    }
+}
 
-                // move curr_sb to the sb next to this large sb
-                curr_sb+=curr_desc->block_size;
-                curr_desc = base_md->desc_lookup(curr_sb);
-            } else {
-                // small sb that's in use
-                for(char* free_block = last_possible_free_block; 
-                    free_block < curr_sb+curr_desc->maxcount*curr_desc->block_size; free_block+=curr_desc->block_size){
-                    // put last_possible_free_block...(curr_sb+SBSIZE-1) to free blk list
-                    (*reinterpret_cast<pptr<char>*>(free_block)) = free_blocks_head;
-                    free_blocks_head = free_block;
-                    anchor.count++;
+size_t GarbageCollection::sweep_sbs(uint64_t begin, uint64_t end){
+    Regions* _rgs = base_md->_rgs;
+    size_t reachable = 0;
+    // free sbs are chained locally and spliced into avail_sb at the end
+    Descriptor* free_head[MAX_NUMA_NODES] = {nullptr};
+    Descriptor* free_tail[MAX_NUMA_NODES] = {nullptr};
+    auto retire = [&](Descriptor* desc, uint32_t node){
+        // clamp in case the descriptor was never initialized by this heap
+        if(node >= (uint32_t)base_md->numa_num) node = 0;
+        new (desc) Descriptor(node);
+        desc->next_free.store(free_head[node]);
+        if(free_head[node] == nullptr) free_tail[node] = desc;
+        free_head[node] = desc;
+    };
+    for(uint64_t i = begin; i < end; i++) {
+        char* sb = sb_base + (i<<SB_SHIFT);
+        Descriptor* desc = base_md->desc_lookup(sb);
+        if(head[i] == NO_SB) {
+            // curr sb isn't in use
+            retire(desc, desc->node);
+            continue;
+        }
+        if(head[i] != i) continue; // in the middle of a large block
+        std::atomic<uint64_t>* sb_marks = &marks[bit_off[i]];
+        Anchor anchor(0, 0, SB_FULL);
+        if(desc->heap.to_addr(_rgs)->sc_idx == 0) {
+            // large block
+            if(!(sb_marks[0].load() & 1)) {
+                uint32_t node = desc->node;
+                uint64_t span = std::min<uint64_t>(desc->block_size>>SB_SHIFT, sb_num-i);
+                for(uint64_t k = 0; k < span; k++) {
+                    retire(desc+k, node);
                 }
-                if(anchor.count == 0) { 
-                    // this sb is fully used
-                    anchor.avail = curr_desc->maxcount;
-                    anchor.state = SB_FULL;
-
-                    // set transient variables in curr_desc
-                    curr_desc->next_free.store(nullptr);
-                    curr_desc->next_partial.store(nullptr);
-                    curr_desc->anchor.store(anchor);
-                } else {
-                    // this sb is partially used
-                    assert(free_blocks_head != nullptr);
-                    assert((uint64_t)(free_blocks_head - curr_sb)%curr_desc->block_size == 0);
-                    anchor.avail = (uint64_t)(free_blocks_head - curr_sb)/curr_desc->block_size;
-                    anchor.state = SB_PARTIAL; // it must be SB_PARTIAL already but we assign it anyway
-
-                    // set transient variables in curr_desc
-                    curr_desc->next_free.store(nullptr);
-                    base_md->heap_push_partial(curr_desc);
-                    curr_desc->anchor.store(anchor);
+                continue;
+            }
+            reachable++;
+        } else {
+            // small sb; chain unmarked blocks from the end so that the list
+            // is in address order
+            uint32_t block_size = desc->block_size;
+            char* free_blocks_head = nullptr;
+            uint32_t count = 0;
+            for(int64_t idx = desc->maxcount-1; idx >= 0; idx--) {
+                if(sb_marks[idx/64].load() & (1ULL<<(idx%64))) {
+                    reachable++;
+                    continue;
                 }
-                // move curr_sb and curr_desc to next sb
-                curr_sb+=SBSIZE;
-                curr_desc++;
+                char* free_block = sb + idx*block_size;
+                (*reinterpret_cast<pptr<char>*>(free_block)) = free_blocks_head;
+                FLUSH(free_block);
+                free_blocks_head = free_block;
+                count++;
+            }
+            if(count == desc->maxcount) {
+                // no block is reachable
+                retire(desc, desc->node);
+                continue;
+            }
+            if(count == 0) {
+                // this sb is fully used
+                anchor.avail = desc->maxcount;
+            } else {
+                // this sb is partially used
+                anchor.avail = (uint64_t)(free_blocks_head - sb)/block_size;
+                anchor.count = count;
+                anchor.state = SB_PARTIAL;
             }
         }
+        // set transient variables in desc
+        desc->next_free.store(nullptr);
+        desc->next_partial.store(nullptr);
+        desc->anchor.store(anchor);
+        if(anchor.state == SB_PARTIAL)
+            base_md->heap_push_partial(desc);
+        FLUSH(desc);
     }
-    // store head of new free sb list into base_md
-    ptr_cnt<Descriptor> tmp_avail_sb(avail_sb, 0);
-    base_md->avail_sb.store(_rgs, tmp_avail_sb);
-    printf("Reconstructed! \n");
-    auto stop = high_resolution_clock::now(); 
-    assert(curr_marked_blk == marked_blk.end());
-    auto duration = duration_cast<milliseconds>(stop - start);
-    cout << "Time elapsed = " << duration.count() <<" ms on GC."<<endl;
-
-
-    printf("Flushing recovered data...");
-    _rgs->flush_region(DESC_IDX);
-    _rgs->flush_region(SB_IDX);
-    char* addr_to_flush = reinterpret_cast<char*>(base_md);
-    // flush values in BaseMeta, including avail_sb and partial lists
-    for(size_t i = 0; i < sizeof(BaseMeta); i += CACHELINE_SIZE) {
-        addr_to_flush += CACHELINE_SIZE;
-        FLUSH(addr_to_flush);
+    for(int node = 0; node < MAX_NUMA_NODES; node++) {
+        if(free_head[node] == nullptr) continue;
+        ptr_cnt<Descriptor> oldhead = base_md->avail_sb[node].load(_rgs);
+        ptr_cnt<Descriptor> newhead;
+        do{
+            free_tail[node]->next_free.store(oldhead.get_ptr());
+            newhead.set(free_head[node], oldhead.get_counter()+1);
+        }while(!base_md->avail_sb[node].compare_exchange_weak(_rgs,oldhead,newhead));
     }
     FLUSHFENCE;
+    return reachable;
+}
+
+size_t GarbageCollection::operator() () {
+    printf("Start garbage collection...\n");
+    // Step 0: initialize all transient data
+    for(int n = 0; n < MAX_NUMA_NODES; n++) {
+        base_md->avail_sb[n].off.store(nullptr); // initialize avail_sb
+        for(int b = 0; b < LARGE_BUCKETS; b++) {
+            base_md->large_free[n][b].off.store(nullptr);
+        }
+        for(int i = 0; i< MAX_SZ_IDX; i++) {
+            // initialize partial list of each heap
+            base_md->heaps[n][i].partial_list.off.store(nullptr);
+        }
+    }
+
+    // each thread takes a range of sbs, starting from the first sb
+    std::vector<uint64_t> range_begin(thd_num+1);
+    uint64_t sb_stride = sb_num > 1 ? (sb_num-1)/thd_num : 0;
+    for(int i = 0; i < thd_num; i++) {
+        range_begin[i] = std::min<uint64_t>(1+i*sb_stride, std::max<uint64_t>(sb_num, 1));
+    }
+    range_begin[thd_num] = std::max<uint64_t>(sb_num, 1);
+    std::vector<uint64_t> range_words(thd_num, 0);
+    std::atomic<size_t> reachable(0);
+    pthread_barrier_t sync_point;
+    pthread_barrier_init(&sync_point, NULL, thd_num);
+    std::vector<std::thread> workers;
+
+    auto gc_begin = high_resolution_clock::now();
+    auto begin = gc_begin;
+    auto report = [&](const char* phase){
+        auto end = high_resolution_clock::now();
+        std::cout << "Spent "
+                  << duration_cast<milliseconds>(end - begin).count()
+                  << "ms in " << phase << std::endl;
+        begin = high_resolution_clock::now();
+    };
+    for(int tid = 0; tid < thd_num; tid++) {
+        workers.emplace_back(std::thread([&, tid]() {
+            gc_tid = tid;
+            const uint64_t rb = range_begin[tid], re = range_begin[tid+1];
+            // Step 1: find in-use sbs and lay out the mark bitmap
+            classify_sbs(rb, re);
+            pthread_barrier_wait(&sync_point);
+            for(uint64_t i = rb; i < re; i++) {
+                if(head[i] != i) continue;
+                Descriptor* desc = base_md->desc_lookup(sb_base + (i<<SB_SHIFT));
+                if(desc->heap.to_addr(base_md->_rgs)->sc_idx == 0) {
+                    // the following sbs of a large block belong to it
+                    uint64_t span = std::min<uint64_t>(desc->block_size>>SB_SHIFT, sb_num-i);
+                    for(uint64_t k = 1; k < span; k++) {
+                        head[i+k] = i;
+                    }
+                }
+            }
+            pthread_barrier_wait(&sync_point);
+            uint64_t words = 0;
+            for(uint64_t i = rb; i < re; i++) {
+                if(head[i] != i) continue;
+                Descriptor* desc = base_md->desc_lookup(sb_base + (i<<SB_SHIFT));
+                bit_off[i] = words;
+                words += (desc->maxcount+63)/64;
+            }
+            range_words[tid] = words;
+            pthread_barrier_wait(&sync_point);
+            if(tid == 0) {
+                uint64_t total = 0;
+                for(int i = 0; i < thd_num; i++) {
+                    uint64_t w = range_words[i];
+                    range_words[i] = total;
+                    total += w;
+                }
+                marks = new std::atomic<uint64_t>[std::max<uint64_t>(total, 1)]();
+            }
+            pthread_barrier_wait(&sync_point);
+            for(uint64_t i = rb; i < re; i++) {
+                if(head[i] == i) bit_off[i] += range_words[tid];
+            }
+            pthread_barrier_wait(&sync_point);
+            if(tid == 0) {
+                report("initialization");
+                // Step 2: mark all accessible blocks from roots
+                mark_roots();
+            }
+            pthread_barrier_wait(&sync_point);
+            mark_from(tid);
+            pthread_barrier_wait(&sync_point);
+            if(tid == 0) report("marking");
+            // Step 3: sweep phase, rebuild free lists
+            pthread_barrier_wait(&sync_point);
+            reachable.fetch_add(sweep_sbs(rb, re));
+            pthread_barrier_wait(&sync_point);
+            if(tid == 0) {
+                report("sweeping");
+                // flush values in BaseMeta, including avail_sb and partial lists
+                char* addr_to_flush = reinterpret_cast<char*>(base_md);
+                for(size_t i = 0; i < sizeof(BaseMeta); i += CACHELINE_SIZE) {
+                    FLUSH(addr_to_flush + i);
+                }
+                FLUSHFENCE;
+                report("flushing");
+            }
+        })); // workers.emplace_back()
+    } // for (thd_num)
+    for(auto& worker : workers) {
+        if(worker.joinable()) {
+            worker.join();
+        }
+    }
+    pthread_barrier_destroy(&sync_point);
+    auto gc_end = high_resolution_clock::now();
+    printf("Reachable blocks = %lu\n", reachable.load());
+    cout << "Time elapsed = " << duration_cast<milliseconds>(gc_end - gc_begin).count() <<" ms on GC."<<endl;
     printf("Garbage collection Completed!\n");
-#endif
+    return reachable.load();
 }
 
 int InuseRecovery::iterator::update_status_dirty(){
@@ -959,13 +1446,15 @@ int InuseRecovery::iterator::update_status_clean(){
 }
 
 void InuseRecovery::iterator::set_sb_free(){
-    new (curr_desc) Descriptor();
-    ptr_cnt<Descriptor> oldhead = base_md->avail_sb.load(base_md->_rgs);
+    // clamp in case the descriptor was never initialized by this heap
+    int node = curr_desc->node < (uint32_t)base_md->numa_num ? curr_desc->node : 0;
+    new (curr_desc) Descriptor(node);
+    ptr_cnt<Descriptor> oldhead = base_md->avail_sb[node].load(base_md->_rgs);
     ptr_cnt<Descriptor> newhead;
     do{
         curr_desc->next_free.store(oldhead.get_ptr());
         newhead.set(curr_desc, 0);
-    }while(!base_md->avail_sb.compare_exchange_weak(base_md->_rgs,oldhead,newhead));
+    }while(!base_md->avail_sb[node].compare_exchange_weak(base_md->_rgs,oldhead,newhead));
 }
 
 bool InuseRecovery::iterator::action_at_new_sb_dirty(){
@@ -17,9 +17,9 @@
 #include <atomic>
 #include <iostream>
 #include <functional>
-#include <set>
 #include <vector>
-#include <stack>
+#include <deque>
+#include <mutex>
 #include <utility>
 #include <pthread.h>
 
@@ -246,14 +246,21 @@ struct Descriptor {
     RP_PERSIST CrossPtr<ProcHeap, META_IDX> heap;
     RP_PERSIST uint32_t block_size; // block size acquired from sc
     RP_PERSIST uint32_t maxcount; // block number acquired from sc
-    Descriptor() noexcept :
+    // NUMA node the superblock is bound to; survives reinitialization
+    RP_PERSIST uint32_t node;
+    // number of sbs in the free large run this desc heads, linked by
+    // next_free in BaseMeta::large_free; 0 otherwise
+    RP_TRANSIENT uint32_t run_len;
+    Descriptor(uint32_t n = 0) noexcept :
         next_free(nullptr),
         next_partial(nullptr),
         anchor(0),
         superblock(nullptr),
         heap(nullptr),
         block_size(0),
-        maxcount(0){
+        maxcount(0),
+        node(n),
+        run_len(0){
             FLUSH(this);
             FLUSHFENCE;
         };
@@ -286,43 +293,79 @@ public:
  * 
  * Descrition:
  *  A function class to do garbage collection during a dirty restart.
- *  Will be instantiated when BaseMeta::restart() is called and the segment is
- *  dirty.
+ *  Will be instantiated by Ralloc::collect() when the segment is dirty.
+ *
+ *  Marking sets one bit per block in a bitmap laid out superblock by
+ *  superblock, with the bit of a block found by compute_idx. thd_num
+ *  threads trace from the roots, each working on its own queue of marked
+ *  blocks and stealing from others' when it runs dry. Sweeping then
+ *  rebuilds free blocks, partial lists and free superblocks, with each
+ *  thread taking a range of superblocks.
  */
+class BaseMeta;
 class GarbageCollection{
 public:
-    std::set<char*> marked_blk;
-    std::stack<char*> to_filter_node;
-    std::stack<std::function<void(char*,GarbageCollection& gc)>> to_filter_func;
+    // filter function of a marked block, which calls mark_func on blocks
+    // the block points to
+    typedef void (*filter_t)(char*, GarbageCollection&);
+    struct Task {
+        char* blk;
+        filter_t filter;
+    };
 
-    GarbageCollection():marked_blk(){};
+    GarbageCollection(BaseMeta* b, int thd);
+    ~GarbageCollection();
 
-    void operator() ();
+    // return the number of reachable blocks
+    size_t operator() ();
 
-    // return true if ptr is a valid and unmarked pointer, otherwise false
+    // mark the block ptr points into, and queue it for filtering if it's a
+    // valid and unmarked block
     template<class T>
     inline void mark_func(T* ptr){
-        #if 0
-        void* addr = reinterpret_cast<void*>(ptr);
-        // Step 1: check if it's a valid pptr
-        if(UNLIKELY(!ralloc::_rgs->in_range(SB_IDX, addr))) 
-            return; // return if not in range
-        auto res = marked_blk.find(reinterpret_cast<char*>(addr));
-        if(res == marked_blk.end()){
-            // Step 2: mark potential pptr
-            marked_blk.insert(reinterpret_cast<char*>(addr));
-            // Step 3: push ptr to stack
-            to_filter_node.push(reinterpret_cast<char*>(addr));
-            to_filter_func.push([](char* ptr,GarbageCollection& gc){
-                    gc.filter_func(reinterpret_cast<T*>(ptr));
-                });
+        char* blk = mark_blk(reinterpret_cast<char*>(ptr));
+        if(blk != nullptr){
+            push(Task{blk, [](char* p, GarbageCollection& gc){
+                gc.filter_func(reinterpret_cast<T*>(p));
+            }});
         }
-        return;
-        #endif
     }
 
     template<class T>
     inline void filter_func(T* ptr);
+
+private:
+    static const uint64_t NO_SB = UINT64_MAX;
+    struct alignas(CACHELINE_SIZE) TaskQueue {
+        std::mutex lk;
+        std::deque<Task> tasks;
+    };
+    BaseMeta* base_md;
+    const int thd_num;
+    // sbs [1, sb_num) are collected
+    char* sb_base;
+    uint64_t sb_num;
+    // head[i]: index of the in-use sb that sb i belongs to, i itself if
+    // sb i starts a small sb or large block, or NO_SB if it's unused
+    uint64_t* head;
+    // bit_off[i]: first word of sb i's bits in marks, valid if head[i] == i
+    uint64_t* bit_off;
+    std::atomic<uint64_t>* marks;
+    TaskQueue* queues;
+    // tasks pushed but not yet filtered
+    std::atomic<uint64_t> pending;
+
+    // return start of the block ptr points into if it gets marked by this
+    // call, otherwise nullptr
+    char* mark_blk(char* ptr);
+    void push(const Task& t);
+    bool pop(int tid, Task& t);
+    bool steal(int tid, Task& t);
+    void mark_roots();
+    void mark_from(int tid);
+    void classify_sbs(uint64_t begin, uint64_t end);
+    // return the number of reachable blocks in sbs [begin, end)
+    size_t sweep_sbs(uint64_t begin, uint64_t end);
 };
 
 #include <iterator>
@@ -386,18 +429,57 @@ public:
 };
 
 
+/*
+ * struct NumaLayout
+ * 
+ * Description:
+ *  NUMA layout applied to heaps created or restarted afterwards, set by
+ *  Ralloc::set_numa() before construction.
+ *  os_index[i] is the OS id of node i, and node_of_tid[t] is the node
+ *  thread t allocates from (node 0 if t is out of range).
+ *  With a single node, the default, nothing is bound.
+ */
+struct NumaLayout {
+    int num = 1;
+    int os_index[MAX_NUMA_NODES] = {0};
+    std::vector<int> node_of_tid;
+};
+namespace ralloc{
+    extern NumaLayout numa;
+}
+
 /*
  * class BaseMeta
  * 
  * Description:
  *  The core data structure in this file.
  *  Contains essential metadata for Ralloc, including:
- *      avail_sb: superblock free list 
+ *      avail_sb: superblock free lists, one per NUMA node
  *      dirty_attr, dirty_mtx: dirty flag
- *      heaps: sizeclasses and their partial lists
+ *      heaps: sizeclasses and their partial lists, one set per NUMA node
  *      roots: pointers to persistent roots
  *  do_malloc() and do_free() are the real entry point of Ralloc's malloc and
- *  free routines.
+ *  free routines. do_free_sized() is free with the size the block was
+ *  allocated with, which saves the descriptor lookup for small blocks.
+ *  A large block that the sb region can't grow to fit makes do_malloc()
+ *  return nullptr with errno set to ENOMEM.
+ *
+ *  Each superblock belongs to the node its range of sb region was bound to
+ *  (Descriptor::node), and goes back to that node's free list or heap when
+ *  it's freed, whichever thread frees it. Threads take superblocks from
+ *  their own node first and steal from other nodes only when the sb region
+ *  is exhausted.
+ *
+ *  Each thread also keeps a few empty sbs of its node in TCaches, taken
+ *  from and returned to avail_sb in batches. They have fresh descriptors
+ *  like those in avail_sb, so recovery finds them free after a crash.
+ *
+ *  Freed large blocks stay whole as runs of sbs in large_free, bucketed
+ *  by length, and are reused by large allocations of the same or, after
+ *  splitting, smaller length. Adjacent runs are merged only when no run
+ *  fits. Only the head desc of a run is set, so after a crash recovery
+ *  sees its sbs as free sbs. When avail_sb runs dry, small sbs are carved
+ *  from large runs before the region grows.
  */
 class BaseMeta {
 public:
@@ -405,14 +487,22 @@ public:
     // constructor or transient_reset
     RP_TRANSIENT Regions* _rgs;
     RP_TRANSIENT int thd_num;
-    // unused small sb
-    RP_TRANSIENT AtomicCrossPtrCnt<Descriptor, DESC_IDX> avail_sb;
+    // number of NUMA nodes the heap was created with; fixed afterwards
+    RP_PERSIST int numa_num;
+    // OS id of each node for mbind, or -1 for not binding
+    RP_TRANSIENT int numa_os_index[MAX_NUMA_NODES];
+    // unused small sb of each node
+    RP_TRANSIENT AtomicCrossPtrCnt<Descriptor, DESC_IDX> avail_sb[MAX_NUMA_NODES];
+    // free large runs of each node, see LARGE_BUCKETS
+    RP_TRANSIENT AtomicCrossPtrCnt<Descriptor, DESC_IDX> large_free[MAX_NUMA_NODES][LARGE_BUCKETS];
+    // set while a thread merges the large runs of the node
+    RP_TRANSIENT std::atomic<bool> large_coalescing[MAX_NUMA_NODES];
     RP_PERSIST pthread_mutexattr_t dirty_attr;
     RP_PERSIST pthread_mutex_t dirty_mtx;
     // fake_dirty is set only in RP_simulate_crash and is transient. Don't call RP_simulate_crash if there may be real crash
     RP_PERSIST bool fake_dirty = false;
 
-    RP_PERSIST ProcHeap heaps[MAX_SZ_IDX];
+    RP_PERSIST ProcHeap heaps[MAX_NUMA_NODES][MAX_SZ_IDX];
     RP_PERSIST CrossPtr<char, SB_IDX> roots[MAX_ROOTS];
     RP_TRANSIENT std::function<void(const CrossPtr<char, SB_IDX>&, 
         GarbageCollection&)> roots_filter_func[MAX_ROOTS];
@@ -421,6 +511,10 @@ public:
     inline void transient_reset(Regions* rgs_, int thd_num_){
         _rgs = rgs_;
         thd_num = thd_num_;
+        load_numa_layout();
+        for(int n = 0; n < MAX_NUMA_NODES; n++) {
+            large_coalescing[n].store(false);
+        }
     }
     BaseMeta(Regions* r) noexcept;
     ~BaseMeta(){
@@ -431,6 +525,8 @@ public:
     }
     void* do_malloc(size_t size, TCaches& t_caches);
     void do_free(void* ptr, TCaches& t_caches);
+    // size must map to the same size class as the size ptr was allocated with
+    void do_free_sized(void* ptr, size_t size, TCaches& t_caches);
     // this func can be called only once during restart
     bool is_dirty();
     // set_dirty must be called AFTER is_dirty
@@ -504,10 +600,14 @@ public:
     }
 
 private:
-    // void* expand_sb(size_t sz);
+    // grow desc region to cover descriptors of all sbs below sb_end;
+    // false if it can't grow that far
+    bool cover_desc(char* sb_end);
+    // expand sb region by size, with descriptors covered beforehand
+    int expand_sb(void** ret, size_t alignment, size_t size);
     // void expand_small_sb();
     // void* expand_get_small_sb();
-    void* expand_get_large_sb(size_t sz);
+    void* expand_get_large_sb(size_t sz, int node);
 
     // func on size class
     size_t get_sizeclass(size_t size);
@@ -516,11 +616,20 @@ private:
     // compute block index in superblock by addr to sb, block, and sc index
     uint32_t compute_idx(char* superblock, char* block, size_t sc_idx);
 
+    // func on NUMA layout
+    // refresh numa_os_index from ralloc::numa
+    void load_numa_layout();
+    // bind [start, start+len) of sb region to node
+    void bind_sb_range(void* start, size_t len, int node);
+
     // func on cache
-    void fill_cache(size_t sc_idx, TCacheBin* cache);
+    void fill_cache(size_t sc_idx, TCacheBin* cache, TCaches& t_caches);
 public:
     // we need to call this function to flush TLS cache during exit
-    void flush_cache(size_t sc_idx, TCacheBin* cache);
+    // emptied sbs go to the reserve of t_caches if given
+    void flush_cache(size_t sc_idx, TCacheBin* cache, TCaches* t_caches=nullptr);
+    // give all sbs in the reserve of t_caches back to free_sb
+    void flush_sb_reserve(TCaches& t_caches);
     // find desc of the block
     // we need to call them in GC
     Descriptor* desc_lookup(const char* ptr);
@@ -529,26 +638,59 @@ public:
 
 private:
     // helper func
-    void heap_push_partial(Descriptor* desc);
-    Descriptor* heap_pop_partial(ProcHeap* heap);
-    // fill cache from a partially used sb in heap[sc_idx]
-    void malloc_from_partial(size_t sc_idx, TCacheBin* cache, size_t& block_num);
-    // fill cache by allocating a new sb in heap[sc_idx]
-    void malloc_from_newsb(size_t sc_idx, TCacheBin* cache, size_t& block_num);
+    // failed CASes on the partial list are added to stats if given
+    void heap_push_partial(Descriptor* desc, TCacheStats* stats=nullptr);
+    Descriptor* heap_pop_partial(ProcHeap* heap, TCacheStats* stats=nullptr);
+    // push ptr of size class sc_idx into the thread's cache
+    void free_to_cache(void* ptr, size_t sc_idx, TCaches& t_caches);
+    // fill cache from a partially used sb in heaps[node][sc_idx]
+    void malloc_from_partial(size_t sc_idx, TCacheBin* cache, size_t& block_num, int node, TCaches& t_caches);
+    // fill cache by allocating a new sb, preferably from the node of t_caches
+    void malloc_from_newsb(size_t sc_idx, TCacheBin* cache, size_t& block_num, TCaches& t_caches);
     // alloc function to call for large block
-    void* alloc_large_block(size_t sz);
-
-    // add all newly allocated sbs to free_sb
-    void organize_sb_list(void* start, uint64_t count);
-    // get one free sb or allocate a new space for sbs
-    void* small_sb_alloc(size_t size);
-    // free the superblock sb points to
-    void small_sb_retire(void* sb, size_t size);
-
-    // allocate a large sb
-    void* large_sb_alloc(size_t size);
-    // retire a large sb
+    void* alloc_large_block(size_t sz, int node);
+
+    // add all newly allocated sbs to free_sb of node
+    void organize_sb_list(void* start, uint64_t count, int node);
+    // pop one sb from free_sb of node, or nullptr if it's empty
+    void* avail_sb_pop(int node);
+    // pop up to max sbs from free_sb of node with a single CAS, returning a
+    // nullptr-terminated chain of their descs and its length in num
+    Descriptor* avail_sb_pop_chain(int node, uint32_t max, uint32_t& num);
+    // push the chain of descs first...last to free_sb of node
+    void avail_sb_push_chain(Descriptor* first, Descriptor* last, int node);
+    // get one free sb of node or allocate a new space for sbs, falling
+    // back to other nodes' free sbs; nullptr if sb region runs out
+    void* small_sb_alloc(size_t size, int node);
+    // free the superblock sb points to, into the reserve of t_caches if
+    // it's given and of the same node
+    void small_sb_retire(void* sb, size_t size, TCaches* t_caches=nullptr);
+    // take an empty sb from the reserve of t_caches, refilling it from
+    // free_sb in a batch; falls back to small_sb_alloc
+    void* reserve_sb_alloc(TCaches& t_caches);
+    // put a reinitialized desc to the reserve, overflowing a batch to free_sb
+    void reserve_sb_retire(Descriptor* desc, TCaches& t_caches);
+
+    // allocate a large sb, reusing a free large run of node if possible;
+    // nullptr if sb region runs out
+    void* large_sb_alloc(size_t size, int node);
+    // retire a large sb as a free large run
     void large_sb_retire(void* sb, size_t size);
+    // push the free run of len sbs headed by desc to large_free of node
+    void large_free_push(Descriptor* desc, uint64_t len, int node);
+    // pop a run from bucket b of large_free of node, or nullptr
+    Descriptor* large_free_pop(int node, int b);
+    // get a run of exactly len sbs of node, splitting a longer one if
+    // needed; nullptr if none is long enough
+    Descriptor* large_free_get(uint64_t len, int node);
+    // merge adjacent free runs of node; if another thread is merging
+    // them, wait for it instead
+    void large_free_coalesce(int node);
+    // wait until no thread is merging the free runs of node
+    void large_free_wait(int node);
+    // take one sb out of the shortest free run of node, returning the rest
+    // of the run to avail_sb; nullptr if there is no free run
+    void* large_free_take_sb(int node);
 
     // get unused desc from avail_desc or allocate a new space for desc
     Descriptor* desc_alloc();
@@ -556,21 +698,18 @@ private:
     void desc_retire(Descriptor* desc);
 }__attribute__((aligned(CACHELINE_SIZE)));
 
-// default (conservative) filter function which traverse all possible pointers
-// in the block
+// default (conservative) filter function which treats every word in the
+// block as a possible pptr
 template<class T>
 inline void GarbageCollection::filter_func(T* ptr){
-    #if 0
     char* curr = reinterpret_cast<char*>(ptr);
-    Descriptor* desc = ralloc::base_md->desc_lookup((char*)ptr);
+    Descriptor* desc = base_md->desc_lookup(curr);
     size_t sz = desc->block_size;
-    for(size_t i=0;i<sz;i++){
-        char* curr_content = static_cast<char*>(*(reinterpret_cast<pptr<char>*>(curr)));
+    for(size_t i = 0; i + sizeof(pptr<char>) <= sz; i += sizeof(pptr<char>)){
+        char* curr_content = static_cast<char*>(*(reinterpret_cast<pptr<char>*>(curr + i)));
         if(curr_content!=nullptr)
             mark_func(curr_content);
-        curr++;
     }
-    #endif
 }
 
 
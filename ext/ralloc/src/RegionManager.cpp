@@ -32,6 +32,15 @@
 #include <sys/select.h>
 
 #include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+MapOptions ralloc::map_opt;
 // //mmap anynomous
 // void RegionManager::__map_transient_region(){
 // 	char* ret = (char*) mmap((void*) 0, FILESIZE,
@@ -57,26 +66,20 @@ void RegionManager::__map_persistent_region(){
                 S_IRUSR | S_IWUSR);
 
     FD = fd;
-    off_t offt = lseek(fd, FILESIZE-1, SEEK_SET);
-    assert(offt != -1);
-
-    int result = write(fd, "", 1);
+    int result = ftruncate(fd, FILESIZE.load());
     assert(result != -1);
 
-    void * addr =
-        mmap(0, FILESIZE, PROT_READ | PROT_WRITE, MMAP_FLAG, fd, 0);
-    assert(addr != MAP_FAILED);
+    char* addr = __map_reserved(MMAP_FLAG);
 
-    base_addr = (char*) addr;
+    base_addr = addr;
     // | curr_addr  |
     // | heap_start |
     // |     size   |
     new (((atomic_pptr<char>*) base_addr)) atomic_pptr<char>((char*) ((size_t)addr + PAGESIZE));
     curr_addr_ptr = (atomic_pptr<char>*)base_addr;
-    *(uint64_t*)((size_t)base_addr + 2*sizeof(atomic_pptr<char>)) = FILESIZE;
+    __store_size(FILESIZE.load());
 
     FLUSH(curr_addr_ptr);
-    FLUSH((uint64_t*)((size_t)base_addr + 2*sizeof(atomic_pptr<char>)));
     FLUSHFENCE;
     DBG_PRINT("Addr: %p\n", addr);
     DBG_PRINT("Base_addr: %p\n", base_addr);
@@ -89,22 +92,12 @@ void RegionManager::__remap_persistent_region(){
                 S_IRUSR | S_IWUSR);
 
     FD = fd;
-    off_t offt = lseek(fd, FILESIZE-1, SEEK_SET);
-    assert(offt != -1);
-
-    int result = write(fd, "", 1);
-    assert(result != -1);
-
-    offt = lseek(fd, 0, SEEK_SET);
-    assert (offt == 0);
+    __load_size();
 
-    void * addr =
-        mmap(0, FILESIZE, PROT_READ | PROT_WRITE, MMAP_FLAG, fd, 0);
-    assert(addr != MAP_FAILED);
+    char* addr = __map_reserved(MMAP_FLAG);
 
-    base_addr = (char*) addr;
+    base_addr = addr;
     curr_addr_ptr = (atomic_pptr<char>*)base_addr;
-    assert(*(uint64_t*)((size_t)base_addr + 2*sizeof(atomic_pptr<char>)) == FILESIZE);
     DBG_PRINT("Addr: %p\n", addr);
     DBG_PRINT("Base_addr: %p\n", base_addr);
     DBG_PRINT("Curr_addr: %p\n", curr_addr_ptr->load());
@@ -117,27 +110,20 @@ void RegionManager::__map_transient_region(){
                 S_IRUSR | S_IWUSR);
 
     FD = fd;
-    off_t offt = lseek(fd, FILESIZE-1, SEEK_SET);
-    assert(offt != -1);
-
-    int result = write(fd, "", 1);
+    int result = ftruncate(fd, FILESIZE.load());
     assert(result != -1);
 
-    void * addr =
-        mmap(0, FILESIZE, PROT_READ | PROT_WRITE, 
-            MAP_SHARED | MAP_NORESERVE, fd, 0);
-    assert(addr != MAP_FAILED);
+    char* addr = __map_reserved(MAP_SHARED | MAP_NORESERVE);
 
-    base_addr = (char*) addr;
+    base_addr = addr;
     // | curr_addr  |
     // | heap_start |
     // |     size   |
     new (((atomic_pptr<char>*) base_addr)) atomic_pptr<char>((char*) ((size_t)addr + PAGESIZE));
     curr_addr_ptr = (atomic_pptr<char>*)base_addr;
-    *(uint64_t*)((size_t)base_addr + 2*sizeof(atomic_pptr<char>)) = FILESIZE;
+    __store_size(FILESIZE.load());
 
     FLUSH(curr_addr_ptr);
-    FLUSH((uint64_t*)((size_t)base_addr + 2*sizeof(atomic_pptr<char>)));
     FLUSHFENCE;
     DBG_PRINT("Addr: %p\n", addr);
     DBG_PRINT("Base_addr: %p\n", base_addr);
@@ -150,28 +136,131 @@ void RegionManager::__remap_transient_region(){
                 S_IRUSR | S_IWUSR);
 
     FD = fd;
-    off_t offt = lseek(fd, FILESIZE-1, SEEK_SET);
-    assert(offt != -1);
+    __load_size();
 
-    int result = write(fd, "", 1);
-    assert(result != -1);
-
-    offt = lseek(fd, 0, SEEK_SET);
-    assert (offt == 0);
+    char* addr = __map_reserved(MAP_SHARED | MAP_NORESERVE);
 
-    void * addr =
-        mmap(0, FILESIZE, PROT_READ | PROT_WRITE, 
-            MAP_SHARED | MAP_NORESERVE, fd, 0);
-    assert(addr != MAP_FAILED);
-
-    base_addr = (char*) addr;
+    base_addr = addr;
     curr_addr_ptr = (atomic_pptr<char>*)base_addr;
-    assert(*(uint64_t*)((size_t)base_addr + 2*sizeof(atomic_pptr<char>)) == FILESIZE);
     DBG_PRINT("Addr: %p\n", addr);
     DBG_PRINT("Base_addr: %p\n", base_addr);
     DBG_PRINT("Curr_addr: %p\n", curr_addr_ptr->load());
 }
 
+char* RegionManager::__map_reserved(int flags){
+    // PROT_NONE placeholder that later growth maps over in place
+    uint64_t align = ralloc::map_opt.huge ? HUGEPAGESIZE : 0;
+    char* addr = (char*) mmap(0, MAXSIZE + align, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    assert(addr != MAP_FAILED);
+    if (align){
+        // trim the placeholder to a huge page aligned start
+        char* aligned = (char*) (((uint64_t)addr + align - 1) & ~(align - 1));
+        if (aligned != addr) munmap(addr, aligned - addr);
+        munmap(aligned + MAXSIZE, addr + align - aligned);
+        addr = aligned;
+    }
+    bool res = __map_range(addr, 0, FILESIZE.load(), flags);
+    assert(res);
+    (void)res;
+    return addr;
+}
+
+// fault in [start, start+len) writable with thd threads
+static void prefault_range(char* start, uint64_t len, int thd){
+    auto touch = [](char* s, uint64_t l){
+        // older kernels lack MADV_POPULATE_WRITE; write each page instead
+        if (madvise(s, l, MADV_POPULATE_WRITE) == 0) return;
+        for (uint64_t i = 0; i < l; i += PAGESIZE){
+            __atomic_fetch_add(s + i, 0, __ATOMIC_RELAXED);
+        }
+    };
+    uint64_t unit = ralloc::map_opt.huge ? HUGEPAGESIZE : PAGESIZE;
+    uint64_t stride = (len / (thd > 0 ? thd : 1) + unit - 1) & ~(unit - 1);
+    if (thd <= 1 || stride >= len){
+        touch(start, len);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (uint64_t off = 0; off < len; off += stride){
+        workers.emplace_back(touch, start + off, std::min(stride, len - off));
+    }
+    for (auto& worker : workers){
+        worker.join();
+    }
+}
+
+bool RegionManager::__map_range(char* start, uint64_t off, uint64_t len, int flags){
+    const MapOptions& opt = ralloc::map_opt;
+    auto begin = std::chrono::high_resolution_clock::now();
+    if (opt.prefault == PREFAULT_POPULATE) flags |= MAP_POPULATE;
+    void* ret = mmap(start, len, PROT_READ | PROT_WRITE, flags | MAP_FIXED, FD, off);
+    if (ret == MAP_FAILED) return false;
+    assert(ret == start);
+    if (opt.huge){
+        // a hint only; THP may be disabled or the file system may not care
+        madvise(start, len, MADV_HUGEPAGE);
+    }
+    if (opt.prefault == PREFAULT_PARALLEL){
+        prefault_range(start, len, opt.prefault_thd);
+    }
+    if (opt.prefault != PREFAULT_NONE){
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "Spent "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count()
+                  << "ms prefaulting " << (len >> 20) << "MB of " << HEAPFILE << std::endl;
+    }
+    return true;
+}
+
+void RegionManager::__load_size(){
+    uint64_t size = 0;
+    ssize_t result = pread(FD, &size, sizeof(size), 2*sizeof(atomic_pptr<char>));
+    assert(result == sizeof(size));
+    struct stat st;
+    result = fstat(FD, &st);
+    assert(result != -1);
+    // the file is always extended before its size is recorded
+    assert((uint64_t)st.st_size >= size);
+    FILESIZE.store(size);
+    if (MAXSIZE < size) MAXSIZE = size;
+}
+
+void RegionManager::__store_size(uint64_t size){
+    uint64_t* size_ptr = (uint64_t*)((size_t)base_addr + 2*sizeof(atomic_pptr<char>));
+    *size_ptr = size;
+    FLUSH(size_ptr);
+    FLUSHFENCE;
+}
+
+bool RegionManager::__grow(uint64_t size){
+    std::lock_guard<std::mutex> lk(grow_lk);
+    uint64_t old_size = FILESIZE.load();
+    if (size <= old_size) return true; // someone else grew it
+    // at least double the size to keep growth rare
+    uint64_t new_size = size > 2*old_size ? size : 2*old_size;
+    new_size = ralloc::map_opt.huge ? HUGEPAGE_CEILING(new_size) : PAGE_CEILING(new_size);
+    if (new_size > MAXSIZE) new_size = MAXSIZE;
+    if (new_size < size) return false;
+    // extend the file first, then map it, then make the size durable, and
+    // only then let allocations past the old end, so that a restart never
+    // finds curr_addr beyond the size it maps
+    if (ftruncate(FD, new_size) == -1) return false;
+    if (!__map_range(base_addr + old_size, old_size, new_size - old_size,
+        persist ? MMAP_FLAG : (MAP_SHARED | MAP_NORESERVE))) return false;
+    __store_size(new_size);
+    FILESIZE.store(new_size);
+    if (imm_expand){
+        // the grown part is allocated right away, like the initial one
+        char* curr = curr_addr_ptr->load();
+        while(!curr_addr_ptr->compare_exchange_weak(curr, curr + (new_size - old_size)));
+        FLUSH(curr_addr_ptr);
+        FLUSHFENCE;
+    }
+    DBG_PRINT("Grew %s from %lu to %lu\n", HEAPFILE.c_str(), old_size, new_size);
+    return true;
+}
+
 //persist the curr and base address
 void RegionManager::__close_persistent_region(){
     FLUSHFENCE;
@@ -182,10 +271,10 @@ void RegionManager::__close_persistent_region(){
     unsigned long space_used = ((unsigned long) curr_addr_ptr->load() 
          - (unsigned long) base_addr);
     unsigned long remaining_space = 
-         ((unsigned long) FILESIZE - space_used) / (1024 * 1024);
+         ((unsigned long) FILESIZE.load() - space_used) / (1024 * 1024);
     DBG_PRINT("Space Used(rounded down to MiB): %ld, Remaining(MiB): %ld\n", 
             space_used / (1024 * 1024), remaining_space);
-    munmap((void*)base_addr, FILESIZE);
+    munmap((void*)base_addr, MAXSIZE);
     close(FD);
 }
 
@@ -201,10 +290,10 @@ void RegionManager::__close_transient_region(){
     unsigned long space_used = ((unsigned long) curr_addr 
          - (unsigned long) base_addr);
     unsigned long remaining_space = 
-         ((unsigned long) FILESIZE - space_used) / (1024 * 1024);
+         ((unsigned long) FILESIZE.load() - space_used) / (1024 * 1024);
     DBG_PRINT("Space Used(rounded down to MiB): %ld, Remaining(MiB): %ld\n", 
             space_used / (1024 * 1024), remaining_space);
-    munmap((void*)base_addr, FILESIZE);
+    munmap((void*)base_addr, MAXSIZE);
     close(FD);
 }
 
@@ -237,7 +326,7 @@ int RegionManager::__nvm_region_allocator(void** memptr, size_t alignment, size_
 
     res = new_curr_addr;
     next = new_curr_addr + size;
-    if (next > base_addr + FILESIZE){
+    if (next > base_addr + FILESIZE.load() && !__grow(next - base_addr)){
         printf("\n----Region Manager: out of space in mmaped file-----\nCurr:%p\nBase:%p\n",res,base_addr);
         return -1;
     }
@@ -271,7 +360,7 @@ int RegionManager::__try_nvm_region_allocator(void** memptr, size_t alignment, s
 
     res = new_curr_addr;
     next = new_curr_addr + size;
-    if (next > base_addr + FILESIZE){
+    if (next > base_addr + FILESIZE.load() && !__grow(next - base_addr)){
         printf("\n----Region Manager: out of space in mmaped file-----\n");
         return -1;
     }
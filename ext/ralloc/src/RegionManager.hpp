@@ -37,6 +37,7 @@
 #include <string>
 #include <fstream>
 #include <atomic>
+#include <mutex>
 #include <vector>
 
 #include "pm_config.hpp"
@@ -53,22 +54,68 @@
  *	(the first page ends and heap starts here to which heap_start points)
  *	....
  *	(heap ends here to which curr_addr points)
+ *
+ * A region reserves MAXSIZE of address space but maps only the first
+ * FILESIZE bytes of its file. __grow() extends the file and maps the new
+ * part in place, so addresses handed out stay valid. The size field is
+ * persisted before any of the new space is handed out, so a restart maps
+ * at least as much as was ever allocated.
  */
+
+/*
+ * struct MapOptions
+ *
+ * Description:
+ *  Opt-in mapping modes for regions mapped afterwards, set by
+ *  Ralloc::set_map_options(). By default pages fault in lazily on first
+ *  touch.
+ *      prefault: PREFAULT_POPULATE maps with MAP_POPULATE, and
+ *          PREFAULT_PARALLEL faults pages in writable with prefault_thd
+ *          threads. Either covers the initial mapping and every growth.
+ *      huge: aligns regions and their sizes to HUGEPAGESIZE and advises
+ *          MADV_HUGEPAGE, so that THP (tmpfs) or DAX can map them with PMDs.
+ *          Heap files on hugetlbfs need it too.
+ */
+enum PrefaultMode {
+    PREFAULT_NONE = 0,
+    PREFAULT_POPULATE = 1,
+    PREFAULT_PARALLEL = 2,
+};
+struct MapOptions {
+    PrefaultMode prefault = PREFAULT_NONE;
+    int prefault_thd = 1;
+    bool huge = false;
+};
+namespace ralloc{
+    extern MapOptions map_opt;
+}
+
 class RegionManager{
 public:
-    const uint64_t FILESIZE;
+    std::atomic<uint64_t> FILESIZE; // current size of file and mapping
+    uint64_t MAXSIZE; // reserved address space
     const std::string HEAPFILE;
     int FD = 0;
     char *base_addr = nullptr;
     atomic_pptr<char>* curr_addr_ptr;//this always points to the place of base_addr
     bool persist;
+    // the whole file is allocated upon creation, and so is every growth
+    bool imm_expand;
+    std::mutex grow_lk;
 
-    RegionManager(const std::string& file_path, uint64_t size, bool p = true, bool imm_expand = true):
+    // the region starts with size and may grow up to max_size
+    RegionManager(const std::string& file_path, uint64_t size, bool p = true, bool imm_expand_ = true, uint64_t max_size = 0):
         FILESIZE(((size/PAGESIZE)+2)*PAGESIZE), // size should align to page
+        MAXSIZE((((max_size > size ? max_size : size)/PAGESIZE)+2)*PAGESIZE),
         HEAPFILE(file_path),
         curr_addr_ptr(nullptr),
-        persist(p){
+        persist(p),
+        imm_expand(imm_expand_){
         assert(size%CACHELINE_SIZE == 0); // size should be multiple of cache line size
+        if(ralloc::map_opt.huge){
+            FILESIZE.store(HUGEPAGE_CEILING(FILESIZE.load()));
+            MAXSIZE = HUGEPAGE_CEILING(MAXSIZE);
+        }
         if(persist){
             if(exists_test(HEAPFILE)){
                 __remap_persistent_region();
@@ -120,6 +167,15 @@ public:
     void __map_transient_region();
     void __remap_transient_region();
 
+    //reserve MAXSIZE of address space and map FILESIZE of the file at its start
+    char* __map_reserved(int flags);
+    //map len bytes of the file from off at start, applying ralloc::map_opt
+    bool __map_range(char* start, uint64_t off, uint64_t len, int flags);
+    //read the persisted size of an existing file into FILESIZE
+    void __load_size();
+    //persist size in the header before it is published in FILESIZE
+    void __store_size(uint64_t size);
+
     //persist the curr and base address
     void __close_persistent_region();
 
@@ -144,6 +200,11 @@ public:
      */
     int __try_nvm_region_allocator(void** /*ret */, size_t /* alignment */, size_t /*size */);
 
+    /* grow the file and mapping to at least size bytes.
+     * return false if size exceeds MAXSIZE or the file can't be extended
+     */
+    bool __grow(uint64_t size);
+
     //true if ptr is in persistent region, otherwise false
     bool __within_range(void* ptr);
 
@@ -195,10 +256,10 @@ public:
         cur_idx = 0;
     }
 
-    /* to create desc or sb region */
-    void create(const std::string& file_path, uint64_t size, bool p = true, bool imm_expand = true){
+    /* to create desc or sb region, growable up to max_size */
+    void create(const std::string& file_path, uint64_t size, bool p = true, bool imm_expand = true, uint64_t max_size = 0){
         bool restart = exists_test(file_path);
-        RegionManager* new_mgr = new RegionManager(file_path,size,p,imm_expand);
+        RegionManager* new_mgr = new RegionManager(file_path,size,p,imm_expand,max_size);
         regions[cur_idx] = new_mgr;
         if(imm_expand || restart)
             regions_address[cur_idx] = (char*)new_mgr->__fetch_heap_start();
@@ -251,7 +312,7 @@ public:
         return (char*)((uint64_t)absolute_address - (uint64_t)regions_address[index]);
     }
 
-    /* expand the region $index$ by $size$ */
+    /* expand the region $index$ by $size$, growing it if needed */
     /* return 1 if succeeds, 0 if CAS failed, -1 if expansion is illegal (e.g., space runs out) */
     inline int expand(int index, void** memptr, size_t alignment, size_t size){
         void* tmp;
@@ -14,8 +14,20 @@
 
 #include "TCache.hpp"
 
-TCaches::TCaches():t_cache(){ };
+TCaches::TCaches():t_cache(),node(0),sb_reserve(nullptr),sb_reserve_num(0){ };
 TCaches::~TCaches(){};
+
+TCacheStats& TCacheStats::operator+=(const TCacheStats& oth)
+{
+	alloc_num += oth.alloc_num;
+	free_num += oth.free_num;
+	fill_num += oth.fill_num;
+	flush_num += oth.flush_num;
+	cas_retry_num += oth.cas_retry_num;
+	sb_get_num += oth.sb_get_num;
+	sb_put_num += oth.sb_put_num;
+	return *this;
+}
 void TCacheBin::push_block(char* block)
 {
 	// block has at least sizeof(char*)
@@ -37,6 +37,24 @@
  */
 
 struct TCaches;
+struct Descriptor;
+
+/*
+ * Counters of one size class in one thread, kept next to its cache bin.
+ * Only the owner thread writes them, so they are plain integers and
+ * should be read once the thread is quiescent, e.g. after a run.
+ */
+struct TCacheStats
+{
+	uint64_t alloc_num = 0; // blocks allocated
+	uint64_t free_num = 0; // blocks freed
+	uint64_t fill_num = 0; // cache refills
+	uint64_t flush_num = 0; // cache flushes
+	uint64_t cas_retry_num = 0; // failed CAS on the partial list
+	uint64_t sb_get_num = 0; // superblocks taken
+	uint64_t sb_put_num = 0; // superblocks retired
+	TCacheStats& operator+=(const TCacheStats& oth);
+};
 
 struct TCacheBin
 {
@@ -45,6 +63,8 @@ private:
 	uint32_t _block_num;
 
 public:
+	TCacheStats stats;
+
 	// common, fast ops
 	void push_block(char* block);
 	// push block list, cache *must* be empty
@@ -64,6 +84,11 @@ public:
 struct TCaches
 {
 	TCacheBin t_cache[MAX_SZ_IDX];
+	// NUMA node whose superblocks refill this cache
+	int node;
+	// private reserve of empty sbs of node, linked by Descriptor::next_free
+	Descriptor* sb_reserve;
+	uint32_t sb_reserve_num;
 	TCaches();
 	~TCaches();
 }__attribute__((aligned(CACHELINE_SIZE)));
@@ -45,6 +45,10 @@ enum RegionIndex : int {
 #define PAGE_CEILING(s) \
     (((s) + (PAGESIZE - 1)) & ~(PAGESIZE - 1))
 
+// return smallest huge page size multiple that is >= s
+#define HUGEPAGE_CEILING(s) \
+    (((s) + (HUGEPAGESIZE - 1)) & ~(HUGEPAGESIZE - 1))
+
 #ifdef DEBUG
   #define DBG_PRINT(msg, ...) \
     fprintf(stderr, "%s:%d %s " msg "\n", __FILE__, __LINE__, __func__, ##__VA_ARGS__); \
@@ -68,6 +72,15 @@ const uint64_t MAX_DESC_AMOUNT_BITS = 24;
 const uint64_t MIN_SB_REGION_SIZE = 1*1024*1024*1024ULL; // min sb region size
 const uint64_t SB_REGION_EXPAND_SIZE = MIN_SB_REGION_SIZE;
 const int MAX_ROOTS = 1024;
+// NUMA nodes with their own superblock pool and heaps; more nodes are folded
+const int MAX_NUMA_NODES = 8;
+// empty sbs a thread keeps privately: refilled SB_RESERVE_BATCH at a time
+// from its node's free list, and SB_RESERVE_BATCH go back past SB_RESERVE_MAX
+const uint32_t SB_RESERVE_BATCH = 8;
+const uint32_t SB_RESERVE_MAX = 16;
+// free large runs of n < LARGE_BUCKETS sbs are kept in bucket n-1 of their
+// node, longer ones all in the last bucket
+const int LARGE_BUCKETS = 64;
 
 /* System Macros */
 const int TYPE_SIZE = 4;
@@ -77,6 +90,7 @@ const int CACHELINE_SIZE = 64; // in byte
 const uint64_t CACHELINE_MASK = (uint64_t)(CACHELINE_SIZE) - 1;
 const int PAGESIZE = 4096;//4K
 const uint64_t PAGE_MASK = (uint64_t)PAGESIZE - 1;
+const uint64_t HUGEPAGESIZE = 2*1024*1024ULL;//2M, a PMD mapping
 
 /* Library Invariant */
 const int LARGE = 249; // tag indicating the block is large
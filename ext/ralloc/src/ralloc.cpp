@@ -35,16 +35,19 @@ Ralloc::Ralloc(int thd_num_, const char* id_, uint64_t size_){
     filepath = HEAPFILE_PREFIX + id;
     assert(sizeof(Descriptor) == DESCSIZE); // check desc size
     assert(size_ < MAX_SB_REGION_SIZE && size_ >= MIN_SB_REGION_SIZE); // ensure user input is >=MAX_SB_REGION_SIZE
+    // size_ caps the sb region, which starts with room for the warm-up
+    // and grows on demand
     uint64_t num_sb = size_/SBSIZE;
+    uint64_t init_sb = std::min(num_sb, SB_REGION_EXPAND_SIZE/SBSIZE + 2);
     restart = Regions::exists_test(filepath+"_basemd");
     _rgs = new Regions();
     for(int i=0; i<LAST_IDX;i++){
     switch(i){
     case DESC_IDX:
-        _rgs->create(filepath+"_desc", num_sb*DESCSIZE, true, true);
+        _rgs->create(filepath+"_desc", init_sb*DESCSIZE, true, true, num_sb*DESCSIZE);
         break;
     case SB_IDX:
-        _rgs->create(filepath+"_sb", num_sb*SBSIZE, true, false);
+        _rgs->create(filepath+"_sb", init_sb*SBSIZE, true, false, num_sb*SBSIZE);
         break;
     case META_IDX:
         base_md = _rgs->create_for<BaseMeta>(filepath+"_basemd", sizeof(BaseMeta), true);
@@ -52,6 +55,9 @@ Ralloc::Ralloc(int thd_num_, const char* id_, uint64_t size_){
         break;
     } // switch
     }
+    for(int i=0;i<thd_num;i++){
+        t_caches[i].node = node_of(i);
+    }
     initialized = true;
     // return (int)restart;
 }
@@ -77,10 +83,15 @@ std::vector<InuseRecovery::iterator> Ralloc::recover(int thd){
     bool dirty = base_md->is_dirty();
     if(dirty) {
         // initialize transient sb free and partial lists
-        base_md->avail_sb.off.store(nullptr); // initialize avail_sb
-        for(int i = 0; i< MAX_SZ_IDX; i++) {
-            // initialize partial list of each heap
-            base_md->heaps[i].partial_list.off.store(nullptr);
+        for(int n = 0; n < MAX_NUMA_NODES; n++) {
+            base_md->avail_sb[n].off.store(nullptr); // initialize avail_sb
+            for(int b = 0; b < LARGE_BUCKETS; b++) {
+                base_md->large_free[n][b].off.store(nullptr);
+            }
+            for(int i = 0; i< MAX_SZ_IDX; i++) {
+                // initialize partial list of each heap
+                base_md->heaps[n][i].partial_list.off.store(nullptr);
+            }
         }
     }
     std::vector<InuseRecovery::iterator> ret;
@@ -100,6 +111,38 @@ std::vector<InuseRecovery::iterator> Ralloc::recover(int thd){
     return ret;
 }
 
+bool Ralloc::collect(int thd){
+    bool dirty = base_md->is_dirty();
+    if(dirty) {
+        GarbageCollection gc(base_md, thd);
+        gc();
+    }
+    return dirty;
+}
+
+void Ralloc::set_numa(const std::vector<int>& os_index, const std::vector<int>& node_of_tid){
+    int num = std::min(std::max((int)os_index.size(), 1), MAX_NUMA_NODES);
+    ralloc::numa.num = num;
+    for(int i=0;i<MAX_NUMA_NODES;i++){
+        ralloc::numa.os_index[i] = i<(int)os_index.size() ? os_index[i] : 0;
+    }
+    ralloc::numa.node_of_tid = node_of_tid;
+    for(auto& node : ralloc::numa.node_of_tid){
+        // fold nodes beyond MAX_NUMA_NODES
+        node %= num;
+    }
+}
+
+void Ralloc::set_map_options(const MapOptions& opt){
+    ralloc::map_opt = opt;
+}
+
+int Ralloc::node_of(int tid_){
+    if(tid_ >= (int)ralloc::numa.node_of_tid.size()) return 0;
+    // the heap may have been created with fewer nodes
+    return ralloc::numa.node_of_tid[tid_] % base_md->numa_num;
+}
+
 void* Ralloc::reallocate(void* ptr, size_t new_size, int tid_){
     if(ptr == nullptr) return allocate(new_size);
     if(!_rgs->in_range(SB_IDX, ptr)) return nullptr;
@@ -116,6 +159,37 @@ void* Ralloc::reallocate(void* ptr, size_t new_size, int tid_){
     return new_ptr;
 }
 
+std::vector<TCacheStats> Ralloc::get_stats(int tid_){
+    assert(tid_<thd_num && "tid out of range!");
+    std::vector<TCacheStats> ret(MAX_SZ_IDX);
+    int lo = tid_ == -1 ? 0 : tid_;
+    int hi = tid_ == -1 ? thd_num : tid_+1;
+    for(int thd=lo;thd<hi;thd++){
+        for(int i=0;i<MAX_SZ_IDX;i++){
+            ret[i] += t_caches[thd].t_cache[i].stats;
+        }
+    }
+    return ret;
+}
+
+void Ralloc::print_stats(std::ostream& os, int tid_){
+    std::vector<TCacheStats> stats = get_stats(tid_);
+    TCacheStats total;
+    os<<"sc\tblock\talloc\tfree\tfill\tflush\tcas_retry\tsb_get\tsb_put\n";
+    for(int i=0;i<MAX_SZ_IDX;i++){
+        const TCacheStats& s = stats[i];
+        total += s;
+        if(s.alloc_num==0 && s.free_num==0) continue;
+        os<<i<<"\t"<<(i==0?0:ralloc::sizeclass.get_sizeclass_by_idx(i)->block_size)<<"\t"
+            <<s.alloc_num<<"\t"<<s.free_num<<"\t"<<s.fill_num<<"\t"
+            <<s.flush_num<<"\t"<<s.cas_retry_num<<"\t"
+            <<s.sb_get_num<<"\t"<<s.sb_put_num<<"\n";
+    }
+    os<<"total\t-\t"<<total.alloc_num<<"\t"<<total.free_num<<"\t"
+        <<total.fill_num<<"\t"<<total.flush_num<<"\t"<<total.cas_retry_num<<"\t"
+        <<total.sb_get_num<<"\t"<<total.sb_put_num<<"\n";
+}
+
 int RallocHolder::init(int thd_num, const char* _id, uint64_t size){
     ralloc_instance = new Ralloc(thd_num, _id,size);
     ralloc_instance->set_tid(0);// set tid for main thread
@@ -133,10 +207,26 @@ int RP_init(const char* _id, uint64_t size, int thd_num){
     return _holder.init(thd_num, _id,size);
 }
 
+void RP_set_numa(const std::vector<int>& os_index, const std::vector<int>& node_of_tid){
+    Ralloc::set_numa(os_index, node_of_tid);
+}
+
+void RP_set_map_options(const MapOptions& opt){
+    Ralloc::set_map_options(opt);
+}
+
 std::vector<InuseRecovery::iterator> RP_recover(int n){
     return _holder.ralloc_instance->recover(n);
 }
 
+int RP_collect(int n){
+    return (int)_holder.ralloc_instance->collect(n);
+}
+
+std::vector<TCacheStats> RP_get_stats(int tid){
+    return _holder.ralloc_instance->get_stats(tid);
+}
+
 // we assume RP_close is called by the last exiting thread.
 void RP_close(){
     // Wentao: this is a noop as the real function body is now in ~RallocHolder
@@ -158,6 +248,10 @@ void RP_free(void* ptr){
     _holder.ralloc_instance->deallocate(ptr);
 }
 
+void RP_free_sized(void* ptr, size_t sz){
+    _holder.ralloc_instance->deallocate_sized(ptr,sz);
+}
+
 void* RP_set_root(void* ptr, uint64_t i){
     return _holder.ralloc_instance->set_root(ptr,i);
 }
@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include <vector>
 #include <cstring>
+#include <iostream>
 #ifdef __cplusplus
 
 #include "RegionManager.hpp"
@@ -31,11 +32,11 @@ private:
 
     // static SizeClass sizeclass;
     static thread_local int tid;
+    // NUMA node of thread tid_ in this heap
+    int node_of(int tid_);
     inline void flush_caches(){
         for(int thd=0;thd<thd_num;thd++){
-            for(int i=1;i<MAX_SZ_IDX;i++){// sc 0 is reserved.
-                base_md->flush_cache(i, &t_caches[thd].t_cache[i]);
-            }
+            flush_cache(thd);
         }
     }
 public:
@@ -61,7 +62,24 @@ public:
         assert(tid_!=-1 && tid_<thd_num && "tid out of range!");
         base_md->do_free(ptr,t_caches[tid_]);
     }
+    // free with the size ptr was allocated with (or any size of the same
+    // size class), skipping the descriptor lookup for small blocks
+    inline void deallocate_sized(void* ptr, size_t sz, int tid_=tid){
+        assert(initialized&&"Ralloc isn't initialized!");
+        assert(tid_!=-1 && tid_<thd_num && "tid out of range!");
+        base_md->do_free_sized(ptr,sz,t_caches[tid_]);
+    }
     void* reallocate(void* ptr, size_t new_size, int tid_=tid);
+    // return the blocks cached by thread tid_ to their superblocks, e.g.
+    // before the thread exits and its tid is reused; tid_'s owner must not
+    // be allocating or freeing meanwhile.
+    inline void flush_cache(int tid_=tid){
+        assert(tid_!=-1 && tid_<thd_num && "tid out of range!");
+        for(int i=1;i<MAX_SZ_IDX;i++){// sc 0 is reserved.
+            base_md->flush_cache(i, &t_caches[tid_].t_cache[i]);
+        }
+        base_md->flush_sb_reserve(t_caches[tid_]);
+    }
 
     inline void* set_root(void* ptr, uint64_t i){
         assert(initialized&&"Ralloc isn't initialized!");
@@ -76,6 +94,10 @@ public:
         return restart;
     }
     std::vector<InuseRecovery::iterator> recover(int thd = 1);
+    // on a dirty restart, rebuild free lists by tracing from the roots
+    // with thd threads, in place of recover(); roots should have been
+    // typed via get_root<T>() first. return true if the heap was dirty.
+    bool collect(int thd = 1);
 
     inline void simulate_crash(){
         // Wentao: directly call destructors from main thread to mimic
@@ -84,6 +106,7 @@ public:
         flush_caches();
         for(int i=0;i<thd_num;i++){
             new (&(t_caches[i])) TCaches();
+            t_caches[i].node = node_of(i);
         }
         base_md->fake_dirty = true;
     }
@@ -104,7 +127,7 @@ public:
             return 1;
         }
         *start_addr = (void*)_rgs->regions_address[idx];
-        *end_addr = (void*) ((uint64_t)_rgs->regions_address[idx] + _rgs->regions[idx]->FILESIZE);
+        *end_addr = (void*) ((uint64_t)_rgs->regions_address[idx] + _rgs->regions[idx]->FILESIZE.load());
         return 0;
     }
 
@@ -112,6 +135,23 @@ public:
         return initialized;
     }
 
+    // NUMA layout for heaps constructed afterwards: os_index[i] is the OS
+    // id of node i and node_of_tid[t] the node of thread t. Nodes beyond
+    // MAX_NUMA_NODES are folded. See NumaLayout in BaseMeta.hpp.
+    static void set_numa(const std::vector<int>& os_index, const std::vector<int>& node_of_tid);
+
+    // prefault and huge page modes for heaps constructed afterwards. See
+    // MapOptions in RegionManager.hpp.
+    static void set_map_options(const MapOptions& opt);
+
+    // per size class counters of thread tid_, or summed over all threads
+    // if tid_ is -1. index 0 holds large blocks. Counters are transient
+    // and restart from zero after simulate_crash; read them only while
+    // no thread allocates.
+    std::vector<TCacheStats> get_stats(int tid_ = -1);
+    // print nonzero rows of get_stats() and the totals
+    void print_stats(std::ostream& os = std::cout, int tid_ = -1);
+
     static void set_tid(int tid_){
         // Wentao: we deliberately allow tid to be set more than once
         // assert((tid==-1 || tid==0) && "tid set more than once!");
@@ -140,6 +180,14 @@ T* RP_get_root(uint64_t i){
 }
 
 std::vector<InuseRecovery::iterator> RP_recover(int n = 1);
+/* return 1 if it's dirty and garbage collected, otherwise 0. */
+int RP_collect(int n = 1);
+/* set NUMA layout before RP_init; see Ralloc::set_numa. */
+void RP_set_numa(const std::vector<int>& os_index, const std::vector<int>& node_of_tid);
+/* set prefault and huge page modes before RP_init; see Ralloc::set_map_options. */
+void RP_set_map_options(const MapOptions& opt);
+/* per size class counters; see Ralloc::get_stats. */
+std::vector<TCacheStats> RP_get_stats(int tid = -1);
 extern "C"{
 #else /* __cplusplus ends */
 // This is a version for pure c only
@@ -156,6 +204,8 @@ void RP_set_tid(int tid);
 void RP_simulate_crash();
 void* RP_malloc(size_t sz);
 void RP_free(void* ptr);
+/* free with the size ptr was allocated with; faster for small blocks. */
+void RP_free_sized(void* ptr, size_t sz);
 void* RP_set_root(void* ptr, uint64_t i);
 size_t RP_malloc_size(void* ptr);
 void* RP_calloc(size_t num, size_t size);
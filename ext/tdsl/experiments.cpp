@@ -37,9 +37,16 @@ void warmUp(tdsl::SkipList<ItemType, ValueType> & sl)
 #else
         ItemType key = distribution(generator);
 #endif
-        trans.TXBegin();
-        sl.insert(key, key, trans);
-        trans.TXCommit();
+        while (true) {
+            try {
+                trans.TXBegin();
+                sl.insert(key, key, trans);
+                trans.TXCommit();
+                break;
+            } catch (AbortTransactionException &) {
+                // only the GV5 clock aborts a lone transaction
+            }
+        }
     }
 
     cout << "Finished" << endl;
@@ -2,6 +2,24 @@
 
 #include "Utils.h"
 
+// The global version clock, in one of TL2's variants, picked at build
+// time with -DTDSL_GVC=<n>; both libtdsl and whatever includes these
+// headers must agree on it.
+//   1: every writing commit increments the clock (the default).
+//   4: a commit tries one CAS from the value it saw; if that fails, the
+//      winner's value is shared, so a contended commit costs one CAS
+//      and no retries.
+//   5: a commit never writes the clock and just stamps clock+1. A
+//      reader that meets a stamp newer than its read version aborts and
+//      advances the clock, so the clock is written only on such aborts.
+#ifndef TDSL_GVC
+#define TDSL_GVC 1
+#endif
+
+#if TDSL_GVC != 1 && TDSL_GVC != 4 && TDSL_GVC != 5
+#error "TDSL_GVC must be 1, 4 or 5"
+#endif
+
 namespace tdsl {
 
 class GVC
@@ -11,18 +29,44 @@ public:
 
     virtual ~GVC() = default;
 
-    unsigned int read() const
+    Version read() const
     {
         return version.load();
     }
 
-    unsigned int addAndFetch()
+    // write version of a commit that holds its write set's locks
+    Version commitVersion()
+    {
+#if TDSL_GVC == 1
+        return version.fetch_add(1) + 1;
+#elif TDSL_GVC == 4
+        Version v = version.load();
+        if (version.compare_exchange_strong(v, v + 1)) {
+            return v + 1;
+        }
+        // v now holds the newer value some other commit installed
+        return v;
+#else
+        return version.load() + 1;
+#endif
+    }
+
+    // called by a transaction that aborts on a node stamped newer than
+    // its read version
+    void observe(Version seen)
     {
-        return std::atomic_fetch_add<unsigned int>(&version, 1) + 1;
+#if TDSL_GVC == 5
+        Version v = version.load();
+        while (v < seen && !version.compare_exchange_weak(v, seen)) {}
+#else
+        (void)seen;
+#endif
     }
 
 private:
-    std::atomic<unsigned int> version;
+    // on its own cache line, away from the other statics
+    alignas(64) std::atomic<Version> version;
+    char pad[64 - sizeof(std::atomic<Version>)];
 };
 
-}
\ No newline at end of file
+}
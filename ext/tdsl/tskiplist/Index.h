@@ -55,7 +55,7 @@ template<typename K, typename V>
 class Index
 {
 public:
-    Index(unsigned int version) : head(nullptr, K(), version, MIN) {
+    Index(Version version) : head(nullptr, K(), version, MIN) {
         skiplist_init(&sl, NodeCmp<K,V>);
         skiplist_insert(&sl, &head.snode);
     }
@@ -13,7 +13,7 @@ enum NodeType{MIN, NORMAL};
 
 class NodeBase{
 public:
-    NodeBase(unsigned int version, NodeType type = NORMAL):
+    NodeBase(Version version, NodeType type = NORMAL):
         type(type), deleted(false), version(version), next(nullptr){
         skiplist_init_node(&snode);
     }
@@ -30,7 +30,7 @@ public:
     NodeType type;
     bool deleted;
     Mutex lock;
-    unsigned int version;
+    Version version;
     NodeBase * next;
     
 };
@@ -39,10 +39,10 @@ template<typename K, typename V>
 class Node : public NodeBase
 {
 public:
-    Node(SkipList<K,V>* sl, const K & k, const V & v, unsigned int version, NodeType type = NORMAL) :
+    Node(SkipList<K,V>* sl, const K & k, const V & v, Version version, NodeType type = NORMAL) :
         NodeBase(version, type), sl(sl), key(k), val(v) {}
 
-    Node(SkipList<K,V>* sl, const K & k, unsigned int version, NodeType type = NORMAL) :
+    Node(SkipList<K,V>* sl, const K & k, Version version, NodeType type = NORMAL) :
         NodeBase(version, type), sl(sl), key(k) {}
 
     virtual ~Node() = default;
@@ -27,8 +27,8 @@ public:
 
     static GVC gvc;
     bool is_inside_txn;
-    unsigned int readVersion;
-    unsigned int writeVersion;
+    Version readVersion;
+    Version writeVersion;
     std::vector<NodeBase *> readSet;
     WriteSet writeSet;
     std::vector<IndexOperation> indexTodo;
@@ -48,6 +48,7 @@ public:
         }
 
         if (node->version > readVersion) {
+            gvc.observe(node->version);
             throw AbortTransactionException();
         }
 
@@ -81,11 +82,14 @@ public:
                 throw AbortTransactionException();
             }
 
+            // as in TL2, take the write version before validating, since
+            // GV4 and GV5 may hand the same version to several commits
+            writeVersion = gvc.commitVersion();
+
             if (!validateReadSet()) {
                 throw AbortTransactionException();
             }
 
-            writeVersion = gvc.addAndFetch();
             writeSet.update(writeVersion);
         }
         for (auto & op : indexTodo) {
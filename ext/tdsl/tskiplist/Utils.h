@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include <atomic>
 #include <mutex>
+#include <cstdint>
 
 #define STRING_KV
 
@@ -22,6 +23,10 @@ typedef int ValueType;
 
 #endif // STRING_KV
 
+// versions stamped by the global version clock (GVC.h); 64 bits so a
+// long run never wraps
+typedef uint64_t Version;
+
 class AbortTransactionException : public std::exception
 {
 };
\ No newline at end of file
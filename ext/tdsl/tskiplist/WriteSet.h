@@ -67,7 +67,7 @@ public:
         return true;
     }
 
-    void update(unsigned int newVersion){
+    void update(Version newVersion){
         for (auto & it : items) {
             NodeBase * n = it.first;
             Operation & op = it.second;
@@ -1,5 +1,8 @@
 #include "ParallelLaunch.hpp"
 #include "HarnessUtils.hpp"
+#include "PerfCounters.hpp"
+#include "ThroughputSampler.hpp"
+#include "OpenLoop.hpp"
 #include <atomic>
 #include <chrono>
 #include <hwloc.h>
@@ -22,6 +25,9 @@ void initSynchronizationPrimitives(int task_num){
 	pthread_barrier_init(&pthread_barrier, NULL, task_num);
 }
 
+// set when -dSampleInterval asks for throughput over time
+static ThroughputSampler* sampler = nullptr;
+
 // ALARM handler ------------------------------------------
 // in case of infinite loop
 bool testComplete;
@@ -115,6 +121,11 @@ static void * thread_main (void *lp)
 
 	barrier(); // barrier all threads at end of parInit
 
+	PerfCounters* perf = nullptr;
+	if(PerfCounters::enabled(gtc)){
+		perf = new PerfCounters();
+	}
+
 	if(task_id==0){
 		gtc->parInit_time = chrono::duration_cast<chrono::milliseconds>(chrono::high_resolution_clock::now() - gtc->start).count();
 	}
@@ -125,15 +136,39 @@ static void * thread_main (void *lp)
         	gtc->start = chrono::high_resolution_clock::now();
         	gtc->finish=gtc->start;
 			gtc->finish+=chrono::seconds{(uint64_t)gtc->interval};
+		if(sampler){
+			sampler->start();
+		}
 	}
 
 
 
 	barrier(); // barrier all threads before starting
 
+	if(OpenLoop::enabled(gtc)){
+		ltc->open_loop = new OpenLoop(gtc,ltc);
+	}
+
+	if(perf){
+		perf->start();
+	}
+
 	/* ------- WE WILL DO ALL OF THE WORK!!! ---------*/
 	int ops = executeTest(gtc,ltc);
 
+	if(perf){
+		// stop before waiting on the end barrier
+		perf->stop();
+		perf->report(gtc->recorder,ltc->tid);
+		delete perf;
+	}
+
+	if(ltc->open_loop){
+		ltc->open_loop->report();
+		delete ltc->open_loop;
+		ltc->open_loop = nullptr;
+	}
+
 	// record standard statistics
 	__sync_fetch_and_add (&gtc->total_operations, ops);
 	gtc->recorder->reportThreadInfo("ops",ops,ltc->tid);
@@ -151,6 +186,12 @@ static void * thread_main (void *lp)
 		if(gtc->interval <= 0.000001) {
 			gtc->interval = 0.000001;
 		}
+		if(sampler){
+			sampler->stop();
+		}
+		if(OpenLoop::enabled(gtc)){
+			OpenLoop::summarize(gtc);
+		}
 	}
 	return NULL;
 }
@@ -169,6 +210,9 @@ void parallelWork(GlobalTestConfig* gtc){
 	initSynchronizationPrimitives(task_num);
 	initTest(gtc);
 	testComplete = false;
+	if(ThroughputSampler::enabled(gtc)){
+		sampler = new ThroughputSampler(gtc);
+	}
 
 	// initialize threads and arguments ----------------
 	ctcs = (CombinedTestConfig *) malloc (sizeof (CombinedTestConfig) * gtc->task_num);
@@ -238,6 +282,8 @@ void parallelWork(GlobalTestConfig* gtc){
 
 
 	testComplete = true;
+	delete sampler;
+	sampler = nullptr;
 	free(ctcs);
 	free(threads);
 	cleanupTest(gtc);
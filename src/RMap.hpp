@@ -50,6 +50,25 @@ public:
     // if the key is already present in the map
     // returns : the replaced value, or NULL if replace was unsuccessful
     virtual optional<V> replace(K key, V val, int tid)=0;
+
+    // Gets the values of n keys at once
+    // vals[i] receives what get(keys[i]) would return; maps may
+    // overlap the lookups, this default just issues them in turn
+    virtual void multi_get(const K* keys, optional<V>* vals, size_t n, int tid){
+        for (size_t i = 0; i < n; i++){
+            vals[i] = get(keys[i], tid);
+        }
+    }
+
+    // Puts n key/value pairs, in order
+    // olds[i], unless olds is null, receives what put(keys[i], vals[i])
+    // would return
+    virtual void multi_put(const K* keys, const V* vals, optional<V>* olds, size_t n, int tid){
+        for (size_t i = 0; i < n; i++){
+            optional<V> old = put(keys[i], vals[i], tid);
+            if (olds) olds[i] = old;
+        }
+    }
 };
 
 #endif   
@@ -31,6 +31,28 @@ public:
     virtual optional<V> dequeue(int tid)=0;
 
     virtual void enqueue(V val, int tid)=0;
+
+    // Enqueues n values, in order
+    // queues may link them privately and publish them at once; this
+    // default just issues them in turn
+    virtual void enqueue_batch(const V* vals, size_t n, int tid){
+        for (size_t i = 0; i < n; i++){
+            enqueue(vals[i], tid);
+        }
+    }
+
+    // Dequeues up to n values, oldest first, into vals
+    // returns how many were dequeued, fewer than n only if the queue
+    // ran empty
+    virtual size_t dequeue_batch(V* vals, size_t n, int tid){
+        size_t i = 0;
+        for (; i < n; i++){
+            optional<V> res = dequeue(tid);
+            if (!res.has_value()) break;
+            vals[i] = res.value();
+        }
+        return i;
+    }
 };
 
 #endif   
\ No newline at end of file
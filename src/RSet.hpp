@@ -10,7 +10,8 @@ public:
 	virtual bool get(K key, int tid)=0;
 
 	// Puts a key into the set. Always succeeds.
-	virtual void put(K key, int tid)=0;
+	// returns : true if the key was already present
+	virtual bool put(K key, int tid)=0;
 
 	// Inserts a new key into the map
 	// if the key is not already present
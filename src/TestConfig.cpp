@@ -1,5 +1,7 @@
 #include "TestConfig.hpp"
 #include "ParallelLaunch.hpp"
+#include "PerfCounters.hpp"
+#include "OpenLoop.hpp"
 // #include "DefaultHarnessTests.hpp"
 // #include "RContainer.hpp"
 // #include "SGLQueue.hpp"
@@ -168,6 +170,10 @@ void GlobalTestConfig::parseCommandLine(int argc, char** argv){
 	hwloc_get_type_depth(topology, HWLOC_OBJ_PU));
 	// std::cout<<"initial affinity built"<<std::endl;
 	buildAffinity(affinities);
+	buildNumaMap();
+	// Ralloc heaps created from now on split over these nodes
+	Ralloc::set_numa(numa_os_index, numa_of_tid);
+	setMapOptions();
 
 
 	recorder = new Recorder(task_num);
@@ -186,6 +192,12 @@ void GlobalTestConfig::parseCommandLine(int argc, char** argv){
 	recorder->addThreadField("ops",&Recorder::sumInts);
 	recorder->addThreadField("ops_stddev",&Recorder::stdDevInts);
 	recorder->addThreadField("ops_each",&Recorder::concat);
+	if(PerfCounters::enabled(this)){
+		PerfCounters::addFields(recorder);
+	}
+	if(OpenLoop::enabled(this)){
+		OpenLoop::addFields(recorder);
+	}
 
 
 	string env ="";
@@ -442,6 +454,23 @@ void GlobalTestConfig::buildAffinity(std::vector<hwloc_obj_t>& aff){
 }
 
 
+void GlobalTestConfig::buildNumaMap(){
+	numa_os_index.clear();
+	numa_of_tid.assign(task_num, 0);
+	int n = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_NUMANODE);
+	for(int i = 0; i<n; i++){
+		numa_os_index.push_back(hwloc_get_obj_by_type(topology, HWLOC_OBJ_NUMANODE, i)->os_index);
+	}
+	for(int t = 0; t<task_num; t++){
+		for(int i = 0; i<n; i++){
+			hwloc_obj_t node = hwloc_get_obj_by_type(topology, HWLOC_OBJ_NUMANODE, i);
+			if(hwloc_bitmap_isincluded(affinities[t]->cpuset, node->cpuset)){
+				numa_of_tid[t] = i;
+				break;
+			}
+		}
+	}
+}
 
 void GlobalTestConfig::setEnv(std::string key, std::string value){
 	if(verbose){
@@ -525,6 +554,26 @@ void GlobalTestConfig::addTestOption(Test* t, const char name[]){
 	testNames.push_back(s);
 }
 
+void GlobalTestConfig::setMapOptions(){
+	// like -w for the system heap, -dPrefault=populate|parallel faults
+	// Ralloc heaps in before the measured window; -dHugePages asks for
+	// 2MB mappings
+	MapOptions opt;
+	if(checkEnv("Prefault")){
+		std::string mode = getEnv("Prefault");
+		if(mode == "populate"){
+			opt.prefault = PREFAULT_POPULATE;
+		} else if(mode == "parallel"){
+			opt.prefault = PREFAULT_PARALLEL;
+		} else if(mode != "none" && mode != "0"){
+			errexit(("unknown Prefault mode \"" + mode + "\", use none, populate or parallel.").c_str());
+		}
+	}
+	opt.prefault_thd = task_num;
+	opt.huge = checkEnv("HugePages") && getEnv("HugePages") != "0";
+	Ralloc::set_map_options(opt);
+}
+
 std::string GlobalTestConfig::getRideableName(int rideableType_){
 	return rideableNames[rideableType_];
 }
@@ -18,6 +18,7 @@
 #include "HarnessUtils.hpp"
 #include "Rideable.hpp"
 #include "Recorder.hpp"
+#include "ConcurrentPrimitives.hpp"
 
 #ifndef TESTS_KEY_SIZE
   #define TESTS_KEY_SIZE 32
@@ -30,6 +31,7 @@
 class Test;
 class Rideable;
 class RideableFactory;
+class OpenLoop;
 
 class GlobalTestConfig{
 public:
@@ -39,6 +41,8 @@ public:
 	uint64_t parInit_time = 0; // number of seconds to run parInit in total 
 
 	std::vector<hwloc_obj_t> affinities; // map from tid to CPU id
+	std::vector<int> numa_os_index; // map from NUMA node to its OS id
+	std::vector<int> numa_of_tid; // map from tid to NUMA node
 	hwloc_topology_t topology;
 	
 	int num_procs=24;
@@ -65,6 +69,16 @@ public:
 
 	long int total_operations=0;
 
+	// running op count of each thread, polled by the throughput sampler;
+	// null unless -dSampleInterval is set
+	paddedAtomic<uint64_t>* progress = nullptr;
+	// for tests to publish their op count as they go
+	inline void reportProgress(int tid, uint64_t ops){
+		if(progress){
+			progress[tid].ui.store(ops, std::memory_order_relaxed);
+		}
+	}
+
 	void setUpEpochSys(void* esys_);
 	void setUpTDSLTxns(void* tdsl_txns_);
 	
@@ -112,6 +126,10 @@ public:
 	// // Affinity functions
 	// // a bunch needed because of recursive traversal of topologies.
 	void buildAffinity(std::vector<hwloc_obj_t>& aff);
+	// map threads to NUMA nodes of their pinned PUs
+	void buildNumaMap();
+	// pass -dPrefault and -dHugePages on to Ralloc
+	void setMapOptions();
 private:
 	void extendAffinity(std::vector<hwloc_obj_t>& aff);
 	void buildDFSAffinity_helper(std::vector<hwloc_obj_t>& aff, hwloc_obj_t obj);
@@ -142,6 +160,8 @@ public:
 	unsigned int seed;
 	unsigned cpu;
 	hwloc_cpuset_t cpuset;
+	// arrival schedule when -dTargetRate asks for open-loop load
+	OpenLoop* open_loop = nullptr;
 };
 
 class CombinedTestConfig{
@@ -14,6 +14,8 @@
 
 #include "txMontageLfHashTable.hpp"
 #include "MedleyLfHashTable.hpp"
+#include "txMontageLfHashSet.hpp"
+#include "MedleyLfHashSet.hpp"
 
 #include "TxnBoostingLfHashTable.hpp"
 
@@ -25,6 +27,8 @@
 
 #include "txMontageFraserSkipList.hpp"
 #include "MedleyFraserSkipList.hpp"
+#include "txMontageFraserSkipListSet.hpp"
+#include "MedleyFraserSkipListSet.hpp"
 
 #include "TxnBoostingFraserSkipList.hpp"
 
@@ -34,10 +38,30 @@
 #include "TDSLSkipList.hpp"
 #include "LFTTSkipList.hpp"
 
+#include "MedleySkipListPQ.hpp"
+#include "txMontageSkipListPQ.hpp"
+
+#include "MedleyGraph.hpp"
+#include "txMontageGraph.hpp"
+
+#include "txMontageMSQueue.hpp"
+#include "MedleySegQueue.hpp"
+#include "txMontageSegQueue.hpp"
+
 #include "MapChurnTest.hpp"
+#include "ThreadChurnTest.hpp"
+#include "SetChurnTest.hpp"
 #include "TxnMapChurnTest.hpp"
 #include "TxnVerify.hpp"
 #include "TPCC.hpp"
+#include "HeapChurnTest.hpp"
+#include "GraphChurnTest.hpp"
+#include "AllocTest.hpp"
+#include "MapRecoverVerifyTest.hpp"
+#include "QueueRecoverVerifyTest.hpp"
+#include "QueueChurnTest.hpp"
+#include "SegQueueStallTest.hpp"
+#include "TxnMapQueueTest.hpp"
 
 using namespace std;
 
@@ -66,8 +90,36 @@ int main(int argc, char *argv[])
 	gtc.addRideableOption(new TDSLSkipListFactory<uint64_t>(), "TDSLSkipList<uint64_t>");
 	gtc.addRideableOption(new LFTTSkipListFactory(), "LFTTSkipList<uint64_t>");
 
+	/* priority queues */
+	gtc.addRideableOption(new MedleySkipListPQFactory<uint64_t>(), "MedleySkipListPQ<uint64_t>");
+	gtc.addRideableOption(new txMontageSkipListPQFactory<uint64_t>(), "txMontageSkipListPQ<uint64_t>");
+
+	/* sets */
+	gtc.addRideableOption(new MedleyLfHashSetFactory<uint64_t>(), "MedleyLfHashSet<uint64_t>");
+	gtc.addRideableOption(new txMontageLfHashSetFactory<uint64_t>(), "txMontageLfHashSet<uint64_t>");
+	gtc.addRideableOption(new MedleyFraserSkipListSetFactory<uint64_t>(), "MedleyFraserSkipListSet<uint64_t>");
+	gtc.addRideableOption(new txMontageFraserSkipListSetFactory<uint64_t>(), "txMontageFraserSkipListSet<uint64_t>");
+
+	/* graphs */
+	gtc.addRideableOption(new MedleyGraphFactory(), "MedleyGraph");
+	gtc.addRideableOption(new txMontageGraphFactory(), "txMontageGraph");
+
+	/* queues */
+	gtc.addRideableOption(new txMontageMSQueueFactory<uint64_t>(), "txMontageMSQueue<uint64_t>");
+	gtc.addRideableOption(new MedleySegQueueFactory<uint64_t>(), "MedleySegQueue<uint64_t>");
+	gtc.addRideableOption(new txMontageSegQueueFactory<uint64_t>(), "txMontageSegQueue<uint64_t>");
+	gtc.addRideableOption(new txMontageMSQueueFactory<std::string>(), "txMontageMSQueue<string>");
+	gtc.addRideableOption(new MedleySegQueueFactory<std::string>(), "MedleySegQueue<string>");
+	gtc.addRideableOption(new txMontageSegQueueFactory<std::string>(), "txMontageSegQueue<string>");
+
 	/* non-transactional microbenchmark */
 	gtc.addTestOption(new MapChurnTest<uint64_t,uint64_t>(50, 0, 25, 25, 1000000, 500000), "MapChurnTest<uint64_t>:g50p0i25rm25:range=1000000:prefill=500000");
+	gtc.addTestOption(new ThreadChurnTest<uint64_t,uint64_t>(50, 0, 25, 25, 1000000, 500000, 4, 10000), "ThreadChurnTest<uint64_t>:g50p0i25rm25:range=1000000:prefill=500000:extra=4:ops=10000");
+
+	gtc.addTestOption(new SetChurnTest<uint64_t>(50, 0, 25, 25, 1000000, 500000), "SetChurnTest<uint64_t>:g50p0i25rm25:range=1000000:prefill=500000");
+
+	gtc.addTestOption(new HeapChurnTest<uint64_t>(50, 50, 1000000, 500000), "HeapChurnTest<uint64_t>:enq50deq50:range=1000000:prefill=500000");
+	gtc.addTestOption(new GraphChurnTest(50, 25, 20, 5, 65536, 262144), "GraphChurnTest:he50ae25re20rv5:range=65536:prefill=262144");
 
 	/* transactional TPCC benchmark */
 	gtc.addTestOption(new tpcc::TPCC<TxnType::NBTC>(50,50,0,0,0),"TPCC<NBTC>");
@@ -97,6 +149,46 @@ int main(int argc, char *argv[])
 	gtc.addTestOption(new TxnMapChurnTest<uint64_t,uint64_t,TxnType::OneFile>(false, 10, 0, 0, 50, 50, 1000000, 500000), "TxnMapChurnTest<uint64_t:OneFile>:txn10:g0p0i50rm50:range=1000000:prefill=500000");
 
 	gtc.addTestOption(new TxnVerify<uint64_t, uint64_t>(30, 14,14, 14, 14,14, 500000,10), "TxnVerify<uint64_t>:g30:wa14:rb14:wb14:rc14:wc14:range=500000");
+
+	/* allocator benchmark, ignores the rideable */
+	gtc.addTestOption(new AllocTest(DO_JEMALLOC_ALLOC, ALLOC_LARSON, 1000, 10, 500), "AllocTest<jemalloc>:larson:sz=10-500:live=1000");
+	gtc.addTestOption(new AllocTest(DO_RALLOC_ALLOC, ALLOC_LARSON, 1000, 10, 500), "AllocTest<Ralloc>:larson:sz=10-500:live=1000");
+	gtc.addTestOption(new AllocTest(DO_MONTAGE_ALLOC, ALLOC_LARSON, 1000, 10, 500), "AllocTest<Montage>:larson:sz=10-500:live=1000");
+	gtc.addTestOption(new AllocTest(DO_JEMALLOC_ALLOC, ALLOC_PRODCON, 64, 64, 64), "AllocTest<jemalloc>:prodcon:sz=64:batch=64");
+	gtc.addTestOption(new AllocTest(DO_RALLOC_ALLOC, ALLOC_PRODCON, 64, 64, 64), "AllocTest<Ralloc>:prodcon:sz=64:batch=64");
+	gtc.addTestOption(new AllocTest(DO_MONTAGE_ALLOC, ALLOC_PRODCON, 64, 64, 64), "AllocTest<Montage>:prodcon:sz=64:batch=64");
+	gtc.addTestOption(new AllocTest(DO_JEMALLOC_ALLOC, ALLOC_SWEEP, 256, 8, 14336), "AllocTest<jemalloc>:sweep:sz=8-14336:batch=256");
+	gtc.addTestOption(new AllocTest(DO_RALLOC_ALLOC, ALLOC_SWEEP, 256, 8, 14336), "AllocTest<Ralloc>:sweep:sz=8-14336:batch=256");
+	gtc.addTestOption(new AllocTest(DO_MONTAGE_ALLOC, ALLOC_SWEEP, 256, 8, 14336), "AllocTest<Montage>:sweep:sz=8-14336:batch=256");
+
+	/* recovery verification */
+	gtc.addTestOption(new MapRecoverVerifyTest<uint64_t,uint64_t>(), "MapRecoverVerifyTest<uint64_t>");
+	gtc.addTestOption(new MapRecoverVerifyTest<uint64_t,uint64_t>(2), "MapRecoverVerifyTest<uint64_t>:crash2");
+	gtc.addTestOption(new QueueRecoverVerifyTest<uint64_t>(), "QueueRecoverVerifyTest<uint64_t>");
+	gtc.addTestOption(new QueueRecoverVerifyTest<uint64_t>(2), "QueueRecoverVerifyTest<uint64_t>:crash2");
+
+	/* empty dequeues of the segment queues vs. a stalled enqueuer; needs -t2 or more */
+	gtc.addTestOption(new SegQueueStallTest<MedleySegQueue<uint64_t>>(), "SegQueueStallTest<MedleySegQueue<uint64_t>>");
+	gtc.addTestOption(new SegQueueStallTest<txMontageSegQueue<uint64_t>>(), "SegQueueStallTest<txMontageSegQueue<uint64_t>>");
+
+	/* queue microbenchmark, on RQueue<string> */
+	gtc.addTestOption(new QueueChurnTest(50, 50, 2000), "QueueChurnTest<string>:enq50deq50:prefill=2000");
+
+	/* transactional maps and queue; ignores the rideable */
+	// GetTotal:Increase:Decrease:Transfer:Aggregate:Deposit:Get:Insert:Remove=10:10:10:10:20:20:10:5:5
+	// Aggregate enqueues and Deposit dequeues, so the queue is in half of the txns.
+	gtc.addTestOption(new TxnMapQueueTest<uint64_t,uint64_t>(10, 10, 10, 10, 20, 20, 10, 5, 5, 1000000, 500000,
+		{gtc.findRideable("MedleyLfHashTable<uint64_t>"), gtc.findRideable("MedleyLfHashTable<uint64_t>")},
+		{gtc.findRideable("MedleySegQueue<uint64_t>")}),
+		"TxnMapQueueTest<uint64_t>:MedleyLfHashTable:MedleySegQueue:tot10inc10dec10tr10agg20dep20g10i5rm5:range=1000000:prefill=500000");
+	gtc.addTestOption(new TxnMapQueueTest<uint64_t,uint64_t>(10, 10, 10, 10, 20, 20, 10, 5, 5, 1000000, 500000,
+		{gtc.findRideable("txMontageLfHashTable<uint64_t>"), gtc.findRideable("txMontageLfHashTable<uint64_t>")},
+		{gtc.findRideable("txMontageSegQueue<uint64_t>")}),
+		"TxnMapQueueTest<uint64_t>:txMontageLfHashTable:txMontageSegQueue:tot10inc10dec10tr10agg20dep20g10i5rm5:range=1000000:prefill=500000");
+	gtc.addTestOption(new TxnMapQueueTest<uint64_t,uint64_t>(10, 10, 10, 10, 20, 20, 10, 5, 5, 1000000, 500000,
+		{gtc.findRideable("txMontageLfHashTable<uint64_t>"), gtc.findRideable("txMontageLfHashTable<uint64_t>")},
+		{gtc.findRideable("txMontageMSQueue<uint64_t>")}),
+		"TxnMapQueueTest<uint64_t>:txMontageLfHashTable:txMontageMSQueue:tot10inc10dec10tr10agg20dep20g10i5rm5:range=1000000:prefill=500000");
 	
 
 	gtc.parseCommandLine(argc, argv);
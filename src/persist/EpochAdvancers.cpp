@@ -26,8 +26,9 @@ DedicatedEpochAdvancer::DedicatedEpochAdvancer(GlobalTestConfig* gtc, EpochSys*
     if (!gtc->checkEnv("NoAdvancerPinning")){
         find_first_socket();
     }
+    target_epoch.ui.store(esys->get_epoch());
     advancer_state.store(INIT);
-    advancer_thread = std::move(std::thread(&DedicatedEpochAdvancer::advancer, this, gtc->task_num));
+    advancer_thread = std::move(std::thread(&DedicatedEpochAdvancer::advancer, this, esys->max_threads()));
     advancer_state.store(RUNNING);
 }
 
@@ -45,7 +46,7 @@ void DedicatedEpochAdvancer::advancer(int task_num){
         advancer_affinity->cpuset,HWLOC_CPUBIND_THREAD);
     }
     EpochSys::init_thread(task_num);// set tid to be the last
-    uint64_t curr_epoch = INIT_EPOCH;
+    uint64_t curr_epoch = esys->get_epoch();
     int64_t next_sleep = epoch_length; // unsigned to signed, but should be fine.
     while(advancer_state.load() == INIT){}
     while(advancer_state.load() == RUNNING){
@@ -136,11 +137,11 @@ DedicatedEpochAdvancerNbSync::DedicatedEpochAdvancerNbSync(GlobalTestConfig* gtc
     if (!gtc->checkEnv("NoAdvancerPinning")){
         find_first_socket();
     }
-    target_epoch.ui.store(INIT_EPOCH);
+    target_epoch.ui.store(esys->get_epoch());
     if(epoch_length!=0){
         // spawn epoch advancer thread only if epoch length isn't 0
         started.store(false);
-        advancer_thread = std::move(std::thread(&DedicatedEpochAdvancerNbSync::advancer, this, gtc->task_num));
+        advancer_thread = std::move(std::thread(&DedicatedEpochAdvancerNbSync::advancer, this, esys->max_threads()));
         started.store(true);
     }
 }
@@ -212,15 +212,15 @@ namespace pds{
         if (gtc->checkEnv("PersistStrat")){
             string env_persist = gtc->getEnv("PersistStrat");
             if (env_persist == "DirWB"){
-                to_be_persisted = new DirWB(_ral, gtc->task_num);
+                to_be_persisted = new DirWB(_ral, task_num);
             } else if (env_persist == "BufferedWB"){
-                to_be_persisted = new BufferedWB(gtc, _ral);
+                to_be_persisted = new BufferedWB(gtc, _ral, task_num);
             } else {
                 errexit("unrecognized 'persist' environment");
             }
         } else {
             gtc->setEnv("PersistStrat", "BufferedWB");
-            to_be_persisted = new BufferedWB(gtc, _ral);
+            to_be_persisted = new BufferedWB(gtc, _ral, task_num);
         }
 
         if (gtc->checkEnv("Free")){
@@ -243,14 +243,14 @@ namespace pds{
             if (env_transcounter == "AtomicCounter"){
                 trans_tracker = new AtomicTransactionTracker(this->global_epoch);
             } else if (env_transcounter == "ActiveThread"){
-                trans_tracker = new FenceBeginTransactionTracker(this->global_epoch, task_num);
+                trans_tracker = new FenceBeginTransactionTracker(this->global_epoch, slots);
             } else if (env_transcounter == "CurrEpoch"){
-                trans_tracker = new PerEpochTransactionTracker(this->global_epoch, task_num);
+                trans_tracker = new PerEpochTransactionTracker(this->global_epoch, slots);
             } else {
                 errexit("unrecognized 'transaction counter' environment");
             }
         } else {
-            trans_tracker = new PerEpochTransactionTracker(this->global_epoch, task_num);
+            trans_tracker = new PerEpochTransactionTracker(this->global_epoch, slots);
         }
 
         if (gtc->checkEnv("PersistTracker")){
@@ -293,6 +293,46 @@ namespace pds{
         // }
     }
 
+    int EpochSys::register_thread(){
+        int slot = slots->acquire();
+        if (slot < 0){
+            errexit("EpochSys: out of thread slots. Raise MaxThreads.");
+        }
+        // the thread can't write in any epoch before this one
+        persisted_epochs->revive_thread(global_epoch->load(std::memory_order_seq_cst), slot);
+        init_thread(slot);
+        return slot;
+    }
+
+    void EpochSys::unregister_thread(){
+        assert(tid >= 0 && tid < task_num);
+        assert(epochs[tid].ui == NULL_EPOCH && "unregister_thread called inside an op");
+        assert(pending_allocs[tid].ui.empty() && pending_retires[tid].ui.empty());
+        uint64_t last_epoch = last_epochs[tid].ui;
+        if (last_epoch != NULL_EPOCH){
+            // end the epochs this thread may have left blocks in, so that
+            // all its to-be-freed buckets are due, and drain them and its
+            // to-be-persisted buffers before giving up the slot.
+            epoch_advancer->sync(last_epoch+1);
+            for (uint64_t e = last_epoch-1; e <= last_epoch+1; e++){
+                to_be_freed->help_free_local(e);
+            }
+            uint64_t c = global_epoch->load(std::memory_order_seq_cst);
+            for (uint64_t e = c-EPOCH_WINDOW+1; e <= c; e++){
+                to_be_persisted->persist_epoch_local(e, tid);
+            }
+            persist_func::sfence();
+        }
+        // transaction trackers need nothing: this thread's indicators are
+        // clear outside an op, and scans skip the slot once it's released.
+        persisted_epochs->retire_thread(tid);
+        tracker.handoff(tid);
+        _ral->flush_cache(tid);
+        last_epochs[tid].ui = NULL_EPOCH;
+        slots->release(tid);
+        init_thread(-1);
+    }
+
     bool EpochSys::check_epoch(uint64_t c){
         return c == global_epoch->load(std::memory_order_seq_cst);
     }
@@ -843,7 +883,7 @@ namespace pds{
         while(!trans_tracker->no_active(c-1)){}
 
         // take modular, in case of dedicated epoch advancer calling this function.
-        int curr_thread = EpochSys::tid % gtc->task_num;
+        int curr_thread = EpochSys::tid % task_num;
         curr_thread = persisted_epochs->next_thread_to_persist(c-1, curr_thread);
         // check the top of mindicator to get the last persisted epoch globally
         while(curr_thread >= 0){
@@ -855,6 +895,10 @@ namespace pds{
     }
 
     std::unordered_map<uint64_t, PBlk*>* EpochSys::recover(const int rec_thd){
+        // recovery threads are pinned like the first rec_thd workers
+        if (rec_thd < 1 || rec_thd > gtc->task_num) {
+            errexit("RecoverThread must be between 1 and the thread count.");
+        }
         std::unordered_map<uint64_t, PBlk*>* in_use = new std::unordered_map<uint64_t, PBlk*>();
         uint64_t max_epoch = 0;
 #ifndef MNEMOSYNE
@@ -892,6 +936,12 @@ namespace pds{
                 // and help Ralloc fully recover by completing the pass.
                 for (; !itr_raw[rec_tid].is_last(); ++itr_raw[rec_tid]){
                     PBlk* curr_blk = (PBlk*) *itr_raw[rec_tid];
+                    // a freed block is INIT (see wipe_pblk); a block that
+                    // shows ralloc's free list links or stale bytes of a
+                    // reused superblock reads past DESC. Neither has an epoch
+                    if (curr_blk->blktype == INIT || curr_blk->blktype > DESC){
+                        continue;
+                    }
                     if (curr_blk->blktype == EPOCH){
                         epoch_container = (Epoch*) curr_blk;
                         global_epoch = &epoch_container->global_epoch;
@@ -966,8 +1016,14 @@ namespace pds{
                     // deleted_ids in not_in_use
                     if (// leave DESC blocks untouched for now.
                         curr_blk->blktype != DESC &&
+                        // the epoch container has no epoch but stays in
+                        // use; freeing it breaks the next recovery
+                        curr_blk->blktype != EPOCH &&
                         // DELETE blocks are already put into anti_nodes_local.
                         curr_blk->blktype != DELETE && (
+                            // leftovers of a freed block, see the first pass
+                            curr_blk->blktype == INIT ||
+                            curr_blk->blktype > DESC ||
                             // block without epoch number, probably just inited
                             curr_blk->epoch == NULL_EPOCH || 
                             // premature pblk
@@ -1066,13 +1122,16 @@ namespace pds{
                 curr_reporting.store((rec_tid + 1) % rec_thd);
                 // clean up not_in_use and anti-nodes
                 for (auto itr : not_in_use_local) {
-                    itr->set_epoch(NULL_EPOCH);
+                    wipe_pblk(itr);
+                    persist_func::clwb(&itr->epoch);
                     _ral->deallocate(itr, rec_tid);
                 }
                 for (auto itr : anti_nodes_local) {
-                    itr.second->set_epoch(NULL_EPOCH);
+                    wipe_pblk(itr.second);
+                    persist_func::clwb(&itr.second->epoch);
                     _ral->deallocate(itr.second, rec_tid);
                 }
+                persist_func::sfence();
                 pthread_barrier_wait(&sync_point);
                 if (rec_tid == rec_thd - 1) {
                     end = chrono::high_resolution_clock::now();
@@ -1094,6 +1153,9 @@ namespace pds{
 
         // set system mode back to online
         sys_mode = ONLINE;
+        // resume past every recovered block, so that they are old to
+        // new operations and new blocks are newer than them
+        global_epoch->store(std::max(max_epoch+1, (uint64_t)INIT_EPOCH), std::memory_order_seq_cst);
         reset();
 
         std::cout<<"returning from EpochSys Recovery."<<std::endl;
@@ -1108,7 +1170,7 @@ namespace pds{
         EpochSys::reset();
         // TODO: only nbEpochSys needs persistent descs. consider move all
         // inits into nbEpochSys.
-        for (int i = 0; i < gtc->task_num; i++) {
+        for (int i = 0; i < task_num; i++) {
             to_be_persisted->init_desc_local(local_descs[i], i);
         }
     }
@@ -1153,17 +1215,17 @@ namespace pds{
         if (gtc->checkEnv("PersistStrat")){
             string env_persist = gtc->getEnv("PersistStrat");
             if (env_persist == "DirWB"){
-                to_be_persisted = new DirWB(_ral, gtc->task_num);
+                to_be_persisted = new DirWB(_ral, task_num);
             } else if (env_persist == "PerEpoch"){
                 errexit("nbEpochSys isn't compatible with PerEpoch!");
             } else if (env_persist == "BufferedWB"){
-                to_be_persisted = new BufferedWB(gtc, _ral);
+                to_be_persisted = new BufferedWB(gtc, _ral, task_num);
             } else {
                 errexit("unrecognized 'persist' environment");
             }
         } else {
             gtc->setEnv("PersistStrat", "BufferedWB");
-            to_be_persisted = new BufferedWB(gtc, _ral);
+            to_be_persisted = new BufferedWB(gtc, _ral, task_num);
         }
 
         if (gtc->checkEnv("Free")){
@@ -1184,14 +1246,14 @@ namespace pds{
             if (env_transcounter == "AtomicCounter"){
                 trans_tracker = new AtomicTransactionTracker(this->global_epoch);
             } else if (env_transcounter == "ActiveThread"){
-                trans_tracker = new FenceBeginTransactionTracker(this->global_epoch, task_num);
+                trans_tracker = new FenceBeginTransactionTracker(this->global_epoch, slots);
             } else if (env_transcounter == "CurrEpoch"){
-                trans_tracker = new PerEpochTransactionTracker(this->global_epoch, task_num);
+                trans_tracker = new PerEpochTransactionTracker(this->global_epoch, slots);
             } else {
                 errexit("unrecognized 'transaction counter' environment");
             }
         } else {
-            trans_tracker = new PerEpochTransactionTracker(this->global_epoch, task_num);
+            trans_tracker = new PerEpochTransactionTracker(this->global_epoch, slots);
         }
 
         if (gtc->checkEnv("PersistTracker")){
@@ -1703,7 +1765,7 @@ namespace pds{
 
     void nbEpochSys::on_epoch_end(uint64_t c){
         // take modular, in case of dedicated epoch advancer calling this function.
-        int curr_thread = EpochSys::tid % gtc->task_num;
+        int curr_thread = EpochSys::tid % task_num;
         curr_thread = persisted_epochs->next_thread_to_persist(c-1, curr_thread);
         // check the top of mindicator to get the last persisted epoch globally
         while(curr_thread >= 0){
@@ -1728,6 +1790,10 @@ namespace pds{
     }
 
     std::unordered_map<uint64_t, PBlk*>* nbEpochSys::recover(const int rec_thd) {
+        // recovery threads are pinned like the first rec_thd workers
+        if (rec_thd < 1 || rec_thd > gtc->task_num) {
+            errexit("RecoverThread must be between 1 and the thread count.");
+        }
         std::unordered_map<uint64_t, PBlk*>* in_use = new std::unordered_map<uint64_t, PBlk*>();
         std::unordered_map<uint64_t, sc_desc_t*> descs;  //tid->desc
         uint64_t max_tid = 0;
@@ -1770,6 +1836,12 @@ namespace pds{
                 // and help Ralloc fully recover by completing the pass.
                 for (; !itr_raw[rec_tid].is_last(); ++itr_raw[rec_tid]) {
                     PBlk* curr_blk = (PBlk*)*itr_raw[rec_tid];
+                    // a freed block is INIT (see wipe_pblk); a block that
+                    // shows ralloc's free list links or stale bytes of a
+                    // reused superblock reads past DESC. Neither has an epoch
+                    if (curr_blk->blktype == INIT || curr_blk->blktype > DESC) {
+                        continue;
+                    }
                     if (curr_blk->blktype == EPOCH) {
                         epoch_container = (Epoch*)curr_blk;
                         global_epoch = &epoch_container->global_epoch;
@@ -1854,8 +1926,14 @@ namespace pds{
                     // deleted_ids in not_in_use
                     if (  // leave DESC blocks untouched for now.
                         curr_blk->blktype != DESC &&
+                        // the epoch container has no epoch but stays in
+                        // use; freeing it breaks the next recovery
+                        curr_blk->blktype != EPOCH &&
                         // DELETE blocks are already put into anti_nodes_local.
                         curr_blk->blktype != DELETE && (
+                            // leftovers of a freed block, see the first pass
+                            curr_blk->blktype == INIT ||
+                            curr_blk->blktype > DESC ||
                             // block without epoch number, probably just inited
                             curr_blk->epoch == NULL_EPOCH ||
                             // premature pblk
@@ -1937,13 +2015,16 @@ namespace pds{
                 curr_reporting.store((rec_tid + 1) % rec_thd);
                 // clean up not_in_use and anti-nodes
                 for (auto itr : not_in_use_local) {
-                    itr->set_epoch(NULL_EPOCH);
+                    wipe_pblk(itr);
+                    persist_func::clwb(&itr->epoch);
                     _ral->deallocate(itr, rec_tid);
                 }
                 for (auto itr : anti_nodes_local) {
-                    itr->set_epoch(NULL_EPOCH);
+                    wipe_pblk(itr);
+                    persist_func::clwb(&itr->epoch);
                     _ral->deallocate(itr, rec_tid);
                 }
+                persist_func::sfence();
             }));  // workers.emplace_back()
         }  // for (rec_thd)
         for (auto& worker : workers) {
@@ -1954,6 +2035,9 @@ namespace pds{
 
         // set system mode back to online
         sys_mode = ONLINE;
+        // resume past every recovered block, so that they are old to
+        // new operations and new blocks are newer than them
+        global_epoch->store(std::max(max_epoch+1, (uint64_t)INIT_EPOCH), std::memory_order_seq_cst);
         reset();
 
         std::cout << "returning from EpochSys Recovery." << std::endl;
@@ -12,6 +12,7 @@
 #include <string>
 #include <exception>
 #include <type_traits>
+#include <typeinfo>
 
 #include "TestConfig.hpp"
 #include "ConcurrentPrimitives.hpp"
@@ -139,6 +140,13 @@ public:
     inline size_t get_size()const{return size;}
 };
 
+// PBlkArrays are bigger than sizeof(PBlkArray<T>), so they can't be
+// freed by static size
+template<typename T>
+struct is_pblk_array : std::false_type{};
+template<typename T>
+struct is_pblk_array<PBlkArray<T>> : std::true_type{};
+
 struct Epoch : public PBlk{
     std::atomic<uint64_t> global_epoch;
     void persist(){}
@@ -507,7 +515,9 @@ protected:
     RCUTracker tracker;
     GlobalTestConfig* gtc = nullptr;
     Ralloc* _ral = nullptr;
+    // number of thread slots; per-thread arrays are this long
     int task_num;
+    SlotRegistry* slots = nullptr;
     static std::atomic<int> esys_num;
 
     /* containers from Recoverable */ 
@@ -542,16 +552,20 @@ public:
     SysMode sys_mode = ONLINE;
 
 
-    EpochSys(GlobalTestConfig* _gtc) : uid_generator(_gtc->task_num), tracker(_gtc->task_num, 100, 1000, true), gtc(_gtc) {
+    EpochSys(GlobalTestConfig* _gtc) : uid_generator(get_max_threads(_gtc)), tracker(get_max_threads(_gtc), 100, 1000, get_reclaim_type(_gtc), true), gtc(_gtc) {
+        task_num = get_max_threads(_gtc);
+        // the harness' threads own the first slots
+        slots = new SlotRegistry(task_num, _gtc->task_num);
+        tracker.set_slots(slots);
         // init main thread
         pds::EpochSys::init_thread(0);
         std::string heap_name = get_ralloc_heap_name();
         // task_num+1 to construct Ralloc for dedicated epoch advancer
-        _ral = new Ralloc(_gtc->task_num+1,heap_name.c_str(),REGION_SIZE);
-        local_descs = new sc_desc_t* [gtc->task_num];
+        _ral = new Ralloc(task_num+1,heap_name.c_str(),REGION_SIZE);
+        local_descs = new sc_desc_t* [task_num];
         // [wentao] FIXME: this may need to change if recovery reuses
         // existing descs
-        for(int i=0;i<gtc->task_num;i++){
+        for(int i=0;i<task_num;i++){
             // Wentao: although in blocking Montage, descriptors don't
             // need to be persistent at all, we still allocate them in
             // NVM for simplicity. By some experiments, we confirmed
@@ -560,21 +574,21 @@ public:
             assert(local_descs[i]!=nullptr);
         }
         
-        epochs = new padded<uint64_t>[gtc->task_num];
-        last_epochs = new padded<uint64_t>[_gtc->task_num];
-        for(int i = 0; i < gtc->task_num; i++){
+        epochs = new padded<uint64_t>[task_num];
+        last_epochs = new padded<uint64_t>[task_num];
+        for(int i = 0; i < task_num; i++){
             epochs[i].ui = NULL_EPOCH;
             last_epochs[i].ui = NULL_EPOCH;
         }
-        pending_allocs = new padded<std::vector<PBlk*>>[gtc->task_num];
-        pending_retires = new padded<std::vector<std::pair<PBlk*,PBlk*>>>[gtc->task_num];
-        pending_reads = new padded<std::unordered_map<atomic_lin_var<uint64_t>*, lin_var>>[gtc->task_num];
+        pending_allocs = new padded<std::vector<PBlk*>>[task_num];
+        pending_retires = new padded<std::vector<std::pair<PBlk*,PBlk*>>>[task_num];
+        pending_reads = new padded<std::unordered_map<atomic_lin_var<uint64_t>*, lin_var>>[task_num];
 
-        cleanups = new padded<std::vector<std::function<void()>>>[_gtc->task_num]();
-        undos = new padded<std::vector<std::function<void()>>>[_gtc->task_num]();
-        unlocks = new padded<std::vector<std::function<void()>>>[_gtc->task_num]();
-        allocs = new padded<std::unordered_map<void*, std::function<void(void*)>>>[_gtc->task_num]();
-        flags = new Flags[_gtc->task_num]();
+        cleanups = new padded<std::vector<std::function<void()>>>[task_num]();
+        undos = new padded<std::vector<std::function<void()>>>[task_num]();
+        unlocks = new padded<std::vector<std::function<void()>>>[task_num]();
+        allocs = new padded<std::unordered_map<void*, std::function<void(void*)>>>[task_num]();
+        flags = new Flags[task_num]();
 
         persist_func::sfence();
         reset(); // TODO: change to recover() later on.
@@ -616,6 +630,7 @@ public:
         delete undos;
         delete unlocks;
         delete allocs;
+        delete slots;
         // std::cout<<"Aborted:Total = "<<abort_cnt.load()<<":"<<total_cnt.load()<<std::endl;
     }
 
@@ -639,15 +654,39 @@ public:
         return ret;
     }
 
+    // number of thread slots, by "MaxThreads" environment; never fewer
+    // than the harness' threads
+    static int get_max_threads(GlobalTestConfig* _gtc){
+        if (_gtc->checkEnv("MaxThreads")){
+            return std::max(_gtc->task_num, stoi(_gtc->getEnv("MaxThreads")));
+        }
+        return _gtc->task_num;
+    }
+
+    // reclamation scheme of tracker, by "Reclaim" environment
+    static RCUType get_reclaim_type(GlobalTestConfig* _gtc){
+        if (_gtc->checkEnv("Reclaim")){
+            return RCUTracker::parse_type(_gtc->getEnv("Reclaim"));
+        }
+        return type_RCU;
+    }
+
     virtual void reset(){
-        task_num = gtc->task_num;
         if (!epoch_container){
             epoch_container = new_pblk<Epoch>();
             epoch_container->blktype = EPOCH;
             global_epoch = &epoch_container->global_epoch;
+            global_epoch->store(INIT_EPOCH, std::memory_order_relaxed);
         }
-        global_epoch->store(INIT_EPOCH, std::memory_order_relaxed);
+        // otherwise recover() has set the epoch to resume from
         parse_env();
+        // free slots, including ones the harness' threads gave back, have
+        // nothing to persist
+        for (int i = 0; i < task_num; i++){
+            if (!slots->active(i)){
+                persisted_epochs->retire_thread(i);
+            }
+        }
     }
 
     void simulate_crash(){
@@ -656,6 +695,8 @@ public:
             delete epoch_advancer;
             epoch_advancer = nullptr;
         // }
+        // transient nodes still in limbo die with the crash
+        tracker.reset();
         _ral->simulate_crash();
     }
 
@@ -663,11 +704,27 @@ public:
     // Operations //
     ////////////////
 
+    Ralloc* get_ralloc(){
+        return _ral;
+    }
+
     static void init_thread(int _tid){
         EpochSys::tid = _tid;
         Ralloc::set_tid(_tid);
     }
 
+    // The harness' threads own slots [0, gtc->task_num) and only call
+    // init_thread(). Any other thread, e.g. from a pool that grows and
+    // shrinks, takes a free slot with register_thread(), which returns
+    // its tid, and gives it back with unregister_thread() outside any op
+    // before it exits. The number of slots is set by "MaxThreads".
+    int register_thread();
+    void unregister_thread();
+
+    int max_threads(){
+        return task_num;
+    }
+
     void* malloc_pblk(size_t sz){
         return _ral->allocate(sz);
     }
@@ -706,20 +763,40 @@ public:
     }
 
     // deallocate pblk, giving it back to Ralloc
+    // a block whose dynamic type is exactly T was allocated with sizeof(T)
+    // by new_pblk, so it takes Ralloc's sized free and skips the
+    // descriptor lookup; blocks from malloc_pblk must therefore have been
+    // allocated with the size of the type constructed in them.
     template <class T>
     void delete_pblk(T* pblk, uint64_t c){
+        bool sized = !is_pblk_array<T>::value && typeid(*pblk) == typeid(T);
         pblk->~T();
-        _ral->deallocate(pblk);
+        wipe_pblk(pblk);
+        if (sized){
+            _ral->deallocate_sized(pblk, sizeof(T));
+        } else {
+            _ral->deallocate(pblk);
+        }
         if (sys_mode == ONLINE && c != NULL_EPOCH){
-            if (tid >= gtc->task_num){
+            if (tid >= task_num){
                 // if this thread does not have to-be-presisted buffer
-                persist_func::clwb(pblk);
+                persist_func::clwb(&((PBlk*)pblk)->epoch);
             } else {
-                to_be_persisted->register_persist_raw((PBlk*)pblk, c);
+                to_be_persisted->register_persist_raw((PBlk*)&((PBlk*)pblk)->epoch, c);
             }
         }
     }
 
+    // Dirty recovery of Ralloc takes every block of an in-use superblock
+    // as allocated, freed ones included. Clear the header fields recovery
+    // goes by, so a freed block reads as INIT with no epoch. epoch and
+    // blktype share a 16-byte-aligned slot, so flushing the line of
+    // &epoch persists both.
+    void wipe_pblk(PBlk* pblk){
+        pblk->epoch = NULL_EPOCH;
+        pblk->blktype = INIT;
+    }
+
     // delete_pblk with pending_allocs stuff
     template<typename T>
     void pdelete(T* b){
@@ -977,6 +1054,11 @@ public:
     void tracker_end_op(){
         tracker.end_op(tid);
     }
+    // called after each load of a transient pointer; false if it has to
+    // be loaded again (see RCUTracker::protect)
+    bool tracker_protect(){
+        return tid < 0 || tracker.protect(tid);
+    }
 
     void reset_pending_reads(){
         pending_reads[tid].ui.clear();
@@ -1038,12 +1120,26 @@ public:
             allocs[tid].ui.emplace(ret, [&](void* obj){ this->preclaim(reinterpret_cast<T*>(obj)); });
             return ret;
         } else {
-            if (!flags[tid].inside_txn) return new T(args...);
             T* ret = new T (args...);
+            // under Reclaim=IBR, the rideable must load every pointer to
+            // an IBRNode through atomic_lin_var (see Recoverable's ibr_safe)
+            if constexpr(std::is_base_of<IBRNode,T>::value){
+                ret->birth_era = tracker.alloc_era(tid);
+            }
+            if (!flags[tid].inside_txn) return ret;
             allocs[tid].ui.emplace(ret, [](void* obj){ delete(reinterpret_cast<T*>(obj)); });
             return ret;
         }
     }
+    // like tnew, for a transient object built outside tnew (e.g. by a
+    // class-specific placement operator new): deleted if the txn aborts
+    template <typename T>
+    T* ttrack(T* obj) {
+        static_assert(!std::is_base_of<PBlk,T>::value, "payloads must use tnew");
+        if (!flags[tid].inside_txn) return obj;
+        allocs[tid].ui.emplace(obj, [](void* o){ delete(reinterpret_cast<T*>(o)); });
+        return obj;
+    }
 
     void tfree(void* obj){
         if (!flags[tid].inside_txn) return free(obj);
@@ -1064,25 +1160,13 @@ public:
     template <typename T>
     void tretire(T* obj) {
         if constexpr(std::is_base_of<PBlk,T>::value){
-            if (!flags[tid].inside_txn) return tracker.retire(
-                obj, 
-                tid, 
-                [&](void* o){
-                    this->preclaim(reinterpret_cast<T*>(o));
-                }
-            );
+            if (!flags[tid].inside_txn) return tracker.retire(obj, tid, &tracker_preclaim<T>, this);
             _tdelete(obj,[&](void* o){ 
-                tracker.retire(
-                    reinterpret_cast<T*>(o), 
-                    tid, 
-                    [&](void* o){
-                        this->preclaim(reinterpret_cast<T*>(o));
-                    }
-                ); 
+                tracker.retire(reinterpret_cast<T*>(o), tid, &tracker_preclaim<T>, this); 
             });
         } else {
-            if (!flags[tid].inside_txn) return tracker.retire(obj, tid);
-            _tdelete(obj,[&](void* o){ tracker.retire(reinterpret_cast<T*>(o), tid); });
+            if (!flags[tid].inside_txn) return tracker.retire(obj, tid, birth_of(obj));
+            _tdelete(obj,[&](void* o){ tracker.retire(reinterpret_cast<T*>(o), tid, birth_of(obj)); });
         }
     }
     // transient retire to be withdrawn at tracker.abort_op
@@ -1091,20 +1175,28 @@ public:
         if constexpr(std::is_base_of<PBlk,T>::value){
             assert (flags[tid].inside_txn);
             _tdelete(obj,[&](void* o){ 
-                tracker.temp_retire(
-                    reinterpret_cast<T*>(o), 
-                    tid,
-                    [&](void* o){
-                        this->preclaim(reinterpret_cast<T*>(o));
-                    }
-                ); 
+                tracker.temp_retire(reinterpret_cast<T*>(o), tid, &tracker_preclaim<T>, this); 
             });
         } else {
             assert (flags[tid].inside_txn);
-            _tdelete(obj,[&](void* o){ tracker.temp_retire(reinterpret_cast<T*>(o), tid); });
+            _tdelete(obj,[&](void* o){ tracker.temp_retire(reinterpret_cast<T*>(o), tid, birth_of(obj)); });
         }
     }
 private:
+    // birth era for tracker; objects without one count as born in era 0
+    template <typename T>
+    static uint64_t birth_of(const T* obj){
+        if constexpr(std::is_base_of<IBRNode,T>::value){
+            return obj->birth_era;
+        } else {
+            return 0;
+        }
+    }
+    // deleter for payloads retired to tracker; esys is the EpochSys
+    template <typename T>
+    static void tracker_preclaim(void* obj, void* esys){
+        static_cast<EpochSys*>(esys)->preclaim(static_cast<T*>(obj));
+    }
     template <typename T> 
     void _tdelete(T* obj, std::function<void(void*)> dealloc_func){
         auto iter = allocs[tid].ui.find(reinterpret_cast<void*>(obj));
@@ -1168,7 +1260,7 @@ class nbEpochSys : public EpochSys {
         // ensure nbEpochSys is used only when VISIBLE_READ is not
         assert(0&&"nbEpochSys is incompatible with VISIBLE_READ!");
 #endif
-    for(int i=0;i<gtc->task_num;i++){
+    for(int i=0;i<task_num;i++){
             // Wentao: although in blocking Montage, descriptors don't
             // need to be persistent at all, we still allocate them in
             // NVM for simplicity. By some experiments, we confirmed
@@ -18,6 +18,10 @@ public:
     virtual int next_thread_to_persist(uint64_t e, int tid) = 0;
     virtual int next_thread_to_persist(uint64_t e) = 0;
     virtual uint64_t next_epoch_to_persist(int tid) = 0;
+    // a thread leaving its slot, with nothing left to persist, drops out
+    // of next_thread_to_persist(); one taking a slot in epoch e rejoins.
+    virtual void retire_thread(int tid) = 0;
+    virtual void revive_thread(uint64_t e, int tid) = 0;
     virtual ~PersistTracker(){}
 };
 
@@ -321,6 +325,15 @@ public:
         }
         return ret;
     }
+    void retire_thread(int tid){
+        for (int i = 0; i < EPOCH_WINDOW; i++){
+            has_write_op[i][tid].ui.store(0);
+        }
+        change(UINT64_MAX, tid);
+    }
+    void revive_thread(uint64_t e, int tid){
+        // the leaf stays at UINT64_MAX until the first write.
+    }
 };
 
 // Contains per-thread TO-BE-PERSISTED epoch information
@@ -507,6 +520,20 @@ public:
     uint64_t next_epoch_to_persist(int tid){
         return leaves[tid].val.load();
     }
+    void retire_thread(int tid){
+        after_persist_epoch(UINT64_MAX-1, tid);
+    }
+    void revive_thread(uint64_t e, int tid){
+        // values only grow in propagate(), so the lowered leaf pulls its
+        // ancestors down itself. A racing propagate() reads the leaf
+        // after its CAS fails, so it can't lift them back over e.
+        leaves[tid].val.store(e);
+        for (int i = paths[tid].size()-2; i >= 0; i--){
+            uint64_t old_val = paths[tid][i]->val.load();
+            while (old_val > e &&
+                !paths[tid][i]->val.compare_exchange_weak(old_val, e)){}
+        }
+    }
 };
 
 #endif
\ No newline at end of file
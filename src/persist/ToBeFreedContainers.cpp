@@ -7,11 +7,11 @@ using namespace pds;
 void ThreadLocalFreedContainer::do_free(PBlk*& x, uint64_t c){
     _esys->delete_pblk(x, c);
 }
-ThreadLocalFreedContainer::ThreadLocalFreedContainer(EpochSys* e, GlobalTestConfig* gtc): task_num(gtc->task_num){
-    container = new VectorContainer<PBlk*>(gtc->task_num);
-    threadEpoch = new padded<uint64_t>[gtc->task_num];
+ThreadLocalFreedContainer::ThreadLocalFreedContainer(EpochSys* e, GlobalTestConfig* gtc): task_num(e->max_threads()){
+    container = new VectorContainer<PBlk*>(task_num);
+    threadEpoch = new padded<uint64_t>[task_num];
     _esys = e;
-    for(int i = 0; i < gtc->task_num; i++){
+    for(int i = 0; i < task_num; i++){
         threadEpoch[i] = INIT_EPOCH;
     }
 }
@@ -50,7 +50,7 @@ void PerEpochFreedContainer::do_free(PBlk*& x, uint64_t c){
     _esys->delete_pblk(x, c);
 }
 PerEpochFreedContainer::PerEpochFreedContainer(EpochSys* e, GlobalTestConfig* gtc){
-    container = new VectorContainer<PBlk*>(gtc->task_num);
+    container = new VectorContainer<PBlk*>(e->max_threads());
     _esys = e;
     // container = new HashSetContainer<PBlk*>(gtc->task_num);
 }
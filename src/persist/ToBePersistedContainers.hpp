@@ -152,8 +152,8 @@ class BufferedWB : public ToBePersistContainer{
     void do_persist(void*& addr);
     // void dump(uint64_t c);
 public:
-    BufferedWB (GlobalTestConfig* _gtc, Ralloc* r): 
-        ToBePersistContainer(r, _gtc->task_num), gtc(_gtc){
+    BufferedWB (GlobalTestConfig* _gtc, Ralloc* r, int tn): 
+        ToBePersistContainer(r, tn), gtc(_gtc){
         if (gtc->checkEnv("BufferSize")){
             buffer_size = stoi(gtc->getEnv("BufferSize"));
         } else {
@@ -13,7 +13,8 @@ bool PerEpochTransactionTracker::consistent_set(uint64_t target, uint64_t c){
         return false;
     }
 }
-PerEpochTransactionTracker::PerEpochTransactionTracker(atomic<uint64_t>* ge, int tn): TransactionTracker(ge), task_num(tn){
+PerEpochTransactionTracker::PerEpochTransactionTracker(atomic<uint64_t>* ge, const SlotRegistry* s):
+    TransactionTracker(ge), task_num(s->size()), slots(s){
     curr_epochs = new paddedAtomic<uint64_t>[task_num];
     for (int i = 0; i < task_num; i++){
         curr_epochs[i].ui.store(NULL_EPOCH);
@@ -34,7 +35,11 @@ void PerEpochTransactionTracker::unregister_bookkeeping(uint64_t target){
     curr_epochs[EpochSys::tid].ui.store(NULL_EPOCH, std::memory_order_seq_cst);
 }
 bool PerEpochTransactionTracker::no_active(uint64_t target){
-    for (int i = 0; i < task_num; i++){
+    int bound = slots->bound();
+    for (int i = 0; i < bound; i++){
+        if (!slots->active(i)){
+            continue;
+        }
         uint64_t curr_epoch = curr_epochs[i].ui.load(std::memory_order_acquire);
         if (target == curr_epoch && curr_epoch != NULL_EPOCH){
             // std::cout<<"target:"<<target<<" curr_epoch:"<<curr_epoch<<" i:"<<i<<std::endl;
@@ -109,15 +114,19 @@ bool NoFenceTransactionTracker::consistent_register(paddedAtomic<bool>* indicato
     }
 }
 bool NoFenceTransactionTracker::all_false(paddedAtomic<bool>* indicators){
-    for (int i = 0; i < task_num; i++){
+    int bound = slots->bound();
+    for (int i = 0; i < bound; i++){
+        if (!slots->active(i)){
+            continue;
+        }
         if (indicators[i].ui.load(std::memory_order_acquire) == true){
             return false;
         }
     }
     return true;
 }
-NoFenceTransactionTracker::NoFenceTransactionTracker(atomic<uint64_t>* ge, int tn):
-    TransactionTracker(ge), task_num(tn){
+NoFenceTransactionTracker::NoFenceTransactionTracker(atomic<uint64_t>* ge, const SlotRegistry* s):
+    TransactionTracker(ge), task_num(s->size()), slots(s){
     for (int i = 0; i < 4; i++){
         active_transactions[i].ui = new paddedAtomic<bool>[task_num];
         bookkeeping_transactions[i].ui = new paddedAtomic<bool>[task_num];
@@ -150,12 +159,12 @@ void FenceBeginTransactionTracker::set_register(paddedAtomic<bool>* indicators){
     assert(EpochSys::tid != -1);
     indicators[EpochSys::tid].ui.store(true, std::memory_order_seq_cst);
 }
-FenceBeginTransactionTracker::FenceBeginTransactionTracker(atomic<uint64_t>* ge, int task_num):
-    NoFenceTransactionTracker(ge, task_num){}
+FenceBeginTransactionTracker::FenceBeginTransactionTracker(atomic<uint64_t>* ge, const SlotRegistry* s):
+    NoFenceTransactionTracker(ge, s){}
 
 void FenceEndTransactionTracker::set_unregister(paddedAtomic<bool>* indicators){
     assert(EpochSys::tid != -1);
     indicators[EpochSys::tid].ui.store(false, std::memory_order_seq_cst);
 }
-FenceEndTransactionTracker::FenceEndTransactionTracker(atomic<uint64_t>* ge, int task_num):
-    NoFenceTransactionTracker(ge, task_num){}
+FenceEndTransactionTracker::FenceEndTransactionTracker(atomic<uint64_t>* ge, const SlotRegistry* s):
+    NoFenceTransactionTracker(ge, s){}
@@ -30,9 +30,11 @@ namespace pds{
     class PerEpochTransactionTracker: public TransactionTracker{
         paddedAtomic<uint64_t>* curr_epochs;
         int task_num;
+        // scans stop at slots->bound() and skip free slots
+        const SlotRegistry* slots;
         bool consistent_set(uint64_t target, uint64_t c);
     public:
-        PerEpochTransactionTracker(std::atomic<uint64_t>* ge, int tn);
+        PerEpochTransactionTracker(std::atomic<uint64_t>* ge, const SlotRegistry* s);
         bool consistent_register_active(uint64_t target, uint64_t c);
         bool consistent_register_bookkeeping(uint64_t target, uint64_t c);
         void unregister_active(uint64_t target);
@@ -80,12 +82,14 @@ namespace pds{
         padded<paddedAtomic<bool>*> active_transactions[EPOCH_WINDOW];
         padded<paddedAtomic<bool>*> bookkeeping_transactions[EPOCH_WINDOW];
         int task_num;
+        // scans stop at slots->bound() and skip free slots
+        const SlotRegistry* slots;
         virtual void set_register(paddedAtomic<bool>* indicators);
         virtual void set_unregister(paddedAtomic<bool>* indicators);
         bool consistent_register(paddedAtomic<bool>* indicators, const uint64_t c);
         bool all_false(paddedAtomic<bool>* indicators);
     public:
-        NoFenceTransactionTracker(std::atomic<uint64_t>* ge, int tn);
+        NoFenceTransactionTracker(std::atomic<uint64_t>* ge, const SlotRegistry* s);
         bool consistent_register_active(uint64_t target, uint64_t c);
         bool consistent_register_bookkeeping(uint64_t target, uint64_t c);
         virtual void unregister_active(uint64_t target);
@@ -97,13 +101,13 @@ namespace pds{
     class FenceBeginTransactionTracker : public NoFenceTransactionTracker{
         virtual void set_register(paddedAtomic<bool>* indicators);
     public:
-        FenceBeginTransactionTracker(std::atomic<uint64_t>* ge, int task_num);
+        FenceBeginTransactionTracker(std::atomic<uint64_t>* ge, const SlotRegistry* s);
     };
 
     class FenceEndTransactionTracker : public NoFenceTransactionTracker{
         virtual void set_unregister(paddedAtomic<bool>* indicators);
     public:
-        FenceEndTransactionTracker(std::atomic<uint64_t>* ge, int task_num);
+        FenceEndTransactionTracker(std::atomic<uint64_t>* ge, const SlotRegistry* s);
     };
 
 }
@@ -2,8 +2,11 @@
 #include "PersistFunc.hpp"
 // std::atomic<size_t> pds::abort_cnt(0);
 // std::atomic<size_t> pds::total_cnt(0);
-Recoverable::Recoverable(GlobalTestConfig* gtc) : 
+Recoverable::Recoverable(GlobalTestConfig* gtc, bool ibr_safe) : 
     _preallocated_esys(gtc->_preallocated_esys) {
+    if(!ibr_safe && pds::EpochSys::get_reclaim_type(gtc) == type_IBR){
+        errexit("Reclaim=IBR isn't supported by this rideable.");
+    }
     // init epoch system
     if(_preallocated_esys){
         // epoch system already allocated; assign to this recoverable
@@ -69,7 +69,10 @@ public:
 
     // return num of blocks recovered.
     virtual int recover(bool simulated = false) = 0;
-    Recoverable(GlobalTestConfig* gtc);
+    // ibr_safe: every transient node of the rideable that derives from
+    // IBRNode is loaded through atomic_lin_var, which protects it. Only
+    // such rideables may run with Reclaim=IBR.
+    Recoverable(GlobalTestConfig* gtc, bool ibr_safe = false);
     virtual ~Recoverable();
 
     void init_thread(GlobalTestConfig*, LocalTestConfig* ltc);
@@ -202,6 +205,10 @@ public:
     T* tnew(Types... args) {
         return _esys->tnew<T>(args...);
     }
+    template <typename T>
+    T* ttrack(T* obj) {
+        return _esys->ttrack(obj);
+    }
 
     void tfree(void* obj) {
         _esys->tfree(obj);
@@ -504,9 +511,10 @@ namespace pds{
 
     template<typename T>
     lin_var atomic_lin_var<T>::full_load(EpochSys* esys){
-        lin_var r = var.load();
-        assert(!r.is_desc() || r.get_desc() != esys->get_dcss_desc());
-        return r;
+        // Unlike load(), this may find the caller's own desc. A txn
+        // installs descs as it goes, and may then help another txn that
+        // read one of those vars before; validation just sees a mismatch.
+        return var.load();
     }
 
     template<typename T>
@@ -519,7 +527,7 @@ namespace pds{
                 assert(D != esys->get_dcss_desc());
                 D->helper_try_complete(esys, var, r);
             }
-        } while(r.is_desc());
+        } while(r.is_desc() || !esys->tracker_protect());
         return reinterpret_cast<T>(r.val);
     }
 
@@ -674,7 +682,7 @@ namespace pds{
                     D->helper_try_complete(ds, var, r);
                 }
             }
-        } while(r.is_desc());
+        } while(r.is_desc() || !ds->_esys->tracker_protect());
         is_speculative = false;
         ds->_esys->addToPendingReads(this, r);
         return reinterpret_cast<T>(r.val);
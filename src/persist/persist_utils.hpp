@@ -78,6 +78,55 @@ public:
     }
 };
 
+// Lock-free registry of thread slots. The first `reserved` slots belong
+// to statically numbered threads (the harness' workers); the rest are
+// handed out by acquire() and given back by release(). bound() is one
+// past the highest slot ever handed out, and only grows, so scans over
+// per-thread state can stop there instead of at capacity.
+class SlotRegistry{
+    paddedAtomic<bool>* taken = nullptr;
+    int capacity;
+    paddedAtomic<int> high_water;
+public:
+    SlotRegistry(int cap, int reserved) : capacity(cap){
+        assert(reserved <= capacity);
+        taken = new paddedAtomic<bool>[capacity];
+        for (int i = 0; i < capacity; i++){
+            taken[i].ui.store(i < reserved);
+        }
+        high_water.ui.store(reserved);
+    }
+    ~SlotRegistry(){
+        delete[] taken;
+    }
+    // take the lowest free slot; -1 if all are taken
+    int acquire(){
+        for (int i = 0; i < capacity; i++){
+            bool f = false;
+            if (!taken[i].ui.load(std::memory_order_relaxed) &&
+                taken[i].ui.compare_exchange_strong(f, true)){
+                int hw = high_water.ui.load();
+                while (hw <= i && !high_water.ui.compare_exchange_weak(hw, i+1)){}
+                return i;
+            }
+        }
+        return -1;
+    }
+    void release(int slot){
+        assert(slot >= 0 && slot < capacity);
+        taken[slot].ui.store(false, std::memory_order_release);
+    }
+    bool active(int slot) const{
+        return taken[slot].ui.load(std::memory_order_acquire);
+    }
+    int bound() const{
+        return high_water.ui.load(std::memory_order_seq_cst);
+    }
+    int size() const{
+        return capacity;
+    }
+};
+
 // A single-threaded circular buffer that grows exponentially
 // when populated and never shrinks (for now).
 // The buffer always allocates new spaces in chunks: the key
@@ -9,20 +9,48 @@
 #include "lfttsetadaptor.h"
 
 class LFTTSkipList : public RMap<uint64_t, uint64_t>{
+    // Max operations per transaction (-dTxnSize). Descriptors are sized
+    // for it, so a longer transaction would overrun its descriptor.
+    const size_t max_txn_size;
+    // Transactions each thread may run (-dLFTTCapacity). LFTT bump-allocates
+    // a descriptor per transaction from a per-thread pool and never reuses
+    // it; the pool is reserved, not populated, so this mostly costs address
+    // space.
+    const uint64_t capacity;
     SetAdaptor<trans_skip> set;
     padded<SetOpArray*>* local_ops = nullptr;
+    padded<uint64_t>* txn_counts = nullptr;
+
+    static uint64_t env_or(GlobalTestConfig* gtc, const std::string& name, uint64_t dflt){
+        return gtc->checkEnv(name) ? std::stoull(gtc->getEnv(name)) : dflt;
+    }
+    bool execute(const SetOpArray& ops, int tid){
+        if (ops.size() > max_txn_size){
+            errexit("LFTT transaction exceeds TxnSize operations.");
+        }
+        if (++txn_counts[tid].ui > capacity){
+            errexit("LFTT descriptor pool exhausted; raise LFTTCapacity.");
+        }
+        return set.ExecuteOps(ops);
+    }
 public:
-    // constructor: SetAdapter(max_node_number, thread_num + 1, max_transaction_size)
-    LFTTSkipList(GlobalTestConfig* gtc) : set(1000000, gtc->task_num+1, 10){
+    // constructor: SetAdapter(descriptors_per_thread, thread_num + 1, max_transaction_size)
+    LFTTSkipList(GlobalTestConfig* gtc) :
+        max_txn_size(env_or(gtc, "TxnSize", 10)),
+        capacity(env_or(gtc, "LFTTCapacity", 1000000)),
+        set(capacity, gtc->task_num+1, max_txn_size){
         local_ops = new padded<SetOpArray*>[gtc->task_num];
+        txn_counts = new padded<uint64_t>[gtc->task_num];
         for (int i = 0 ;i < gtc->task_num; i++) {
             local_ops[i].ui = nullptr;
+            txn_counts[i].ui = 0;
         }
         set.Init();
     }
     virtual ~LFTTSkipList(){
         set.Uninit();
         delete local_ops;
+        delete[] txn_counts;
     }
     void init_thread(GlobalTestConfig* gtc, LocalTestConfig* ltc) override {
         if (ltc->tid != 0) {
@@ -35,7 +63,7 @@ public:
             SetOpArray ops(1);
             ops[0].type = FIND;
             ops[0].key = key;
-            set.ExecuteOps(ops);
+            execute(ops, tid);
         } else {
             SetOpArray* local_op = local_ops[tid].ui;
             local_op->emplace_back();
@@ -55,7 +83,7 @@ public:
             ops[0].type = INSERT;
             ops[0].key = key;
             ops[0].val = val;
-            set.ExecuteOps(ops);
+            execute(ops, tid);
         } else {
             SetOpArray* local_op = local_ops[tid].ui;
             local_op->emplace_back();
@@ -70,7 +98,7 @@ public:
             SetOpArray ops(1);
             ops[0].type = DELETE;
             ops[0].key = key;
-            set.ExecuteOps(ops);
+            execute(ops, tid);
         } else {
             SetOpArray* local_op = local_ops[tid].ui;
             local_op->emplace_back();
@@ -89,12 +117,13 @@ public:
     }
     void begin_transaction(size_t trans_size, int tid) {
         assert(!is_in_transaction(tid));
-        local_ops[tid].ui = new SetOpArray(trans_size);
+        local_ops[tid].ui = new SetOpArray();
+        local_ops[tid].ui->reserve(trans_size);
     }
     bool commit_transaction(int tid){
         bool ret;
         assert(is_in_transaction(tid));
-        ret = set.ExecuteOps(*local_ops[tid].ui);
+        ret = execute(*local_ops[tid].ui, tid);
         delete(local_ops[tid].ui);
         local_ops[tid].ui = nullptr;
         return ret;
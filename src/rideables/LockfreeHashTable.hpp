@@ -14,10 +14,11 @@
 #include "HarnessUtils.hpp"
 #include "ConcurrentPrimitives.hpp"
 #include "RMap.hpp"
+#include "FastHash.hpp"
 #include "RCUTracker.hpp"
 #include "CustomTypes.hpp"
 
-template <class K, class V>
+template <class K, class V, class Hash=FastHash<K>>
 class LockfreeHashTable : public RMap<K,V>{
     struct Node;
 
@@ -34,7 +35,7 @@ class LockfreeHashTable : public RMap<K,V>{
         Node(K k, V v, Node* n):key(k),val(v),next(n){};
     };
 private:
-    std::hash<K> hash_fn;
+    Hash hash_fn;
     const int idxSize=1000000;//number of buckets for hash table
     padded<MarkPtr>* buckets=new padded<MarkPtr>[idxSize]{};
     bool findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid);
@@ -74,8 +75,8 @@ class LockfreeHashTableFactory : public RideableFactory{
 
 
 //-------Definition----------
-template <class K, class V> 
-optional<V> LockfreeHashTable<K,V>::get(K key, int tid) {
+template <class K, class V, class Hash>
+optional<V> LockfreeHashTable<K,V,Hash>::get(K key, int tid) {
     MarkPtr* prev=nullptr;
     Node* curr=nullptr;
     Node* next=nullptr;
@@ -90,8 +91,8 @@ optional<V> LockfreeHashTable<K,V>::get(K key, int tid) {
     return res;
 }
 
-template <class K, class V> 
-optional<V> LockfreeHashTable<K,V>::put(K key, V val, int tid) {
+template <class K, class V, class Hash>
+optional<V> LockfreeHashTable<K,V,Hash>::put(K key, V val, int tid) {
     Node* tmpNode = nullptr;
     MarkPtr* prev=nullptr;
     Node* curr=nullptr;
@@ -129,8 +130,8 @@ optional<V> LockfreeHashTable<K,V>::put(K key, V val, int tid) {
     return res;
 }
 
-template <class K, class V> 
-bool LockfreeHashTable<K,V>::insert(K key, V val, int tid){
+template <class K, class V, class Hash>
+bool LockfreeHashTable<K,V,Hash>::insert(K key, V val, int tid){
     Node* tmpNode = nullptr;
     MarkPtr* prev=nullptr;
     Node* curr=nullptr;
@@ -159,8 +160,8 @@ bool LockfreeHashTable<K,V>::insert(K key, V val, int tid){
     return res;
 }
 
-template <class K, class V> 
-optional<V> LockfreeHashTable<K,V>::remove(K key, int tid) {
+template <class K, class V, class Hash>
+optional<V> LockfreeHashTable<K,V,Hash>::remove(K key, int tid) {
     MarkPtr* prev=nullptr;
     Node* curr=nullptr;
     Node* next=nullptr;
@@ -188,8 +189,8 @@ optional<V> LockfreeHashTable<K,V>::remove(K key, int tid) {
     return res;
 }
 
-template <class K, class V> 
-optional<V> LockfreeHashTable<K,V>::replace(K key, V val, int tid) {
+template <class K, class V, class Hash>
+optional<V> LockfreeHashTable<K,V,Hash>::replace(K key, V val, int tid) {
     Node* tmpNode = nullptr;
     MarkPtr* prev=nullptr;
     Node* curr=nullptr;
@@ -224,10 +225,10 @@ optional<V> LockfreeHashTable<K,V>::replace(K key, V val, int tid) {
     return res;
 }
 
-template <class K, class V> 
-bool LockfreeHashTable<K,V>::findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid){
+template <class K, class V, class Hash>
+bool LockfreeHashTable<K,V,Hash>::findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid){
     while(true){
-        size_t idx=hash_fn(key)%idxSize;
+        size_t idx=fastrange(hash_fn(key),idxSize);
         bool cmark=false;
         prev=&buckets[idx].ui;
         curr=getPtr(prev->ptr.load());
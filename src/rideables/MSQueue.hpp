@@ -41,6 +41,8 @@ public:
 
     void enqueue(T val, int tid);
     optional<T> dequeue(int tid);
+    void enqueue_batch(const T* vals, size_t n, int tid);
+    size_t dequeue_batch(T* vals, size_t n, int tid);
 };
 
 template<typename T>
@@ -96,6 +98,81 @@ optional<T> MSQueue<T>::dequeue(int tid){
     return res;
 }
 
+template<typename T>
+void MSQueue<T>::enqueue_batch(const T* vals, size_t n, int tid){
+    if (n == 0) return;
+    // link the batch privately; a single CAS publishes all of it
+    Node* first = new Node(vals[0]);
+    Node* last = first;
+    for (size_t i = 1; i < n; i++){
+        Node* new_node = new Node(vals[i]);
+        last->next.store(new_node, std::memory_order_relaxed);
+        last = new_node;
+    }
+    Node* cur_tail = nullptr;
+    tracker.start_op(tid);
+    while(true){
+        cur_tail = tail.load();
+        Node* next = cur_tail->next.load();
+        if(cur_tail == tail.load()){
+            if(next == nullptr) {
+                if((cur_tail->next).compare_exchange_strong(next, first)){
+                    break;
+                }
+            } else {
+                tail.compare_exchange_strong(cur_tail, next); // try to swing tail to next node
+            }
+        }
+    }
+    tail.compare_exchange_strong(cur_tail, last); // try to swing tail to the end of the batch
+    tracker.end_op(tid);
+}
+
+template<typename T>
+size_t MSQueue<T>::dequeue_batch(T* vals, size_t n, int tid){
+    if (n == 0) return 0;
+    size_t k = 0;
+    tracker.start_op(tid);
+    while(true){
+        Node* cur_head = head.load();
+        // walk up to n nodes past the dummy; the last one becomes the
+        // new dummy, so a single CAS on head takes all of them
+        Node* last = cur_head;
+        k = 0;
+        while(k < n){
+            Node* next = last->next.load();
+            if(next == nullptr){
+                break;
+            }
+            Node* cur_tail = last;
+            if(tail.load() == last){
+                // tail is falling behind; it mustn't be left behind head
+                tail.compare_exchange_strong(cur_tail, next);
+            }
+            vals[k++] = next->val;
+            last = next;
+        }
+        if(k == 0){
+            // queue is empty
+            if(cur_head == head.load()){
+                break;
+            }
+            continue;
+        }
+        if(head.compare_exchange_strong(cur_head, last)){
+            Node* curr = cur_head;
+            while(curr != last){
+                Node* next = curr->next.load();
+                tracker.retire(curr, tid);
+                curr = next;
+            }
+            break;
+        }
+    }
+    tracker.end_op(tid);
+    return k;
+}
+
 template <class T> 
 class MSQueueFactory : public RideableFactory{
     Rideable* build(GlobalTestConfig* gtc){
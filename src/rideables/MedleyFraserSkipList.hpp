@@ -45,10 +45,12 @@
 #include <cassert>
 #include <random>
 #include <functional>
+#include <type_traits>
 
 #include "HarnessUtils.hpp"
 #include "ConcurrentPrimitives.hpp"
 #include "RMap.hpp"
+#include "SizeClassPool.hpp"
 // #include "RCUTracker.hpp"
 #include "Recoverable.hpp"
 
@@ -59,6 +61,10 @@ private:
     static constexpr int READY_FOR_FREE = 0x100;
     static constexpr int NUM_LEVELS = 20;
     enum KeyType { MIN, REAL, MAX };
+    // Small trivially-copyable values are stored in the node itself;
+    // see Node.
+    static constexpr bool INLINE_VAL = std::is_trivially_copyable<V>::value
+        && sizeof(V) <= 16 && alignof(V) <= alignof(void*);
 
     class Value 
     {
@@ -81,43 +87,75 @@ private:
         ValuePtr(Value *n) : ptr(n){};
         ValuePtr() : ptr(nullptr){};
     };
-    struct alignas(64) Node{
+    using NodePool = SizeClassPool<Node, NUM_LEVELS>;
+    // A node of level l is allocated from class l-1 of NodePool and
+    // carries only the l-1 tower entries it uses (level 0 is
+    // floor_next). With INLINE_VAL, the Value the node is inserted with
+    // follows the tower; val points at it until a put replaces it with a
+    // separately allocated Value, and it goes away with the node.
+    struct Node{
         std::atomic<int> level;
         KeyType key_type; // 0 min, 1 real val, 2 max
-        MedleyFraserSkipList* ds;
         K key;
         ValuePtr val;
         // Transient-to-transient pointers
         NodePtr floor_next;
-        std::atomic<Node*> next [NUM_LEVELS-1];
-        Node(MedleyFraserSkipList* _ds, K k, Value* _val, Node *_next, int _level, KeyType _key_type) : 
+        std::atomic<Node*> next [0];
+        Node(MedleyFraserSkipList* ds, K k, Value* _val, Node *_next, int _level, KeyType _key_type) : 
             level(_level), 
             key_type(_key_type), 
-            ds(_ds),
             key(k), 
             val(_val), 
-            floor_next(),
-            next{} 
+            floor_next()
         { 
             floor_next.ptr.store(ds, _next);
             for(int i = 0; i < level-1; i++) 
                 next[i].store(_next);
         }
-        Node(MedleyFraserSkipList* _ds, Node *_next, int _level, KeyType _key_type) : 
+        template <bool I = INLINE_VAL, typename std::enable_if<I, int>::type = 0>
+        Node(MedleyFraserSkipList* ds, K k, const V& _val, Node *_next, int _level, KeyType _key_type) : 
+            Node(ds, k, (Value*)nullptr, _next, _level, _key_type)
+        {
+            val.ptr.store(ds, new (inline_val()) Value(_val));
+        }
+        Node(MedleyFraserSkipList* ds, Node *_next, int _level, KeyType _key_type) : 
             level(_level), 
             key_type(_key_type), 
-            ds(_ds),
             key(), 
             val(nullptr), 
-            floor_next(),
-            next{} 
+            floor_next()
         {
             floor_next.ptr.store(ds, _next);
             for(int i = 0; i < level-1; i++) 
                 next[i].store(_next);
         }
-        ~Node(){ }
+
+        static size_t size_of(int _level){
+            return sizeof(Node) + (_level-1)*sizeof(std::atomic<Node*>) +
+                (INLINE_VAL ? sizeof(Value) : 0);
+        }
+        Value* inline_val(){
+            return reinterpret_cast<Value*>(&next[(level.load() & LEVEL_MASK)-1]);
+        }
+        static void* operator new(size_t sz, int _level){
+            return NodePool::alloc(_level-1, size_of(_level));
+        }
+        static void operator delete(void* p, int _level){
+            NodePool::free(p);
+        }
+        static void operator delete(void* p){
+            NodePool::free(p);
+        }
     };
+    // whether v is the value stored inside n, which must not be retired
+    // on its own
+    bool is_inline_val(Node* n, Value* v){
+        if constexpr (INLINE_VAL) {
+            return v == n->inline_val();
+        } else {
+            return false;
+        }
+    }
 
     int get_level(int tid) {
         size_t r = rands[tid].ui();
@@ -141,7 +179,7 @@ private:
     void mark_deleted(Node* x, int level);
     int check_for_full_delete(Node* x);
     void do_full_delete(Node* x, int level, int tid);
-    bool do_update(const K& key, Value* val, int tid, optional<V>& res, bool overwrite);
+    bool do_update(const K& key, const V& val, int tid, optional<V>& res, bool overwrite);
 
     GlobalTestConfig* gtc;
     padded<std::mt19937>* rands;
@@ -150,10 +188,11 @@ public:
     MedleyFraserSkipList(GlobalTestConfig* gtc) : 
         Recoverable(gtc),
         gtc(gtc),
-        head(new Node(this, new Node(this, nullptr, NUM_LEVELS, MAX), NUM_LEVELS, MIN))
+        head(new (NUM_LEVELS) Node(this, new (NUM_LEVELS) Node(this, nullptr, NUM_LEVELS, MAX), NUM_LEVELS, MIN))
         { 
-        rands = new padded<std::mt19937>[gtc->task_num];
-        for(int i=0;i<gtc->task_num;i++){
+        int thd_num = pds::EpochSys::get_max_threads(gtc);
+        rands = new padded<std::mt19937>[thd_num];
+        for(int i=0;i<thd_num;i++){
             rands[i].ui.seed(i);
         }
     };
@@ -306,9 +345,10 @@ void MedleyFraserSkipList<K,V>::do_full_delete(Node* x, int level, int tid)
 }
 
 template<class K, class V>
-bool MedleyFraserSkipList<K,V>::do_update(const K& key, Value* val, int tid, optional<V>& res, bool overwrite)
+bool MedleyFraserSkipList<K,V>::do_update(const K& key, const V& val, int tid, optional<V>& res, bool overwrite)
 {
     Value*  ov = nullptr;
+    Value*  nv = nullptr; // separately allocated new value, if needed
     Node* preds[NUM_LEVELS] = {nullptr};
     Node* succs[NUM_LEVELS] = {nullptr};
     Node* pred = nullptr;
@@ -340,7 +380,8 @@ bool MedleyFraserSkipList<K,V>::do_update(const K& key, Value* val, int tid, opt
                 goto retry;
             }
             if (overwrite) {
-                cas_ret = succ->val.ptr.nbtc_CAS(this, ov, val, true, true); //lin cas if succeeds
+                if ( nv == nullptr ) nv = tnew<Value>(val);
+                cas_ret = succ->val.ptr.nbtc_CAS(this, ov, nv, true, true); //lin cas if succeeds
             }
         } while ( overwrite && !cas_ret );
 
@@ -348,19 +389,29 @@ bool MedleyFraserSkipList<K,V>::do_update(const K& key, Value* val, int tid, opt
         res = ov->val;
         if (overwrite) {
             result = true;
-            if (cas_ret == 1)
+            if (is_inline_val(succ, ov)) {
+                // freed along with succ
+            } else if (cas_ret == 1)
                 this->tretire(ov);
             else 
                 this->txn_tretire(ov);
         } else {
+            if ( nv != nullptr ) tdelete(nv);
             addToReadSet(&(succ->val.ptr), ov);
             result = false;
         }
         // goto out;
     } else {
         /* Not in the list, so initialise a new_node node for insertion. */
-        if ( new_node == nullptr )
-            new_node    = tnew<Node>(this, key, val, nullptr, get_level(tid), REAL);
+        if ( new_node == nullptr ) {
+            level = get_level(tid);
+            if constexpr (INLINE_VAL) {
+                new_node = ttrack(new (level) Node(this, key, val, nullptr, level, REAL));
+            } else {
+                if ( nv == nullptr ) nv = tnew<Value>(val);
+                new_node = ttrack(new (level) Node(this, key, nv, nullptr, level, REAL));
+            }
+        }
         level = new_node->level.load();
 
         /* If successors don't change, this saves us some CAS operations. */
@@ -377,6 +428,7 @@ bool MedleyFraserSkipList<K,V>::do_update(const K& key, Value* val, int tid, opt
             goto retry;
         }
         result = true; // inserted
+        if ( INLINE_VAL && nv != nullptr ) tdelete(nv); // left over from a retry
 
         /* Insert at each of the other levels in turn. */
         auto cleanup = [=]()mutable{
@@ -495,7 +547,8 @@ optional<V> MedleyFraserSkipList<K,V>::remove(K key, int tid){
     res = v->val;
     
     auto cleanup = [=]()mutable{
-        this->tretire(v);
+        if (!is_inline_val(x, v))
+            this->tretire(v);
         /* Committed to @x: mark lower-level forward pointers. */
         mark_deleted(x, level);
 
@@ -539,11 +592,7 @@ template<class K, class V>
 optional<V> MedleyFraserSkipList<K,V>::put(K key, V val, int tid){
     TX_OP_SEPARATOR();
     optional<V> res = {};
-    // XXX(wentao): this tnew automatically detects whether the type
-    // is derived from PBlk, and if yes it will invoke pnew/preclaim
-    // instead of new/delete.
-    Value* _v = tnew<Value>(val);
-    bool ret = do_update(key, _v, tid, res, true);
+    do_update(key, val, tid, res, true);
     return res;
 }
 
@@ -551,13 +600,7 @@ template<class K, class V>
 bool MedleyFraserSkipList<K,V>::insert(K key, V val, int tid) {
     TX_OP_SEPARATOR();
     optional<V> res = {};
-    Value* _v = tnew<Value>(val);
-    if (do_update(key, _v, tid, res, false)){
-        return true;
-    } else {
-        tdelete(_v);
-        return false;
-    }
+    return do_update(key, val, tid, res, false);
 }
 
 template<class K, class V>
@@ -0,0 +1,507 @@
+#ifndef MEDLEY_FRASER_CAS_SKIPLIST_SET
+#define MEDLEY_FRASER_CAS_SKIPLIST_SET
+/******************************************************************************
+ * Skip lists, allowing concurrent update by use of CAS primitives. 
+ * 
+ * Copyright (c) 2001-2003, K A Fraser
+ * 
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright 
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright 
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * * The name of the author may not be used to endorse or promote products
+ * derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR 
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, 
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) 
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN 
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// The original C code comes from SynchBench at
+// https://github.com/gramoli/synchrobench/blob/master/c-cpp/src/skiplists/fraser/skip_cas.c
+//
+// We transform it to C++.
+//
+// This is the set version of MedleyFraserSkipList. A node carries only
+// its key; instead of a pointer to a separately allocated Value, a
+// node has a `live' word whose nbtc_CAS from 1 to 0 is the
+// linearization point of remove, so a member costs one allocation.
+
+#include <cassert>
+#include <random>
+#include <functional>
+
+#include "HarnessUtils.hpp"
+#include "ConcurrentPrimitives.hpp"
+#include "RSet.hpp"
+#include "Recoverable.hpp"
+
+template <class K>
+class MedleyFraserSkipListSet : public RSet<K>, public Recoverable{
+private:
+    static constexpr int LEVEL_MASK = 0x0ff;
+    static constexpr int READY_FOR_FREE = 0x100;
+    static constexpr int NUM_LEVELS = 20;
+    enum KeyType { MIN, REAL, MAX };
+
+    struct Node;
+    struct NodePtr {
+        pds::atomic_lin_var<Node *> ptr;
+        NodePtr(Node *n) : ptr(n){};
+        NodePtr() : ptr(nullptr){};
+    };
+    struct alignas(64) Node{
+        std::atomic<int> level;
+        KeyType key_type; // 0 min, 1 real val, 2 max
+        K key;
+        // 1 while the key is in the set, 0 once removed
+        pds::atomic_lin_var<uint64_t> live;
+        // Transient-to-transient pointers
+        NodePtr floor_next;
+        std::atomic<Node*> next [NUM_LEVELS-1];
+        Node(MedleyFraserSkipListSet* ds, K k, Node *_next, int _level, KeyType _key_type) : 
+            level(_level), 
+            key_type(_key_type), 
+            key(k), 
+            live(1), 
+            floor_next(),
+            next{} 
+        { 
+            floor_next.ptr.store(ds, _next);
+            for(int i = 0; i < level-1; i++) 
+                next[i].store(_next);
+        }
+        Node(MedleyFraserSkipListSet* ds, Node *_next, int _level, KeyType _key_type) : 
+            level(_level), 
+            key_type(_key_type), 
+            key(), 
+            live(0), 
+            floor_next(),
+            next{} 
+        {
+            floor_next.ptr.store(ds, _next);
+            for(int i = 0; i < level-1; i++) 
+                next[i].store(_next);
+        }
+        ~Node(){ }
+    };
+
+    int get_level(int tid) {
+        size_t r = rands[tid].ui();
+        int l = 1;
+        r = (r >> 4) & ((1 << (NUM_LEVELS-1)) - 1);
+        while ( (r & 1) ) { l++; r >>= 1; }
+        return l;
+    }
+    Node* get_marked_ref(Node* _p) {
+        return ((Node *)(((size_t)(_p)) | 1ULL));
+    }
+    Node* get_unmarked_ref(Node* _p) {
+        return ((Node *)(((size_t)(_p)) & ~1ULL));
+    }
+    bool is_marked_ref(Node* _p) {
+        return (((size_t)(_p)) & 1);
+    }
+
+    Node* strong_search_predecessors(const K& key, Node** pa, Node** na);
+    Node* weak_search_predecessors(const K& key, Node** pa, Node** na);
+    void mark_deleted(Node* x, int level);
+    int check_for_full_delete(Node* x);
+    void do_full_delete(Node* x, int level, int tid);
+
+    GlobalTestConfig* gtc;
+    padded<std::mt19937>* rands;
+    alignas(64) NodePtr head;
+public:
+    MedleyFraserSkipListSet(GlobalTestConfig* gtc) : 
+        Recoverable(gtc),
+        gtc(gtc),
+        head(new Node(this, new Node(this, nullptr, NUM_LEVELS, MAX), NUM_LEVELS, MIN))
+        { 
+        int thd_num = pds::EpochSys::get_max_threads(gtc);
+        rands = new padded<std::mt19937>[thd_num];
+        for(int i=0;i<thd_num;i++){
+            rands[i].ui.seed(i);
+        }
+    };
+    void init_thread(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+        Recoverable::init_thread(gtc, ltc);
+    }
+    
+    int recover(bool simulated){
+        errexit("recover() not implemented!");
+        return 0;
+    }
+
+    bool get(K key, int tid);
+    bool put(K key, int tid);
+    bool insert(K key, int tid);
+    bool remove(K key, int tid);
+};
+
+template<class K>
+typename MedleyFraserSkipListSet<K>::Node* MedleyFraserSkipListSet<K>::strong_search_predecessors(const K& key, MedleyFraserSkipListSet<K>::Node** pa, MedleyFraserSkipListSet<K>::Node** na)
+{
+    Node* x = nullptr;
+    Node* x_next = nullptr;
+    Node* y = nullptr;
+    Node* y_next = nullptr;
+    int i = 0;
+
+ retry:
+    x = head.ptr.nbtc_load(this);
+    for ( i = NUM_LEVELS - 1; i >= 0; i-- )
+    {
+        /* We start our search at previous level's unmarked predecessor. */
+        if(i==0)
+            x_next = x->floor_next.ptr.nbtc_load(this);
+        else 
+            x_next = x->next[i-1].load();
+        /* If this pointer's marked, so is @pa[i+1]. May as well retry. */
+        if ( is_marked_ref(x_next) ) goto retry;
+
+        for ( y = x_next; ; y = y_next )
+        {
+            /* Shift over a sequence of marked nodes. */
+            for ( ; ; )
+            {
+                if(i==0)
+                    y_next = y->floor_next.ptr.nbtc_load(this);
+                else
+                    y_next = y->next[i-1].load();
+                if ( !is_marked_ref(y_next) ) break;
+                y = get_unmarked_ref(y_next);
+            }
+
+            
+            if ( y->key_type != MIN && ( y->key_type == MAX || y->key >= key) ) break;
+
+            /* Update estimate of predecessor at this level. */
+            x      = y;
+            x_next = y_next;
+        }
+
+        /* Swing forward pointer over any marked nodes. */
+        if ( x_next != y ) {
+            if(i==0) {
+                if (!x->floor_next.ptr.nbtc_CAS(this, x_next, y, false, false)) 
+                    goto retry;
+            } else {
+                if (!x->next[i-1].compare_exchange_strong(x_next, y)) 
+                    goto retry;
+            }
+        }
+
+        if ( pa ) pa[i] = x;
+        if ( na ) na[i] = y;
+    }
+
+    return y;
+}
+
+template<class K>
+typename MedleyFraserSkipListSet<K>::Node* MedleyFraserSkipListSet<K>::weak_search_predecessors(const K& key, MedleyFraserSkipListSet<K>::Node** pa, MedleyFraserSkipListSet<K>::Node** na)
+{
+    Node* x = nullptr;
+    Node* x_next = nullptr;
+    Node* ox_next = nullptr;
+    int i = 0;
+
+    x = head.ptr.nbtc_load(this);
+    for ( i = NUM_LEVELS - 1; i >= 0; i-- )
+    {
+        for ( ; ; )
+        {
+            if(i==0)
+                ox_next = x->floor_next.ptr.nbtc_load(this);
+            else 
+                ox_next = x->next[i-1].load();
+            x_next = get_unmarked_ref(ox_next);
+
+            if ( x_next->key_type != MIN && ( x_next->key_type == MAX || x_next->key >= key) ) break;
+
+            x = x_next;
+        }
+
+        if ( pa ) pa[i] = x;
+        if ( na ) na[i] = x_next;
+    }
+
+    return ox_next;
+}
+
+template<class K>
+void MedleyFraserSkipListSet<K>::mark_deleted(Node* x, int level)
+{
+    Node* x_next = nullptr;
+
+    while ( --level >= 0 )
+    {
+        if (level == 0)
+            x_next = x->floor_next.ptr.nbtc_load(this);
+        else
+            x_next = x->next[level-1].load();
+        while ( !is_marked_ref(x_next) )
+        {
+            if (level == 0) {
+                if (x->floor_next.ptr.nbtc_CAS(this, x_next, get_marked_ref(x_next), false, false)) break;
+                x_next = x->floor_next.ptr.nbtc_load(this);
+            } else {
+                if (x->next[level-1].compare_exchange_strong(x_next, get_marked_ref(x_next))) break;
+                x_next = x->next[level-1].load();
+            }
+        }
+    }
+}
+
+template<class K>
+int MedleyFraserSkipListSet<K>::check_for_full_delete(Node* x)
+{
+    // This function is called only as a cleanup, so level field can
+    // be plain std::atomic.
+    int level = x->level.load();
+    return ((level & READY_FOR_FREE) ||
+            !x->level.compare_exchange_strong(level, level | READY_FOR_FREE));
+}
+
+template<class K>
+void MedleyFraserSkipListSet<K>::do_full_delete(Node* x, int level, int tid)
+{
+    (void)strong_search_predecessors(x->key, nullptr, nullptr);
+    this->tretire(x);
+}
+
+template<class K>
+bool MedleyFraserSkipListSet<K>::get(K key, int tid)
+{
+    TX_OP_SEPARATOR();
+    Node* x = nullptr;
+    Node* ox = nullptr;
+    Node* preds[NUM_LEVELS] = {nullptr};
+    uint64_t v = 0;
+
+    ox = weak_search_predecessors(key, preds, nullptr);
+    x = get_unmarked_ref(ox);
+    if ( x->key_type == REAL && x->key == key ) {
+        v = x->live.nbtc_load(this);
+        addToReadSet(&(x->live), v);
+    } else {
+        addToReadSet(&(preds[0]->floor_next.ptr), ox);
+    }
+
+    return v != 0;
+}
+
+template<class K>
+bool MedleyFraserSkipListSet<K>::remove(K key, int tid){
+    TX_OP_SEPARATOR();
+    uint64_t v = 0;
+    Node* preds[NUM_LEVELS] = {nullptr};
+    Node* x = nullptr;
+    Node* ox = nullptr;
+    int level=0, i=0;
+
+    ox = weak_search_predecessors(key, preds, nullptr);
+    x = get_unmarked_ref(ox);
+
+    if ( x->key_type != MIN && ( x->key_type == MAX || x->key > key) ) {
+        addToReadSet(&(preds[0]->floor_next.ptr), ox);
+        return false;
+    }
+    level = x->level.load();
+    level = level & LEVEL_MASK;
+
+    /* Once we've cleared the live word, the node is effectively deleted. */
+    do {
+        v = x->live.nbtc_load(this);
+        if ( v == 0 ) {
+            // doesn't exist; previous load becomes lin point
+            addToReadSet(&(x->live), v);
+            return false;
+        }
+    }
+    while ( !x->live.nbtc_CAS(this, v, 0, true, true) );//lin cas if succeeds
+
+    auto cleanup = [=]()mutable{
+        /* Committed to @x: mark lower-level forward pointers. */
+        mark_deleted(x, level);
+
+        /*
+        * We must swing predecessors' pointers, or we can end up with
+        * an unbounded number of marked but not fully deleted nodes.
+        * Doing this creates a bound equal to number of threads in the system.
+        * Furthermore, we can't legitimately call 'free_node' until all shared
+        * references are gone.
+        */
+        for ( i = level - 1; i >= 0; i-- )
+        {
+            Node* tmp_x = x; // failed CAS would modify the first argument
+            bool ret = false;
+            if(i==0) {
+                ret = preds[i]->floor_next.ptr.CAS(this,
+                    tmp_x,
+                    get_unmarked_ref(x->floor_next.ptr.load(this)));
+            } else {
+                ret = preds[i]->next[i-1].compare_exchange_strong(
+                    tmp_x,
+                    get_unmarked_ref(x->next[i-1].load()));
+            }
+            if (!ret)
+            {
+                if ( (i != (level - 1)) || check_for_full_delete(x) )
+                {
+                    do_full_delete(x, i, tid);
+                }
+                break;
+            }
+        }
+        // retire only if we successfully detach @x from the lowest level
+        if(i == -1)
+            this->tretire(x);
+    };
+    if (is_inside_txn()){
+        addToCleanups(cleanup); // if inside txn, cleanup only after lin CAS succeeds.
+    } else {
+        cleanup(); // execute cleanup in place
+    }
+    return true;
+}
+
+template<class K>
+bool MedleyFraserSkipListSet<K>::put(K key, int tid){
+    // a key carries nothing to overwrite, so put is insert with the
+    // result flipped
+    return !insert(key, tid);
+}
+
+template<class K>
+bool MedleyFraserSkipListSet<K>::insert(K key, int tid) {
+    TX_OP_SEPARATOR();
+    uint64_t ov = 0;
+    Node* preds[NUM_LEVELS] = {nullptr};
+    Node* succs[NUM_LEVELS] = {nullptr};
+    Node* pred = nullptr;
+    Node* succ = nullptr;
+    Node* osucc = nullptr;
+    Node* new_node = nullptr;
+    Node* new_next = nullptr;
+    Node* old_next = nullptr;
+    int i=0, level=0;
+
+    osucc = weak_search_predecessors(key, preds, succs);
+    succ = get_unmarked_ref(osucc);
+
+ retry:
+    if ( succ->key_type == REAL && succ->key == key )
+    {
+        /* Already a @key node in the list. */
+        ov = succ->live.nbtc_load(this);
+        if ( ov == 0 )
+        {
+            /* Finish deleting the node, then retry. */
+            level = succ->level.load();
+            mark_deleted(succ, level & LEVEL_MASK);
+            succ = strong_search_predecessors(key, preds, succs);
+            goto retry;
+        }
+        if ( new_node != nullptr ) tdelete(new_node);
+        addToReadSet(&(succ->live), ov);
+        return false;
+    }
+
+    /* Not in the list, so initialise a new_node node for insertion. */
+    if ( new_node == nullptr )
+        new_node    = tnew<Node>(this, key, nullptr, get_level(tid), REAL);
+    level = new_node->level.load();
+
+    /* If successors don't change, this saves us some CAS operations. */
+    new_node->floor_next.ptr.store(this, succs[0]);
+    for ( i = 0; i < level-1; i++ )
+    {
+        new_node->next[i].store(succs[i+1]);
+    }
+
+    /* We've committed when we've inserted at level 1. */
+    if (!preds[0]->floor_next.ptr.nbtc_CAS(this, succ, new_node, true, true))//lin cas if succeeds
+    {
+        succ = strong_search_predecessors(key, preds, succs);
+        goto retry;
+    }
+
+    /* Insert at each of the other levels in turn. */
+    auto cleanup = [=]()mutable{
+        i = 1;
+        while ( i < level )
+        {
+            pred = preds[i];
+            succ = succs[i];
+
+            /* Someone *can* delete @new_node under our feet! */
+            new_next = new_node->next[i-1].load();
+            if ( is_marked_ref(new_next) ) break; // goto success
+
+            /* Ensure forward pointer of new_node node is up to date. */
+            if ( new_next != succ )
+            {
+                old_next = new_next;
+                new_node->next[i-1].compare_exchange_strong(old_next, succ);
+                if ( is_marked_ref(old_next) ) break; // goto success
+                assert(old_next == new_next);
+            }
+
+            /* Ensure we have unique key values at every level. */
+            if ( succ->key_type == REAL && succ->key == key ) {
+                (void)strong_search_predecessors(key, preds, succs);
+                continue;
+            }
+
+            /* Replumb predecessor's forward pointer. */
+            if (!pred->next[i-1].compare_exchange_strong(succ, new_node))
+            {
+                (void)strong_search_predecessors(key, preds, succs);
+                continue;
+            }
+
+            /* Succeeded at this level. */
+            i++;
+        }
+
+    //  success:
+        /* Ensure node is visible at all levels before punting deletion. */
+        if ( check_for_full_delete(new_node) )
+        {
+            do_full_delete(new_node, level - 1, tid);
+        }
+    };
+    if (is_inside_txn()){
+        addToCleanups(cleanup); // if inside txn, cleanup only after lin CAS succeeds.
+    } else {
+        cleanup(); // execute cleanup in place
+    }
+    return true;
+}
+
+template <class T>
+class MedleyFraserSkipListSetFactory : public RideableFactory{
+    Rideable* build(GlobalTestConfig* gtc){
+        return new MedleyFraserSkipListSet<T>(gtc);
+    }
+};
+
+#endif
@@ -0,0 +1,628 @@
+#ifndef MEDLEY_GRAPH_HPP
+#define MEDLEY_GRAPH_HPP
+
+// Transactional nonblocking graph on Medley. Vertices sit in a fixed
+// array of lin vars indexed by vertex id; each vertex owns an out- and
+// an in-adjacency set of neighbor ids, which are MedleyLfHashSet's
+// Harris-Michael bucket lists hung off a per-set table.
+//
+// Every public operation but add_vertex touches more than one set, so
+// each runs as a single Medley transaction, or as part of the caller's
+// transaction if there is one. In particular remove_vertex unlinks the
+// vertex and drops all of its incoming and outgoing edges atomically.
+// Edge weights are not kept, since RGraph has no way to read them.
+//
+// Degrees are skewed in the graphs we care about, so a set starts with
+// ADJ_INIT_BUCKETS buckets and is regrown ADJ_GROWTH-fold by its own
+// transaction once it holds twice as many members as buckets. Growth is
+// only attempted by operations that are not part of a caller's
+// transaction.
+//
+// The number of vertices is taken from env "VertexNum" (default 65536).
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <tuple>
+#include <thread>
+#include <random>
+#include <algorithm>
+
+#include "HarnessUtils.hpp"
+#include "ConcurrentPrimitives.hpp"
+#include "RGraph.hpp"
+#include "FastHash.hpp"
+#include "Recoverable.hpp"
+
+template <int ADJ_INIT_BUCKETS=4, int ADJ_GROWTH=4>
+class MedleyGraph : public RGraph, public Recoverable{
+private:
+    struct AdjNode;
+
+    struct MarkPtr{
+        pds::atomic_lin_var<AdjNode*> ptr;
+        MarkPtr(AdjNode* n):ptr(n){};
+        MarkPtr():ptr(nullptr){};
+    };
+
+    struct AdjNode{
+        int key;
+        MarkPtr next;
+        AdjNode(int k, AdjNode* n):key(k),next(n){};
+        ~AdjNode(){}
+    };
+
+    struct AdjTable{
+        int size; // number of buckets; a power of two
+        std::atomic<int> count; // members as of the last commit, approximately
+        MarkPtr* buckets;
+        AdjTable(int n):size(n),count(0){
+            buckets = new MarkPtr[n];
+        };
+        ~AdjTable(){
+            delete[] buckets;
+        }
+        inline bool overloaded(){
+            return count.load(std::memory_order_relaxed) > 2*size;
+        }
+    };
+
+    struct AdjSet{
+        pds::atomic_lin_var<AdjTable*> table;
+        AdjSet(AdjTable* t):table(t){};
+    };
+
+    struct Vertex{
+        MedleyGraph* ds;
+        int id;
+        AdjSet out;
+        AdjSet in;
+        Vertex(MedleyGraph* ds_, int i):
+            ds(ds_),id(i),out(new AdjTable(ADJ_INIT_BUCKETS)),in(new AdjTable(ADJ_INIT_BUCKETS)){};
+        ~Vertex(){
+            delete out.table.load(ds);
+            delete in.table.load(ds);
+        }
+    };
+
+    struct VertexPtr{
+        pds::atomic_lin_var<Vertex*> ptr;
+        VertexPtr():ptr(nullptr){};
+    };
+
+    FastHash<int> hash_fn;
+    // An aborted transaction waits a random number of pauses before it
+    // retries, within a window that doubles with each abort in a row,
+    // from 2^BACKOFF_MIN to 2^BACKOFF_MAX. A hub's remove_vertex
+    // conflicts with nearly every concurrent operation; backing off
+    // spreads the others out so that it gets through.
+    static constexpr int BACKOFF_MIN = 4;
+    static constexpr int BACKOFF_MAX = 16;
+    int numVertices;
+    VertexPtr* vertices;
+
+    static constexpr uint64_t MARK_MASK = ~0x1;
+    inline AdjNode* getPtr(AdjNode* d){
+        return reinterpret_cast<AdjNode*>((uint64_t)d & MARK_MASK);
+    }
+    inline bool getMark(AdjNode* d){
+        return (bool)((uint64_t)d & 1);
+    }
+    inline AdjNode* setMark(AdjNode* d){
+        return reinterpret_cast<AdjNode*>((uint64_t)d | 1);
+    }
+    inline bool valid(int vid){
+        return vid >= 0 && vid < numVertices;
+    }
+    inline size_t bucket(int key, AdjTable* t){
+        return hash_fn(key) & (t->size - 1);
+    }
+    inline bool overloaded(AdjSet* s){
+        return s->table.load(this)->overloaded();
+    }
+
+    inline void backoff(int aborts){
+        thread_local std::minstd_rand rng(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        int shift = std::min(BACKOFF_MIN + aborts, BACKOFF_MAX);
+        for (uint64_t spins = rng() & ((1ull << shift) - 1); spins > 0; spins--){
+            __builtin_ia32_pause();
+        }
+    }
+
+    // Runs f as one transaction, retrying on abort, unless we are
+    // already inside a transaction, in which case f joins it.
+    template <typename F>
+    bool run_txn(F f){
+        if (is_inside_txn()) return f();
+        for (int aborts = 0; ; aborts++){
+            try{
+                _esys->tx_begin();
+                bool res = f();
+                _esys->tx_end();
+                return res;
+            } catch(const pds::TransactionAborted& e){
+                // aborted and rolled back by EpochSys; back off and retry
+                backoff(aborts);
+            }
+        }
+    }
+
+    Vertex* find_vertex(int vid);
+    Vertex* ensure_vertex(int vid);
+    Vertex* detach_vertex(int vid);
+
+    AdjTable* adj_table(AdjSet* s);
+    bool adj_find(AdjTable* t, MarkPtr* &prev, AdjNode* &curr, AdjNode* &next, int key);
+    bool adj_contains(AdjSet* s, int key);
+    bool adj_insert(AdjSet* s, int key);
+    bool adj_remove(AdjSet* s, int key);
+    void adj_keys(AdjSet* s, std::vector<int>& keys);
+    bool adj_regrow(AdjSet* s);
+    void adj_retire_table(AdjTable* t);
+    void grow(int vid, bool out);
+
+public:
+    MedleyGraph(GlobalTestConfig* gtc) : Recoverable(gtc){
+        numVertices = 65536;
+        if (gtc->checkEnv("VertexNum")){
+            numVertices = stoi(gtc->getEnv("VertexNum"));
+        }
+        vertices = new VertexPtr[numVertices];
+    };
+    ~MedleyGraph(){};
+
+    void init_thread(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+        Recoverable::init_thread(gtc, ltc);
+    }
+    int recover(bool simulated){
+        errexit("MedleyGraph isn't recoverable!");
+        return 0;
+    }
+
+    bool add_edge(int src, int dest, int weight);
+    bool add_vertex(int vid);
+    bool has_edge(int v1, int v2);
+    bool remove_edge(int src, int dest);
+    bool remove_vertex(int vid);
+    std::tuple<int, int, double, int*, int> grab_stats();
+};
+
+class MedleyGraphFactory : public RideableFactory{
+    Rideable* build(GlobalTestConfig* gtc){
+        return new MedleyGraph<>(gtc);
+    }
+};
+
+
+//-------Definition----------
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::add_edge(int src, int dest, int weight){
+    if (!valid(src) || !valid(dest)) return false;
+    bool standalone = !is_inside_txn();
+    bool grow_out = false;
+    bool grow_in = false;
+    bool res = run_txn([&](){
+        Vertex* s = ensure_vertex(src);
+        Vertex* d = ensure_vertex(dest);
+        if (!adj_insert(&s->out, dest)) return false;
+        adj_insert(&d->in, src);
+        grow_out = overloaded(&s->out);
+        grow_in = overloaded(&d->in);
+        return true;
+    });
+    if (res && standalone){
+        if (grow_out) grow(src, true);
+        if (grow_in) grow(dest, false);
+    }
+    return res;
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::add_vertex(int vid){
+    if (!valid(vid)) return false;
+    TX_OP_SEPARATOR();
+
+    pds::atomic_lin_var<Vertex*>* slot = &vertices[vid].ptr;
+    Vertex* tmpVertex = tnew<Vertex>(this, vid);
+    while(true){
+        Vertex* v = slot->nbtc_load(this);
+        if (v != nullptr){
+            addToReadSet(slot, v);
+            tdelete(tmpVertex);
+            return false;
+        }
+        if (slot->nbtc_CAS(this, nullptr, tmpVertex, true, true)){
+            return true;
+        }
+    }
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::has_edge(int v1, int v2){
+    if (!valid(v1) || !valid(v2)) return false;
+    return run_txn([&](){
+        Vertex* s = find_vertex(v1);
+        if (s == nullptr) return false;
+        return adj_contains(&s->out, v2);
+    });
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::remove_edge(int src, int dest){
+    if (!valid(src) || !valid(dest)) return false;
+    return run_txn([&](){
+        Vertex* s = find_vertex(src);
+        if (s == nullptr) return false;
+        Vertex* d = find_vertex(dest);
+        if (d == nullptr) return false;
+        if (!adj_remove(&s->out, dest)) return false;
+        adj_remove(&d->in, src);
+        return true;
+    });
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::remove_vertex(int vid){
+    if (!valid(vid)) return false;
+    return run_txn([&](){
+        Vertex* v = detach_vertex(vid);
+        if (v == nullptr) return false;
+
+        // Every writer of v's sets reads v's slot first, so once the slot
+        // is ours nobody can commit a new edge on v; the adjacency we see
+        // now is final.
+        std::vector<int> outs, ins;
+        adj_keys(&v->out, outs);
+        adj_keys(&v->in, ins);
+        for (int w : outs){
+            adj_remove(&v->out, w);
+            if (w == vid){
+                adj_remove(&v->in, vid);
+                continue;
+            }
+            Vertex* wv = find_vertex(w);
+            if (wv != nullptr) adj_remove(&wv->in, vid);
+        }
+        for (int u : ins){
+            if (u == vid) continue; // self loop, dropped above
+            adj_remove(&v->in, u);
+            Vertex* uv = find_vertex(u);
+            if (uv != nullptr) adj_remove(&uv->out, vid);
+        }
+        addToCleanups([=](){
+            this->tretire(v);
+        });
+        return true;
+    });
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+std::tuple<int, int, double, int*, int> MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::grab_stats(){
+    // single-threaded; call only while no operation is in flight
+    int* degrees = new int[numVertices];
+    int numV = 0;
+    int numE = 0;
+    for (int i = 0; i < numVertices; i++){
+        degrees[i] = 0;
+        Vertex* v = vertices[i].ptr.load(this);
+        if (v == nullptr) continue;
+        numV++;
+        AdjTable* t = v->out.table.load(this);
+        for (int b = 0; b < t->size; b++){
+            AdjNode* curr = t->buckets[b].ptr.load(this);
+            while(curr){
+                AdjNode* next = curr->next.ptr.load(this);
+                if (!getMark(next)) degrees[i]++;
+                curr = getPtr(next);
+            }
+        }
+        numE += degrees[i];
+    }
+    double avgDeg = numV == 0 ? 0 : (double)numE / numV;
+    return std::make_tuple(numV, numE, avgDeg, degrees, numVertices);
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+void MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::grow(int vid, bool out){
+    // Growing only speeds up later operations, so give up rather than
+    // fight a busy vertex for long.
+    for (int attempt = 0; attempt < 3; attempt++){
+        try{
+            _esys->tx_begin();
+            Vertex* v = find_vertex(vid);
+            if (v != nullptr) adj_regrow(out ? &v->out : &v->in);
+            _esys->tx_end();
+            return;
+        } catch(const pds::TransactionAborted& e){
+            // aborted and rolled back by EpochSys; back off and retry
+            backoff(attempt);
+        }
+    }
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+typename MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::Vertex* MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::find_vertex(int vid){
+    TX_OP_SEPARATOR();
+    Vertex* v = vertices[vid].ptr.nbtc_load(this);
+    addToReadSet(&vertices[vid].ptr, v);
+    return v;
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+typename MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::Vertex* MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::ensure_vertex(int vid){
+    TX_OP_SEPARATOR();
+    pds::atomic_lin_var<Vertex*>* slot = &vertices[vid].ptr;
+    Vertex* tmpVertex = nullptr;
+    while(true){
+        Vertex* v = slot->nbtc_load(this);
+        if (v != nullptr){
+            addToReadSet(slot, v);
+            if (tmpVertex != nullptr) tdelete(tmpVertex);
+            return v;
+        }
+        if (tmpVertex == nullptr) tmpVertex = tnew<Vertex>(this, vid);
+        if (slot->nbtc_CAS(this, nullptr, tmpVertex, true, true)){
+            return tmpVertex;
+        }
+    }
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+typename MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::Vertex* MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::detach_vertex(int vid){
+    TX_OP_SEPARATOR();
+    pds::atomic_lin_var<Vertex*>* slot = &vertices[vid].ptr;
+    while(true){
+        Vertex* v = slot->nbtc_load(this);
+        if (v == nullptr){
+            addToReadSet(slot, v);
+            return nullptr;
+        }
+        if (slot->nbtc_CAS(this, v, nullptr, true, true)){
+            return v;
+        }
+    }
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+typename MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::AdjTable* MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_table(AdjSet* s){
+    // the table is read before every lin point on the set, so that a
+    // regrow conflicts with whatever else touches the set
+    AdjTable* t = s->table.nbtc_load(this);
+    addToReadSet(&s->table, t);
+    return t;
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_contains(AdjSet* s, int key){
+    TX_OP_SEPARATOR();
+    MarkPtr* prev=nullptr;
+    AdjNode* curr;
+    AdjNode* next;
+    AdjTable* t = adj_table(s);
+
+    bool res=adj_find(t,prev,curr,next,key);
+    addToReadSet(&(prev->ptr), curr);
+    return res;
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_insert(AdjSet* s, int key){
+    TX_OP_SEPARATOR();
+
+    bool res=false;
+    MarkPtr* prev=nullptr;
+    AdjNode* curr;
+    AdjNode* next;
+    AdjTable* t = adj_table(s);
+    AdjNode* tmpNode = tnew<AdjNode>(key, nullptr);
+
+    while(true) {
+        if(adj_find(t,prev,curr,next,key)) {
+            addToReadSet(&(prev->ptr), curr);
+            res=false;
+            tdelete(tmpNode);
+            break;
+        }
+        else {
+            //does not exist, insert.
+            tmpNode->next.ptr.store(this,curr);// this don't need undo, so we use regular store
+            if(prev->ptr.nbtc_CAS(this,curr,tmpNode,true,true)) {
+                res=true;
+                break;
+            }
+        }
+    }
+    if (res){
+        auto cleanup = [=](){
+            t->count.fetch_add(1, std::memory_order_relaxed);
+        };
+        if (is_inside_txn()) {
+            addToCleanups(cleanup);
+        } else {
+            cleanup();
+        }
+    }
+    return res;
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_remove(AdjSet* s, int key){
+    TX_OP_SEPARATOR();
+
+    bool res=false;
+    MarkPtr* prev=nullptr;
+    AdjNode* curr;
+    AdjNode* next;
+    AdjTable* t = adj_table(s);
+
+    while(true) {
+        if(!adj_find(t,prev,curr,next,key)) {
+            addToReadSet(&(prev->ptr), curr);
+            res=false;
+            break;
+        }
+        if(!curr->next.ptr.nbtc_CAS(this,next,setMark(next),true,true)) {
+            continue;
+        }
+        res=true;
+        auto cleanup = [=]()mutable{
+            t->count.fetch_sub(1, std::memory_order_relaxed);
+            if(prev->ptr.CAS(this,curr,next)) {
+                this->tretire(curr);
+            } else {
+                this->adj_find(t,prev,curr,next,key);
+            }
+        };
+        if (is_inside_txn()) {
+            addToCleanups(cleanup);
+        } else {
+            cleanup();//execute cleanup in place
+        }
+        break;
+    }
+    return res;
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+void MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_keys(AdjSet* s, std::vector<int>& keys){
+    TX_OP_SEPARATOR();
+    AdjTable* t = adj_table(s);
+    for (int b = 0; b < t->size; b++){
+        AdjNode* curr = t->buckets[b].ptr.nbtc_load(this);
+        while(curr){
+            AdjNode* next = curr->next.ptr.nbtc_load(this);
+            if (!getMark(next)) keys.push_back(curr->key);
+            curr = getPtr(next);
+        }
+    }
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_regrow(AdjSet* s){
+    TX_OP_SEPARATOR();
+    AdjTable* t = s->table.nbtc_load(this);
+    if (!t->overloaded()){
+        // someone else has regrown it
+        addToReadSet(&s->table, t);
+        return false;
+    }
+    AdjTable* newTable = tnew<AdjTable>(t->size * ADJ_GROWTH);
+    // Swap the table first: from here on, anyone else who reaches the
+    // set conflicts with us, so the members copied below are final.
+    if (!s->table.nbtc_CAS(this, t, newTable, true, true)){
+        tdelete(newTable);
+        return false;
+    }
+    int count = 0;
+    for (int b = 0; b < t->size; b++){
+        AdjNode* curr = t->buckets[b].ptr.nbtc_load(this);
+        while(curr){
+            AdjNode* next = curr->next.ptr.nbtc_load(this);
+            if (!getMark(next)){
+                // newTable is private until we commit; a plain sorted
+                // insert will do
+                AdjNode* tmpNode = tnew<AdjNode>(curr->key, nullptr);
+                MarkPtr* prev = &newTable->buckets[bucket(curr->key, newTable)];
+                AdjNode* succ = prev->ptr.load(this);
+                while(succ && succ->key < curr->key){
+                    prev = &succ->next;
+                    succ = prev->ptr.load(this);
+                }
+                tmpNode->next.ptr.store(this, succ);
+                prev->ptr.store(this, tmpNode);
+                count++;
+            }
+            curr = getPtr(next);
+        }
+    }
+    newTable->count.store(count);
+    addToCleanups([=](){
+        this->adj_retire_table(t);
+    });
+    return true;
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+void MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_retire_table(AdjTable* t){
+    // Runs after the regrow commits. Unlinking a marked node is what
+    // entitles a thread to retire it, so first unlink the marked ones,
+    // racing their removers, then retire every node left in the table.
+    for (int b = 0; b < t->size; b++){
+        MarkPtr* prev = &t->buckets[b];
+        AdjNode* curr = prev->ptr.load(this);
+        while(curr){
+            AdjNode* next = curr->next.ptr.load(this);
+            if (getMark(next)){
+                if (prev->ptr.CAS(this, curr, getPtr(next))){
+                    this->tretire(curr);
+                } else {
+                    // restart this bucket
+                    prev = &t->buckets[b];
+                }
+                curr = prev->ptr.load(this);
+            } else {
+                prev = &curr->next;
+                curr = next;
+            }
+        }
+        curr = t->buckets[b].ptr.load(this);
+        while(curr){
+            AdjNode* next = getPtr(curr->next.ptr.load(this));
+            this->tretire(curr);
+            curr = next;
+        }
+    }
+    this->tretire(t);
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool MedleyGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_find(AdjTable* t, MarkPtr* &prev, AdjNode* &curr, AdjNode* &next, int key){
+    size_t idx=bucket(key, t);
+    while(true){
+        bool cmark=false;
+        prev=&t->buckets[idx];
+        curr=prev->ptr.nbtc_load(this);
+
+        while(true){
+            if(getPtr(curr)==nullptr) {
+                curr = getPtr(curr);
+                next = getPtr(next);
+                return false;
+            }
+            next=getPtr(curr)->next.ptr.nbtc_load(this);
+            cmark=getMark(next);
+            auto ckey=getPtr(curr)->key;
+            if(prev->ptr.nbtc_load(this)!=getPtr(curr)) break;//retry
+            if(!cmark) {
+                if(ckey>=key) {
+                    curr = getPtr(curr);
+                    next = getPtr(next);
+                    return ckey==key;
+                }
+                prev=&(getPtr(curr)->next);
+            } else {
+                int res = prev->ptr.nbtc_CAS(
+                    this,
+                    getPtr(curr),
+                    getPtr(next),
+                    false,
+                    false);
+                if(res == 0) {
+                    break;//retry
+                } else {
+                    if (res == 1) // real succeeded CAS
+                        tretire(getPtr(curr));
+                    else // speculative succeeded CAS
+                        txn_tretire(getPtr(curr));
+                }
+            }
+            curr=next;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef MEDLEY_LF_HASHSET_P
+#define MEDLEY_LF_HASHSET_P
+
+// This is the set counterpart of MedleyLfHashTable: same bucket
+// array of Harris-Michael lists, but nodes carry only a key, so a
+// node is 32 bytes for word-sized keys instead of a whole cache line.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <atomic>
+#include <functional>
+
+#include "HarnessUtils.hpp"
+#include "ConcurrentPrimitives.hpp"
+#include "RSet.hpp"
+#include "FastHash.hpp"
+#include "CustomTypes.hpp"
+#include "Recoverable.hpp"
+
+template <class K, int idxSize=1000000, class Hash=FastHash<K>>
+class MedleyLfHashSet : public RSet<K>, public Recoverable{
+private:
+    struct Node;
+
+    struct MarkPtr{
+        pds::atomic_lin_var<Node*> ptr;
+        MarkPtr(Node* n):ptr(n){};
+        MarkPtr():ptr(nullptr){};
+    };
+
+    struct Node{
+        K key;
+        MarkPtr next;
+        Node(K k, Node* n):key(k),next(n){};
+        ~Node(){}
+    };
+    Hash hash_fn;
+    padded<MarkPtr>* buckets=new padded<MarkPtr>[idxSize]{};
+    bool findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid);
+
+    static constexpr uint64_t MARK_MASK = ~0x1;
+    inline Node* getPtr(Node* d){
+        return reinterpret_cast<Node*>((uint64_t)d & MARK_MASK);
+    }
+    inline bool getMark(Node* d){
+        return (bool)((uint64_t)d & 1);
+    }
+    inline Node* setMark(Node* d){
+        return reinterpret_cast<Node*>((uint64_t)d | 1);
+    }
+public:
+    MedleyLfHashSet(GlobalTestConfig* gtc) : Recoverable(gtc){};
+    ~MedleyLfHashSet(){};
+
+    void init_thread(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+        Recoverable::init_thread(gtc, ltc);
+    }
+    int recover(bool simulated){
+        errexit("MedleyLfHashSet isn't recoverable!");
+        return 0;
+    }
+
+    bool get(K key, int tid);
+    bool put(K key, int tid);
+    bool insert(K key, int tid);
+    bool remove(K key, int tid);
+};
+
+template <class T>
+class MedleyLfHashSetFactory : public RideableFactory{
+    Rideable* build(GlobalTestConfig* gtc){
+        return new MedleyLfHashSet<T>(gtc);
+    }
+};
+
+
+//-------Definition----------
+template <class K, int idxSize, class Hash>
+bool MedleyLfHashSet<K,idxSize,Hash>::get(K key, int tid) {
+    TX_OP_SEPARATOR();
+    MarkPtr* prev=nullptr;
+    Node* curr;
+    Node* next;
+
+    bool res=findNode(prev,curr,next,key,tid);
+    addToReadSet(&(prev->ptr), curr);
+    return res;
+}
+
+template <class K, int idxSize, class Hash>
+bool MedleyLfHashSet<K,idxSize,Hash>::put(K key, int tid) {
+    // a key carries nothing to overwrite, so put is insert with the
+    // result flipped
+    return !insert(key, tid);
+}
+
+template <class K, int idxSize, class Hash>
+bool MedleyLfHashSet<K,idxSize,Hash>::insert(K key, int tid){
+    TX_OP_SEPARATOR();
+
+    bool res=false;
+    MarkPtr* prev=nullptr;
+    Node* curr;
+    Node* next;
+    Node* tmpNode = tnew<Node>(key, nullptr);
+
+    while(true) {
+        if(findNode(prev,curr,next,key,tid)) {
+            addToReadSet(&(prev->ptr), curr);
+            res=false;
+            tdelete(tmpNode);
+            break;
+        }
+        else {
+            //does not exist, insert.
+            tmpNode->next.ptr.store(this,curr);// this don't need undo, so we use regular store
+            if(prev->ptr.nbtc_CAS(this,curr,tmpNode,true,true)) {
+                res=true;
+                break;
+            }
+        }
+    }
+    return res;
+}
+
+template <class K, int idxSize, class Hash>
+bool MedleyLfHashSet<K,idxSize,Hash>::remove(K key, int tid) {
+    TX_OP_SEPARATOR();
+
+    bool res=false;
+    MarkPtr* prev=nullptr;
+    Node* curr;
+    Node* next;
+
+    while(true) {
+        if(!findNode(prev,curr,next,key,tid)) {
+            addToReadSet(&(prev->ptr), curr);
+            res=false;
+            break;
+        }
+        if(!curr->next.ptr.nbtc_CAS(this,next,setMark(next),true,true)) {
+            continue;
+        }
+        res=true;
+        auto cleanup = [=]()mutable{
+            if(prev->ptr.CAS(this,curr,next)) {
+                this->tretire(curr);
+            } else {
+                this->findNode(prev,curr,next,key,tid);
+            }
+        };
+        if (is_inside_txn()) {
+            addToCleanups(cleanup);
+        } else {
+            cleanup();//execute cleanup in place
+        }
+        break;
+    }
+    return res;
+}
+
+template <class K, int idxSize, class Hash>
+bool MedleyLfHashSet<K,idxSize,Hash>::findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid){
+    size_t idx=bucket_of<idxSize>(hash_fn(key));
+    while(true){
+        bool cmark=false;
+        prev=&buckets[idx].ui;
+        curr=prev->ptr.nbtc_load(this);
+
+        while(true){
+            if(getPtr(curr)==nullptr) {
+                curr = getPtr(curr);
+                next = getPtr(next);
+                return false;
+            }
+            next=getPtr(curr)->next.ptr.nbtc_load(this);
+            cmark=getMark(next);
+            auto ckey=getPtr(curr)->key;
+            if(prev->ptr.nbtc_load(this)!=getPtr(curr)) break;//retry
+            if(!cmark) {
+                if(ckey>=key) {
+                    curr = getPtr(curr);
+                    next = getPtr(next);
+                    return ckey==key;
+                }
+                prev=&(getPtr(curr)->next);
+            } else {
+                int res = prev->ptr.nbtc_CAS(
+                    this,
+                    getPtr(curr),
+                    getPtr(next),
+                    false,
+                    false);
+                if(res == 0) {
+                    break;//retry
+                } else {
+                    if (res == 1) // real succeeded CAS
+                        tretire(getPtr(curr));
+                    else // speculative succeeded CAS
+                        txn_tretire(getPtr(curr));
+                }
+            }
+            curr=next;
+        }
+    }
+}
+
+#endif
@@ -19,11 +19,12 @@
 #include "HarnessUtils.hpp"
 #include "ConcurrentPrimitives.hpp"
 #include "RMap.hpp"
+#include "FastHash.hpp"
 // #include "RCUTracker.hpp"
 #include "CustomTypes.hpp"
 #include "Recoverable.hpp"
 
-template <class K, class V, int idxSize=1000000>
+template <class K, class V, int idxSize=1000000, class Hash=FastHash<K>>
 class MedleyLfHashTable : public RMap<K,V>, public Recoverable{
 private:
     struct Node;
@@ -34,7 +35,9 @@ private:
         MarkPtr():ptr(nullptr){};
     };
 
-    struct Node{
+    // every pointer to a node is loaded through atomic_lin_var, which
+    // protects it, so nodes can carry a birth era for Reclaim=IBR
+    struct Node : public IBRNode{
         MedleyLfHashTable* ds;
         K key;
         V val;
@@ -47,10 +50,24 @@ private:
         }
 
     }__attribute__((aligned(CACHELINE_SIZE)));
-    std::hash<K> hash_fn;
+    Hash hash_fn;
     padded<MarkPtr>* buckets=new padded<MarkPtr>[idxSize]{};
     bool findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid);
 
+    // findNode split into resumable steps, so that multi_get can walk
+    // several chains at once
+    struct FindState{
+        const K* key;
+        size_t idx;
+        MarkPtr* prev; // nullptr: (re)start from the bucket
+        Node* curr;
+        Node* next;
+        bool found;
+    };
+    bool findStep(FindState& s);
+    // lookups multi_get keeps in flight at a time
+    static constexpr int MULTI_GET_WINDOW = 8;
+
     // RCUTracker tracker;
     // GlobalTestConfig* gtc;
 
@@ -68,7 +85,7 @@ private:
         return reinterpret_cast<Node*>((uint64_t)d | 1);
     }
 public:
-    MedleyLfHashTable(GlobalTestConfig* gtc) : Recoverable(gtc){
+    MedleyLfHashTable(GlobalTestConfig* gtc) : Recoverable(gtc, true){
         // tracker(gtc->task_num, 100, 1000, true), 
         // gtc(gtc) {
     };
@@ -104,6 +121,8 @@ public:
     bool insert(K key, V val, int tid);
     optional<V> remove(K key, int tid);
     optional<V> replace(K key, V val, int tid);
+    void multi_get(const K* keys, optional<V>* vals, size_t n, int tid);
+    void multi_put(const K* keys, const V* vals, optional<V>* olds, size_t n, int tid);
 };
 
 template <class T> 
@@ -115,8 +134,8 @@ class MedleyLfHashTableFactory : public RideableFactory{
 
 
 //-------Definition----------
-template <class K, class V, int idxSize> 
-optional<V> MedleyLfHashTable<K,V,idxSize>::get(K key, int tid) {
+template <class K, class V, int idxSize, class Hash> 
+optional<V> MedleyLfHashTable<K,V,idxSize,Hash>::get(K key, int tid) {
     TX_OP_SEPARATOR();
     optional<V> res={};
     MarkPtr* prev=nullptr;
@@ -138,8 +157,8 @@ optional<V> MedleyLfHashTable<K,V,idxSize>::get(K key, int tid) {
     return res;
 }
 
-template <class K, class V, int idxSize> 
-optional<V> MedleyLfHashTable<K,V,idxSize>::put(K key, V val, int tid) {
+template <class K, class V, int idxSize, class Hash> 
+optional<V> MedleyLfHashTable<K,V,idxSize,Hash>::put(K key, V val, int tid) {
     TX_OP_SEPARATOR();
 
     optional<V> res={};
@@ -193,8 +212,8 @@ optional<V> MedleyLfHashTable<K,V,idxSize>::put(K key, V val, int tid) {
     return res;
 }
 
-template <class K, class V, int idxSize> 
-bool MedleyLfHashTable<K,V,idxSize>::insert(K key, V val, int tid){
+template <class K, class V, int idxSize, class Hash> 
+bool MedleyLfHashTable<K,V,idxSize,Hash>::insert(K key, V val, int tid){
     TX_OP_SEPARATOR();
 
     bool res=false;
@@ -229,8 +248,8 @@ bool MedleyLfHashTable<K,V,idxSize>::insert(K key, V val, int tid){
     return res;
 }
 
-template <class K, class V, int idxSize> 
-optional<V> MedleyLfHashTable<K,V,idxSize>::remove(K key, int tid) {
+template <class K, class V, int idxSize, class Hash> 
+optional<V> MedleyLfHashTable<K,V,idxSize,Hash>::remove(K key, int tid) {
     TX_OP_SEPARATOR();
 
     optional<V> res={};
@@ -272,8 +291,8 @@ optional<V> MedleyLfHashTable<K,V,idxSize>::remove(K key, int tid) {
     return res;
 }
 
-template <class K, class V, int idxSize> 
-optional<V> MedleyLfHashTable<K,V,idxSize>::replace(K key, V val, int tid) {
+template <class K, class V, int idxSize, class Hash> 
+optional<V> MedleyLfHashTable<K,V,idxSize,Hash>::replace(K key, V val, int tid) {
     TX_OP_SEPARATOR();
 
     optional<V> res={};
@@ -322,9 +341,121 @@ optional<V> MedleyLfHashTable<K,V,idxSize>::replace(K key, V val, int tid) {
     return res;
 }
 
-template <class K, class V, int idxSize> 
-bool MedleyLfHashTable<K,V,idxSize>::findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid){
-    size_t idx=hash_fn(key)%idxSize;
+template <class K, class V, int idxSize, class Hash> 
+void MedleyLfHashTable<K,V,idxSize,Hash>::multi_get(const K* keys, optional<V>* vals, size_t n, int tid) {
+    TX_OP_SEPARATOR();
+
+    // AMAC-style: hash and prefetch a window of buckets up front, then
+    // walk their chains round-robin one node at a time, so that the
+    // cache misses of different keys overlap instead of queueing up.
+    // Each read is recorded right after the step that made it, as
+    // another chain may load the same var later.
+    FindState s[MULTI_GET_WINDOW];
+    bool done[MULTI_GET_WINDOW];
+    for (size_t base = 0; base < n; base += MULTI_GET_WINDOW){
+        int m = (int)std::min<size_t>(MULTI_GET_WINDOW, n - base);
+        for (int i = 0; i < m; i++){
+            s[i].key = &keys[base+i];
+            s[i].idx = bucket_of<idxSize>(hash_fn(keys[base+i]));
+            s[i].prev = nullptr;
+            done[i] = false;
+            __builtin_prefetch(&buckets[s[i].idx]);
+        }
+        int pending = m;
+        while (pending > 0){
+            for (int i = 0; i < m; i++){
+                if (done[i]) continue;
+                if (findStep(s[i])){
+                    addToReadSet(&(s[i].prev->ptr), s[i].curr);
+                    done[i] = true;
+                    pending--;
+                }
+            }
+        }
+        for (int i = 0; i < m; i++){
+            optional<V> res={};
+            if (s[i].found) {
+                res=s[i].curr->val;
+            }
+            vals[base+i] = res;
+        }
+    }
+}
+
+template <class K, class V, int idxSize, class Hash> 
+void MedleyLfHashTable<K,V,idxSize,Hash>::multi_put(const K* keys, const V* vals, optional<V>* olds, size_t n, int tid) {
+    // Puts may retry their CASes, so they still go one at a time, but
+    // warming every bucket first takes the head misses off their path.
+    for (size_t i = 0; i < n; i++){
+        __builtin_prefetch(&buckets[bucket_of<idxSize>(hash_fn(keys[i]))], 1);
+    }
+    for (size_t i = 0; i < n; i++){
+        optional<V> old = put(keys[i], vals[i], tid);
+        if (olds) olds[i] = old;
+    }
+}
+
+template <class K, class V, int idxSize, class Hash> 
+bool MedleyLfHashTable<K,V,idxSize,Hash>::findStep(FindState& s){
+    // One iteration of findNode's inner loop. Returns true once s.prev
+    // and s.curr hold what findNode would return; a step that ends on
+    // nullptr finishes at once, so the last load of s.prev is always
+    // made by the finishing step.
+    if(s.prev==nullptr) {
+        s.prev=&buckets[s.idx].ui;
+        s.curr=s.prev->ptr.nbtc_load(this);
+        if(getPtr(s.curr)==nullptr) {
+            s.curr=nullptr;
+            s.found=false;
+            return true;
+        }
+    }
+    Node* c=getPtr(s.curr);
+    s.next=c->next.ptr.nbtc_load(this);
+    bool cmark=getMark(s.next);
+    auto ckey=c->key;
+    if(s.prev->ptr.nbtc_load(this)!=c) {
+        s.prev=nullptr;//retry
+        return false;
+    }
+    if(!cmark) {
+        if(ckey>=*s.key) {
+            s.curr=c;
+            s.next=getPtr(s.next);
+            s.found=(ckey==*s.key);
+            return true;
+        }
+        s.prev=&(c->next);
+    } else {
+        int res = s.prev->ptr.nbtc_CAS(
+            this,
+            c,
+            getPtr(s.next),
+            false,
+            false);
+        if(res == 0) {
+            s.prev=nullptr;//retry
+            return false;
+        } else {
+            if (res == 1) // real succeeded CAS
+                tretire(c);
+            else // speculative succeeded CAS
+                txn_tretire(c);
+        }
+    }
+    s.curr=s.next;
+    if(getPtr(s.curr)==nullptr) {
+        s.curr=nullptr;
+        s.found=false;
+        return true;
+    }
+    __builtin_prefetch(getPtr(s.curr));
+    return false;
+}
+
+template <class K, class V, int idxSize, class Hash> 
+bool MedleyLfHashTable<K,V,idxSize,Hash>::findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid){
+    size_t idx=bucket_of<idxSize>(hash_fn(key));
     while(true){
         bool cmark=false;
         prev=&buckets[idx].ui;
@@ -0,0 +1,257 @@
+#ifndef MEDLEY_SEG_QUEUE
+#define MEDLEY_SEG_QUEUE
+
+// This is a transient version of txMontageSegQueue, i.e., a
+// transactional segment-based queue built with txMontage but without
+// persistent payloads.
+//
+// The queue is an unbounded array of cells, allocated in segments of
+// SEG_SIZE cells linked in index order (LCRQ/LPRQ style). An enqueuer
+// takes an index with fetch-and-add on tail_ticket, raises tail_idx
+// past it, and publishes its node by claiming that cell; a dequeuer
+// walks forward from head_idx and claims the first cell holding a node.
+// Both claims are nbtc_CAS on the cell, and are the NBTC publication
+// points. A dequeuer that runs into a cell whose enqueuer hasn't
+// published yet closes it, and the enqueuer retries with a fresh index.
+//
+// Dequeuers don't take indices with fetch-and-add: a transaction that
+// claims a cell may still abort, and the node must then stay visible at
+// its place in the queue.
+
+#include <iostream>
+#include <atomic>
+#include <algorithm>
+#include "HarnessUtils.hpp"
+#include "ConcurrentPrimitives.hpp"
+#include "RQueue.hpp"
+#include "CustomTypes.hpp"
+#include "Recoverable.hpp"
+
+template<typename T, int SEG_SIZE=1024>
+class MedleySegQueue : public RQueue<T>, public Recoverable{
+private:
+    struct Node{
+        T val;
+        Node(T v): val(v){}
+    };
+
+    // besides a Node*, a cell is EMPTY (initial), TAKEN (dequeued) or
+    // CLOSED (overtaken by a dequeuer before its enqueuer published)
+    static constexpr uint64_t TAKEN = 0x1;
+    static constexpr uint64_t CLOSED = 0x2;
+    static Node* empty_cell(){ return nullptr; }
+    static Node* taken_cell(){ return reinterpret_cast<Node*>(TAKEN); }
+    static Node* closed_cell(){ return reinterpret_cast<Node*>(CLOSED); }
+    static bool is_node(Node* n){ return reinterpret_cast<uint64_t>(n) > CLOSED; }
+
+    // times a dequeuer rereads an EMPTY cell before closing it
+    static constexpr int PATIENCE = 64;
+
+    struct Segment{
+        const uint64_t id;
+        std::atomic<Segment*> next;
+        pds::atomic_lin_var<Node*> cells[SEG_SIZE];
+        Segment(uint64_t i): id(i), next(nullptr){}
+    };
+
+    // next index to hand out to an enqueuer
+    alignas(CACHELINE_SIZE) std::atomic<uint64_t> tail_ticket;
+    // one past the highest index an enqueuer may publish at. Enqueuers
+    // raise it before claiming their cell, so an empty dequeue inside a
+    // transaction can put it in its read set and fail validation once
+    // an enqueue at or past what it saw becomes visible.
+    alignas(CACHELINE_SIZE) pds::atomic_lin_var<uint64_t> tail_idx;
+    // every cell below head_idx is TAKEN or CLOSED for good
+    alignas(CACHELINE_SIZE) std::atomic<uint64_t> head_idx;
+    // hints to start segment walks from; neither is past the segment
+    // of its index, and tail_seg is never behind head_seg
+    alignas(CACHELINE_SIZE) std::atomic<Segment*> head_seg;
+    alignas(CACHELINE_SIZE) std::atomic<Segment*> tail_seg;
+
+    // take index i and make tail_idx cover it
+    uint64_t take_tail(){
+        uint64_t i = tail_ticket.fetch_add(1);
+        uint64_t t = tail_idx.load(this);
+        while (t <= i && !tail_idx.CAS(this, t, i+1)){
+            t = tail_idx.load(this);
+        }
+        return i;
+    }
+    uint64_t load_tail(){
+        return tail_idx.nbtc_load(this);
+    }
+
+    // walk from s to the segment holding idx, appending segments as needed
+    Segment* find_segment(Segment* s, uint64_t idx){
+        uint64_t id = idx / SEG_SIZE;
+        assert(s->id <= id);
+        while (s->id < id){
+            Segment* next = s->next.load();
+            if (next == nullptr){
+                Segment* fresh = new Segment(s->id+1);
+                if (s->next.compare_exchange_strong(next, fresh)){
+                    next = fresh;
+                } else {
+                    delete fresh;
+                }
+            }
+            s = next;
+        }
+        return s;
+    }
+    void advance_tail_seg(Segment* s){
+        Segment* cur = tail_seg.load();
+        while (cur->id < s->id && !tail_seg.compare_exchange_weak(cur, s)){}
+    }
+    // called once cell i is TAKEN or CLOSED for good
+    void advance_head(uint64_t i){
+        uint64_t h = i;
+        if (head_idx.compare_exchange_strong(h, i+1) && (i+1) % SEG_SIZE == 0){
+            retire_segments(i+1);
+        }
+    }
+    // unlink and retire the segments wholly below head index h
+    void retire_segments(uint64_t h){
+        Segment* s = head_seg.load();
+        while (s->id < h / SEG_SIZE){
+            Segment* next = find_segment(s, (s->id+1)*SEG_SIZE);
+            if (head_seg.compare_exchange_strong(s, next)){
+                advance_tail_seg(next);
+                this->tretire(s);
+                s = next;
+            }
+        }
+    }
+    void free_segments(){
+        Segment* s = head_seg.load();
+        while (s != nullptr){
+            for (int k = 0; k < SEG_SIZE; k++){
+                Node* n = s->cells[k].var.load().template get_val<Node*>();
+                if (is_node(n)) delete n;
+            }
+            Segment* next = s->next.load();
+            delete s;
+            s = next;
+        }
+    }
+
+public:
+    MedleySegQueue(GlobalTestConfig* gtc):
+        Recoverable(gtc), tail_ticket(0), tail_idx(0), head_idx(0){
+        Segment* s = new Segment(0);
+        head_seg.store(s);
+        tail_seg.store(s);
+    }
+    ~MedleySegQueue(){
+        free_segments();
+    }
+
+    void init_thread(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+        Recoverable::init_thread(gtc, ltc);
+    }
+    void clear(){
+        //single-threaded; for recovery test only
+        free_segments();
+        Segment* s = new Segment(0);
+        head_seg.store(s);
+        tail_seg.store(s);
+        head_idx.store(0);
+        tail_ticket.store(0);
+        tail_idx.var.store(pds::lin_var(0));
+    }
+    int recover(bool simulated){
+        assert(0&&"MedleySegQueue isn't recoverable!");
+        return 0;
+    }
+
+    void enqueue(T val, int tid);
+    optional<T> dequeue(int tid);
+
+    // only for testing: take an index like an enqueuer that stalls
+    // before publishing at it
+    uint64_t stall_enqueue(){
+        return take_tail();
+    }
+};
+
+template<typename T, int SEG_SIZE>
+void MedleySegQueue<T,SEG_SIZE>::enqueue(T v, int tid){
+    TX_OP_SEPARATOR();
+
+    Node* new_node = tnew<Node>(v);
+    while(true){
+        // read the hint before taking an index, so that it can't be
+        // past the index's segment
+        Segment* seg = tail_seg.load();
+        uint64_t i = take_tail();
+        seg = find_segment(seg, i);
+        advance_tail_seg(seg);
+        if(seg->cells[i % SEG_SIZE].nbtc_CAS(this, empty_cell(), new_node, true, true)){
+            break;
+        }
+        // a dequeuer closed our cell; take another index
+    }
+}
+
+template<typename T, int SEG_SIZE>
+optional<T> MedleySegQueue<T,SEG_SIZE>::dequeue(int tid){
+    TX_OP_SEPARATOR();
+
+    optional<T> res = {};
+    // read the hint before the index, as in enqueue
+    Segment* seg = head_seg.load();
+    uint64_t i = head_idx.load();
+    int patience = PATIENCE;
+    while(true){
+        uint64_t t = load_tail();
+        if (i >= t){
+            // queue is empty: every cell below t is TAKEN or CLOSED,
+            // and any later enqueue changes tail_idx
+            addToReadSet(&tail_idx, t);
+            res.reset();
+            break;
+        }
+        seg = find_segment(seg, i);
+        pds::atomic_lin_var<Node*>& cell = seg->cells[i % SEG_SIZE];
+        bool is_speculative = false;
+        Node* n = cell.nbtc_load(this, is_speculative);
+        if (n == empty_cell()){
+            // the enqueuer of cell i hasn't published yet; wait a
+            // little, then close the cell so it retries further on
+            if (patience-- > 0) continue;
+            cell.CAS(this, empty_cell(), closed_cell());
+            continue;
+        }
+        if (!is_node(n)){
+            // our own speculative claim may still be undone, so it
+            // mustn't let head_idx pass
+            if (!is_speculative) advance_head(i);
+            i++;
+            patience = PATIENCE;
+            continue;
+        }
+        if(cell.nbtc_CAS(this, n, taken_cell(), true, true)){
+            res = n->val;
+            auto cleanup = [=]()mutable{
+                this->advance_head(i);
+                this->tretire(n);
+            };
+            if (is_inside_txn()){
+                addToCleanups(cleanup);
+            } else {
+                cleanup();//execute cleanup in place
+            }
+            break;
+        }
+    }
+    return res;
+}
+
+template <class T>
+class MedleySegQueueFactory : public RideableFactory{
+    Rideable* build(GlobalTestConfig* gtc){
+        return new MedleySegQueue<T>(gtc);
+    }
+};
+
+#endif
@@ -0,0 +1,312 @@
+#ifndef MEDLEY_SKIPLIST_PQ
+#define MEDLEY_SKIPLIST_PQ
+
+// Skiplist-based priority queue of J. Linden and B. Jonsson, "A
+// Skiplist-Based Concurrent Priority Queue with Minimal Memory
+// Contention" (OPODIS'13), made transactional with Medley.
+//
+// A node is logically deleted by setting the mark bit on its
+// predecessor's floor-level pointer, so deleted nodes always form a
+// prefix of the list that enqueue skips over. dequeue walks that
+// prefix and marks the first unmarked pointer. The prefix is
+// unlinked in one batch, with a single CAS on head, only once a
+// dequeuer has walked more than BOUND_OFFSET deleted nodes, which
+// keeps dequeuers from all CASing the same head pointer.
+//
+// Linearization points are the nbtc_CAS that links a node at the
+// floor level (enqueue) and the nbtc_CAS that marks its predecessor's
+// floor pointer (dequeue). Linking of upper levels and the batched
+// physical deletion are deferred to cleanups.
+//
+// This is the transient version; see txMontageSkipListPQ for the one
+// with persistent payloads.
+
+#include <cassert>
+#include <random>
+#include <functional>
+
+#include "HarnessUtils.hpp"
+#include "ConcurrentPrimitives.hpp"
+#include "HeapQueue.hpp"
+#include "Recoverable.hpp"
+
+template <class K, class V>
+class MedleySkipListPQ : public HeapQueue<K,V>, public Recoverable{
+private:
+    static constexpr int NUM_LEVELS = 20;
+    // max length of the deleted prefix before a dequeuer unlinks it
+    static constexpr int BOUND_OFFSET = 32;
+    enum KeyType { MIN, REAL, MAX };
+
+    struct Node;
+    struct NodePtr {
+        pds::atomic_lin_var<Node *> ptr;
+        NodePtr(Node *n) : ptr(n){};
+        NodePtr() : ptr(nullptr){};
+    };
+    struct alignas(64) Node{
+        int level;
+        KeyType key_type; // 0 min, 1 real val, 2 max
+        // set until all upper levels are linked; head is never moved
+        // past an inserting node
+        std::atomic<bool> inserting;
+        K key;
+        V val;
+        // Mark bit on floor_next means the *successor* is deleted
+        NodePtr floor_next;
+        std::atomic<Node*> next [NUM_LEVELS-1];
+        Node(MedleySkipListPQ* ds, K k, V v, int _level) :
+            level(_level),
+            key_type(REAL),
+            inserting(true),
+            key(k),
+            val(v),
+            floor_next(),
+            next{} {}
+        Node(MedleySkipListPQ* ds, Node *_next, int _level, KeyType _key_type) :
+            level(_level),
+            key_type(_key_type),
+            inserting(false),
+            key(),
+            val(),
+            floor_next(),
+            next{}
+        {
+            floor_next.ptr.store(ds, _next);
+            for(int i = 0; i < level-1; i++)
+                next[i].store(_next);
+        }
+        ~Node(){ }
+    };
+
+    int get_level(int tid) {
+        size_t r = rands[tid].ui();
+        int l = 1;
+        r = (r >> 4) & ((1 << (NUM_LEVELS-1)) - 1);
+        while ( (r & 1) ) { l++; r >>= 1; }
+        return l;
+    }
+    Node* get_marked_ref(Node* _p) {
+        return ((Node *)(((size_t)(_p)) | 1ULL));
+    }
+    Node* get_unmarked_ref(Node* _p) {
+        return ((Node *)(((size_t)(_p)) & ~1ULL));
+    }
+    bool is_marked_ref(Node* _p) {
+        return (((size_t)(_p)) & 1);
+    }
+    bool key_less(Node* x, const K& key) {
+        return x->key_type == MIN || (x->key_type == REAL && x->key < key);
+    }
+    Node* load_next(Node* x, int i) {
+        if (i == 0)
+            return x->floor_next.ptr.nbtc_load(this);
+        return x->next[i-1].load();
+    }
+    // x is in the deleted prefix but not its last node
+    bool succ_deleted(Node* x) {
+        return is_marked_ref(x->floor_next.ptr.nbtc_load(this));
+    }
+
+    Node* locate_preds(const K& key, Node** preds, Node** succs);
+    void link_upper_levels(Node* new_node, Node** preds, Node** succs, Node* del);
+    void restructure();
+
+    GlobalTestConfig* gtc;
+    padded<std::mt19937>* rands;
+    Node* head;
+public:
+    MedleySkipListPQ(GlobalTestConfig* gtc) :
+        Recoverable(gtc),
+        gtc(gtc),
+        head(new Node(this, new Node(this, nullptr, NUM_LEVELS, MAX), NUM_LEVELS, MIN))
+        {
+        int thd_num = pds::EpochSys::get_max_threads(gtc);
+        rands = new padded<std::mt19937>[thd_num];
+        for(int i=0;i<thd_num;i++){
+            rands[i].ui.seed(i);
+        }
+    };
+    void init_thread(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+        Recoverable::init_thread(gtc, ltc);
+    }
+
+    int recover(bool simulated){
+        errexit("MedleySkipListPQ isn't recoverable!");
+        return 0;
+    }
+
+    void enqueue(K key, V val, int tid);
+    optional<V> dequeue(int tid);
+};
+
+// Find the predecessors and successors of key at every level, skipping
+// the deleted prefix. Returns the last deleted node seen at the floor
+// level, if any.
+template<class K, class V>
+typename MedleySkipListPQ<K,V>::Node* MedleySkipListPQ<K,V>::locate_preds(const K& key, Node** preds, Node** succs)
+{
+    Node* x = head;
+    Node* x_next = nullptr;
+    Node* del = nullptr;
+    bool d = false;
+
+    for ( int i = NUM_LEVELS - 1; i >= 0; i-- )
+    {
+        x_next = load_next(x, i);
+        d = is_marked_ref(x_next);
+        x_next = get_unmarked_ref(x_next);
+        while ( key_less(x_next, key) || succ_deleted(x_next) || (i == 0 && d) )
+        {
+            if ( i == 0 && d ) del = x_next;
+            x = x_next;
+            x_next = load_next(x, i);
+            d = is_marked_ref(x_next);
+            x_next = get_unmarked_ref(x_next);
+        }
+        preds[i] = x;
+        succs[i] = x_next;
+    }
+    return del;
+}
+
+template<class K, class V>
+void MedleySkipListPQ<K,V>::link_upper_levels(Node* new_node, Node** preds, Node** succs, Node* del)
+{
+    int i = 1;
+    while ( i < new_node->level )
+    {
+        new_node->next[i-1].store(succs[i]);
+        /* Stop if new_node, or the node we would point to, is already deleted. */
+        if ( is_marked_ref(new_node->floor_next.ptr.load(this)) ||
+             is_marked_ref(succs[i]->floor_next.ptr.load(this)) ||
+             del == succs[i] )
+            break;
+        Node* expected = succs[i];
+        if ( preds[i]->next[i-1].compare_exchange_strong(expected, new_node) ) {
+            i++;
+            continue;
+        }
+        del = locate_preds(new_node->key, preds, succs);
+        if ( succs[0] != new_node ) break;
+    }
+    new_node->inserting.store(false);
+}
+
+// Swing head's upper-level pointers past the deleted prefix.
+template<class K, class V>
+void MedleySkipListPQ<K,V>::restructure()
+{
+    int i = NUM_LEVELS - 1;
+    Node* pred = head;
+    while ( i > 0 )
+    {
+        Node* h = head->next[i-1].load();
+        Node* cur = pred->next[i-1].load();
+        if ( !is_marked_ref(h->floor_next.ptr.load(this)) ) {
+            i--;
+            continue;
+        }
+        while ( is_marked_ref(cur->floor_next.ptr.load(this)) ) {
+            pred = cur;
+            cur = pred->next[i-1].load();
+        }
+        if ( head->next[i-1].compare_exchange_strong(h, pred->next[i-1].load()) )
+            i--;
+    }
+}
+
+template<class K, class V>
+void MedleySkipListPQ<K,V>::enqueue(K key, V val, int tid)
+{
+    TX_OP_SEPARATOR();
+    Node* preds[NUM_LEVELS] = {nullptr};
+    Node* succs[NUM_LEVELS] = {nullptr};
+    Node* del = nullptr;
+    Node* new_node = tnew<Node>(this, key, val, get_level(tid));
+
+    while ( true )
+    {
+        del = locate_preds(key, preds, succs);
+        new_node->floor_next.ptr.store(this, succs[0]);
+        /* We've committed when we've inserted at level 1. */
+        if ( preds[0]->floor_next.ptr.nbtc_CAS(this, succs[0], new_node, true, true) )//lin cas if succeeds
+            break;
+    }
+
+    auto cleanup = [=]()mutable{
+        link_upper_levels(new_node, preds, succs, del);
+    };
+    if (is_inside_txn()){
+        addToCleanups(cleanup); // if inside txn, cleanup only after lin CAS succeeds.
+    } else {
+        cleanup(); // execute cleanup in place
+    }
+}
+
+template<class K, class V>
+optional<V> MedleySkipListPQ<K,V>::dequeue(int tid)
+{
+    TX_OP_SEPARATOR();
+    optional<V> res = {};
+    Node* x = head;
+    Node* obs_head = head->floor_next.ptr.nbtc_load(this);
+    Node* new_head = nullptr;
+    Node* nxt = nullptr;
+    int offset = 0;
+
+    while ( true )
+    {
+        nxt = x->floor_next.ptr.nbtc_load(this);
+        if ( get_unmarked_ref(nxt)->key_type == MAX ) {
+            // empty; every pointer before x is marked, so the load of
+            // x's floor pointer is the lin point
+            addToReadSet(&(x->floor_next.ptr), nxt);
+            return res;
+        }
+        if ( new_head == nullptr && x->inserting.load() ) new_head = x;
+        if ( is_marked_ref(nxt) ) {
+            /* Successor already deleted; move along the prefix. */
+            offset++;
+            x = get_unmarked_ref(nxt);
+            continue;
+        }
+        if ( x->floor_next.ptr.nbtc_CAS(this, nxt, get_marked_ref(nxt), true, true) ) {//lin cas if succeeds
+            offset++;
+            x = nxt;
+            break;
+        }
+    }
+    res = x->val;
+    if ( new_head == nullptr ) new_head = x;
+    if ( offset <= BOUND_OFFSET ) return res;
+
+    /* Prefix is long enough; unlink it in one go. */
+    auto cleanup = [=]()mutable{
+        if ( head->floor_next.ptr.load(this) != obs_head ) return;
+        if ( head->floor_next.ptr.CAS(this, obs_head, get_marked_ref(new_head)) ) {
+            restructure();
+            Node* cur = get_unmarked_ref(obs_head);
+            while ( cur != new_head ) {
+                Node* n = get_unmarked_ref(cur->floor_next.ptr.load(this));
+                this->tretire(cur);
+                cur = n;
+            }
+        }
+    };
+    if (is_inside_txn()){
+        addToCleanups(cleanup);
+    } else {
+        cleanup();
+    }
+    return res;
+}
+
+template <class T>
+class MedleySkipListPQFactory : public RideableFactory{
+    Rideable* build(GlobalTestConfig* gtc){
+        return new MedleySkipListPQ<T,T>(gtc);
+    }
+};
+
+#endif
@@ -40,6 +40,7 @@
 
 #include <cassert>
 #include <random>
+#include <type_traits>
 
 #include "HarnessUtils.hpp"
 #include "ConcurrentPrimitives.hpp"
@@ -53,6 +54,10 @@ private:
     static constexpr int READY_FOR_FREE = 0x100;
     static constexpr int NUM_LEVELS = 20;
     enum KeyType { MIN, REAL, MAX };
+    // Small trivially-copyable values are stored in the node itself;
+    // see Node.
+    static constexpr bool INLINE_VAL = std::is_trivially_copyable<V>::value
+        && sizeof(V) <= 16 && alignof(V) <= alignof(void*);
     struct Node;
     struct NodePtr {
         std::atomic<Node *> ptr;
@@ -64,35 +69,69 @@ private:
         VPtr(V *n) : ptr(n){};
         VPtr() : ptr(nullptr){};
     };
-    struct alignas(64) Node : public Persistent{
+    // A node of level l carries only the l entries of next it uses, so
+    // Ralloc serves it from the size class that fits. With INLINE_VAL,
+    // the value the node is inserted with follows the tower; val points
+    // at it until a put replaces it with a separately allocated V, and
+    // it goes away with the node.
+    struct Node : public Persistent{
         std::atomic<int> level;
         KeyType key_type; // 0 min, 1 real val, 2 max
         K key;
         VPtr val;
         // Transient-to-transient pointers
-        NodePtr next [NUM_LEVELS];
+        NodePtr next [0];
         Node(K k, V* v, Node *_next, int _level, KeyType _key_type) : 
             level(_level),
             key_type(_key_type), 
             key(k), 
-            val(v),
-            next{} 
+            val(v)
         { 
             for(int i = 0; i < level; i++) 
-                next[i].ptr.store(_next, std::memory_order_relaxed);
+                new (&next[i]) NodePtr(_next);
+        }
+        template <bool I = INLINE_VAL, typename std::enable_if<I, int>::type = 0>
+        Node(K k, const V& v, Node *_next, int _level, KeyType _key_type) : 
+            Node(k, (V*)nullptr, _next, _level, _key_type)
+        {
+            val.ptr.store(new (inline_val()) V(v), std::memory_order_relaxed);
         }
         Node(Node *_next, int _level, KeyType _key_type) : 
             level(_level),
             key_type(_key_type),
             key(),
-            val(nullptr),
-            next{} 
+            val(nullptr)
         {
             for(int i = 0; i < level; i++) 
-                next[i].ptr.store(_next, std::memory_order_relaxed);
+                new (&next[i]) NodePtr(_next);
+        }
+
+        static size_t size_of(int _level){
+            return sizeof(Node) + _level*sizeof(NodePtr) +
+                (INLINE_VAL ? sizeof(V) : 0);
+        }
+        V* inline_val(){
+            return reinterpret_cast<V*>(&next[level.load() & LEVEL_MASK]);
+        }
+        static void* operator new(size_t sz, int _level){
+            return Persistent::operator new(size_of(_level));
+        }
+        static void operator delete(void* p, int _level){
+            Persistent::operator delete(p);
+        }
+        static void operator delete(void* p){
+            Persistent::operator delete(p);
         }
-        ~Node(){ }
     };
+    // whether v is the value stored inside n, which must not be retired
+    // on its own
+    bool is_inline_val(Node* n, V* v){
+        if constexpr (INLINE_VAL) {
+            return v == n->inline_val();
+        } else {
+            return false;
+        }
+    }
 
     int get_level(int tid) {
         size_t r = rands[tid].ui();
@@ -119,7 +158,7 @@ private:
     void mark_deleted(Node* x, int level);
     int check_for_full_delete(Node* x);
     void do_full_delete(Node* x, int level, int tid);
-    bool do_update(const K& key, V* val, int tid, optional<V>& res, bool overwrite);
+    bool do_update(const K& key, const V& val, int tid, optional<V>& res, bool overwrite);
 
 public:
     NVMFraserSkipList(GlobalTestConfig* gtc) : tracker(gtc->task_num, 100, 1000, true){ 
@@ -128,8 +167,8 @@ public:
         for(int i=0;i<gtc->task_num;i++){
             rands[i].ui.seed(i);
         }
-        Node* tail = new Node(nullptr, NUM_LEVELS, MAX);
-        head.ptr = new Node(tail, NUM_LEVELS, MIN);
+        Node* tail = new (NUM_LEVELS) Node(nullptr, NUM_LEVELS, MAX);
+        head.ptr = new (NUM_LEVELS) Node(tail, NUM_LEVELS, MIN);
     };
     ~NVMFraserSkipList(){
         Persistent::finalize();
@@ -253,9 +292,10 @@ void NVMFraserSkipList<K,V>::do_full_delete(Node* x, int level, int tid)
 }
 
 template<class K, class V>
-bool NVMFraserSkipList<K,V>::do_update(const K& key, V* val, int tid, optional<V>& res, bool overwrite)
+bool NVMFraserSkipList<K,V>::do_update(const K& key, const V& val, int tid, optional<V>& res, bool overwrite)
 {
     V*  ov;
+    V*  nv = nullptr; // separately allocated new value, if needed
     Node* preds[NUM_LEVELS];
     Node* succs[NUM_LEVELS];
     Node* pred;
@@ -285,21 +325,31 @@ bool NVMFraserSkipList<K,V>::do_update(const K& key, V* val, int tid, optional<V
                 succ = strong_search_predecessors(key, preds, succs);
                 goto retry;
             }
-        } while ( overwrite && !succ->val.ptr.compare_exchange_strong(ov, val));
+            if ( overwrite && nv == nullptr ) nv = new V(val);
+        } while ( overwrite && !succ->val.ptr.compare_exchange_strong(ov, nv));
 
         if ( new_node != nullptr ) delete(new_node);
         res = *ov;
         if (overwrite) {
             result = true;
-            tracker.retire(ov, tid);
+            if (!is_inline_val(succ, ov))
+                tracker.retire(ov, tid);
         } else {
+            if ( nv != nullptr ) delete(nv);
             result = false;
         }
         // goto out;
     } else {
         /* Not in the list, so initialise a new_node node for insertion. */
-        if ( new_node == nullptr )
-            new_node    = new Node(key, val, nullptr, get_level(tid), REAL);
+        if ( new_node == nullptr ) {
+            level = get_level(tid);
+            if constexpr (INLINE_VAL) {
+                new_node = new (level) Node(key, val, nullptr, level, REAL);
+            } else {
+                if ( nv == nullptr ) nv = new V(val);
+                new_node = new (level) Node(key, nv, nullptr, level, REAL);
+            }
+        }
         level = new_node->level.load();
 
         /* If successors don't change, this saves us some CAS operations. */
@@ -315,6 +365,7 @@ bool NVMFraserSkipList<K,V>::do_update(const K& key, V* val, int tid, optional<V
             goto retry;
         }
         result = true; // inserted
+        if ( INLINE_VAL && nv != nullptr ) delete(nv); // left over from a retry
 
         /* Insert at each of the other levels in turn. */
         i = 1;
@@ -416,7 +467,8 @@ optional<V> NVMFraserSkipList<K,V>::remove(K key, int tid){
     }
     while ( !x->val.ptr.compare_exchange_strong(v, nullptr) );
     res = *v;
-    tracker.retire(v, tid);
+    if (!is_inline_val(x, v))
+        tracker.retire(v, tid);
 
     /* Committed to @x: mark lower-level forward pointers. */
     mark_deleted(x, level);
@@ -453,21 +505,14 @@ optional<V> NVMFraserSkipList<K,V>::remove(K key, int tid){
 template<class K, class V>
 optional<V> NVMFraserSkipList<K,V>::put(K key, V val, int tid){
     optional<V> res = {};
-    V* _v = new V(val);
-    bool ret = do_update(key, _v, tid, res, true);
+    do_update(key, val, tid, res, true);
     return res;
 }
 
 template<class K, class V>
 bool NVMFraserSkipList<K,V>::insert(K key, V val, int tid) {
     optional<V> res = {};
-    V* _v = new V(val);
-    if (do_update(key, _v, tid, res, false)){
-        return true;
-    } else {
-        delete(_v);
-        return false;
-    }
+    return do_update(key, val, tid, res, false);
 }
 
 template<class K, class V>
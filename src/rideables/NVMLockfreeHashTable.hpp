@@ -14,12 +14,13 @@
 #include "HarnessUtils.hpp"
 #include "ConcurrentPrimitives.hpp"
 #include "RMap.hpp"
+#include "FastHash.hpp"
 #include "RCUTracker.hpp"
 #include "CustomTypes.hpp"
 #include "InPlaceString.hpp"
 
 // lock-free hash table placed on NVM
-template <class K, class V>
+template <class K, class V, class Hash=FastHash<K>>
 class NVMLockfreeHashTable : public RMap<K,V>{
     // template <class T>
     // class my_alloc {
@@ -58,7 +59,7 @@ class NVMLockfreeHashTable : public RMap<K,V>{
         };
     };
 private:
-    std::hash<K> hash_fn;
+    Hash hash_fn;
     const int idxSize=1000000;//number of buckets for hash table
     padded<MarkPtr>* buckets=new padded<MarkPtr>[idxSize]{};
     bool findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid);
@@ -116,8 +117,8 @@ struct NVMLockfreeHashTable<std::string,std::string>::Node : public Persistent{
 };
 
 //-------Definition----------
-template <class K, class V>
-optional<V> NVMLockfreeHashTable<K,V>::get(K key, int tid) {
+template <class K, class V, class Hash>
+optional<V> NVMLockfreeHashTable<K,V,Hash>::get(K key, int tid) {
     MarkPtr* prev=nullptr;
     Node* curr=nullptr;
     Node* next=nullptr;
@@ -132,8 +133,8 @@ optional<V> NVMLockfreeHashTable<K,V>::get(K key, int tid) {
     return res;
 }
 
-template<class K, class V>
-optional<V> NVMLockfreeHashTable<K,V>::put(K key, V val, int tid) {
+template <class K, class V, class Hash>
+optional<V> NVMLockfreeHashTable<K,V,Hash>::put(K key, V val, int tid) {
     Node* tmpNode = nullptr;
     MarkPtr* prev=nullptr;
     Node* curr=nullptr;
@@ -171,8 +172,8 @@ optional<V> NVMLockfreeHashTable<K,V>::put(K key, V val, int tid) {
     return res;
 }
 
-template<class K, class V>
-bool NVMLockfreeHashTable<K,V>::insert(K key, V val, int tid){
+template <class K, class V, class Hash>
+bool NVMLockfreeHashTable<K,V,Hash>::insert(K key, V val, int tid){
     Node* tmpNode = nullptr;
     MarkPtr* prev=nullptr;
     Node* curr=nullptr;
@@ -201,8 +202,8 @@ bool NVMLockfreeHashTable<K,V>::insert(K key, V val, int tid){
     return res;
 }
 
-template<class K, class V>
-optional<V> NVMLockfreeHashTable<K,V>::remove(K key, int tid) {
+template <class K, class V, class Hash>
+optional<V> NVMLockfreeHashTable<K,V,Hash>::remove(K key, int tid) {
     MarkPtr* prev=nullptr;
     Node* curr=nullptr;
     Node* next=nullptr;
@@ -230,8 +231,8 @@ optional<V> NVMLockfreeHashTable<K,V>::remove(K key, int tid) {
     return res;
 }
 
-template<class K, class V>
-optional<V> NVMLockfreeHashTable<K,V>::replace(K key, V val, int tid) {
+template <class K, class V, class Hash>
+optional<V> NVMLockfreeHashTable<K,V,Hash>::replace(K key, V val, int tid) {
     Node* tmpNode = nullptr;
     MarkPtr* prev=nullptr;
     Node* curr=nullptr;
@@ -265,10 +266,10 @@ optional<V> NVMLockfreeHashTable<K,V>::replace(K key, V val, int tid) {
     return res;
 }
 
-template<class K, class V>
-bool NVMLockfreeHashTable<K,V>::findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid){
+template <class K, class V, class Hash>
+bool NVMLockfreeHashTable<K,V,Hash>::findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid){
     while(true){
-        size_t idx=hash_fn(key)%idxSize;
+        size_t idx=fastrange(hash_fn(key),idxSize);
         bool cmark=false;
         prev=&buckets[idx].ui;
         curr=getPtr(prev->ptr.load());
@@ -301,7 +302,7 @@ bool NVMLockfreeHashTable<K,V>::findNode(MarkPtr* &prev, Node* &curr, Node* &nex
 template<>
 bool NVMLockfreeHashTable<std::string,std::string>::findNode(MarkPtr* &prev, Node* &curr, Node* &next, std::string key, int tid){
     while(true){
-        size_t idx=hash_fn(key)%idxSize;
+        size_t idx=fastrange(hash_fn(key),idxSize);
         bool cmark=false;
         prev=&buckets[idx].ui;
         curr=getPtr(prev->ptr.load());
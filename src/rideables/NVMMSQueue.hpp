@@ -71,6 +71,10 @@ public:
 
     void enqueue(std::string value, int tid);
     optional<std::string> dequeue(int tid);
+    void enqueue_batch(const std::string* vals, size_t n, int tid);
+    // dequeue_batch keeps RQueue's default: a dequeue claims its node
+    // via deqTid and persists the value in returnedVal[tid], which
+    // holds a single value.
 };
 
 class NVMMSQueueFactory : public RideableFactory{
@@ -99,6 +103,34 @@ void NVMMSQueue::enqueue(std::string val, int tid){
     tracker.end_op(tid);
 }
 
+void NVMMSQueue::enqueue_batch(const std::string* vals, size_t n, int tid){
+    if (n == 0) return;
+    // link the batch privately; a single CAS publishes all of it
+    Node* first = new Node(vals[0]);
+    Node* node = first;
+    for (size_t i = 1; i < n; i++){
+        Node* new_node = new Node(vals[i]);
+        node->next.store(new_node);
+        node = new_node;
+    }
+    tracker.start_op(tid);
+    while(1){
+        Node* last = tail->load();
+        Node* next = last->next.load();
+        if(last == tail->load()){
+            if(next == nullptr){
+                if((last->next).compare_exchange_strong(next, first)){
+                    tail->compare_exchange_strong(last, node);
+                    break;
+                }
+            } else{
+                tail->compare_exchange_strong(last, next);
+            }
+        }
+    }
+    tracker.end_op(tid);
+}
+
 optional<std::string> NVMMSQueue::dequeue(int tid){
     optional<std::string> res = {};
     returnedVal[tid]->fill('\0');
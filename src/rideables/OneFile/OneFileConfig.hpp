@@ -0,0 +1,34 @@
+#ifndef ONEFILE_CONFIG_HPP
+#define ONEFILE_CONFIG_HPP
+
+// Sizes OneFile's thread registry and per-thread logs from the harness
+// configuration: -t threads plus the main thread, and -dTxnSize
+// operations per transaction. OneFile's own defaults stay as lower
+// bounds, so this only ever raises them.
+//
+// Call it before the first OneFile transaction, i.e., from rideable
+// constructors and, for the persistent variant, before anything is
+// allocated in its region, since configuring re-maps the region.
+
+#include <algorithm>
+#include <string>
+
+#include "TestConfig.hpp"
+
+// write-set entries budgeted per data structure operation; a skip list
+// insert with a full tower logs about 45
+static constexpr uint64_t ONEFILE_STORES_PER_OP = 64;
+
+inline int onefile_max_threads(GlobalTestConfig* gtc, int dflt){
+    return std::max(dflt, gtc->task_num + 1);
+}
+
+inline uint64_t onefile_max_stores(GlobalTestConfig* gtc, uint64_t dflt){
+    if (gtc->checkEnv("TxnSize")){
+        uint64_t txn_size = std::stoull(gtc->getEnv("TxnSize"));
+        return std::max(dflt, txn_size * ONEFILE_STORES_PER_OP);
+    }
+    return dflt;
+}
+
+#endif
@@ -10,12 +10,14 @@
 #ifndef _ONE_FILE_LOCK_FREE_TRANSACTIONAL_MEMORY_WITH_HAZARD_ERAS_H_
 #define _ONE_FILE_LOCK_FREE_TRANSACTIONAL_MEMORY_WITH_HAZARD_ERAS_H_
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <iostream>
 #include <vector>
 #include <functional>
 #include <cstring>
+#include <cstdlib>
 #include <cstdint>   // Needed by uint64_t
 
 // Please keep this file in sync (as much as possible) with ptms/POneFileLF.hpp
@@ -24,19 +26,29 @@ namespace oflf {
 
 //
 // User configurable variables.
-// Feel free to change these if you need larger transactions, more allocations per transacation, or more threads.
+// These are the defaults. Call gOFLF.configure() before the first transaction
+// if you need larger transactions, more allocations per transaction, or more threads.
 //
 
 // Maximum number of registered threads that can execute transactions
-static const int REGISTRY_MAX_THREADS = 128;
+inline int REGISTRY_MAX_THREADS = 128;
 // Maximum number of stores in the WriteSet per transaction
-static const uint64_t TX_MAX_STORES = 10*1024;
+inline uint64_t TX_MAX_STORES = 10*1024;
 // Number of buckets in the hashmap of the WriteSet.
-static const uint64_t HASH_BUCKETS = 1024;
+inline uint64_t HASH_BUCKETS = 1024;
 // Maximum number of allocations in one transaction
-static const uint64_t TX_MAX_ALLOCS = 10*1024;
+inline uint64_t TX_MAX_ALLOCS = 10*1024;
 // Maximum number of deallocations in one transaction
-static const uint64_t TX_MAX_RETIRES = 10*1024;
+inline uint64_t TX_MAX_RETIRES = 10*1024;
+// The transaction identifier keeps the tid in 10 bits
+static const int TID_BITS_MAX_THREADS = 1024;
+
+// Reports a transaction that outgrew one of its logs. Overflowing a log would
+// corrupt the other threads' logs, so this is checked even in release builds.
+[[noreturn]] static inline void txLogOverflow(const char* log, uint64_t cap) {
+    std::cout << "ERROR: transaction exceeds " << cap << " " << log << "; raise it with gOFLF.configure()\n";
+    std::abort();
+}
 
 
 
@@ -100,16 +112,37 @@ extern ThreadRegistry gThreadRegistry;
  */
 class ThreadRegistry {
 private:
-    alignas(128) std::atomic<bool>      usedTID[REGISTRY_MAX_THREADS];   // Which TIDs are in use by threads
+    alignas(128) std::atomic<bool>*     usedTID;                         // Which TIDs are in use by threads
     alignas(128) std::atomic<int>       maxTid {-1};                     // Highest TID (+1) in use by threads
 
 public:
     ThreadRegistry() {
+        usedTID = new std::atomic<bool>[REGISTRY_MAX_THREADS];
         for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
             usedTID[it].store(false, std::memory_order_relaxed);
         }
     }
 
+    ~ThreadRegistry() {
+        delete[] usedTID;
+    }
+
+    // Reallocates the registry for REGISTRY_MAX_THREADS threads.
+    // Only valid while no thread has ever registered.
+    void resize(void) {
+        assert(maxTid.load() == -1);
+        delete[] usedTID;
+        usedTID = new std::atomic<bool>[REGISTRY_MAX_THREADS];
+        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+            usedTID[it].store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // Progress condition: wait-free population oblivious
+    static inline bool anyRegistered(void) {
+        return gThreadRegistry.maxTid.load(std::memory_order_acquire) != -1;
+    }
+
     // Progress condition: wait-free bounded (by the number of threads)
     int register_thread_new(void) {
         for (int tid = 0; tid < REGISTRY_MAX_THREADS; tid++) {
@@ -178,20 +211,32 @@ private:
     static const int                         THRESHOLD_R = 0; // This is named 'R' in the HP paper
     alignas(128) std::atomic<uint64_t>*      he;
     // It's not nice that we have a lot of empty vectors, but we need padding to avoid false sharing
-    alignas(128) std::vector<tmbase*>        retiredList[REGISTRY_MAX_THREADS*CLPAD];
+    alignas(128) std::vector<tmbase*>*       retiredList;
 
-public:
-    HazardErasOF() {
+    void allocate() {
         he = new std::atomic<uint64_t>[REGISTRY_MAX_THREADS*CLPAD];
-        for (unsigned it = 0; it < REGISTRY_MAX_THREADS; it++) {
+        retiredList = new std::vector<tmbase*>[REGISTRY_MAX_THREADS*CLPAD];
+        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
             he[it*CLPAD].store(NOERA, std::memory_order_relaxed);
             retiredList[it*CLPAD].reserve(REGISTRY_MAX_THREADS);  // We pre-reserve one object per thread, should be enough to start
         }
     }
 
+public:
+    HazardErasOF() {
+        allocate();
+    }
+
+    // Reallocates for REGISTRY_MAX_THREADS threads. Only valid before the first transaction.
+    void resize() {
+        delete[] he;
+        delete[] retiredList;
+        allocate();
+    }
+
     ~HazardErasOF() {
         // Clear the objects in the retired lists
-        for (unsigned it = 0; it < REGISTRY_MAX_THREADS; it++) {
+        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
             for (unsigned iret = 0; iret < retiredList[it*CLPAD].size(); iret++) {
                 tmbase* del = retiredList[it*CLPAD][iret];
                 std::free(del);
@@ -199,6 +244,7 @@ public:
             }
         }
         delete[] he;
+        delete[] retiredList;
     }
 
     // Progress condition: wait-free population oblivious
@@ -276,15 +322,24 @@ extern thread_local bool tl_is_read_only;
 // This log is an array with an intrusive hashmap of size HASH_BUCKETS.
 struct WriteSet {
     static const uint64_t MAX_ARRAY_LOOKUP = 30;  // Beyond this, it seems to be faster to use the hashmap
-    WriteSetEntry*        buckets[HASH_BUCKETS];  // Intrusive HashMap for fast lookup in large(r) transactions
+    WriteSetEntry**       buckets;                // Intrusive HashMap for fast lookup in large(r) transactions
     uint64_t              numStores {0};          // Number of stores in the writeSet for the current transaction
-    WriteSetEntry         log[TX_MAX_STORES];     // Redo log of stores
+    WriteSetEntry*        log;                    // Redo log of stores, TX_MAX_STORES entries
 
     WriteSet() {
         numStores = 0;
+        buckets = new WriteSetEntry*[HASH_BUCKETS];
+        log = new WriteSetEntry[TX_MAX_STORES];
         for (unsigned i = 0; i < HASH_BUCKETS; i++) buckets[i] = &log[TX_MAX_STORES-1];
     }
 
+    WriteSet(const WriteSet&) = delete;
+
+    ~WriteSet() {
+        delete[] buckets;
+        delete[] log;
+    }
+
     // Each address on a different bucket
     inline uint64_t hash(const void* addr) const {
         return (((uint64_t)addr) >> 3) % HASH_BUCKETS;
@@ -316,8 +371,8 @@ struct WriteSet {
             }
         }
         // Add to array
+        if (numStores+1 >= TX_MAX_STORES) txLogOverflow("stores", TX_MAX_STORES);
         WriteSetEntry* e = &log[numStores++];
-        assert(numStores < TX_MAX_STORES);
         e->addr = addr;
         e->val = val;
         // Add to hashmap
@@ -384,9 +439,17 @@ struct OpData {
     std::atomic<uint64_t> request {0};                 // Can be moved to CLOSED by other threads, using a CAS
     uint64_t              nestedTrans {0};             // Thread-local: Number of nested transactions
     uint64_t              numRetires {0};              // Number of calls to retire() in this transaction (owner thread only)
-    tmbase*               rlog[TX_MAX_RETIRES];        // List of retired objects during the transaction (owner thread only)
+    tmbase**              rlog;                        // List of retired objects during the transaction (owner thread only)
     uint64_t              numAllocs {0};               // Number of calls to tmNew() in this transaction (owner thread only)
-    Deletable             alog[TX_MAX_ALLOCS];         // List of newly allocated objects during the transaction (owner thread only)
+    Deletable*            alog;                        // List of newly allocated objects during the transaction (owner thread only)
+
+    OpData() : rlog(new tmbase*[TX_MAX_RETIRES]), alog(new Deletable[TX_MAX_ALLOCS]) { }
+    OpData(const OpData&) = delete;
+
+    ~OpData() {
+        delete[] rlog;
+        delete[] alog;
+    }
 };
 
 
@@ -435,6 +498,32 @@ public:
         delete[] writeSets;
     }
 
+    // Resizes the thread registry and the per-thread logs. Must be called before
+    // any thread runs a transaction; calling it again with the same sizes is a no-op.
+    void configure(int maxThreads, uint64_t maxStores) {
+        if (maxThreads == REGISTRY_MAX_THREADS && maxStores == TX_MAX_STORES) return;
+        if (maxThreads > TID_BITS_MAX_THREADS) {
+            std::cout << "ERROR: OneFile supports at most " << TID_BITS_MAX_THREADS << " threads\n";
+            std::abort();
+        }
+        if (ThreadRegistry::anyRegistered()) {
+            std::cout << "ERROR: OneFile can only be configured before the first transaction\n";
+            std::abort();
+        }
+        delete[] opData;
+        delete[] writeSets;
+        REGISTRY_MAX_THREADS = maxThreads;
+        TX_MAX_STORES = maxStores;
+        TX_MAX_ALLOCS = maxStores;
+        TX_MAX_RETIRES = maxStores;
+        // Keep the default ratio of about ten stores per bucket
+        HASH_BUCKETS = std::max<uint64_t>(1024, maxStores/10);
+        gThreadRegistry.resize();
+        he.resize();
+        opData = new OpData[REGISTRY_MAX_THREADS];
+        writeSets = new WriteSet[REGISTRY_MAX_THREADS];
+    }
+
     static std::string className() { return "OneFileSTM-LF"; }
 
     // Progress Condition: lock-free
@@ -545,7 +634,7 @@ public:
         ptr->newEra_ = trans2seq(gOFLF.curTx.load(std::memory_order_acquire));
         OpData* myopd = tl_opdata;
         if (myopd != nullptr) {
-            assert(myopd->numAllocs != TX_MAX_ALLOCS);
+            if (myopd->numAllocs == TX_MAX_ALLOCS) txLogOverflow("allocations", TX_MAX_ALLOCS);
             Deletable& del = myopd->alog[myopd->numAllocs++];
             del.obj = ptr;
             // This func ptr to a lambda gives us a way to call the destructor
@@ -571,7 +660,7 @@ public:
             std::free(obj);  // Outside a transaction, just delete the object
             return;
         }
-        assert(myopd->numRetires != TX_MAX_RETIRES);
+        if (myopd->numRetires == TX_MAX_RETIRES) txLogOverflow("retires", TX_MAX_RETIRES);
         myopd->rlog[myopd->numRetires++] = obj;
     }
 
@@ -583,7 +672,7 @@ public:
         ((tmbase*)ptr)->newEra_ = trans2seq(gOFLF.curTx.load(std::memory_order_acquire));
         OpData* myopd = tl_opdata;
         if (myopd != nullptr) {
-            assert(myopd->numAllocs != TX_MAX_ALLOCS);
+            if (myopd->numAllocs == TX_MAX_ALLOCS) txLogOverflow("allocations", TX_MAX_ALLOCS);
             Deletable& del = myopd->alog[myopd->numAllocs++];
             del.obj = ptr;
             del.reclaim = [](void* obj) { std::free(obj); };
@@ -600,7 +689,7 @@ public:
             std::free(ptr);  // Outside a transaction, just free the object
             return;
         }
-        assert(myopd->numRetires != TX_MAX_RETIRES);
+        if (myopd->numRetires == TX_MAX_RETIRES) txLogOverflow("retires", TX_MAX_RETIRES);
         myopd->rlog[myopd->numRetires++] = (tmbase*)ptr;
     }
 
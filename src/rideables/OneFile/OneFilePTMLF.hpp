@@ -16,6 +16,8 @@
 #include <vector>
 #include <functional>
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
 #include <sys/mman.h>   // Needed if we use mmap()
 #include <sys/types.h>  // Needed by open() and close()
 #include <sys/stat.h>
@@ -91,15 +93,18 @@ namespace poflf {
 
 //
 // User configurable variables.
-// Feel free to change these if you need larger transactions, more allocations per transacation, or more threads.
+// These are the defaults. Call gOFLF.configure() before the first transaction
+// if you need larger transactions or more threads.
 //
 
 // Maximum number of registered threads that can execute transactions
-static const int REGISTRY_MAX_THREADS = 128;
+inline int REGISTRY_MAX_THREADS = 128;
 // Maximum number of stores in the WriteSet per transaction
-static const uint64_t TX_MAX_STORES = 40*1024;
+inline uint64_t TX_MAX_STORES = 40*1024;
 // Number of buckets in the hashmap of the WriteSet.
-static const uint64_t HASH_BUCKETS = 2048;
+inline uint64_t HASH_BUCKETS = 2048;
+// The transaction identifier keeps the tid in 10 bits
+static const int TID_BITS_MAX_THREADS = 1024;
 
 // Persistent-specific configuration
 // Start address of mapped persistent memory
@@ -139,6 +144,13 @@ static inline uint64_t trans2idx(uint64_t trans) {
     return trans & 0x3FF; // 10 bits
 }
 
+// Reports a transaction that outgrew its write-set. Overflowing it would
+// corrupt the other threads' logs, so this is checked even in release builds.
+[[noreturn]] static inline void txLogOverflow(const char* log, uint64_t cap) {
+    std::cout << "ERROR: transaction exceeds " << cap << " " << log << "; raise it with gOFLF.configure()\n";
+    std::abort();
+}
+
 // Flush each cache line in a range
 static inline void flushFromTo(void* from, void* to) noexcept {
     const uint64_t cache_line_size = 64;
@@ -179,16 +191,37 @@ extern ThreadRegistry gThreadRegistry;
  */
 class ThreadRegistry {
 private:
-    alignas(128) std::atomic<bool>      usedTID[REGISTRY_MAX_THREADS];   // Which TIDs are in use by threads
+    alignas(128) std::atomic<bool>*     usedTID;                         // Which TIDs are in use by threads
     alignas(128) std::atomic<int>       maxTid {-1};                     // Highest TID (+1) in use by threads
 
 public:
     ThreadRegistry() {
+        usedTID = new std::atomic<bool>[REGISTRY_MAX_THREADS];
+        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
+            usedTID[it].store(false, std::memory_order_relaxed);
+        }
+    }
+
+    ~ThreadRegistry() {
+        delete[] usedTID;
+    }
+
+    // Reallocates the registry for REGISTRY_MAX_THREADS threads.
+    // Only valid while no thread has ever registered.
+    void resize(void) {
+        assert(maxTid.load() == -1);
+        delete[] usedTID;
+        usedTID = new std::atomic<bool>[REGISTRY_MAX_THREADS];
         for (int it = 0; it < REGISTRY_MAX_THREADS; it++) {
             usedTID[it].store(false, std::memory_order_relaxed);
         }
     }
 
+    // Progress condition: wait-free population oblivious
+    static inline bool anyRegistered(void) {
+        return gThreadRegistry.maxTid.load(std::memory_order_acquire) != -1;
+    }
+
     // Progress condition: wait-free bounded (by the number of threads)
     int register_thread_new(void) {
         for (int tid = 0; tid < REGISTRY_MAX_THREADS; tid++) {
@@ -384,18 +417,28 @@ struct PWriteSetEntry {
 };
 
 
-// The persistent write-set (undo log)
+// The persistent write-set (undo log).
+// In persistent memory it is followed by its TX_MAX_STORES entries.
 struct PWriteSet {
     uint64_t              numStores {0};          // Number of stores in the writeSet for the current transaction
     std::atomic<uint64_t> request {0};            // Can be moved to CLOSED by other threads, using a CAS
-    PWriteSetEntry        plog[TX_MAX_STORES];    // Redo log of stores
+
+    // Redo log of stores
+    inline PWriteSetEntry* plog() {
+        return reinterpret_cast<PWriteSetEntry*>(this+1);
+    }
+
+    // Bytes taken by one write-set and its entries, rounded up to a cache line
+    static uint64_t stride() {
+        return (sizeof(PWriteSet) + TX_MAX_STORES*sizeof(PWriteSetEntry) + 63) & ~63ULL;
+    }
 
     // Applies all entries in the log. Called only by recover() which is non-concurrent.
     void applyFromRecover() {
         // We're assuming that 'val' is the size of a uint64_t
         for (uint64_t i = 0; i < numStores; i++) {
-            *((uint64_t*)plog[i].addr) = plog[i].val;
-            PWB(plog[i].addr);
+            *((uint64_t*)plog()[i].addr) = plog()[i].val;
+            PWB(plog()[i].addr);
         }
     }
 };
@@ -403,14 +446,30 @@ struct PWriteSet {
 
 // The persistent metadata is a 'header' that contains all the logs and the persistent curTx variable.
 // It is located at the start of the persistent region, and the remaining region contains the data available for the allocator to use.
+// The REGISTRY_MAX_THREADS logs come right after the fixed part; numLogs and maxStores record their
+// geometry so that a region is only re-used with the same configuration.
 struct PMetadata {
-    static const uint64_t   MAGIC_ID = 0x1337babe;
+    static const uint64_t   MAGIC_ID = 0x1337babf;
     std::atomic<uint64_t>   curTx {seqidx2trans(1,0)};
     std::atomic<uint64_t>   pad1[15];
     tmtypebase<void*>       rootPtrs[MAX_ROOT_POINTERS];
-    PWriteSet               plog[REGISTRY_MAX_THREADS];
+    uint64_t                numLogs {0};
+    uint64_t                maxStores {0};
     uint64_t                id {0};
     uint64_t                pad2 {0};
+
+    static uint64_t logsOffset() {
+        return (sizeof(PMetadata) + 63) & ~63ULL;
+    }
+
+    // Size of the header including the logs, for the current configuration
+    static uint64_t size() {
+        return logsOffset() + REGISTRY_MAX_THREADS*PWriteSet::stride();
+    }
+
+    inline PWriteSet* plog(uint64_t tid) {
+        return reinterpret_cast<PWriteSet*>((uint8_t*)this + logsOffset() + tid*PWriteSet::stride());
+    }
 };
 
 
@@ -428,24 +487,34 @@ extern thread_local bool tl_is_read_only;
 // This log is an array with an intrusive hashmap of size HASH_BUCKETS.
 struct WriteSet {
     static const uint64_t MAX_ARRAY_LOOKUP = 30;  // Beyond this, it seems to be faster to use the hashmap
-    WriteSetEntry         log[TX_MAX_STORES];     // Redo log of stores
+    WriteSetEntry*        log;                    // Redo log of stores, TX_MAX_STORES entries
     uint64_t              numStores {0};          // Number of stores in the writeSet for the current transaction
-    WriteSetEntry*        buckets[HASH_BUCKETS];  // Intrusive HashMap for fast lookup in large(r) transactions
+    WriteSetEntry**       buckets;                // Intrusive HashMap for fast lookup in large(r) transactions
 
     WriteSet() {
         numStores = 0;
+        log = new WriteSetEntry[TX_MAX_STORES];
+        buckets = new WriteSetEntry*[HASH_BUCKETS];
         for (uint64_t i = 0; i < HASH_BUCKETS; i++) buckets[i] = &log[TX_MAX_STORES-1];
     }
 
+    WriteSet(const WriteSet&) = delete;
+
+    ~WriteSet() {
+        delete[] log;
+        delete[] buckets;
+    }
+
     // Copies the current write set to persistent memory
     inline void persistAndFlushLog(PWriteSet* const pwset) {
+        PWriteSetEntry* const plog = pwset->plog();
         for (uint64_t i = 0; i < numStores; i++) {
-            pwset->plog[i].addr = log[i].addr;
-            pwset->plog[i].val = log[i].val;
+            plog[i].addr = log[i].addr;
+            plog[i].val = log[i].val;
         }
         pwset->numStores = numStores;
         // Flush the log and the numStores variable
-        flushFromTo(&pwset->numStores, &pwset->plog[numStores+1]);
+        flushFromTo(&pwset->numStores, &plog[numStores+1]);
     }
 
     // Uses the log to flush the modifications to NVM.
@@ -485,8 +554,8 @@ struct WriteSet {
             }
         }
         // Add to array
+        if (numStores+1 >= TX_MAX_STORES) txLogOverflow("stores", TX_MAX_STORES);
         WriteSetEntry* e = &log[numStores++];
-        assert(numStores < TX_MAX_STORES);
         e->addr = addr;
         e->val = val;
         // Add to hashmap
@@ -606,11 +675,40 @@ public:
         delete[] writeSets;
     }
 
+    // Resizes the thread registry and the volatile and persistent logs, re-mapping
+    // the persistent region. Must be called before any thread runs a transaction;
+    // calling it again with the same sizes is a no-op.
+    void configure(int maxThreads, uint64_t maxStores) {
+        if (maxThreads == REGISTRY_MAX_THREADS && maxStores == TX_MAX_STORES) return;
+        if (maxThreads > TID_BITS_MAX_THREADS) {
+            std::cout << "ERROR: OneFile supports at most " << TID_BITS_MAX_THREADS << " threads\n";
+            std::abort();
+        }
+        if (ThreadRegistry::anyRegistered()) {
+            std::cout << "ERROR: OneFile can only be configured before the first transaction\n";
+            std::abort();
+        }
+        delete[] opData;
+        delete[] writeSets;
+        munmap(regionAddr, PREGION_SIZE);
+        close(fd);
+        REGISTRY_MAX_THREADS = maxThreads;
+        TX_MAX_STORES = maxStores;
+        // Keep the default ratio of twenty stores per bucket
+        HASH_BUCKETS = std::max<uint64_t>(2048, maxStores/20);
+        gThreadRegistry.resize();
+        opData = new OpData[REGISTRY_MAX_THREADS];
+        writeSets = new WriteSet[REGISTRY_MAX_THREADS];
+        regionAddr = PREGION_ADDR;
+        regionEnd = PREGION_END;
+        mapPersistentRegion(PFILE_NAME, PREGION_SIZE);
+    }
+
     static std::string className() { return "OneFilePTM-LF"; }
 
     void mapPersistentRegion(const char* filename, const uint64_t regionSize) {
         // Check that the header with the logs leaves at least half the memory available to the user
-        if (sizeof(PMetadata) > regionSize/2) {
+        if (PMetadata::size() > regionSize/2) {
             printf("ERROR: the size of the logs in persistent memory is so large that it takes more than half the whole persistent memory\n");
             printf("Please reduce some of the settings in OneFilePTMLF.hpp and try again\n");
             assert(false);
@@ -646,20 +744,24 @@ public:
         }
         // Check if the header is consistent and only then can we attempt to re-use, otherwise we clear everything that's there
         pmd = reinterpret_cast<PMetadata*>(regionAddr);
-        if (reuseRegion) reuseRegion = (pmd->id == PMetadata::MAGIC_ID);
+        if (reuseRegion) reuseRegion = (pmd->id == PMetadata::MAGIC_ID &&
+                                        pmd->numLogs == (uint64_t)REGISTRY_MAX_THREADS &&
+                                        pmd->maxStores == TX_MAX_STORES);
         // Map pieces of persistent Metadata to pointers in volatile memory
-        for (uint64_t i = 0; i < REGISTRY_MAX_THREADS; i++) opData[i].pWriteSet = &(pmd->plog[i]);
+        for (int i = 0; i < REGISTRY_MAX_THREADS; i++) opData[i].pWriteSet = pmd->plog(i);
         curTx = &(pmd->curTx);
         // If the file has just been created or if the header is not consistent, clear everything.
         // Otherwise, re-use and recover to a consistent state.
         if (reuseRegion) {
-            esloco.init(regionAddr+sizeof(PMetadata), regionSize-sizeof(PMetadata), false);
+            esloco.init(regionAddr+PMetadata::size(), regionSize-PMetadata::size(), false);
             //recover(); // Not needed on x86
         } else {
             // Start by resetting all tmtypes::seq in the metadata region
-            std::memset(regionAddr, 0, sizeof(PMetadata));
+            std::memset(regionAddr, 0, PMetadata::size());
             new (regionAddr) PMetadata();
-            esloco.init(regionAddr+sizeof(PMetadata), regionSize-sizeof(PMetadata), true);
+            pmd->numLogs = REGISTRY_MAX_THREADS;
+            pmd->maxStores = TX_MAX_STORES;
+            esloco.init(regionAddr+PMetadata::size(), regionSize-PMetadata::size(), true);
             PFENCE();
             pmd->id = PMetadata::MAGIC_ID;
             PWB(&pmd->id);
@@ -19,6 +19,7 @@
 #include "ConcurrentPrimitives.hpp"
 #include "RMap.hpp"
 #include "OneFile/OneFileLF.hpp"
+#include "OneFile/OneFileConfig.hpp"
 /**
  * <h1> A Resizable Hash Map for usage with STMs </h1>
  * TODO
@@ -44,6 +45,8 @@ private:
 
 public:
     OneFileHashTable(GlobalTestConfig* gtc) : capacity{1000000} {
+        oflf::gOFLF.configure(onefile_max_threads(gtc, oflf::REGISTRY_MAX_THREADS),
+            onefile_max_stores(gtc, oflf::TX_MAX_STORES));
         oflf::updateTx([&] () {
             buckets = (oflf::tmtype<Node*>*)oflf::tmMalloc(capacity*sizeof(oflf::tmtype<Node*>));
         });
@@ -45,6 +45,7 @@
 #include "RMap.hpp"
 #include "RCUTracker.hpp"
 #include "OneFile/OneFileLF.hpp"
+#include "OneFile/OneFileConfig.hpp"
 
 template <class K, class V>
 class OneFileSkipList : public RMap<K,V>{
@@ -128,6 +129,8 @@ private:
 
 public:
     OneFileSkipList(GlobalTestConfig* gtc) : tracker(gtc->task_num, 100, 1000, true){ 
+        oflf::gOFLF.configure(onefile_max_threads(gtc, oflf::REGISTRY_MAX_THREADS),
+            onefile_max_stores(gtc, oflf::TX_MAX_STORES));
         rands = new padded<std::mt19937>[gtc->task_num];
         for(int i=0;i<gtc->task_num;i++){
             rands[i].ui.seed(i);
@@ -19,6 +19,7 @@
 #include "ConcurrentPrimitives.hpp"
 #include "RMap.hpp"
 #include "OneFile/OneFilePTMLF.hpp"
+#include "OneFile/OneFileConfig.hpp"
 /**
  * <h1> A Resizable Hash Map for usage with STMs </h1>
  * TODO
@@ -44,6 +45,8 @@ private:
 
 public:
     POneFileHashTable(GlobalTestConfig* gtc) : capacity{1000000} {
+        poflf::gOFLF.configure(onefile_max_threads(gtc, poflf::REGISTRY_MAX_THREADS),
+            onefile_max_stores(gtc, poflf::TX_MAX_STORES));
         int t = sizeof(poflf::tmtype<uint64_t>);
         poflf::updateTx([&] () {
             buckets = (poflf::tmtype<Node*>*)poflf::tmMalloc(capacity*sizeof(poflf::tmtype<Node*>));
@@ -222,6 +225,9 @@ template <class T>
 class POneFileHashTableFactory : public RideableFactory{
     POneFileHashTable<T,T>* s = nullptr;
     Rideable* build(GlobalTestConfig* gtc){
+        // before tmNew, since configuring re-maps the persistent region
+        poflf::gOFLF.configure(onefile_max_threads(gtc, poflf::REGISTRY_MAX_THREADS),
+            onefile_max_stores(gtc, poflf::TX_MAX_STORES));
         s = poflf::tmNew<POneFileHashTable<T,T>>(gtc);
         return s;
     }
@@ -45,6 +45,7 @@
 #include "RMap.hpp"
 #include "RCUTracker.hpp"
 #include "OneFile/OneFilePTMLF.hpp"
+#include "OneFile/OneFileConfig.hpp"
 
 template <class K, class V>
 class POneFileSkipList : public RMap<K,V>{
@@ -127,6 +128,8 @@ private:
 
 public:
     POneFileSkipList(GlobalTestConfig* gtc) { 
+        poflf::gOFLF.configure(onefile_max_threads(gtc, poflf::REGISTRY_MAX_THREADS),
+            onefile_max_stores(gtc, poflf::TX_MAX_STORES));
         rands = new padded<std::mt19937>[gtc->task_num];
         for(int i=0;i<gtc->task_num;i++){
             rands[i].ui.seed(i);
@@ -292,6 +295,9 @@ template <class T>
 class POneFileSkipListFactory : public RideableFactory{
     POneFileSkipList<T,T>* s = nullptr;
     Rideable* build(GlobalTestConfig* gtc){
+        // before tmNew, since configuring re-maps the persistent region
+        poflf::gOFLF.configure(onefile_max_threads(gtc, poflf::REGISTRY_MAX_THREADS),
+            onefile_max_stores(gtc, poflf::TX_MAX_STORES));
         s = poflf::tmNew<POneFileSkipList<T,T>>(gtc);
         return s;
     }
@@ -12,6 +12,11 @@ class TDSLSkipList : public RMap<K,V>{
     tdsl::SkipList<K,V> sl;
     padded<::tdsl::SkipListTransaction>* _tdsl_txns = nullptr;
     bool _preallocated_tdsl_txns = false;
+    // Under the GV5 clock a transaction aborts on any node stamped since
+    // it began, even with no conflict, so a standalone operation is
+    // retried rather than silently dropped. The other clocks keep the
+    // original single attempt.
+    static constexpr bool retry_standalone = (TDSL_GVC == 5);
 
     void tx_begin(bool is_inside_txn, int tid){
         if(!is_inside_txn) {
@@ -43,7 +48,7 @@ public:
         bool is_inside_txn = _tdsl_txns[tid].ui.is_inside_txn;
 
         uint64_t retry = 0;
-        // while(!succeeded){
+        do{
             try{
                 tx_begin(is_inside_txn, tid);
                 succeeded = true;
@@ -57,7 +62,7 @@ public:
                 succeeded = false;
                 // throw;
             }
-        // }
+        } while(!succeeded && !is_inside_txn && retry_standalone);
         return ret;
     }
     optional<V> put(K key, V val, int tid){
@@ -67,7 +72,7 @@ public:
         bool is_inside_txn = _tdsl_txns[tid].ui.is_inside_txn;
 
         uint64_t retry = 0;
-        // while(!succeeded){
+        do{
             try{
                 tx_begin(is_inside_txn, tid);
                 succeeded = true;
@@ -81,7 +86,7 @@ public:
                 succeeded = false;
                 // throw;
             }
-        // }
+        } while(!succeeded && !is_inside_txn && retry_standalone);
         return ret;
     }
     bool insert(K key, V val, int tid){
@@ -91,7 +96,7 @@ public:
         bool is_inside_txn = _tdsl_txns[tid].ui.is_inside_txn;
 
         uint64_t retry = 0;
-        // while(!succeeded){
+        do{
             try{
                 tx_begin(is_inside_txn, tid);
                 succeeded = true;
@@ -105,7 +110,7 @@ public:
                 succeeded = false;
                 // throw;
             }
-        // }
+        } while(!succeeded && !is_inside_txn && retry_standalone);
         return ret;
     }
     optional<V> remove(K key, int tid){
@@ -115,7 +120,7 @@ public:
         bool is_inside_txn = _tdsl_txns[tid].ui.is_inside_txn;
 
         uint64_t retry = 0;
-        // while(!succeeded){
+        do{
             try{
                 tx_begin(is_inside_txn, tid);
                 succeeded = true;
@@ -129,7 +134,7 @@ public:
                 succeeded = false;
                 // throw;
             }
-        // }
+        } while(!succeeded && !is_inside_txn && retry_standalone);
         return ret;
     }
     optional<V> replace(K key, V val, int tid){
@@ -40,12 +40,12 @@
 
 #include <cassert>
 #include <random>
-#include <shared_mutex>
 
 #include "HarnessUtils.hpp"
 #include "ConcurrentPrimitives.hpp"
 #include "RMap.hpp"
 #include "RCUTracker.hpp"
+#include "StripedLockTable.hpp"
 
 template <class K, class V>
 class TxnBoostingFraserSkipList : public RMap<K,V>, public Recoverable{
@@ -53,7 +53,6 @@ private:
     static constexpr int LEVEL_MASK = 0x0ff;
     static constexpr int READY_FOR_FREE = 0x100;
     static constexpr int NUM_LEVELS = 20;
-    static constexpr int idxSize = 1000000;
     enum KeyType { MIN, REAL, MAX };
     struct Node;
     struct NodePtr {
@@ -95,51 +94,6 @@ private:
         }
         ~Node(){ }
     };
-    struct LockBucket {
-        std::unordered_map<K, std::shared_mutex> table;
-        std::shared_mutex lk;
-
-        bool try_lock(K k){
-            auto& l = lock_prologue(k);
-            lk.unlock_shared();
-            bool ret = l.try_lock();
-            return ret;
-        }
-        bool try_lock_shared(K k){
-            auto& l = lock_prologue(k);
-            lk.unlock_shared();
-            bool ret = l.try_lock_shared();
-            return ret;
-        }
-        void unlock(K k){
-            lk.lock_shared();
-            auto iter = table.find(k);
-            assert (iter != table.end());
-            iter->second.unlock();
-            lk.unlock_shared();
-        }
-        void unlock_shared(K k){
-            lk.lock_shared();
-            auto iter = table.find(k);
-            assert (iter != table.end());
-            iter->second.unlock_shared();
-            lk.unlock_shared();
-        }
-    private:
-        std::shared_mutex& lock_prologue(K k){
-            lk.lock_shared();
-            auto iter = table.find(k);
-            if (iter == table.end()) {
-                lk.unlock_shared();
-                lk.lock();
-                (void)table[k];
-                iter = table.find(k);
-                lk.unlock();
-                lk.lock_shared();
-            }
-            return iter->second;
-        }
-    }__attribute__((aligned(CACHELINE_SIZE)));
 
     int get_level(int tid) {
         size_t r = rands[tid].ui();
@@ -158,12 +112,13 @@ private:
         return (((size_t)(_p)) & 1);
     }
 
-    std::hash<K> hash_fn;
+    FastHash<K> hash_fn;
     NodePtr head;
     // RCUTracker tracker;
     GlobalTestConfig* gtc;
     padded<std::mt19937>* rands;
-    LockBucket* locks=new LockBucket[idxSize]{};
+    // abstract locks on keys
+    StripedLockTable<> locks;
     Node* strong_search_predecessors(const K& key, Node** pa, Node** na);
     Node* weak_search_predecessors(const K& key, Node** pa, Node** na);
     void mark_deleted(Node* x, int level);
@@ -173,9 +128,10 @@ private:
 
 public:
     TxnBoostingFraserSkipList(GlobalTestConfig* gtc) : Recoverable(gtc), 
-        gtc(gtc) {
-        rands = new padded<std::mt19937>[gtc->task_num];
-        for(int i=0;i<gtc->task_num;i++){
+        gtc(gtc), locks(pds::EpochSys::get_max_threads(gtc)) {
+        int thd_num = pds::EpochSys::get_max_threads(gtc);
+        rands = new padded<std::mt19937>[thd_num];
+        for(int i=0;i<thd_num;i++){
             rands[i].ui.seed(i);
         }
         Node* tail = new Node(nullptr, NUM_LEVELS, MAX);
@@ -320,6 +276,18 @@ bool TxnBoostingFraserSkipList<K,V>::do_update(const K& key, V* val, int tid, op
     int        i, level, retval;
     bool result = false;
 
+    if(is_inside_txn() && !is_during_abort()) {
+        size_t idx=locks.stripe_of(hash_fn(key));
+        bool locked = locks.try_lock(idx, tid);
+        if(!locked) {
+            delete(val);
+            _esys->tx_abort();
+        }
+        addToUnlocks([=]()mutable{
+            this->locks.unlock(idx, tid);
+        });
+    }
+
     succ = weak_search_predecessors(key, preds, succs);
 
  retry:
@@ -441,13 +409,13 @@ optional<V> TxnBoostingFraserSkipList<K,V>::get(K key, int tid)
     Node* x;
     V* v = nullptr;
     if(is_inside_txn() && !is_during_abort()) {
-        size_t idx=hash_fn(key)%idxSize;
-        bool locked = locks[idx].try_lock_shared(key);
+        size_t idx=locks.stripe_of(hash_fn(key));
+        bool locked = locks.try_lock_shared(idx, tid);
         if(!locked) {
             _esys->tx_abort();
         }
         addToUnlocks([=]()mutable{
-            this->locks[idx].unlock_shared(key);
+            this->locks.unlock_shared(idx, tid);
         });
     }
 
@@ -470,13 +438,13 @@ optional<V> TxnBoostingFraserSkipList<K,V>::remove(K key, int tid){
     int level, i;
 
     if(is_inside_txn() && !is_during_abort()) {
-        size_t idx=hash_fn(key)%idxSize;
-        bool locked = locks[idx].try_lock(key);
+        size_t idx=locks.stripe_of(hash_fn(key));
+        bool locked = locks.try_lock(idx, tid);
         if(!locked) {
             _esys->tx_abort();
         }
         addToUnlocks([=]()mutable{
-            this->locks[idx].unlock(key);
+            this->locks.unlock(idx, tid);
         });
     }
 
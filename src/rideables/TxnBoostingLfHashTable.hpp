@@ -14,16 +14,17 @@
 #include <functional>
 #include <vector>
 #include <utility>
-#include <shared_mutex>
 
 #include "HarnessUtils.hpp"
 #include "ConcurrentPrimitives.hpp"
 #include "RMap.hpp"
+#include "FastHash.hpp"
+#include "StripedLockTable.hpp"
 // #include "RCUTracker.hpp"
 #include "CustomTypes.hpp"
 #include "Recoverable.hpp"
 
-template <class K, class V, int idxSize=1000000>
+template <class K, class V, int idxSize=1000000, class Hash=FastHash<K>>
 class TxnBoostingLfHashTable : public RMap<K,V>, public Recoverable{
 private:
     struct Node;
@@ -46,55 +47,11 @@ private:
         }
 
     }__attribute__((aligned(CACHELINE_SIZE)));
-    struct LockBucket {
-        std::unordered_map<K, std::shared_mutex> table;
-        std::shared_mutex lk;
-
-        bool try_lock(K k){
-            auto& l = lock_prologue(k);
-            lk.unlock_shared();
-            bool ret = l.try_lock();
-            return ret;
-        }
-        bool try_lock_shared(K k){
-            auto& l = lock_prologue(k);
-            lk.unlock_shared();
-            bool ret = l.try_lock_shared();
-            return ret;
-        }
-        void unlock(K k){
-            lk.lock_shared();
-            auto iter = table.find(k);
-            assert (iter != table.end());
-            iter->second.unlock();
-            lk.unlock_shared();
-        }
-        void unlock_shared(K k){
-            lk.lock_shared();
-            auto iter = table.find(k);
-            assert (iter != table.end());
-            iter->second.unlock_shared();
-            lk.unlock_shared();
-        }
-    private:
-        std::shared_mutex& lock_prologue(K k){
-            lk.lock_shared();
-            auto iter = table.find(k);
-            if (iter == table.end()) {
-                lk.unlock_shared();
-                lk.lock();
-                (void)table[k];
-                iter = table.find(k);
-                lk.unlock();
-                lk.lock_shared();
-            }
-            return iter->second;
-        }
-    }__attribute__((aligned(CACHELINE_SIZE)));
 
-    std::hash<K> hash_fn;
+    Hash hash_fn;
     padded<MarkPtr>* buckets=new padded<MarkPtr>[idxSize]{};
-    LockBucket* locks=new LockBucket[idxSize]{};
+    // abstract locks on keys
+    StripedLockTable<> locks;
     bool findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid);
 
     // RCUTracker tracker;
@@ -116,6 +73,7 @@ private:
 public:
     TxnBoostingLfHashTable(GlobalTestConfig* gtc) : Recoverable(gtc),
         // tracker(gtc->task_num, 100, 1000, true), 
+        locks(pds::EpochSys::get_max_threads(gtc)),
         gtc(gtc) {
     };
     ~TxnBoostingLfHashTable(){};
@@ -148,8 +106,8 @@ class TxnBoostingLfHashTableFactory : public RideableFactory{
 
 
 //-------Definition----------
-template <class K, class V, int idxSize> 
-optional<V> TxnBoostingLfHashTable<K,V,idxSize>::get(K key, int tid) {
+template <class K, class V, int idxSize, class Hash> 
+optional<V> TxnBoostingLfHashTable<K,V,idxSize,Hash>::get(K key, int tid) {
     TX_OP_SEPARATOR();
     optional<V> res={};
     MarkPtr* prev=nullptr;
@@ -157,13 +115,13 @@ optional<V> TxnBoostingLfHashTable<K,V,idxSize>::get(K key, int tid) {
     Node* next;
 
     if(is_inside_txn() && !is_during_abort()) {
-        size_t idx=hash_fn(key)%idxSize;
-        bool locked = locks[idx].try_lock_shared(key);
+        size_t idx=locks.stripe_of(hash_fn(key));
+        bool locked = locks.try_lock_shared(idx, tid);
         if(!locked) {
             _esys->tx_abort();
         }
         addToUnlocks([=]()mutable{
-            this->locks[idx].unlock_shared(key);
+            this->locks.unlock_shared(idx, tid);
         });
     }
 
@@ -180,8 +138,8 @@ optional<V> TxnBoostingLfHashTable<K,V,idxSize>::get(K key, int tid) {
     return res;
 }
 
-template <class K, class V, int idxSize> 
-optional<V> TxnBoostingLfHashTable<K,V,idxSize>::put(K key, V val, int tid) {
+template <class K, class V, int idxSize, class Hash> 
+optional<V> TxnBoostingLfHashTable<K,V,idxSize,Hash>::put(K key, V val, int tid) {
     TX_OP_SEPARATOR();
 
     optional<V> res={};
@@ -192,13 +150,13 @@ optional<V> TxnBoostingLfHashTable<K,V,idxSize>::put(K key, V val, int tid) {
     tmpNode = new Node(key, val, nullptr);
 
     if(is_inside_txn() && !is_during_abort()) {
-        size_t idx=hash_fn(key)%idxSize;
-        bool locked = locks[idx].try_lock(key);
+        size_t idx=locks.stripe_of(hash_fn(key));
+        bool locked = locks.try_lock(idx, tid);
         if(!locked) {
             _esys->tx_abort();
         }
         addToUnlocks([=]()mutable{
-            this->locks[idx].unlock(key);
+            this->locks.unlock(idx, tid);
         });
     }
     // Otherwise, no need to do semantic locking
@@ -250,8 +208,8 @@ optional<V> TxnBoostingLfHashTable<K,V,idxSize>::put(K key, V val, int tid) {
     return res;
 }
 
-template <class K, class V, int idxSize> 
-bool TxnBoostingLfHashTable<K,V,idxSize>::insert(K key, V val, int tid){
+template <class K, class V, int idxSize, class Hash> 
+bool TxnBoostingLfHashTable<K,V,idxSize,Hash>::insert(K key, V val, int tid){
     TX_OP_SEPARATOR();
 
     bool res=false;
@@ -262,13 +220,13 @@ bool TxnBoostingLfHashTable<K,V,idxSize>::insert(K key, V val, int tid){
     tmpNode = new Node(key, val, nullptr);
 
     if(is_inside_txn() && !is_during_abort()) {
-        size_t idx=hash_fn(key)%idxSize;
-        bool locked = locks[idx].try_lock(key);
+        size_t idx=locks.stripe_of(hash_fn(key));
+        bool locked = locks.try_lock(idx, tid);
         if(!locked) {
             _esys->tx_abort();
         }
         addToUnlocks([=]()mutable{
-            this->locks[idx].unlock(key);
+            this->locks.unlock(idx, tid);
         });
     }
     // Otherwise, no need to do semantic locking
@@ -302,8 +260,8 @@ bool TxnBoostingLfHashTable<K,V,idxSize>::insert(K key, V val, int tid){
     return res;
 }
 
-template <class K, class V, int idxSize> 
-optional<V> TxnBoostingLfHashTable<K,V,idxSize>::remove(K key, int tid) {
+template <class K, class V, int idxSize, class Hash> 
+optional<V> TxnBoostingLfHashTable<K,V,idxSize,Hash>::remove(K key, int tid) {
     TX_OP_SEPARATOR();
 
     optional<V> res={};
@@ -312,13 +270,13 @@ optional<V> TxnBoostingLfHashTable<K,V,idxSize>::remove(K key, int tid) {
     Node* next;
 
     if(is_inside_txn() && !is_during_abort()) {
-        size_t idx=hash_fn(key)%idxSize;
-        bool locked = locks[idx].try_lock(key);
+        size_t idx=locks.stripe_of(hash_fn(key));
+        bool locked = locks.try_lock(idx, tid);
         if(!locked) {
             _esys->tx_abort();
         }
         addToUnlocks([=]()mutable{
-            this->locks[idx].unlock(key);
+            this->locks.unlock(idx, tid);
         });
     }
     // Otherwise, no need to do semantic locking
@@ -354,8 +312,8 @@ optional<V> TxnBoostingLfHashTable<K,V,idxSize>::remove(K key, int tid) {
     return res;
 }
 
-template <class K, class V, int idxSize> 
-optional<V> TxnBoostingLfHashTable<K,V,idxSize>::replace(K key, V val, int tid) {
+template <class K, class V, int idxSize, class Hash> 
+optional<V> TxnBoostingLfHashTable<K,V,idxSize,Hash>::replace(K key, V val, int tid) {
     TX_OP_SEPARATOR();
 
     optional<V> res={};
@@ -366,13 +324,13 @@ optional<V> TxnBoostingLfHashTable<K,V,idxSize>::replace(K key, V val, int tid)
     tmpNode = new Node(key, val, nullptr);
 
     if(is_inside_txn() && !is_during_abort()) {
-        size_t idx=hash_fn(key)%idxSize;
-        bool locked = locks[idx].try_lock(key);
+        size_t idx=locks.stripe_of(hash_fn(key));
+        bool locked = locks.try_lock(idx, tid);
         if(!locked) {
             _esys->tx_abort();
         }
         addToUnlocks([=]()mutable{
-            this->locks[idx].unlock(key);
+            this->locks.unlock(idx, tid);
         });
     }
     // Otherwise, no need to do semantic locking
@@ -408,9 +366,9 @@ optional<V> TxnBoostingLfHashTable<K,V,idxSize>::replace(K key, V val, int tid)
     return res;
 }
 
-template <class K, class V, int idxSize> 
-bool TxnBoostingLfHashTable<K,V,idxSize>::findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid){
-    size_t idx=hash_fn(key)%idxSize;
+template <class K, class V, int idxSize, class Hash> 
+bool TxnBoostingLfHashTable<K,V,idxSize,Hash>::findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid){
+    size_t idx=bucket_of<idxSize>(hash_fn(key));
     while(true){
         bool cmark=false;
         prev=&buckets[idx].ui;
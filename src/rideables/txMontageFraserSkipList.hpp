@@ -49,6 +49,7 @@
 #include "HarnessUtils.hpp"
 #include "ConcurrentPrimitives.hpp"
 #include "RMap.hpp"
+#include "SizeClassPool.hpp"
 // #include "RCUTracker.hpp"
 #include "Recoverable.hpp"
 
@@ -85,42 +86,53 @@ private:
         PayloadPtr(Payload *n) : ptr(n){};
         PayloadPtr() : ptr(nullptr){};
     };
-    struct alignas(64) Node{
+    using NodePool = SizeClassPool<Node, NUM_LEVELS>;
+    // A node of level l is allocated from class l-1 of NodePool and
+    // carries only the l-1 tower entries it uses (level 0 is
+    // floor_next).
+    struct Node{
         std::atomic<int> level;
         KeyType key_type; // 0 min, 1 real val, 2 max
-        txMontageFraserSkipList* ds;
         K key;
         PayloadPtr payload;
         // Transient-to-transient pointers
         NodePtr floor_next;
-        std::atomic<Node*> next [NUM_LEVELS-1];
-        Node(txMontageFraserSkipList* _ds, K k, Payload* _payload, Node *_next, int _level, KeyType _key_type) : 
+        std::atomic<Node*> next [0];
+        Node(txMontageFraserSkipList* ds, K k, Payload* _payload, Node *_next, int _level, KeyType _key_type) : 
             level(_level), 
             key_type(_key_type), 
-            ds(_ds),
             key(k), 
             payload(_payload), 
-            floor_next(),
-            next{} 
+            floor_next()
         { 
             floor_next.ptr.store(ds, _next);
             for(int i = 0; i < level-1; i++) 
                 next[i].store(_next);
         }
-        Node(txMontageFraserSkipList* _ds, Node *_next, int _level, KeyType _key_type) : 
+        Node(txMontageFraserSkipList* ds, Node *_next, int _level, KeyType _key_type) : 
             level(_level), 
             key_type(_key_type), 
-            ds(_ds),
             key(), 
             payload(nullptr), 
-            floor_next(),
-            next{} 
+            floor_next()
         {
             floor_next.ptr.store(ds, _next);
             for(int i = 0; i < level-1; i++) 
                 next[i].store(_next);
         }
-        ~Node(){ }
+
+        static size_t size_of(int _level){
+            return sizeof(Node) + (_level-1)*sizeof(std::atomic<Node*>);
+        }
+        static void* operator new(size_t sz, int _level){
+            return NodePool::alloc(_level-1, size_of(_level));
+        }
+        static void operator delete(void* p, int _level){
+            NodePool::free(p);
+        }
+        static void operator delete(void* p){
+            NodePool::free(p);
+        }
     };
 
     int get_level(int tid) {
@@ -154,9 +166,10 @@ public:
     txMontageFraserSkipList(GlobalTestConfig* gtc) : 
         Recoverable(gtc),
         gtc(gtc),
-        head(new Node(this, new Node(this, nullptr, NUM_LEVELS, MAX), NUM_LEVELS, MIN)){ 
-        rands = new padded<std::mt19937>[gtc->task_num];
-        for(int i=0;i<gtc->task_num;i++){
+        head(new (NUM_LEVELS) Node(this, new (NUM_LEVELS) Node(this, nullptr, NUM_LEVELS, MAX), NUM_LEVELS, MIN)){ 
+        int thd_num = pds::EpochSys::get_max_threads(gtc);
+        rands = new padded<std::mt19937>[thd_num];
+        for(int i=0;i<thd_num;i++){
             rands[i].ui.seed(i);
         }
     };
@@ -363,8 +376,10 @@ bool txMontageFraserSkipList<K,V>::do_update(const K& key, Payload* val, int tid
         // goto out;
     } else {
         /* Not in the list, so initialise a new_node node for insertion. */
-        if ( new_node == nullptr )
-            new_node    = tnew<Node>(this, key, val, nullptr, get_level(tid), REAL);
+        if ( new_node == nullptr ) {
+            level = get_level(tid);
+            new_node    = ttrack(new (level) Node(this, key, val, nullptr, level, REAL));
+        }
         level = new_node->level.load();
 
         /* If successors don't change, this saves us some CAS operations. */
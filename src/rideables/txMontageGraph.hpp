@@ -0,0 +1,802 @@
+#ifndef TX_MONTAGE_GRAPH_HPP
+#define TX_MONTAGE_GRAPH_HPP
+
+// This is the persistent counterpart of MedleyGraph. Each vertex and
+// each edge owns one payload: a vertex payload is (vid, -1, 0) and an
+// edge payload is (src, dest, weight), hung off the node in the source
+// vertex's out-set. In-set nodes are transient only and are rebuilt
+// from the edge payloads on recovery. Regrowing an out-set gives every
+// copied node a fresh payload and retires the old one within the same
+// transaction, so no payload is ever shared by two nodes.
+//
+// The number of vertices is taken from env "VertexNum" (default 65536).
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <tuple>
+#include <thread>
+#include <random>
+#include <algorithm>
+
+#include "HarnessUtils.hpp"
+#include "ConcurrentPrimitives.hpp"
+#include "RGraph.hpp"
+#include "FastHash.hpp"
+#include "CustomTypes.hpp"
+#include "Recoverable.hpp"
+
+template <int ADJ_INIT_BUCKETS=4, int ADJ_GROWTH=4>
+class txMontageGraph : public RGraph, public Recoverable{
+public:
+    class Payload : public pds::PBlk{
+        GENERATE_FIELD(int, src, Payload);
+        GENERATE_FIELD(int, dest, Payload);
+        GENERATE_FIELD(int, weight, Payload);
+    public:
+        Payload(){}
+        Payload(int s, int d, int w): m_src(s), m_dest(d), m_weight(w){}
+        Payload(const Payload& oth): pds::PBlk(oth), m_src(oth.m_src), m_dest(oth.m_dest), m_weight(oth.m_weight){}
+        void persist(){}
+    };
+private:
+    struct AdjNode;
+
+    struct MarkPtr{
+        pds::atomic_lin_var<AdjNode*> ptr;
+        MarkPtr(AdjNode* n):ptr(n){};
+        MarkPtr():ptr(nullptr){};
+    };
+
+    struct AdjNode{
+        txMontageGraph* ds;
+        Payload* payload; // edge payload in out-sets, nullptr in in-sets
+        MarkPtr next;
+        int key;
+        AdjNode(txMontageGraph* ds_, int k, Payload* p):
+            ds(ds_),payload(p),next(nullptr),key(k){};
+        ~AdjNode(){
+            if(payload)
+                ds->preclaim(payload);
+        }
+        void retire_payload(){
+            // call it before END_OP but after linearization point
+            if(payload)
+                ds->pretire(payload);
+        }
+    };
+
+    struct AdjTable{
+        int size; // number of buckets; a power of two
+        std::atomic<int> count; // members as of the last commit, approximately
+        MarkPtr* buckets;
+        AdjTable(int n):size(n),count(0){
+            buckets = new MarkPtr[n];
+        };
+        ~AdjTable(){
+            delete[] buckets;
+        }
+        inline bool overloaded(){
+            return count.load(std::memory_order_relaxed) > 2*size;
+        }
+    };
+
+    struct AdjSet{
+        pds::atomic_lin_var<AdjTable*> table;
+        AdjSet(AdjTable* t):table(t){};
+    };
+
+    struct Vertex{
+        txMontageGraph* ds;
+        Payload* payload;
+        int id;
+        AdjSet out;
+        AdjSet in;
+        Vertex(txMontageGraph* ds_, int i):
+            ds(ds_),id(i),out(new AdjTable(ADJ_INIT_BUCKETS)),in(new AdjTable(ADJ_INIT_BUCKETS)){
+            payload = ds->pnew<Payload>(i, -1, 0);
+        };
+        Vertex(txMontageGraph* ds_, Payload* _payload, int outBuckets, int inBuckets):
+            ds(ds_),payload(_payload),id(_payload->get_unsafe_src(ds)),
+            out(new AdjTable(outBuckets)),in(new AdjTable(inBuckets)){} // for recovery
+        ~Vertex(){
+            if(payload)
+                ds->preclaim(payload);
+            delete out.table.load(ds);
+            delete in.table.load(ds);
+        }
+        void retire_payload(){
+            // call it before END_OP but after linearization point
+            assert(payload!=nullptr && "payload shouldn't be null");
+            ds->pretire(payload);
+        }
+    };
+
+    struct VertexPtr{
+        pds::atomic_lin_var<Vertex*> ptr;
+        VertexPtr():ptr(nullptr){};
+    };
+
+    FastHash<int> hash_fn;
+    // An aborted transaction waits a random number of pauses before it
+    // retries, within a window that doubles with each abort in a row,
+    // from 2^BACKOFF_MIN to 2^BACKOFF_MAX. A hub's remove_vertex
+    // conflicts with nearly every concurrent operation; backing off
+    // spreads the others out so that it gets through.
+    static constexpr int BACKOFF_MIN = 4;
+    static constexpr int BACKOFF_MAX = 16;
+    GlobalTestConfig* gtc;
+    int numVertices;
+    VertexPtr* vertices;
+
+    static constexpr uint64_t MARK_MASK = ~0x1;
+    inline AdjNode* getPtr(AdjNode* d){
+        return reinterpret_cast<AdjNode*>((uint64_t)d & MARK_MASK);
+    }
+    inline bool getMark(AdjNode* d){
+        return (bool)((uint64_t)d & 1);
+    }
+    inline AdjNode* setMark(AdjNode* d){
+        return reinterpret_cast<AdjNode*>((uint64_t)d | 1);
+    }
+    inline bool valid(int vid){
+        return vid >= 0 && vid < numVertices;
+    }
+    inline size_t bucket(int key, AdjTable* t){
+        return hash_fn(key) & (t->size - 1);
+    }
+    inline bool overloaded(AdjSet* s){
+        return s->table.load(this)->overloaded();
+    }
+
+    inline void backoff(int aborts){
+        thread_local std::minstd_rand rng(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        int shift = std::min(BACKOFF_MIN + aborts, BACKOFF_MAX);
+        for (uint64_t spins = rng() & ((1ull << shift) - 1); spins > 0; spins--){
+            __builtin_ia32_pause();
+        }
+    }
+
+    // Runs f as one transaction, retrying on abort, unless we are
+    // already inside a transaction, in which case f joins it.
+    template <typename F>
+    bool run_txn(F f){
+        if (is_inside_txn()) return f();
+        for (int aborts = 0; ; aborts++){
+            try{
+                _esys->tx_begin();
+                bool res = f();
+                _esys->tx_end();
+                return res;
+            } catch(const pds::TransactionAborted& e){
+                // aborted and rolled back by EpochSys; back off and retry
+                backoff(aborts);
+            }
+        }
+    }
+
+    Vertex* find_vertex(int vid);
+    Vertex* ensure_vertex(int vid);
+    Vertex* detach_vertex(int vid);
+
+    AdjTable* adj_table(AdjSet* s);
+    bool adj_find(AdjTable* t, MarkPtr* &prev, AdjNode* &curr, AdjNode* &next, int key);
+    bool adj_contains(AdjSet* s, int key);
+    bool adj_insert(AdjSet* s, int key, Payload* edge);
+    bool adj_remove(AdjSet* s, int key);
+    void adj_keys(AdjSet* s, std::vector<int>& keys);
+    bool adj_regrow(AdjSet* s);
+    void adj_retire_table(AdjTable* t);
+    void grow(int vid, bool out);
+    void adj_recover(AdjSet* s, AdjNode* node);
+    void clear_set(AdjSet* s){
+        AdjTable* t = s->table.load(this);
+        for (int b = 0; b < t->size; b++){
+            AdjNode* curr = t->buckets[b].ptr.load(this);
+            while(curr){
+                AdjNode* next = getPtr(curr->next.ptr.load(this));
+                delete curr;
+                curr = next;
+            }
+            t->buckets[b].ptr.store(this, nullptr);
+        }
+        t->count.store(0);
+    }
+
+public:
+    txMontageGraph(GlobalTestConfig* gtc) : Recoverable(gtc), gtc(gtc){
+        numVertices = 65536;
+        if (gtc->checkEnv("VertexNum")){
+            numVertices = stoi(gtc->getEnv("VertexNum"));
+        }
+        vertices = new VertexPtr[numVertices];
+    };
+    ~txMontageGraph(){};
+
+    void init_thread(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+        Recoverable::init_thread(gtc, ltc);
+    }
+    void clear(){
+        //single-threaded; for recovery test only
+        for (int i = 0; i < numVertices; i++){
+            Vertex* v = vertices[i].ptr.load(this);
+            if (v == nullptr) continue;
+            clear_set(&v->out);
+            clear_set(&v->in);
+            delete v;
+            vertices[i].ptr.store(this, nullptr);
+        }
+    }
+    int recover(bool simulated);
+
+    bool add_edge(int src, int dest, int weight);
+    bool add_vertex(int vid);
+    bool has_edge(int v1, int v2);
+    bool remove_edge(int src, int dest);
+    bool remove_vertex(int vid);
+    std::tuple<int, int, double, int*, int> grab_stats();
+};
+
+class txMontageGraphFactory : public RideableFactory{
+    Rideable* build(GlobalTestConfig* gtc){
+        return new txMontageGraph<>(gtc);
+    }
+};
+
+
+//-------Definition----------
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+int txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::recover(bool simulated){
+    if (simulated){
+        recover_mode(); // PDELETE --> noop
+        // clear transient structures.
+        clear();
+        online_mode(); // re-enable PDELETE.
+    }
+
+    int rec_cnt = 0;
+    int rec_thd = gtc->task_num;
+    if (gtc->checkEnv("RecoverThread")){
+        rec_thd = stoi(gtc->getEnv("RecoverThread"));
+    }
+    auto begin = chrono::high_resolution_clock::now();
+    std::unordered_map<uint64_t, pds::PBlk*>* recovered = recover_pblks(rec_thd);
+    auto end = chrono::high_resolution_clock::now();
+    auto dur = end - begin;
+    auto dur_ms = std::chrono::duration_cast<std::chrono::milliseconds>(dur).count();
+    std::cout << "Spent " << dur_ms << "ms getting PBlk(" << recovered->size() << ")" << std::endl;
+    std::vector<Payload*> vertexVector;
+    std::vector<Payload*> edgeVector;
+    std::vector<int> outDegree(numVertices, 0);
+    std::vector<int> inDegree(numVertices, 0);
+    for (auto itr = recovered->begin(); itr != recovered->end(); itr++){
+        rec_cnt++;
+        Payload* p = reinterpret_cast<Payload*>(itr->second);
+        int src = p->get_unsafe_src(this);
+        int dest = p->get_unsafe_dest(this);
+        if (dest < 0){
+            vertexVector.push_back(p);
+        } else if (valid(src) && valid(dest)){
+            edgeVector.push_back(p);
+            outDegree[src]++;
+            inDegree[dest]++;
+        } else {
+            errexit("edge recovered without its vertices.");
+        }
+    }
+    begin = chrono::high_resolution_clock::now();
+    // vertices first, so that every edge finds both of its endpoints;
+    // size each set for its final degree so that hubs don't recover
+    // into a handful of long lists
+    auto buckets_for = [](int n){
+        int size = ADJ_INIT_BUCKETS;
+        while (n > 2*size) size *= ADJ_GROWTH;
+        return size;
+    };
+    for (size_t i = 0; i < vertexVector.size(); i++){
+        int vid = vertexVector[i]->get_unsafe_src(this);
+        if (!valid(vid) || vertices[vid].ptr.load(this) != nullptr){
+            errexit("conflicting vertices recovered.");
+        }
+        Vertex* v = new Vertex(this, vertexVector[i],
+            buckets_for(outDegree[vid]), buckets_for(inDegree[vid]));
+        v->out.table.load(this)->count.store(outDegree[vid]);
+        v->in.table.load(this)->count.store(inDegree[vid]);
+        vertices[vid].ptr.store(this, v);
+    }
+    std::vector<std::thread> workers;
+    for (int rec_tid = 0; rec_tid < rec_thd; rec_tid++) {
+        workers.emplace_back(std::thread([&, rec_tid]() {
+            Recoverable::init_thread(rec_tid);
+            hwloc_set_cpubind(gtc->topology,
+                              gtc->affinities[rec_tid]->cpuset,
+                              HWLOC_CPUBIND_THREAD);
+            for (size_t i = rec_tid; i < edgeVector.size(); i += rec_thd) {
+                // re-insert edge into both endpoints.
+                int src = edgeVector[i]->get_unsafe_src(this);
+                int dest = edgeVector[i]->get_unsafe_dest(this);
+                Vertex* s = vertices[src].ptr.load(this);
+                Vertex* d = vertices[dest].ptr.load(this);
+                if (s == nullptr || d == nullptr){
+                    errexit("edge recovered without its vertices.");
+                }
+                adj_recover(&s->out, new AdjNode(this, dest, edgeVector[i]));
+                adj_recover(&d->in, new AdjNode(this, src, nullptr));
+            }
+        }));
+    }
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    end = chrono::high_resolution_clock::now();
+    dur = end - begin;
+    auto dur_ms_ins = std::chrono::duration_cast<std::chrono::milliseconds>(dur).count();
+    std::cout << "Spent " << dur_ms_ins << "ms inserting(" << recovered->size() << ")" << std::endl;
+    std::cout << "Total time to recover: " << dur_ms+dur_ms_ins << "ms" << std::endl;
+    delete recovered;
+    return rec_cnt;
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::add_edge(int src, int dest, int weight){
+    if (!valid(src) || !valid(dest)) return false;
+    bool standalone = !is_inside_txn();
+    bool grow_out = false;
+    bool grow_in = false;
+    bool res = run_txn([&](){
+        Vertex* s = ensure_vertex(src);
+        Vertex* d = ensure_vertex(dest);
+        if (!adj_insert(&s->out, dest, pnew<Payload>(src, dest, weight))) return false;
+        adj_insert(&d->in, src, nullptr);
+        grow_out = overloaded(&s->out);
+        grow_in = overloaded(&d->in);
+        return true;
+    });
+    if (res && standalone){
+        if (grow_out) grow(src, true);
+        if (grow_in) grow(dest, false);
+    }
+    return res;
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::add_vertex(int vid){
+    if (!valid(vid)) return false;
+    TX_OP_SEPARATOR();
+
+    pds::atomic_lin_var<Vertex*>* slot = &vertices[vid].ptr;
+    Vertex* tmpVertex = tnew<Vertex>(this, vid);
+    while(true){
+        Vertex* v = slot->nbtc_load(this);
+        if (v != nullptr){
+            addToReadSet(slot, v);
+            tdelete(tmpVertex);
+            return false;
+        }
+        if (slot->nbtc_CAS(this, nullptr, tmpVertex, true, true)){
+            return true;
+        }
+    }
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::has_edge(int v1, int v2){
+    if (!valid(v1) || !valid(v2)) return false;
+    return run_txn([&](){
+        Vertex* s = find_vertex(v1);
+        if (s == nullptr) return false;
+        return adj_contains(&s->out, v2);
+    });
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::remove_edge(int src, int dest){
+    if (!valid(src) || !valid(dest)) return false;
+    return run_txn([&](){
+        Vertex* s = find_vertex(src);
+        if (s == nullptr) return false;
+        Vertex* d = find_vertex(dest);
+        if (d == nullptr) return false;
+        if (!adj_remove(&s->out, dest)) return false;
+        adj_remove(&d->in, src);
+        return true;
+    });
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::remove_vertex(int vid){
+    if (!valid(vid)) return false;
+    return run_txn([&](){
+        Vertex* v = detach_vertex(vid);
+        if (v == nullptr) return false;
+
+        // Every writer of v's sets reads v's slot first, so once the slot
+        // is ours nobody can commit a new edge on v; the adjacency we see
+        // now is final.
+        std::vector<int> outs, ins;
+        adj_keys(&v->out, outs);
+        adj_keys(&v->in, ins);
+        for (int w : outs){
+            adj_remove(&v->out, w);
+            if (w == vid){
+                adj_remove(&v->in, vid);
+                continue;
+            }
+            Vertex* wv = find_vertex(w);
+            if (wv != nullptr) adj_remove(&wv->in, vid);
+        }
+        for (int u : ins){
+            if (u == vid) continue; // self loop, dropped above
+            adj_remove(&v->in, u);
+            Vertex* uv = find_vertex(u);
+            if (uv != nullptr) adj_remove(&uv->out, vid);
+        }
+        addToCleanups([=](){
+            this->tretire(v);
+        });
+        return true;
+    });
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+std::tuple<int, int, double, int*, int> txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::grab_stats(){
+    // single-threaded; call only while no operation is in flight
+    int* degrees = new int[numVertices];
+    int numV = 0;
+    int numE = 0;
+    for (int i = 0; i < numVertices; i++){
+        degrees[i] = 0;
+        Vertex* v = vertices[i].ptr.load(this);
+        if (v == nullptr) continue;
+        numV++;
+        AdjTable* t = v->out.table.load(this);
+        for (int b = 0; b < t->size; b++){
+            AdjNode* curr = t->buckets[b].ptr.load(this);
+            while(curr){
+                AdjNode* next = curr->next.ptr.load(this);
+                if (!getMark(next)) degrees[i]++;
+                curr = getPtr(next);
+            }
+        }
+        numE += degrees[i];
+    }
+    double avgDeg = numV == 0 ? 0 : (double)numE / numV;
+    return std::make_tuple(numV, numE, avgDeg, degrees, numVertices);
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+void txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::grow(int vid, bool out){
+    // Growing only speeds up later operations, so give up rather than
+    // fight a busy vertex for long.
+    for (int attempt = 0; attempt < 3; attempt++){
+        try{
+            _esys->tx_begin();
+            Vertex* v = find_vertex(vid);
+            if (v != nullptr) adj_regrow(out ? &v->out : &v->in);
+            _esys->tx_end();
+            return;
+        } catch(const pds::TransactionAborted& e){
+            // aborted and rolled back by EpochSys; back off and retry
+            backoff(attempt);
+        }
+    }
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+typename txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::Vertex* txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::find_vertex(int vid){
+    TX_OP_SEPARATOR();
+    Vertex* v = vertices[vid].ptr.nbtc_load(this);
+    addToReadSet(&vertices[vid].ptr, v);
+    return v;
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+typename txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::Vertex* txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::ensure_vertex(int vid){
+    TX_OP_SEPARATOR();
+    pds::atomic_lin_var<Vertex*>* slot = &vertices[vid].ptr;
+    Vertex* tmpVertex = nullptr;
+    while(true){
+        Vertex* v = slot->nbtc_load(this);
+        if (v != nullptr){
+            addToReadSet(slot, v);
+            if (tmpVertex != nullptr) tdelete(tmpVertex);
+            return v;
+        }
+        if (tmpVertex == nullptr) tmpVertex = tnew<Vertex>(this, vid);
+        if (slot->nbtc_CAS(this, nullptr, tmpVertex, true, true)){
+            return tmpVertex;
+        }
+    }
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+typename txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::Vertex* txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::detach_vertex(int vid){
+    TX_OP_SEPARATOR();
+    pds::atomic_lin_var<Vertex*>* slot = &vertices[vid].ptr;
+    while(true){
+        Vertex* v = slot->nbtc_load(this);
+        if (v == nullptr){
+            addToReadSet(slot, v);
+            return nullptr;
+        }
+        if (!is_inside_txn()) v->retire_payload();
+        if (slot->nbtc_CAS(this, v, nullptr, true, true)){
+            if (is_inside_txn()) v->retire_payload(); // if inside txn, create anti-node only after lin CAS succeeds.
+            return v;
+        }
+    }
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+typename txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::AdjTable* txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_table(AdjSet* s){
+    // the table is read before every lin point on the set, so that a
+    // regrow conflicts with whatever else touches the set
+    AdjTable* t = s->table.nbtc_load(this);
+    addToReadSet(&s->table, t);
+    return t;
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_contains(AdjSet* s, int key){
+    TX_OP_SEPARATOR();
+    MarkPtr* prev=nullptr;
+    AdjNode* curr;
+    AdjNode* next;
+    AdjTable* t = adj_table(s);
+
+    bool res=adj_find(t,prev,curr,next,key);
+    addToReadSet(&(prev->ptr), curr);
+    return res;
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_insert(AdjSet* s, int key, Payload* edge){
+    TX_OP_SEPARATOR();
+
+    bool res=false;
+    MarkPtr* prev=nullptr;
+    AdjNode* curr;
+    AdjNode* next;
+    AdjTable* t = adj_table(s);
+    AdjNode* tmpNode = tnew<AdjNode>(this, key, edge);
+
+    while(true) {
+        if(adj_find(t,prev,curr,next,key)) {
+            addToReadSet(&(prev->ptr), curr);
+            res=false;
+            tdelete(tmpNode);
+            break;
+        }
+        else {
+            //does not exist, insert.
+            tmpNode->next.ptr.store(this,curr);// this don't need undo, so we use regular store
+            if(prev->ptr.nbtc_CAS(this,curr,tmpNode,true,true)) {
+                res=true;
+                break;
+            }
+        }
+    }
+    if (res){
+        auto cleanup = [=](){
+            t->count.fetch_add(1, std::memory_order_relaxed);
+        };
+        if (is_inside_txn()) {
+            addToCleanups(cleanup);
+        } else {
+            cleanup();
+        }
+    }
+    return res;
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_remove(AdjSet* s, int key){
+    TX_OP_SEPARATOR();
+
+    bool res=false;
+    MarkPtr* prev=nullptr;
+    AdjNode* curr;
+    AdjNode* next;
+    AdjTable* t = adj_table(s);
+
+    while(true) {
+        if(!adj_find(t,prev,curr,next,key)) {
+            addToReadSet(&(prev->ptr), curr);
+            res=false;
+            break;
+        }
+        if (!is_inside_txn()) curr->retire_payload();
+        if(!curr->next.ptr.nbtc_CAS(this,next,setMark(next),true,true)) {
+            continue;
+        }
+        res=true;
+        auto cleanup = [=]()mutable{
+            t->count.fetch_sub(1, std::memory_order_relaxed);
+            if(prev->ptr.CAS(this,curr,next)) {
+                this->tretire(curr);
+            } else {
+                this->adj_find(t,prev,curr,next,key);
+            }
+        };
+        if (is_inside_txn()) {
+            curr->retire_payload(); // if inside txn, create anti-node only after lin CAS succeeds.
+            addToCleanups(cleanup);
+        } else {
+            cleanup();//execute cleanup in place
+        }
+        break;
+    }
+    return res;
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+void txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_keys(AdjSet* s, std::vector<int>& keys){
+    TX_OP_SEPARATOR();
+    AdjTable* t = adj_table(s);
+    for (int b = 0; b < t->size; b++){
+        AdjNode* curr = t->buckets[b].ptr.nbtc_load(this);
+        while(curr){
+            AdjNode* next = curr->next.ptr.nbtc_load(this);
+            if (!getMark(next)) keys.push_back(curr->key);
+            curr = getPtr(next);
+        }
+    }
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_regrow(AdjSet* s){
+    TX_OP_SEPARATOR();
+    AdjTable* t = s->table.nbtc_load(this);
+    if (!t->overloaded()){
+        // someone else has regrown it
+        addToReadSet(&s->table, t);
+        return false;
+    }
+    AdjTable* newTable = tnew<AdjTable>(t->size * ADJ_GROWTH);
+    // Swap the table first: from here on, anyone else who reaches the
+    // set conflicts with us, so the members copied below are final.
+    if (!s->table.nbtc_CAS(this, t, newTable, true, true)){
+        tdelete(newTable);
+        return false;
+    }
+    int count = 0;
+    for (int b = 0; b < t->size; b++){
+        AdjNode* curr = t->buckets[b].ptr.nbtc_load(this);
+        while(curr){
+            AdjNode* next = curr->next.ptr.nbtc_load(this);
+            if (!getMark(next)){
+                // newTable is private until we commit; a plain sorted
+                // insert will do. The copy gets its own payload, and the
+                // old one is retired when we commit.
+                Payload* edge = nullptr;
+                if (curr->payload){
+                    edge = pnew<Payload>(curr->payload->get_unsafe_src(this),
+                        curr->payload->get_unsafe_dest(this),
+                        curr->payload->get_unsafe_weight(this));
+                    curr->retire_payload();
+                }
+                AdjNode* tmpNode = tnew<AdjNode>(this, curr->key, edge);
+                MarkPtr* prev = &newTable->buckets[bucket(curr->key, newTable)];
+                AdjNode* succ = prev->ptr.load(this);
+                while(succ && succ->key < curr->key){
+                    prev = &succ->next;
+                    succ = prev->ptr.load(this);
+                }
+                tmpNode->next.ptr.store(this, succ);
+                prev->ptr.store(this, tmpNode);
+                count++;
+            }
+            curr = getPtr(next);
+        }
+    }
+    newTable->count.store(count);
+    addToCleanups([=](){
+        this->adj_retire_table(t);
+    });
+    return true;
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+void txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_retire_table(AdjTable* t){
+    // Runs after the regrow commits. Unlinking a marked node is what
+    // entitles a thread to retire it, so first unlink the marked ones,
+    // racing their removers, then retire every node left in the table.
+    for (int b = 0; b < t->size; b++){
+        MarkPtr* prev = &t->buckets[b];
+        AdjNode* curr = prev->ptr.load(this);
+        while(curr){
+            AdjNode* next = curr->next.ptr.load(this);
+            if (getMark(next)){
+                if (prev->ptr.CAS(this, curr, getPtr(next))){
+                    this->tretire(curr);
+                } else {
+                    // restart this bucket
+                    prev = &t->buckets[b];
+                }
+                curr = prev->ptr.load(this);
+            } else {
+                prev = &curr->next;
+                curr = next;
+            }
+        }
+        curr = t->buckets[b].ptr.load(this);
+        while(curr){
+            AdjNode* next = getPtr(curr->next.ptr.load(this));
+            this->tretire(curr);
+            curr = next;
+        }
+    }
+    this->tretire(t);
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+void txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_recover(AdjSet* s, AdjNode* node){
+    MarkPtr* prev = nullptr;
+    AdjNode* curr;
+    AdjNode* next;
+    AdjTable* t = s->table.load(this);
+    while (true) {
+        if (adj_find(t, prev, curr, next, node->key)) {
+            errexit("conflicting edges recovered.");
+        } else {
+            node->next.ptr.store(this, curr);
+            if (prev->ptr.CAS(this, curr, node)) {
+                break;
+            }
+        }
+    }
+}
+
+template <int ADJ_INIT_BUCKETS, int ADJ_GROWTH>
+bool txMontageGraph<ADJ_INIT_BUCKETS,ADJ_GROWTH>::adj_find(AdjTable* t, MarkPtr* &prev, AdjNode* &curr, AdjNode* &next, int key){
+    size_t idx=bucket(key, t);
+    while(true){
+        bool cmark=false;
+        prev=&t->buckets[idx];
+        curr=prev->ptr.nbtc_load(this);
+
+        while(true){
+            if(getPtr(curr)==nullptr) {
+                curr = getPtr(curr);
+                next = getPtr(next);
+                return false;
+            }
+            next=getPtr(curr)->next.ptr.nbtc_load(this);
+            cmark=getMark(next);
+            auto ckey=getPtr(curr)->key;
+            if(prev->ptr.nbtc_load(this)!=getPtr(curr)) break;//retry
+            if(!cmark) {
+                if(ckey>=key) {
+                    curr = getPtr(curr);
+                    next = getPtr(next);
+                    return ckey==key;
+                }
+                prev=&(getPtr(curr)->next);
+            } else {
+                int res = prev->ptr.nbtc_CAS(
+                    this,
+                    getPtr(curr),
+                    getPtr(next),
+                    false,
+                    false);
+                if(res == 0) {
+                    break;//retry
+                } else {
+                    if (res == 1) // real succeeded CAS
+                        tretire(getPtr(curr));
+                    else // speculative succeeded CAS
+                        txn_tretire(getPtr(curr));
+                }
+            }
+            curr=next;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,328 @@
+#ifndef TX_MONTAGE_LF_HASHSET_P
+#define TX_MONTAGE_LF_HASHSET_P
+
+// This is the set counterpart of txMontageLfHashTable. The payload
+// holds only the key, and the transient node drops the cache-line
+// alignment of the map's node, so a member costs a key-sized PBlk
+// plus a 48-byte node instead of a key/value PBlk plus a 64-byte node.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <thread>
+
+#include "HarnessUtils.hpp"
+#include "ConcurrentPrimitives.hpp"
+#include "RSet.hpp"
+#include "FastHash.hpp"
+#include "CustomTypes.hpp"
+#include "Recoverable.hpp"
+
+template <class K, int idxSize=1000000, class Hash=FastHash<K>>
+class txMontageLfHashSet : public RSet<K>, public Recoverable{
+public:
+    class Payload : public pds::PBlk{
+        GENERATE_FIELD(K, key, Payload);
+    public:
+        Payload(){}
+        Payload(K x): m_key(x){}
+        Payload(const Payload& oth): pds::PBlk(oth), m_key(oth.m_key){}
+        void persist(){}
+    };
+private:
+    struct Node;
+
+    struct MarkPtr{
+        pds::atomic_lin_var<Node*> ptr;
+        MarkPtr(Node* n):ptr(n){};
+        MarkPtr():ptr(nullptr){};
+    };
+
+    struct Node{
+        txMontageLfHashSet* ds;
+        Payload* payload;
+        MarkPtr next;
+        K key;
+        Node(txMontageLfHashSet* ds_, K k, Node* n):
+            ds(ds_),next(n),key(k){
+            payload = ds->pnew<Payload>(k);
+        };
+        Node(txMontageLfHashSet* ds_, Payload* _payload) : ds(ds_), payload(_payload), next(nullptr), key(_payload->get_unsafe_key(ds)) {} // for recovery
+        ~Node(){
+            if(payload)
+                ds->preclaim(payload);
+        }
+        void retire_payload(){
+            // call it before END_OP but after linearization point
+            assert(payload!=nullptr && "payload shouldn't be null");
+            ds->pretire(payload);
+        }
+    };
+    Hash hash_fn;
+    padded<MarkPtr>* buckets=new padded<MarkPtr>[idxSize]{};
+    bool findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid);
+
+    GlobalTestConfig* gtc;
+
+    static constexpr uint64_t MARK_MASK = ~0x1;
+    inline Node* getPtr(Node* d){
+        return reinterpret_cast<Node*>((uint64_t)d & MARK_MASK);
+    }
+    inline bool getMark(Node* d){
+        return (bool)((uint64_t)d & 1);
+    }
+    inline Node* setMark(Node* d){
+        return reinterpret_cast<Node*>((uint64_t)d | 1);
+    }
+public:
+    txMontageLfHashSet(GlobalTestConfig* gtc) : Recoverable(gtc), gtc(gtc){};
+    ~txMontageLfHashSet(){};
+
+    void init_thread(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+        Recoverable::init_thread(gtc, ltc);
+    }
+    void clear(){
+        //single-threaded; for recovery test only
+        for (uint64_t i = 0; i < idxSize; i++){
+            Node* curr = buckets[i].ui.ptr.load(this);
+            Node* next = nullptr;
+            while(curr){
+                next = curr->next.ptr.load(this);
+                delete curr;
+                curr = next;
+            }
+            buckets[i].ui.ptr.store(this,nullptr);
+        }
+    }
+    int recover(bool simulated){
+        if (simulated){
+            recover_mode(); // PDELETE --> noop
+            // clear transient structures.
+            clear();
+            online_mode(); // re-enable PDELETE.
+        }
+
+        int rec_cnt = 0;
+        int rec_thd = gtc->task_num;
+        if (gtc->checkEnv("RecoverThread")){
+            rec_thd = stoi(gtc->getEnv("RecoverThread"));
+        }
+        auto begin = chrono::high_resolution_clock::now();
+        std::unordered_map<uint64_t, pds::PBlk*>* recovered = recover_pblks(rec_thd);
+        auto end = chrono::high_resolution_clock::now();
+        auto dur = end - begin;
+        auto dur_ms = std::chrono::duration_cast<std::chrono::milliseconds>(dur).count();
+        std::cout << "Spent " << dur_ms << "ms getting PBlk(" << recovered->size() << ")" << std::endl;
+        std::vector<Payload*> payloadVector;
+        payloadVector.reserve(recovered->size());
+        for (auto itr = recovered->begin(); itr != recovered->end(); itr++){
+            rec_cnt++;
+            payloadVector.push_back(reinterpret_cast<Payload*>(itr->second));
+        }
+        begin = chrono::high_resolution_clock::now();
+        std::vector<std::thread> workers;
+        for (int rec_tid = 0; rec_tid < rec_thd; rec_tid++) {
+            workers.emplace_back(std::thread([&, rec_tid]() {
+                Recoverable::init_thread(rec_tid);
+                hwloc_set_cpubind(gtc->topology,
+                                  gtc->affinities[rec_tid]->cpuset,
+                                  HWLOC_CPUBIND_THREAD);
+                for (size_t i = rec_tid; i < payloadVector.size(); i += rec_thd) {
+                    // re-insert payload.
+                    Node* tmpNode = new Node(this, payloadVector[i]);
+                    K key = tmpNode->key;
+                    MarkPtr* prev = nullptr;
+                    Node* curr;
+                    Node* next;
+                    while (true) {
+                        if (findNode(prev, curr, next, key, rec_tid)) {
+                            errexit("conflicting keys recovered.");
+                        } else {
+                            tmpNode->next.ptr.store(this, curr);
+                            if (prev->ptr.CAS(this,curr, tmpNode)) {
+                                break;
+                            }
+                        }
+                    }
+                }
+            }));
+        }
+        for (auto& worker : workers) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+        end = chrono::high_resolution_clock::now();
+        dur = end - begin;
+        auto dur_ms_ins = std::chrono::duration_cast<std::chrono::milliseconds>(dur).count();
+        std::cout << "Spent " << dur_ms_ins << "ms inserting(" << recovered->size() << ")" << std::endl;
+        std::cout << "Total time to recover: " << dur_ms+dur_ms_ins << "ms" << std::endl;
+        delete recovered;
+        return rec_cnt;
+    }
+
+    bool get(K key, int tid);
+    bool put(K key, int tid);
+    bool insert(K key, int tid);
+    bool remove(K key, int tid);
+};
+
+template <class T>
+class txMontageLfHashSetFactory : public RideableFactory{
+    Rideable* build(GlobalTestConfig* gtc){
+        return new txMontageLfHashSet<T>(gtc);
+    }
+};
+
+
+//-------Definition----------
+template <class K, int idxSize, class Hash>
+bool txMontageLfHashSet<K,idxSize,Hash>::get(K key, int tid) {
+    TX_OP_SEPARATOR();
+    MarkPtr* prev=nullptr;
+    Node* curr;
+    Node* next;
+
+    bool res=findNode(prev,curr,next,key,tid);
+    addToReadSet(&(prev->ptr), curr);
+    return res;
+}
+
+template <class K, int idxSize, class Hash>
+bool txMontageLfHashSet<K,idxSize,Hash>::put(K key, int tid) {
+    // a key carries nothing to overwrite, so put is insert with the
+    // result flipped
+    return !insert(key, tid);
+}
+
+template <class K, int idxSize, class Hash>
+bool txMontageLfHashSet<K,idxSize,Hash>::insert(K key, int tid){
+    TX_OP_SEPARATOR();
+
+    bool res=false;
+    MarkPtr* prev=nullptr;
+    Node* curr;
+    Node* next;
+    Node* tmpNode = tnew<Node>(this, key, nullptr);
+
+    while(true) {
+        if(findNode(prev,curr,next,key,tid)) {
+            addToReadSet(&(prev->ptr), curr);
+            res=false;
+            tdelete(tmpNode);
+            break;
+        }
+        else {
+            //does not exist, insert.
+            tmpNode->next.ptr.store(this,curr);// this don't need undo, so we use regular store
+            if(prev->ptr.nbtc_CAS(this,curr,tmpNode,true,true)) {
+                res=true;
+                break;
+            }
+        }
+    }
+    return res;
+}
+
+template <class K, int idxSize, class Hash>
+bool txMontageLfHashSet<K,idxSize,Hash>::remove(K key, int tid) {
+    TX_OP_SEPARATOR();
+
+    bool res=false;
+    MarkPtr* prev=nullptr;
+    Node* curr;
+    Node* next;
+
+    while(true) {
+        if(!findNode(prev,curr,next,key,tid)) {
+            addToReadSet(&(prev->ptr), curr);
+            res=false;
+            break;
+        }
+        if (!is_inside_txn()) curr->retire_payload();
+        if(!curr->next.ptr.nbtc_CAS(this,next,setMark(next),true,true)) {
+            continue;
+        }
+        res=true;
+        auto cleanup = [=]()mutable{
+            if(prev->ptr.CAS(this,curr,next)) {
+                this->tretire(curr);
+            } else {
+                this->findNode(prev,curr,next,key,tid);
+            }
+        };
+        if (is_inside_txn()) {
+            curr->retire_payload(); // if inside txn, create anti-node only after lin CAS succeeds.
+            addToCleanups(cleanup);
+        } else {
+            cleanup();//execute cleanup in place
+        }
+        break;
+    }
+    return res;
+}
+
+template <class K, int idxSize, class Hash>
+bool txMontageLfHashSet<K,idxSize,Hash>::findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key, int tid){
+    size_t idx=bucket_of<idxSize>(hash_fn(key));
+    while(true){
+        bool cmark=false;
+        prev=&buckets[idx].ui;
+        curr=prev->ptr.nbtc_load(this);
+
+        while(true){
+            if(getPtr(curr)==nullptr) {
+                curr = getPtr(curr);
+                next = getPtr(next);
+                return false;
+            }
+            next=getPtr(curr)->next.ptr.nbtc_load(this);
+            cmark=getMark(next);
+            auto ckey=getPtr(curr)->key;
+            if(prev->ptr.nbtc_load(this)!=getPtr(curr)) break;//retry
+            if(!cmark) {
+                if(ckey>=key) {
+                    curr = getPtr(curr);
+                    next = getPtr(next);
+                    return ckey==key;
+                }
+                prev=&(getPtr(curr)->next);
+            } else {
+                int res = prev->ptr.nbtc_CAS(
+                    this,
+                    getPtr(curr),
+                    getPtr(next),
+                    false,
+                    false);
+                if(res == 0) {
+                    break;//retry
+                } else {
+                    if (res == 1) // real succeeded CAS
+                        tretire(getPtr(curr));
+                    else // speculative succeeded CAS
+                        txn_tretire(getPtr(curr));
+                }
+            }
+            curr=next;
+        }
+    }
+}
+
+/* Specialization for strings */
+#include <string>
+#include "InPlaceString.hpp"
+template <>
+class txMontageLfHashSet<std::string>::Payload : public pds::PBlk{
+    GENERATE_FIELD(pds::InPlaceString<TESTS_KEY_SIZE>, key, Payload);
+
+public:
+    Payload(std::string k) : m_key(this, k){}
+    Payload(const Payload& oth) : pds::PBlk(oth), m_key(this, oth.m_key){}
+    void persist(){}
+};
+
+#endif
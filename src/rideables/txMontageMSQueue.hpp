@@ -4,6 +4,10 @@
 #include <iostream>
 #include <atomic>
 #include <algorithm>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <unordered_map>
 #include "HarnessUtils.hpp"
 #include "ConcurrentPrimitives.hpp"
 #include "RQueue.hpp"
@@ -35,6 +39,8 @@ private:
         Node(txMontageMSQueue* ds_, T v): ds(ds_), next(nullptr), payload(ds_->pnew<Payload>(v)){
             // assert(ds->epochs[EpochSys::tid].ui == NULL_EPOCH);
         }
+        // for recovery: wrap a recovered payload
+        Node(txMontageMSQueue* ds_, Payload* p): ds(ds_), next(nullptr), payload(p){}
 
         void set_sn(uint64_t s){
             assert(payload!=nullptr && "payload shouldn't be null");
@@ -56,10 +62,11 @@ private:
     // enqueue pushes node to tail
     std::atomic<Node*> tail;
     // RCUTracker tracker;
+    GlobalTestConfig* gtc;
 
 public:
     txMontageMSQueue(GlobalTestConfig* gtc): 
-        Recoverable(gtc), global_sn(0), head(nullptr), tail(nullptr)
+        Recoverable(gtc), global_sn(0), head(nullptr), tail(nullptr), gtc(gtc)
         // , tracker(gtc->task_num, 100, 1000, true)
     {
 
@@ -72,15 +79,140 @@ public:
         Recoverable::init_thread(gtc, ltc);
     }
 
+    // delete all transient nodes and reset to an empty queue.
+    // payloads are untouched if called in recover mode.
+    void clear(){
+        Node* curr = head.load(this);
+        while (curr != nullptr){
+            Node* next = curr->next.load(this);
+            delete curr;
+            curr = next;
+        }
+        Node* dummy = new Node(this);
+        head.store(this,dummy);
+        tail.store(dummy);
+    }
+
     int recover(bool simulated){
-        errexit("recover of txMontageMSQueue not implemented.");
-        return 0;
+        if (simulated){
+            recover_mode(); // PDELETE --> noop
+            // clear transient structures.
+            clear();
+            online_mode(); // re-enable PDELETE.
+        }
+
+        int rec_thd = gtc->task_num;
+        if (gtc->checkEnv("RecoverThread")){
+            rec_thd = stoi(gtc->getEnv("RecoverThread"));
+        }
+        auto begin = chrono::high_resolution_clock::now();
+        std::unordered_map<uint64_t, pds::PBlk*>* recovered = recover_pblks(rec_thd);
+        auto end = chrono::high_resolution_clock::now();
+        auto dur = end - begin;
+        auto dur_ms = std::chrono::duration_cast<std::chrono::milliseconds>(dur).count();
+        std::cout << "Spent " << dur_ms << "ms getting PBlk(" << recovered->size() << ")" << std::endl;
+        std::vector<Payload*> payloadVector;
+        payloadVector.reserve(recovered->size());
+        for (auto itr = recovered->begin(); itr != recovered->end(); itr++){
+            payloadVector.push_back(reinterpret_cast<Payload*>(itr->second));
+        }
+        delete recovered;
+        size_t n = payloadVector.size();
+        if (rec_thd < 1) rec_thd = 1;
+        if ((size_t)rec_thd > n) rec_thd = n > 0 ? n : 1;
+
+        // Surviving payloads are ordered by sn, the order in which they
+        // were enqueued. Each worker sorts a slice, then slices are
+        // merged pairwise, in parallel, until one is left.
+        begin = chrono::high_resolution_clock::now();
+        std::vector<std::pair<uint64_t, Payload*>> order(n);
+        std::vector<size_t> bounds(rec_thd+1);
+        for (int i = 0; i <= rec_thd; i++){
+            bounds[i] = n*i/rec_thd;
+        }
+        std::vector<std::thread> workers;
+        for (int rec_tid = 0; rec_tid < rec_thd; rec_tid++) {
+            workers.emplace_back(std::thread([&, rec_tid]() {
+                Recoverable::init_thread(rec_tid);
+                hwloc_set_cpubind(gtc->topology,
+                                  gtc->affinities[rec_tid]->cpuset,
+                                  HWLOC_CPUBIND_THREAD);
+                for (size_t i = bounds[rec_tid]; i < bounds[rec_tid+1]; i++){
+                    Payload* p = payloadVector[i];
+                    order[i] = std::make_pair(p->get_unsafe_sn(this), p);
+                }
+                std::sort(order.begin()+bounds[rec_tid], order.begin()+bounds[rec_tid+1]);
+            }));
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        for (int width = 1; width < rec_thd; width *= 2){
+            workers.clear();
+            for (int i = 0; i + width < rec_thd; i += 2*width){
+                auto first = order.begin()+bounds[i];
+                auto middle = order.begin()+bounds[i+width];
+                auto last = order.begin()+bounds[std::min(i+2*width, rec_thd)];
+                workers.emplace_back(std::thread([=]() {
+                    std::inplace_merge(first, middle, last);
+                }));
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+        end = chrono::high_resolution_clock::now();
+        dur = end - begin;
+        auto dur_ms_sort = std::chrono::duration_cast<std::chrono::milliseconds>(dur).count();
+        std::cout << "Spent " << dur_ms_sort << "ms sorting(" << n << ")" << std::endl;
+
+        // Nodes are built and linked in place: nobody else sees the
+        // queue until recover returns, so next pointers are set without
+        // CAS, and the slices are stitched together afterwards.
+        begin = chrono::high_resolution_clock::now();
+        std::vector<Node*> nodes(n);
+        workers.clear();
+        for (int rec_tid = 0; rec_tid < rec_thd; rec_tid++) {
+            workers.emplace_back(std::thread([&, rec_tid]() {
+                hwloc_set_cpubind(gtc->topology,
+                                  gtc->affinities[rec_tid]->cpuset,
+                                  HWLOC_CPUBIND_THREAD);
+                Node* prev = nullptr;
+                for (size_t i = bounds[rec_tid]; i < bounds[rec_tid+1]; i++){
+                    Node* new_node = new Node(this, order[i].second);
+                    if (prev != nullptr){
+                        prev->next.var.store(pds::lin_var(reinterpret_cast<uint64_t>(new_node)), std::memory_order_relaxed);
+                    }
+                    nodes[i] = prev = new_node;
+                }
+            }));
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        Node* dummy = head.load(this);
+        Node* last = dummy;
+        for (int i = 0; i < rec_thd; i++){
+            if (bounds[i] == bounds[i+1]) continue;
+            last->next.var.store(pds::lin_var(reinterpret_cast<uint64_t>(nodes[bounds[i]])), std::memory_order_relaxed);
+            last = nodes[bounds[i+1]-1];
+        }
+        tail.store(last);
+        global_sn.store(n > 0 ? order[n-1].first+1 : 0);
+        end = chrono::high_resolution_clock::now();
+        dur = end - begin;
+        auto dur_ms_ins = std::chrono::duration_cast<std::chrono::milliseconds>(dur).count();
+        std::cout << "Spent " << dur_ms_ins << "ms linking(" << n << ")" << std::endl;
+        std::cout << "Total time to recover: " << dur_ms+dur_ms_sort+dur_ms_ins << "ms" << std::endl;
+        return n;
     }
 
     ~txMontageMSQueue(){};
 
     void enqueue(T val, int tid);
     optional<T> dequeue(int tid);
+    void enqueue_batch(const T* vals, size_t n, int tid);
+    size_t dequeue_batch(T* vals, size_t n, int tid);
 };
 
 template<typename T>
@@ -182,6 +314,147 @@ optional<T> txMontageMSQueue<T>::dequeue(int tid){
     return res;
 }
 
+template<typename T>
+void txMontageMSQueue<T>::enqueue_batch(const T* vals, size_t n, int tid){
+    if (n == 0) return;
+    TX_OP_SEPARATOR();
+
+    // link the batch privately; a single nbtc_CAS publishes all of
+    // it, so a transaction gets one write set entry per batch.
+    // Payloads are still allocated one per node, not as one PBlkArray:
+    // they are dequeued and retired one by one, and Montage can only
+    // retire a whole PBlk, so recovery would bring back the values of
+    // an array that were dequeued before its last one.
+    Node* first = tnew<Node>(this,vals[0]);
+    Node* last = first;
+    for (size_t i = 1; i < n; i++){
+        Node* new_node = tnew<Node>(this,vals[i]);
+        // private until published: no CAS, undo or read set needed
+        last->next.var.store(pds::lin_var(reinterpret_cast<uint64_t>(new_node)), std::memory_order_relaxed);
+        last = new_node;
+    }
+    Node* cur_tail = nullptr;
+    while(true){
+        cur_tail = tail.load();
+        bool is_speculative = false;
+        Node* next = cur_tail->next.nbtc_load(this, is_speculative);
+        if(cur_tail == tail.load()){
+            if(next == nullptr) {
+                // take the n sns only for an attempt to publish. Taking
+                // them after loading cur_tail still makes them larger
+                // than cur_tail's.
+                uint64_t s = global_sn.fetch_add(n);
+                // set sn in place before publishing, as in enqueue
+                Node* curr = first;
+                for (size_t i = 0; i < n; i++){
+                    curr->set_sn(s+i);
+                    curr = curr->next.load(this);
+                }
+                if((cur_tail->next).nbtc_CAS(this, next, first, true, true)){
+                    break;
+                }
+            } else {
+                // help swing only if `next` isn't speculative
+                if(!is_speculative)
+                    tail.compare_exchange_strong(cur_tail, next); // try to swing tail to next node
+            }
+        }
+    }
+    auto cleanup = [=]()mutable{
+        this->tail.compare_exchange_strong(cur_tail, last); // try to swing tail to the end of the batch
+    };
+    if (is_inside_txn()) {
+        addToCleanups(cleanup);
+    } else {
+        cleanup();//execute cleanup in place
+    }
+}
+
+template<typename T>
+size_t txMontageMSQueue<T>::dequeue_batch(T* vals, size_t n, int tid){
+    if (n == 0) return 0;
+    TX_OP_SEPARATOR();
+
+    size_t k = 0;
+    while(true){
+        Node* cur_head = head.nbtc_load(this);
+        // walk up to n nodes past the dummy; the last one becomes the
+        // new dummy, so a single nbtc_CAS on head takes all of them
+        Node* last = cur_head;
+        bool ran_out = false;
+        k = 0;
+        while(k < n){
+            bool is_speculative = false;
+            Node* next = last->next.nbtc_load(this, is_speculative);
+            if(next == nullptr){
+                ran_out = true;
+                break;
+            }
+            if(tail.load() == last){
+                // tail is falling behind; it mustn't be left behind
+                // head, and can't be swung to a speculative node
+                if(is_speculative) break;
+                Node* cur_tail = last;
+                tail.compare_exchange_strong(cur_tail, next);
+            }
+            last = next;
+            k++;
+        }
+        if(cur_head != head.nbtc_load(this)){
+            continue;
+        }
+        if(k == 0){
+            if(ran_out){
+                // queue is empty
+                addToReadSet(&(cur_head->next),(Node*)nullptr);
+                break;
+            }
+            continue;
+        }
+        // last becomes the dummy once we succeed; as soon as it is
+        // dequeued past, its payload field is overwritten, so read it now
+        Payload* last_payload = last->payload;
+        if (!is_inside_txn()){
+            // semantically we are tentatively removing the batch from queue
+            Node* curr = cur_head;
+            for (size_t i = 0; i < k; i++){
+                curr = curr->next.nbtc_load(this);
+                pretire(curr->payload);
+            }
+        }
+        if(head.nbtc_CAS(this, cur_head, last, true, true)){
+            Node* curr = cur_head;
+            for (size_t i = 0; i < k; i++){
+                curr = curr->next.nbtc_load(this);
+                Payload* payload = (curr == last) ? last_payload : curr->payload;
+                vals[i] = (T)payload->get_unsafe_val(this);// old see new is impossible
+                if (is_inside_txn()) pretire(payload);
+            }
+            if(ran_out){
+                // fewer than n only because the queue ran empty
+                addToReadSet(&(last->next),(Node*)nullptr);
+            }
+            auto cleanup = [=]()mutable{
+                Node* prev = cur_head;
+                while(prev != last){
+                    Node* curr = prev->next.load(this);
+                    // let payload have same lifetime as dummy node
+                    prev->payload = (curr == last) ? last_payload : curr->payload;
+                    this->tretire(prev);
+                    prev = curr;
+                }
+            };
+            if (is_inside_txn()){
+                addToCleanups(cleanup);
+            } else {
+                cleanup();//execute cleanup in place
+            }
+            break;
+        }
+    }
+    return k;
+}
+
 template <class T> 
 class txMontageMSQueueFactory : public RideableFactory{
     Rideable* build(GlobalTestConfig* gtc){
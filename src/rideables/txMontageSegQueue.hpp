@@ -0,0 +1,360 @@
+#ifndef MONTAGE_SEG_QUEUE
+#define MONTAGE_SEG_QUEUE
+
+// Transactional, persistent segment-based queue.
+//
+// The queue is an unbounded array of cells, allocated in segments of
+// SEG_SIZE cells linked in index order (LCRQ/LPRQ style). An enqueuer
+// takes an index with fetch-and-add on tail_ticket, raises tail_idx
+// past it, and publishes its node by claiming that cell; a dequeuer
+// walks forward from head_idx and claims the first cell holding a node.
+// Both claims are nbtc_CAS on the cell, and are the NBTC publication
+// points. A dequeuer that runs into a cell whose enqueuer hasn't
+// published yet closes it, and the enqueuer retries with a fresh index.
+//
+// Dequeuers don't take indices with fetch-and-add: a transaction that
+// claims a cell may still abort, and the node must then stay visible at
+// its place in the queue.
+//
+// A payload's sn is the index of its cell, so recovery puts surviving
+// payloads back in sn order, right below the largest sn, and later
+// enqueues keep counting from there.
+
+#include <iostream>
+#include <atomic>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+#include <unordered_map>
+#include "HarnessUtils.hpp"
+#include "ConcurrentPrimitives.hpp"
+#include "RQueue.hpp"
+#include "CustomTypes.hpp"
+#include "Recoverable.hpp"
+
+template<typename T, int SEG_SIZE=1024>
+class txMontageSegQueue : public RQueue<T>, public Recoverable{
+public:
+    class Payload : public pds::PBlk{
+        GENERATE_FIELD(T, val, Payload);
+        GENERATE_FIELD(uint64_t, sn, Payload);
+    public:
+        Payload(): pds::PBlk(){}
+        Payload(T v): pds::PBlk(), m_val(v), m_sn(0){}
+        Payload(const Payload& oth): pds::PBlk(oth), m_sn(0), m_val(oth.m_val){}
+        void persist(){}
+    };
+
+private:
+    struct Node{
+        txMontageSegQueue* ds;
+        Payload* payload;
+
+        Node(txMontageSegQueue* ds_, T v): ds(ds_), payload(ds_->pnew<Payload>(v)){}
+        // for recovery: wrap a recovered payload
+        Node(txMontageSegQueue* ds_, Payload* p): ds(ds_), payload(p){}
+        ~Node(){
+            if (payload){
+                ds->preclaim(payload);
+            }
+        }
+    };
+
+    // besides a Node*, a cell is EMPTY (initial), TAKEN (dequeued) or
+    // CLOSED (overtaken by a dequeuer before its enqueuer published)
+    static constexpr uint64_t TAKEN = 0x1;
+    static constexpr uint64_t CLOSED = 0x2;
+    static Node* empty_cell(){ return nullptr; }
+    static Node* taken_cell(){ return reinterpret_cast<Node*>(TAKEN); }
+    static Node* closed_cell(){ return reinterpret_cast<Node*>(CLOSED); }
+    static bool is_node(Node* n){ return reinterpret_cast<uint64_t>(n) > CLOSED; }
+
+    // times a dequeuer rereads an EMPTY cell before closing it
+    static constexpr int PATIENCE = 64;
+
+    struct Segment{
+        const uint64_t id;
+        std::atomic<Segment*> next;
+        pds::atomic_lin_var<Node*> cells[SEG_SIZE];
+        Segment(uint64_t i): id(i), next(nullptr){}
+    };
+
+    // next index to hand out to an enqueuer
+    alignas(CACHELINE_SIZE) std::atomic<uint64_t> tail_ticket;
+    // one past the highest index an enqueuer may publish at. Enqueuers
+    // raise it before claiming their cell, so an empty dequeue inside a
+    // transaction can put it in its read set and fail validation once
+    // an enqueue at or past what it saw becomes visible.
+    alignas(CACHELINE_SIZE) pds::atomic_lin_var<uint64_t> tail_idx;
+    // every cell below head_idx is TAKEN or CLOSED for good
+    alignas(CACHELINE_SIZE) std::atomic<uint64_t> head_idx;
+    // hints to start segment walks from; neither is past the segment
+    // of its index, and tail_seg is never behind head_seg
+    alignas(CACHELINE_SIZE) std::atomic<Segment*> head_seg;
+    alignas(CACHELINE_SIZE) std::atomic<Segment*> tail_seg;
+    GlobalTestConfig* gtc;
+
+    // take index i and make tail_idx cover it
+    uint64_t take_tail(){
+        uint64_t i = tail_ticket.fetch_add(1);
+        uint64_t t = tail_idx.load(this);
+        while (t <= i && !tail_idx.CAS(this, t, i+1)){
+            t = tail_idx.load(this);
+        }
+        return i;
+    }
+    uint64_t load_tail(){
+        return tail_idx.nbtc_load(this);
+    }
+
+    // walk from s to the segment holding idx, appending segments as needed
+    Segment* find_segment(Segment* s, uint64_t idx){
+        uint64_t id = idx / SEG_SIZE;
+        assert(s->id <= id);
+        while (s->id < id){
+            Segment* next = s->next.load();
+            if (next == nullptr){
+                Segment* fresh = new Segment(s->id+1);
+                if (s->next.compare_exchange_strong(next, fresh)){
+                    next = fresh;
+                } else {
+                    delete fresh;
+                }
+            }
+            s = next;
+        }
+        return s;
+    }
+    void advance_tail_seg(Segment* s){
+        Segment* cur = tail_seg.load();
+        while (cur->id < s->id && !tail_seg.compare_exchange_weak(cur, s)){}
+    }
+    // called once cell i is TAKEN or CLOSED for good
+    void advance_head(uint64_t i){
+        uint64_t h = i;
+        if (head_idx.compare_exchange_strong(h, i+1) && (i+1) % SEG_SIZE == 0){
+            retire_segments(i+1);
+        }
+    }
+    // unlink and retire the segments wholly below head index h
+    void retire_segments(uint64_t h){
+        Segment* s = head_seg.load();
+        while (s->id < h / SEG_SIZE){
+            Segment* next = find_segment(s, (s->id+1)*SEG_SIZE);
+            if (head_seg.compare_exchange_strong(s, next)){
+                advance_tail_seg(next);
+                this->tretire(s);
+                s = next;
+            }
+        }
+    }
+    // payloads are untouched if called in recover mode.
+    void free_segments(){
+        Segment* s = head_seg.load();
+        while (s != nullptr){
+            for (int k = 0; k < SEG_SIZE; k++){
+                Node* n = s->cells[k].var.load().template get_val<Node*>();
+                if (is_node(n)) delete n;
+            }
+            Segment* next = s->next.load();
+            delete s;
+            s = next;
+        }
+    }
+
+public:
+    txMontageSegQueue(GlobalTestConfig* gtc):
+        Recoverable(gtc), tail_ticket(0), tail_idx(0), head_idx(0), gtc(gtc){
+        Segment* s = new Segment(0);
+        head_seg.store(s);
+        tail_seg.store(s);
+    }
+    ~txMontageSegQueue(){
+        free_segments();
+    }
+
+    void init_thread(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+        Recoverable::init_thread(gtc, ltc);
+    }
+    // delete all transient nodes and segments and reset to an empty
+    // queue.
+    void clear(){
+        free_segments();
+        Segment* s = new Segment(0);
+        head_seg.store(s);
+        tail_seg.store(s);
+        head_idx.store(0);
+        tail_ticket.store(0);
+        tail_idx.var.store(pds::lin_var(0));
+    }
+
+    int recover(bool simulated){
+        if (simulated){
+            recover_mode(); // PDELETE --> noop
+            // clear transient structures.
+            clear();
+            online_mode(); // re-enable PDELETE.
+        }
+
+        int rec_thd = gtc->task_num;
+        if (gtc->checkEnv("RecoverThread")){
+            rec_thd = stoi(gtc->getEnv("RecoverThread"));
+        }
+        auto begin = chrono::high_resolution_clock::now();
+        std::unordered_map<uint64_t, pds::PBlk*>* recovered = recover_pblks(rec_thd);
+        auto end = chrono::high_resolution_clock::now();
+        auto dur = end - begin;
+        auto dur_ms = std::chrono::duration_cast<std::chrono::milliseconds>(dur).count();
+        std::cout << "Spent " << dur_ms << "ms getting PBlk(" << recovered->size() << ")" << std::endl;
+
+        begin = chrono::high_resolution_clock::now();
+        std::vector<std::pair<uint64_t, Payload*>> order;
+        order.reserve(recovered->size());
+        for (auto itr = recovered->begin(); itr != recovered->end(); itr++){
+            Payload* p = reinterpret_cast<Payload*>(itr->second);
+            order.push_back(std::make_pair(p->get_unsafe_sn(this), p));
+        }
+        delete recovered;
+        std::sort(order.begin(), order.end());
+
+        // survivors keep their sn, so new enqueues must get larger ones:
+        // refill the cells just below the largest sn and go on from
+        // there, rather than from index 0. Cells are filled without CAS,
+        // as nobody else sees the queue until recover returns.
+        size_t n = order.size();
+        uint64_t end_idx = n == 0 ? 0 : std::max<uint64_t>(order.back().first + 1, n);
+        uint64_t base = end_idx - n;
+        Segment* s = head_seg.load();
+        if (s->id != base / SEG_SIZE){
+            // the queue is empty here, so start it at base's segment
+            delete s;
+            s = new Segment(base / SEG_SIZE);
+            head_seg.store(s);
+        }
+        for (size_t i = 0; i < n; i++){
+            s = find_segment(s, base + i);
+            Node* new_node = new Node(this, order[i].second);
+            s->cells[(base + i) % SEG_SIZE].var.store(pds::lin_var(reinterpret_cast<uint64_t>(new_node)), std::memory_order_relaxed);
+        }
+        tail_seg.store(s);
+        head_idx.store(base);
+        tail_ticket.store(end_idx);
+        tail_idx.var.store(pds::lin_var(end_idx));
+        end = chrono::high_resolution_clock::now();
+        dur = end - begin;
+        auto dur_ms_ins = std::chrono::duration_cast<std::chrono::milliseconds>(dur).count();
+        std::cout << "Spent " << dur_ms_ins << "ms rebuilding(" << n << ")" << std::endl;
+        std::cout << "Total time to recover: " << dur_ms+dur_ms_ins << "ms" << std::endl;
+        return n;
+    }
+
+    void enqueue(T val, int tid);
+    optional<T> dequeue(int tid);
+
+    // only for testing: take an index like an enqueuer that stalls
+    // before publishing at it
+    uint64_t stall_enqueue(){
+        return take_tail();
+    }
+};
+
+template<typename T, int SEG_SIZE>
+void txMontageSegQueue<T,SEG_SIZE>::enqueue(T v, int tid){
+    TX_OP_SEPARATOR();
+
+    Node* new_node = tnew<Node>(this,v);
+    while(true){
+        // read the hint before taking an index, so that it can't be
+        // past the index's segment
+        Segment* seg = tail_seg.load();
+        uint64_t i = take_tail();
+        seg = find_segment(seg, i);
+        advance_tail_seg(seg);
+        // set sn in place before the claim, as in txMontageMSQueue
+        new_node->payload->set_unsafe_sn(this, i);
+        if(seg->cells[i % SEG_SIZE].nbtc_CAS(this, empty_cell(), new_node, true, true)){
+            break;
+        }
+        // a dequeuer closed our cell; take another index
+    }
+}
+
+template<typename T, int SEG_SIZE>
+optional<T> txMontageSegQueue<T,SEG_SIZE>::dequeue(int tid){
+    TX_OP_SEPARATOR();
+
+    optional<T> res = {};
+    // read the hint before the index, as in enqueue
+    Segment* seg = head_seg.load();
+    uint64_t i = head_idx.load();
+    int patience = PATIENCE;
+    while(true){
+        uint64_t t = load_tail();
+        if (i >= t){
+            // queue is empty: every cell below t is TAKEN or CLOSED,
+            // and any later enqueue changes tail_idx
+            addToReadSet(&tail_idx, t);
+            res.reset();
+            break;
+        }
+        seg = find_segment(seg, i);
+        pds::atomic_lin_var<Node*>& cell = seg->cells[i % SEG_SIZE];
+        bool is_speculative = false;
+        Node* n = cell.nbtc_load(this, is_speculative);
+        if (n == empty_cell()){
+            // the enqueuer of cell i hasn't published yet; wait a
+            // little, then close the cell so it retries further on
+            if (patience-- > 0) continue;
+            cell.CAS(this, empty_cell(), closed_cell());
+            continue;
+        }
+        if (!is_node(n)){
+            // our own speculative claim may still be undone, so it
+            // mustn't let head_idx pass
+            if (!is_speculative) advance_head(i);
+            i++;
+            patience = PATIENCE;
+            continue;
+        }
+        Payload* payload = n->payload;
+        if (!is_inside_txn()) pretire(payload); // semantically we are tentatively removing n from queue
+        if(cell.nbtc_CAS(this, n, taken_cell(), true, true)){
+            res = (T)payload->get_unsafe_val(this);// old see new is impossible
+            auto cleanup = [=]()mutable{
+                this->advance_head(i);
+                this->tretire(n); // preclaims payload
+            };
+            if (is_inside_txn()){
+                pretire(payload);
+                addToCleanups(cleanup);
+            } else {
+                cleanup();//execute cleanup in place
+            }
+            break;
+        }
+    }
+    return res;
+}
+
+template <class T>
+class txMontageSegQueueFactory : public RideableFactory{
+    Rideable* build(GlobalTestConfig* gtc){
+        return new txMontageSegQueue<T>(gtc);
+    }
+};
+
+/* Specialization for strings */
+#include <string>
+#include "InPlaceString.hpp"
+template <>
+class txMontageSegQueue<std::string>::Payload : public pds::PBlk{
+    GENERATE_FIELD(pds::InPlaceString<TESTS_VAL_SIZE>, val, Payload);
+    GENERATE_FIELD(uint64_t, sn, Payload);
+
+public:
+    Payload(std::string v) : m_val(this, v), m_sn(0){}
+    Payload(const Payload& oth) : pds::PBlk(oth), m_val(this, oth.m_val), m_sn(oth.m_sn){}
+    void persist(){}
+};
+
+#endif
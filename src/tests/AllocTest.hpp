@@ -1,7 +1,26 @@
 #ifndef ALLOC_TEST_HPP
 #define ALLOC_TEST_HPP
 
-// Simple allocation test for JEMalloc vs 
+// Allocation tests for JEMalloc vs Ralloc vs Montage pnew.
+//
+// Workloads, ported from ext/ralloc/test/benchmark:
+//  loop:    each thread allocates a fixed number of 64B objects, then
+//           frees them all. Runs to completion, not for -i seconds.
+//  larson:  (larson.cpp) each thread keeps batch live blocks of random
+//           size in [min_sz, max_sz] and repeatedly replaces a random one.
+//           Threads live for the whole run instead of being respawned.
+//  prodcon: (prod-con.cpp) each thread allocates batches of min_sz blocks
+//           and hands them to the next thread, which frees them, so every
+//           free is a cross-thread free. Threads form a ring rather than
+//           producer/consumer pairs so any thread count works.
+//  sweep:   (threadtest.cpp, sh6bench.cpp) each thread cycles through
+//           sizes from min_sz to max_sz, about four per doubling,
+//           allocating and freeing batch blocks of each.
+// Each reported op is one allocation (and its free). -dbatch, -dminsz
+// and -dmaxsz override the constructor arguments.
+//
+// Montage has no untyped allocation, so its requests are served by pnew
+// of a PBlk whose payload is the size rounded up to a power of two.
 
 #include <cstdint>
 #include <chrono>
@@ -9,6 +28,9 @@
 #include <unistd.h>
 #include <vector>
 #include <cmath>
+#include <atomic>
+#include <random>
+#include <utility>
 #include <ralloc.hpp>
 #include "Recoverable.hpp"
 
@@ -19,25 +41,104 @@ enum AllocTestType {
     DO_MONTAGE_ALLOC
 };
 
+enum AllocTestWorkload {
+    ALLOC_LOOP,
+    ALLOC_LARSON,
+    ALLOC_PRODCON,
+    ALLOC_SWEEP
+};
+
 class DummyObject : public pds::PBlk {
     uint8_t data[64];
     void persist();
 };
 
+template <int LG>
+class SizedDummyObject : public pds::PBlk {
+    uint8_t data[1 << LG];
+    void persist();
+};
+
 struct MontageDummy : public Recoverable {
+    // payload sizes of SizedDummyObject, 16B to 16KB
+    static constexpr int MIN_LG = 4;
+    static constexpr int MAX_LG = 14;
+    typedef pds::PBlk* (MontageDummy::*create_func)();
+    typedef void (MontageDummy::*destroy_func)(pds::PBlk*);
+    create_func creators[MAX_LG - MIN_LG + 1];
+    destroy_func destroyers[MAX_LG - MIN_LG + 1];
+
+    template <size_t... I>
+    void fill_funcs(std::index_sequence<I...>) {
+        ((creators[I] = &MontageDummy::create<MIN_LG + I>), ...);
+        ((destroyers[I] = &MontageDummy::destroy<MIN_LG + I>), ...);
+    }
+
     int recover(bool simulated) { return 0; }
-    MontageDummy(GlobalTestConfig *gtc) : Recoverable(gtc) {}
+    MontageDummy(GlobalTestConfig *gtc) : Recoverable(gtc) {
+        fill_funcs(std::make_index_sequence<MAX_LG - MIN_LG + 1>());
+    }
     ~MontageDummy() {}
 
-    DummyObject *create() { 
+    DummyObject *create() {
         MontageOpHolder op(this);
         auto ret = pnew<DummyObject>();
-        return ret;    
+        return ret;
+    }
+
+    void destroy(DummyObject *obj) {
+        MontageOpHolder op(this);
+        pdelete(obj);
+    }
+
+    template <int LG>
+    pds::PBlk *create() {
+        MontageOpHolder op(this);
+        return pnew<SizedDummyObject<LG>>();
+    }
+
+    template <int LG>
+    void destroy(pds::PBlk *obj) {
+        MontageOpHolder op(this);
+        pdelete((SizedDummyObject<LG>*)obj);
+    }
+
+    static int size_idx(size_t sz) {
+        int lg = MIN_LG;
+        while (lg < MAX_LG && ((size_t)1 << lg) < sz) lg++;
+        return lg - MIN_LG;
+    }
+
+    pds::PBlk *create_sized(size_t sz) {
+        return (this->*creators[size_idx(sz)])();
     }
 
-    void destroy(DummyObject *obj) { 
-        MontageOpHolder op(this);    
-        pdelete(obj); 
+    void destroy_sized(pds::PBlk *obj, size_t sz) {
+        (this->*destroyers[size_idx(sz)])(obj);
+    }
+};
+
+// single producer single consumer ring that passes blocks to the
+// thread freeing them in prodcon
+struct AllocRing {
+    static constexpr size_t CAP = 1024;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    void* buf[CAP];
+
+    bool push(void* p) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == CAP) return false;
+        buf[t % CAP] = p;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    void* pop() {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return nullptr;
+        void* p = buf[h % CAP];
+        head.store(h + 1, std::memory_order_release);
+        return p;
     }
 };
 
@@ -48,26 +149,176 @@ class AllocTest : public Test {
         uint64_t total_ops;
         uint64_t *thd_ops;
         enum AllocTestType allocType;
+        enum AllocTestWorkload workload;
+        // larson: live blocks per thread; prodcon and sweep: blocks per batch
+        int batch;
+        size_t min_sz, max_sz;
+
+        std::vector<size_t> sweep_sizes;
+        // larson: live blocks and their sizes, one vector per thread
+        padded<std::vector<std::pair<void*, size_t>>> *live;
+        AllocRing *rings;
+        pthread_barrier_t barrier;
 
-        AllocTest(uint64_t ops, enum AllocTestType allocType) : total_ops(ops), allocType(allocType) {}
+        AllocTest(uint64_t ops, enum AllocTestType allocType) :
+            total_ops(ops), allocType(allocType), workload(ALLOC_LOOP),
+            batch(0), min_sz(sizeof(DummyObject)), max_sz(sizeof(DummyObject)) {}
+        AllocTest(enum AllocTestType allocType, enum AllocTestWorkload workload,
+            int batch, size_t min_sz, size_t max_sz) :
+            total_ops(0), allocType(allocType), workload(workload),
+            batch(batch), min_sz(min_sz), max_sz(max_sz) {}
 
         void init(GlobalTestConfig *gtc) {
-            uint64_t new_ops = total_ops / gtc->task_num;
-            thd_ops = new uint64_t[gtc->task_num];
-            for (int i = 0; i<gtc->task_num; i++) {
-                thd_ops[i] = new_ops;
+            if (gtc->checkEnv("batch")) {
+                batch = atoi((gtc->getEnv("batch")).c_str());
             }
-            if (new_ops * gtc->task_num != total_ops) {
-                thd_ops[0] += (total_ops - new_ops * gtc->task_num);
+            if (gtc->checkEnv("minsz")) {
+                min_sz = atoi((gtc->getEnv("minsz")).c_str());
             }
+            if (gtc->checkEnv("maxsz")) {
+                max_sz = atoi((gtc->getEnv("maxsz")).c_str());
+            }
+            if (min_sz == 0 || max_sz < min_sz) {
+                errexit("AllocTest: need 0 < minsz <= maxsz.");
+            }
+            if (workload != ALLOC_LOOP && batch <= 0) {
+                errexit("AllocTest: batch must be positive.");
+            }
+
             dummy = new MontageDummy(gtc);
-	
-            if (allocType == DO_RALLOC_ALLOC) Persistent::init();	    
-            /* set interval to inf so this won't be killed by timeout */
-            gtc->interval = numeric_limits<double>::max();
+            if (allocType == DO_RALLOC_ALLOC) Persistent::init();
+
+            switch (workload) {
+                case ALLOC_LOOP: {
+                    uint64_t new_ops = total_ops / gtc->task_num;
+                    thd_ops = new uint64_t[gtc->task_num];
+                    for (int i = 0; i<gtc->task_num; i++) {
+                        thd_ops[i] = new_ops;
+                    }
+                    if (new_ops * gtc->task_num != total_ops) {
+                        thd_ops[0] += (total_ops - new_ops * gtc->task_num);
+                    }
+                    /* set interval to inf so this won't be killed by timeout */
+                    gtc->interval = numeric_limits<double>::max();
+                    break;
+                }
+                case ALLOC_LARSON: {
+                    live = new padded<std::vector<std::pair<void*, size_t>>>[gtc->task_num];
+                    break;
+                }
+                case ALLOC_PRODCON: {
+                    rings = new AllocRing[gtc->task_num];
+                    pthread_barrier_init(&barrier, NULL, gtc->task_num);
+                    break;
+                }
+                case ALLOC_SWEEP: {
+                    for (size_t sz = min_sz; sz <= max_sz; ) {
+                        sweep_sizes.push_back(sz);
+                        size_t step = std::max<size_t>(sz / 4, 8);
+                        sz = (sz + step) & ~(size_t)7;
+                    }
+                    break;
+                }
+            }
+            if (gtc->verbose) {
+                printf("AllocTest batch:%d size:%zu-%zu\n", batch, min_sz, max_sz);
+            }
+        }
+
+        void parInit(GlobalTestConfig *gtc, LocalTestConfig *ltc) {
+            Persistent::init_thread(ltc->tid);
+            if (allocType == DO_MONTAGE_ALLOC) {
+                dummy->init_thread(gtc, ltc);
+            }
+            if (workload == ALLOC_LARSON) {
+                std::mt19937_64 gen(ltc->seed);
+                auto& blks = live[ltc->tid].ui;
+                blks.resize(batch);
+                for (auto& b : blks) {
+                    b.second = rand_size(gen);
+                    b.first = alloc_obj(b.second);
+                }
+            }
         }
 
         int execute(GlobalTestConfig *gtc, LocalTestConfig *ltc) {
+            switch (workload) {
+                case ALLOC_LOOP: return loop(gtc, ltc);
+                case ALLOC_LARSON: return larson(gtc, ltc);
+                case ALLOC_PRODCON: return prodcon(gtc, ltc);
+                case ALLOC_SWEEP: return sweep(gtc, ltc);
+            }
+            return 0;
+        }
+
+        void cleanup(GlobalTestConfig *gtc) {
+            // jemalloc reports zeros so that all modes share one CSV header
+            std::vector<TCacheStats> stats;
+            if (allocType == DO_RALLOC_ALLOC) {
+                stats = RP_get_stats();
+            } else if (allocType == DO_MONTAGE_ALLOC) {
+                stats = dummy->_esys->get_ralloc()->get_stats();
+            }
+            TCacheStats total;
+            for (auto& s : stats) total += s;
+            gtc->recorder->reportGlobalInfo("ralloc_allocs", (unsigned long)total.alloc_num);
+            gtc->recorder->reportGlobalInfo("ralloc_frees", (unsigned long)total.free_num);
+            gtc->recorder->reportGlobalInfo("ralloc_fills", (unsigned long)total.fill_num);
+            gtc->recorder->reportGlobalInfo("ralloc_flushes", (unsigned long)total.flush_num);
+            gtc->recorder->reportGlobalInfo("ralloc_cas_retries", (unsigned long)total.cas_retry_num);
+            gtc->recorder->reportGlobalInfo("ralloc_sb_in_use", (long)(total.sb_get_num - total.sb_put_num));
+            if (gtc->verbose) {
+                if (allocType == DO_RALLOC_ALLOC) {
+                    _holder.ralloc_instance->print_stats();
+                } else if (allocType == DO_MONTAGE_ALLOC) {
+                    dummy->_esys->get_ralloc()->print_stats();
+                }
+            }
+            // stops the epoch advancer before gtc goes away
+            delete dummy;
+        }
+
+    private:
+        size_t rand_size(std::mt19937_64& gen) {
+            return min_sz + gen() % (max_sz - min_sz + 1);
+        }
+
+        void* alloc_obj(size_t sz) {
+            switch (allocType) {
+                case DO_JEMALLOC_ALLOC: {
+                    char* ret = (char*)malloc(sz);
+                    ret[sz - 1] = 1;
+                    return ret;
+                }
+                case DO_RALLOC_ALLOC: {
+                    char* ret = (char*)RP_malloc(sz);
+                    ret[sz - 1] = 1;
+                    return ret;
+                }
+                case DO_MONTAGE_ALLOC: {
+                    return dummy->create_sized(sz);
+                }
+            }
+            return nullptr;
+        }
+
+        void free_obj(void* obj, size_t sz) {
+            switch (allocType) {
+                case DO_JEMALLOC_ALLOC: {
+                    free(obj);
+                    break;
+                }
+                case DO_RALLOC_ALLOC: {
+                    RP_free_sized(obj, sz);
+                    break;
+                }
+                case DO_MONTAGE_ALLOC: {
+                    dummy->destroy_sized((pds::PBlk*)obj, sz);
+                }
+            }
+        }
+
+        int loop(GlobalTestConfig *gtc, LocalTestConfig *ltc) {
             int tid = ltc->tid;
             std::vector<DummyObject*> objs;
             for (size_t i = 0; i < thd_ops[tid]; i++) {
@@ -93,7 +344,7 @@ class AllocTest : public Test {
                         break;
                     }
                     case DO_RALLOC_ALLOC: {
-                        RP_free(obj);
+                        RP_free_sized(obj, sizeof(DummyObject));
                         break;
                     }
                     case DO_MONTAGE_ALLOC: {
@@ -104,11 +355,76 @@ class AllocTest : public Test {
             return thd_ops[ltc->tid];
         }
 
-        void cleanup(GlobalTestConfig *gtc) {
+        int larson(GlobalTestConfig *gtc, LocalTestConfig *ltc) {
+            auto time_up = gtc->finish;
+            std::mt19937_64 gen(ltc->seed + 1);
+            auto& blks = live[ltc->tid].ui;
+            int ops = 0;
+            while (std::chrono::high_resolution_clock::now() < time_up) {
+                for (int i = 0; i < 64; i++) {
+                    auto& b = blks[gen() % blks.size()];
+                    free_obj(b.first, b.second);
+                    b.second = rand_size(gen);
+                    b.first = alloc_obj(b.second);
+                }
+                ops += 64;
+                gtc->reportProgress(ltc->tid, ops);
+            }
+            for (auto& b : blks) {
+                free_obj(b.first, b.second);
+            }
+            blks.clear();
+            return ops;
         }
 
-        void parInit(GlobalTestConfig *gtc, LocalTestConfig *ltc) {
-             Persistent::init_thread(ltc->tid);
-	}
+        // free every block queued for this thread
+        void drain(AllocRing& ring) {
+            void* obj;
+            while ((obj = ring.pop()) != nullptr) {
+                free_obj(obj, min_sz);
+            }
+        }
+
+        int prodcon(GlobalTestConfig *gtc, LocalTestConfig *ltc) {
+            auto time_up = gtc->finish;
+            AllocRing& in = rings[ltc->tid];
+            AllocRing& out = rings[(ltc->tid + 1) % gtc->task_num];
+            int ops = 0;
+            while (std::chrono::high_resolution_clock::now() < time_up) {
+                for (int i = 0; i < batch; i++) {
+                    void* obj = alloc_obj(min_sz);
+                    while (!out.push(obj)) {
+                        drain(in);
+                    }
+                }
+                drain(in);
+                ops += batch;
+                gtc->reportProgress(ltc->tid, ops);
+            }
+            // wait for the last pushes into our ring
+            pthread_barrier_wait(&barrier);
+            drain(in);
+            return ops;
+        }
+
+        int sweep(GlobalTestConfig *gtc, LocalTestConfig *ltc) {
+            auto time_up = gtc->finish;
+            std::vector<void*> objs(batch);
+            size_t idx = ltc->tid % sweep_sizes.size();
+            int ops = 0;
+            while (std::chrono::high_resolution_clock::now() < time_up) {
+                size_t sz = sweep_sizes[idx];
+                for (auto& obj : objs) {
+                    obj = alloc_obj(sz);
+                }
+                for (auto obj : objs) {
+                    free_obj(obj, sz);
+                }
+                ops += batch;
+                gtc->reportProgress(ltc->tid, ops);
+                idx = (idx + 1) % sweep_sizes.size();
+            }
+            return ops;
+        }
 };
 #endif
@@ -2,6 +2,7 @@
 #define CHURNTEST_HPP
 
 #include "TestConfig.hpp"
+#include "OpenLoop.hpp"
 #include "AllocatorMacro.hpp"
 #include "Persistent.hpp"
 
@@ -143,6 +144,9 @@ int ChurnTest::execute(GlobalTestConfig* gtc, LocalTestConfig* ltc){
 	auto now = std::chrono::high_resolution_clock::now();
 
 	while(std::chrono::duration_cast<std::chrono::microseconds>(time_up - now).count()>0){
+		if(ltc->open_loop && !ltc->open_loop->arrive()){
+			break;
+		}
 
 		r = abs((long)gen_k()%range);
 		// r = abs(rand_nums[(k_idx++)%1000]%range);
@@ -152,6 +156,10 @@ int ChurnTest::execute(GlobalTestConfig* gtc, LocalTestConfig* ltc){
 		operation(r, p, tid);
 		
 		ops++;
+		if(ltc->open_loop){
+			ltc->open_loop->complete();
+		}
+		gtc->reportProgress(tid, ops);
 		if (ops % 512 == 0){
 			now = std::chrono::high_resolution_clock::now();
 		}
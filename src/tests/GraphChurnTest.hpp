@@ -0,0 +1,161 @@
+#ifndef GRAPHCHURNTEST_HPP
+#define GRAPHCHURNTEST_HPP
+
+/*
+ * This is a test with a time length for graphs.
+ * Edge endpoints are drawn from a power-law (Zipf) distribution over
+ * vertex ids, so a few low ids become hubs and most vertices have small
+ * degree; vertices to remove are drawn uniformly. The exponent is taken
+ * from env "alpha" (default 1.0), and the number of vertices from
+ * "range", which is also handed to the graph as "VertexNum".
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "ChurnTest.hpp"
+#include "TestConfig.hpp"
+#include "RGraph.hpp"
+
+class GraphChurnTest : public ChurnTest{
+public:
+	RGraph* g;
+	double alpha = 1.0;
+	std::vector<double> cdf;
+
+	// proportions map onto ChurnTest's gets/puts/inserts/removes
+	GraphChurnTest(int p_has_edge, int p_add_edge, int p_remove_edge, int p_remove_vertex, int range, int prefill):
+		ChurnTest(p_has_edge, p_add_edge, p_remove_edge, p_remove_vertex, range, prefill){}
+
+	void init(GlobalTestConfig* gtc){
+		if(gtc->checkEnv("range")){
+			range = atoi((gtc->getEnv("range")).c_str());
+		}
+		if(!gtc->checkEnv("VertexNum")){
+			gtc->setEnv("VertexNum", std::to_string(range));
+		}
+		if(gtc->checkEnv("alpha")){
+			alpha = atof((gtc->getEnv("alpha")).c_str());
+		}
+		// cumulative Zipf weights of vertex ids [0, range)
+		cdf.resize(range);
+		double sum = 0;
+		for(int i = 0; i < range; i++){
+			sum += 1.0 / pow(i + 1, alpha);
+			cdf[i] = sum;
+		}
+		for(int i = 0; i < range; i++){
+			cdf[i] /= sum;
+		}
+		ChurnTest::init(gtc);
+	}
+
+	inline int sampleVertex(std::mt19937_64& gen){
+		double u = (double)(gen() >> 11) * (1.0 / 9007199254740992.0);
+		int v = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+		return std::min(v, range - 1);
+	}
+
+	virtual void parInit(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+		g->init_thread(gtc, ltc);
+		ChurnTest::parInit(gtc, ltc);
+	}
+
+	void allocRideable(GlobalTestConfig* gtc){
+		Rideable* ptr = gtc->allocRideable();
+		g = dynamic_cast<RGraph*>(ptr);
+		if (!g) {
+			 errexit("GraphChurnTest must be run on RGraph type object.");
+		}
+	}
+	Rideable* getRideable(){
+		return g;
+	}
+	void doPrefill(GlobalTestConfig* gtc){
+		// prefill deterministically with power-law edges; duplicates
+		// are redrawn, but give up after a bounded number of tries in
+		// case prefill is close to what the distribution can produce.
+		if (this->prefill > 0){
+			std::mt19937_64 gen(0);
+			int i = 0;
+			long tries = 0;
+			while(i<this->prefill && tries<10L*this->prefill){
+				int src = sampleVertex(gen);
+				int dest = sampleVertex(gen);
+				if(g->add_edge(src, dest, 1)){
+					i++;
+				}
+				tries++;
+			}
+			if(gtc->verbose){
+				printf("Prefilled %d\n",i);
+			}
+			Recoverable* rec=dynamic_cast<Recoverable*>(g);
+			if(rec){
+				rec->sync();
+			}
+		}
+	}
+	int execute(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+		auto time_up = gtc->finish;
+
+		int ops = 0;
+		uint64_t r = ltc->seed;
+		std::mt19937_64 gen_k(r);
+		std::mt19937_64 gen_p(r+1);
+
+		int tid = ltc->tid;
+
+		auto now = std::chrono::high_resolution_clock::now();
+
+		while(std::chrono::duration_cast<std::chrono::microseconds>(time_up - now).count()>0){
+			int p = abs((long)gen_p()%100);
+			uint64_t key;
+			if(p<this->prop_removes && p>=this->prop_inserts){
+				key = abs((long)gen_k()%range);
+			} else {
+				// pack both endpoints into the key
+				key = ((uint64_t)sampleVertex(gen_k) << 32) | (uint64_t)sampleVertex(gen_k);
+			}
+
+			operation(key, p, tid);
+
+			ops++;
+			gtc->reportProgress(tid, ops);
+			if (ops % 512 == 0){
+				now = std::chrono::high_resolution_clock::now();
+			}
+		}
+		return ops;
+	}
+	void operation(uint64_t key, int op, int tid){
+		int src = (int)(key >> 32);
+		int dest = (int)(key & 0xffffffff);
+
+		if(op<this->prop_gets){
+			g->has_edge(src, dest);
+		}
+		else if(op<this->prop_puts){
+			g->add_edge(src, dest, 1);
+		}
+		else if(op<this->prop_inserts){
+			g->remove_edge(src, dest);
+		}
+		else{ // op<=prop_removes
+			g->remove_vertex(dest);
+		}
+	}
+	void cleanup(GlobalTestConfig* gtc){
+		ChurnTest::cleanup(gtc);
+		if(gtc->verbose){
+			auto stats = g->grab_stats();
+			printf("|V|=%d |E|=%d avg degree=%f\n",
+				std::get<0>(stats), std::get<1>(stats), std::get<2>(stats));
+			delete[] std::get<3>(stats);
+		}
+		delete g;
+	}
+
+};
+
+#endif // GRAPHCHURNTEST_HPP
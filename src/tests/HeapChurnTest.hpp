@@ -1,9 +1,10 @@
-// This test is obsolete
-#if 0 
-
 #ifndef HEAPCHURNTEST_HPP
 #define HEAPCHURNTEST_HPP
 
+/*
+ * This is a test with a time length for priority queues.
+ */
+
 #include "AllocatorMacro.hpp"
 #include "Persistent.hpp"
 #include "TestConfig.hpp"
@@ -34,12 +35,12 @@ public:
     void init(GlobalTestConfig* gtc){
 
         getRideable(gtc);
-        
+
         if(gtc->verbose){
             printf("Enqueues:%d Dequeues:%d\n",
             prop_enqs,100-prop_enqs);
         }
-        
+
         // overrides for constructor arguments
         if(gtc->checkEnv("range")){
             range = atoi((gtc->getEnv("range")).c_str());
@@ -49,12 +50,12 @@ public:
         }
 
         doPrefill(gtc);
-        
+
     }
 
     int execute(GlobalTestConfig* gtc, LocalTestConfig* ltc){
         auto time_up = gtc->finish;
-        
+
         int ops = 0;
         uint64_t r = ltc->seed;
         std::mt19937_64 gen_v(r);
@@ -72,10 +73,11 @@ public:
             // r = abs(rand_nums[(k_idx++)%1000]%range);
             int p = abs((long)gen_p()%100);
             // int p = abs(rand_nums[(p_idx++)%1000]%100);
-            
+
             operation(r, p, tid);
-            
+
             ops++;
+            gtc->reportProgress(tid, ops);
             if (ops % 500 == 0){
                 now = std::chrono::high_resolution_clock::now();
             }
@@ -86,27 +88,33 @@ public:
     }
 
     void cleanup(GlobalTestConfig* gtc){
-        delete g;
+        delete q;
     }
     void getRideable(GlobalTestConfig* gtc){
         Rideable* ptr = gtc->allocRideable();
         q = dynamic_cast<HeapQueue<V,V>*>(ptr);
         if(!q){
             errexit("HeapChurnTest must be run on HeapQueue<V,V> type object.");
-        } 
+        }
     }
     void doPrefill(GlobalTestConfig* gtc){
         if(this->prefill > 0){
-            int stride = this->range/this->prefill;
+            // priorities are drawn from the same distribution as in
+            // the test, so the prefilled keys may repeat
+            std::mt19937_64 gen_v(0);
             int i = 0;
-            for(i = 0; i < this->prefill; i += stride){
-                V k = this->fromInt(i);
-                V v = this->fromInt(i);
-                q->enqueue(k, v, 0);
+            while(i<this->prefill){
+                V k = this->fromInt(gen_v()%range);
+                q->enqueue(k, k, 0);
+                i++;
             }
             if(gtc->verbose){
                 printf("Prefilled %d\n", i);
             }
+            Recoverable* rec=dynamic_cast<Recoverable*>(q);
+            if(rec){
+                rec->sync();
+            }
         }
     }
 
@@ -133,5 +141,3 @@ inline std::string HeapChurnTest<std::string>::fromInt(uint64_t v){
 }
 
 #endif
-
-#endif // 0
\ No newline at end of file
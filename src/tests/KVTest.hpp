@@ -86,6 +86,7 @@ public:
         for (size_t i = 0; i < traces[tid]->size(); i++) {
             operation(traces[tid]->at(i), tid);
             ops++;
+            gtc->reportProgress(tid, ops);
         }
         return ops;
     }
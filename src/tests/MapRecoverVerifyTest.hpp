@@ -0,0 +1,154 @@
+#ifndef MAPRECOVERVERIFYTEST_HPP
+#define MAPRECOVERVERIFYTEST_HPP
+
+/*
+ * This is a test to verify that EpochSys recovery leaves a mapping
+ * usable: every recovered key maps to its last value, and the recovered
+ * payloads can be updated and removed afterwards. With more than one
+ * crash round, the recovered map is changed, crashed and recovered
+ * again, so the second recovery starts from a heap that was itself
+ * recovered.
+ */
+
+#include <unordered_map>
+#include "TestConfig.hpp"
+#include "AllocatorMacro.hpp"
+#include "Persistent.hpp"
+#include "Recoverable.hpp"
+#include "RMap.hpp"
+
+template <class K, class V>
+class MapRecoverVerifyTest : public Test{
+public:
+    RMap<K,V>* m;
+    Recoverable* rec;
+    size_t ins_cnt = 100000;
+    size_t range = ins_cnt*10;
+    // times to change the map, crash and recover before draining it
+    int crash_rounds;
+    MapRecoverVerifyTest(int crash_rounds_=1): crash_rounds(crash_rounds_){}
+    void init(GlobalTestConfig* gtc);
+    void parInit(GlobalTestConfig* gtc, LocalTestConfig* ltc);
+    int execute(GlobalTestConfig* gtc, LocalTestConfig* ltc);
+    void cleanup(GlobalTestConfig* gtc);
+};
+
+template <class K, class V>
+void MapRecoverVerifyTest<K,V>::parInit(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+    m->init_thread(gtc, ltc);
+}
+
+template <class K, class V>
+void MapRecoverVerifyTest<K,V>::init(GlobalTestConfig* gtc){
+
+    Rideable* ptr = gtc->allocRideable();
+    m = dynamic_cast<RMap<K,V>*>(ptr);
+    if (!m) {
+        errexit("MapRecoverVerifyTest must be run on RMap<K,V> type object.");
+    }
+    rec = dynamic_cast<Recoverable*>(ptr);
+    if (!rec){
+        errexit("MapRecoverVerifyTest must be run on Recoverable type object.");
+    }
+    if (gtc->checkEnv("InsCnt")){
+        ins_cnt = stoll(gtc->getEnv("InsCnt"));
+        range = ins_cnt * 10;
+    }
+
+    /* set interval to inf so this won't be killed by timeout */
+    gtc->interval = numeric_limits<double>::max();
+}
+
+template <class K, class V>
+int MapRecoverVerifyTest<K,V>::execute(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+    int tid = ltc->tid;
+    // Only thread 0 drives the map, so that it can be checked against a
+    // reference. The other workers only set how many threads recovery
+    // may use, and give their slots back meanwhile.
+    if (tid != 0){
+        rec->_esys->unregister_thread();
+        return 0;
+    }
+    std::unordered_map<K,V> reference;
+    size_t ops = 0;
+    std::mt19937_64 gen_k(ltc->seed);
+    std::mt19937_64 gen_p(ltc->seed+1);
+    for (int round = 1; round <= crash_rounds; round++){
+        auto begin = chrono::high_resolution_clock::now();
+        // 2:1:1 inserts to puts to removes; keys are drawn from a range
+        // ten times the target size, so the map keeps growing
+        while(reference.size() < ins_cnt*round){
+            K k = (K)(gen_k()%range);
+            V v = (V)ops;
+            int p = abs((long)gen_p()%4);
+            if (p < 2){
+                bool ret1 = m->insert(k, v, tid);
+                bool ret2 = reference.try_emplace(k, v).second;
+                if (ret1 != ret2){
+                    std::cout<<"insert of key:"<<k<<" returned "<<ret1<<", expecting "<<ret2<<"."<<std::endl;
+                    exit(1);
+                }
+            } else {
+                auto itr = reference.find(k);
+                optional<V> ret1 = (p == 2) ? m->put(k, v, tid) : m->remove(k, tid);
+                if (ret1.has_value() != (itr != reference.end()) ||
+                    (ret1.has_value() && ret1.value() != itr->second)){
+                    std::cout<<(p == 2 ? "put" : "remove")<<" of key:"<<k<<" returned a wrong old value."<<std::endl;
+                    exit(1);
+                }
+                if (p == 2){
+                    reference[k] = v;
+                } else if (itr != reference.end()){
+                    reference.erase(itr);
+                }
+            }
+            ops++;
+        }
+        auto end = chrono::high_resolution_clock::now();
+        auto dur = end - begin;
+        auto dur_ms = std::chrono::duration_cast<std::chrono::milliseconds>(dur).count();
+
+        std::cout<<"update finished. Spent "<< dur_ms << "ms" <<std::endl;
+        rec->flush();
+        std::cout<<"epochsys flushed."<<std::endl;
+        rec->simulate_crash();
+        std::cout<<"crashed."<<std::endl;
+        int rec_cnt = rec->recover(true);
+        std::cout<<"recover returned."<<std::endl;
+        if (rec_cnt == (int)reference.size()){
+            std::cout<<"rec_cnt currect."<<std::endl;
+        } else {
+            std::cout<<"recovered:"<<rec_cnt<<" expecting:"<<reference.size()<<std::endl;
+            exit(1);
+        }
+        for (auto itr = reference.begin(); itr != reference.end(); itr++){
+            auto ret = m->get(itr->first, tid);
+            if (!ret.has_value() || ret.value() != itr->second){
+                std::cout<<"key:"<<itr->first<<" not recovered with its last value."<<std::endl;
+                exit(1);
+            }
+        }
+    }
+
+    // the recovered payloads must stay usable
+    for (auto itr = reference.begin(); itr != reference.end(); itr++){
+        auto ret = m->remove(itr->first, tid);
+        if (!ret.has_value() || ret.value() != itr->second){
+            std::cout<<"key:"<<itr->first<<" could not be removed after recovery."<<std::endl;
+            exit(1);
+        }
+        if (m->get(itr->first, tid).has_value()){
+            std::cout<<"key:"<<itr->first<<" still present after its removal."<<std::endl;
+            exit(1);
+        }
+    }
+    std::cout<<"all records recovered."<<std::endl;
+    return ops;
+}
+
+template <class K, class V>
+void MapRecoverVerifyTest<K,V>::cleanup(GlobalTestConfig* gtc){
+    delete m;
+}
+
+#endif
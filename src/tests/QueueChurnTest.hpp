@@ -9,6 +9,7 @@
 #include "Persistent.hpp"
 #include "TestConfig.hpp"
 #include "RQueue.hpp"
+#include <vector>
 
 class QueueChurnTest : public Test{
 #ifdef PRONTO
@@ -54,6 +55,10 @@ public:
     int prefill = 2000;
     size_t val_size = TESTS_VAL_SIZE;
     std::string value_buffer; // for string kv only
+    // >1: every operation moves this many values with
+    // enqueue_batch/dequeue_batch
+    size_t batch_size = 1;
+    std::vector<V> batch_buffer;
     RQueue<V>* q;
 
     QueueChurnTest(int p_enqs, int p_deqs, int prefill){
@@ -101,6 +106,12 @@ public:
         }
         value_buffer += '\0';
 
+        if(gtc->checkEnv("BatchSize")){
+            batch_size = atoi((gtc->getEnv("BatchSize")).c_str());
+            assert(batch_size>0);
+        }
+        batch_buffer.assign(batch_size, value_buffer);
+
         allocRideable(gtc);
         
         if(gtc->verbose){
@@ -126,6 +137,7 @@ public:
         std::mt19937_64 gen_p(r);
 
         int tid = ltc->tid;
+        std::vector<V> deq_buffer(batch_size);
 
         // atomic_thread_fence(std::memory_order_acq_rel);
         //broker->threadInit(gtc,ltc);
@@ -136,9 +148,10 @@ public:
             int p = abs((long)gen_p()%100);
             // int p = abs(rand_nums[(p_idx++)%1000]%100);
             
-            operation(p, tid);
+            operation(p, tid, deq_buffer.data());
             
             ops++;
+            gtc->reportProgress(tid, ops);
             if (ops % 500 == 0){
                 now = std::chrono::high_resolution_clock::now();
             }
@@ -191,12 +204,18 @@ public:
         }
     }
 
-    void operation(int op, int tid){
+    void operation(int op, int tid, V* deq_buffer){
         if(op < this->prop_enqs){
-            q->enqueue(value_buffer, tid);
+            if(batch_size > 1)
+                q->enqueue_batch(batch_buffer.data(), batch_size, tid);
+            else
+                q->enqueue(value_buffer, tid);
         }
         else{// op<=prop_deqs
-            q->dequeue(tid);
+            if(batch_size > 1)
+                q->dequeue_batch(deq_buffer, batch_size, tid);
+            else
+                q->dequeue(tid);
         }
     }
 };
@@ -0,0 +1,205 @@
+#ifndef QUEUERECOVERVERIFYTEST_HPP
+#define QUEUERECOVERVERIFYTEST_HPP
+
+/*
+ * This is a test to verify correctness of queues' recovery:
+ * every element still in the queue is recovered, in FIFO order.
+ * With more than one crash round, the recovered queue is grown again
+ * and crashed again before it is checked, so that elements enqueued
+ * after a recovery must come back behind the ones recovered before.
+ */
+
+#include <deque>
+#include <vector>
+#include "TestConfig.hpp"
+#include "AllocatorMacro.hpp"
+#include "Persistent.hpp"
+#include "Recoverable.hpp"
+#include "RQueue.hpp"
+
+template <class V>
+class QueueRecoverVerifyTest : public Test{
+public:
+    RQueue<V>* q;
+    Recoverable* rec;
+    size_t ins_cnt = 1000000;
+    // >1: build the queue with enqueue_batch/dequeue_batch
+    size_t batch_size = 1;
+    // times to grow the queue, crash and recover before draining it
+    int crash_rounds;
+    pthread_barrier_t sync_point;
+    QueueRecoverVerifyTest(int crash_rounds_=1): crash_rounds(crash_rounds_){}
+    void init(GlobalTestConfig* gtc);
+    void parInit(GlobalTestConfig* gtc, LocalTestConfig* ltc);
+    int execute(GlobalTestConfig* gtc, LocalTestConfig* ltc);
+    void cleanup(GlobalTestConfig* gtc);
+};
+
+template <class V>
+void QueueRecoverVerifyTest<V>::parInit(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+    q->init_thread(gtc, ltc);
+}
+
+template <class V>
+void QueueRecoverVerifyTest<V>::init(GlobalTestConfig* gtc){
+
+    Rideable* ptr = gtc->allocRideable();
+    q = dynamic_cast<RQueue<V>*>(ptr);
+    if (!q) {
+        errexit("QueueRecoverVerifyTest must be run on RQueue<V> type object.");
+    }
+    rec = dynamic_cast<Recoverable*>(ptr);
+    if (!rec){
+        errexit("QueueRecoverVerifyTest must be run on Recoverable type object.");
+    }
+    if (gtc->checkEnv("InsCnt")){
+        ins_cnt = stoll(gtc->getEnv("InsCnt"));
+    }
+    if (gtc->checkEnv("BatchSize")){
+        long long b = stoll(gtc->getEnv("BatchSize"));
+        if (b <= 0){
+            errexit("BatchSize must be positive.");
+        }
+        batch_size = b;
+    }
+
+    /* set interval to inf so this won't be killed by timeout */
+    gtc->interval = numeric_limits<double>::max();
+    pthread_barrier_init(&sync_point, NULL, gtc->task_num);
+}
+
+template <class V>
+int QueueRecoverVerifyTest<V>::execute(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+    int tid = ltc->tid;
+    if (!gtc->checkEnv("NoVerify")){
+        // Only thread 0 drives the queue, so that it can be checked
+        // against a reference. The other workers only set how many
+        // threads recovery may use, and give their slots back meanwhile.
+        if (tid != 0){
+            rec->_esys->unregister_thread();
+            return 0;
+        } else {
+            std::deque<V> reference;
+            size_t ops = 0;
+            uint64_t next_val = 0;
+            std::mt19937_64 gen_p(ltc->seed);
+            std::vector<V> buf(batch_size);
+            for (int round = 1; round <= crash_rounds; round++){
+                auto begin = chrono::high_resolution_clock::now();
+                // 2:1 enqueues to dequeues, so the queue keeps growing
+                while(reference.size() < ins_cnt*round){
+                    int p = abs((long)gen_p()%3);
+                    if (batch_size > 1){
+                        if (p < 2){
+                            for (size_t i = 0; i < batch_size; i++){
+                                buf[i] = (V)next_val;
+                                reference.push_back((V)next_val);
+                                next_val++;
+                            }
+                            q->enqueue_batch(buf.data(), batch_size, tid);
+                        } else {
+                            size_t got = q->dequeue_batch(buf.data(), batch_size, tid);
+                            if (got != std::min(batch_size, reference.size())){
+                                std::cout<<"dequeue_batch got "<<got<<" values, expecting "<<std::min(batch_size, reference.size())<<"."<<std::endl;
+                                exit(1);
+                            }
+                            for (size_t i = 0; i < got; i++){
+                                if (buf[i] != reference.front()){
+                                    std::cout<<"dequeue_batch got "<<buf[i]<<", expecting "<<reference.front()<<"."<<std::endl;
+                                    exit(1);
+                                }
+                                reference.pop_front();
+                            }
+                        }
+                    } else if (p < 2){
+                        q->enqueue((V)next_val, tid);
+                        reference.push_back((V)next_val);
+                        next_val++;
+                    } else {
+                        auto ret1 = q->dequeue(tid);
+                        if (ret1.has_value() != !reference.empty()){
+                            std::cout<<"dequeue returned "<<(ret1.has_value() ? "a value" : "nothing")<<" on a queue of "<<reference.size()<<"."<<std::endl;
+                            exit(1);
+                        }
+                        if (ret1.has_value()){
+                            if (ret1.value() != reference.front()){
+                                std::cout<<"dequeue got "<<ret1.value()<<", expecting "<<reference.front()<<"."<<std::endl;
+                                exit(1);
+                            }
+                            reference.pop_front();
+                        }
+                    }
+                    ops++;
+                }
+                auto end = chrono::high_resolution_clock::now();
+                auto dur = end - begin;
+                auto dur_ms = std::chrono::duration_cast<std::chrono::milliseconds>(dur).count();
+
+                std::cout<<"enqueue finished. Spent "<< dur_ms << "ms" <<std::endl;
+                rec->flush();
+                std::cout<<"epochsys flushed."<<std::endl;
+                rec->simulate_crash();
+                std::cout<<"crashed."<<std::endl;
+                int rec_cnt = rec->recover(true);
+                std::cout<<"recover returned."<<std::endl;
+                if (rec_cnt == (int)reference.size()){
+                    std::cout<<"rec_cnt currect."<<std::endl;
+                } else {
+                    std::cout<<"recovered:"<<rec_cnt<<" expecting:"<<reference.size()<<std::endl;
+                    exit(1);
+                }
+            }
+
+            for (auto itr = reference.begin(); itr != reference.end(); itr++){
+                auto ret = q->dequeue(tid);
+                if (!ret.has_value() || ret.value() != *itr){
+                    std::cout<<"value:"<<*itr<<" not recovered in order."<<std::endl;
+                    exit(1);
+                }
+            }
+            if (q->dequeue(tid).has_value()){
+                std::cout<<"queue not empty after draining recovered values."<<std::endl;
+                exit(1);
+            }
+            // the recovered queue must keep working
+            q->enqueue((V)next_val, tid);
+            auto ret = q->dequeue(tid);
+            if (!ret.has_value() || ret.value() != (V)next_val){
+                std::cout<<"queue broken after recovery."<<std::endl;
+                exit(1);
+            }
+            std::cout<<"all records recovered in order."<<std::endl;
+            return ops;
+        }
+    } else {
+        // we don't need to verify but just test the speed.
+        size_t ops = 0;
+        size_t thd_ins_cnt = ins_cnt/gtc->task_num;
+        if(tid==0) {
+            thd_ins_cnt+=(ins_cnt-thd_ins_cnt*gtc->task_num);
+        }
+        pthread_barrier_wait(&sync_point);
+        while(ops < thd_ins_cnt){
+            q->enqueue((V)ops, tid);
+            ops++;
+        }
+        pthread_barrier_wait(&sync_point);
+
+        if(tid==0){
+            rec->flush();
+            std::cout<<"epochsys flushed."<<std::endl;
+            rec->simulate_crash();
+            std::cout<<"crashed."<<std::endl;
+            int rec_cnt = rec->recover(true);
+            std::cout<<"recover returned."<<std::endl;
+        }
+        return ops;
+    }
+}
+
+template <class V>
+void QueueRecoverVerifyTest<V>::cleanup(GlobalTestConfig* gtc){
+    delete q;
+}
+
+#endif
@@ -72,7 +72,13 @@ template <class K, class V>
 int RecoverVerifyTest<K,V>::execute(GlobalTestConfig* gtc, LocalTestConfig* ltc){
     std::string value_buffer; // for string kv only
     if (!gtc->checkEnv("NoVerify")){
-        if (ltc->tid == 0){ // FIXME: workaround when we can't change the total thread count of ralloc.
+        // Only thread 0 drives the map, so that it can be checked against
+        // a reference. The other workers only set how many threads
+        // recovery may use, and give their slots back meanwhile.
+        if (ltc->tid != 0){
+            rec->_esys->unregister_thread();
+            return 0;
+        } else {
             std::unordered_map<K,V> reference;
             size_t ops = 0;
             uint64_t r = ltc->seed;
@@ -133,8 +139,6 @@ int RecoverVerifyTest<K,V>::execute(GlobalTestConfig* gtc, LocalTestConfig* ltc)
             }
             std::cout<<"all records recovered."<<std::endl;
             return ops;
-        } else {
-            return 0;
         }
     } else {
         // we don't need to verify but just test the speed.
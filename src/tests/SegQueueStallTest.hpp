@@ -0,0 +1,98 @@
+#ifndef SEGQUEUESTALLTEST_HPP
+#define SEGQUEUESTALLTEST_HPP
+
+/*
+ * This is a test to verify that an empty dequeue inside a transaction
+ * fails validation once the queue stops being empty, even when the
+ * enqueuer at the first unpublished index stalls and a later one
+ * publishes past it. Thread 0 dequeues from the empty queue in a
+ * transaction; before it commits, thread 1 takes an index and never
+ * publishes at it, then enqueues a value behind it. Q is a segment
+ * queue, i.e., MedleySegQueue or txMontageSegQueue.
+ */
+
+#include <atomic>
+#include "TestConfig.hpp"
+#include "Recoverable.hpp"
+
+template <class Q>
+class SegQueueStallTest : public Test{
+public:
+    Q* q;
+    Recoverable* rec;
+    std::atomic<int> stage;
+    void init(GlobalTestConfig* gtc);
+    void parInit(GlobalTestConfig* gtc, LocalTestConfig* ltc);
+    int execute(GlobalTestConfig* gtc, LocalTestConfig* ltc);
+    void cleanup(GlobalTestConfig* gtc);
+};
+
+template <class Q>
+void SegQueueStallTest<Q>::parInit(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+    q->init_thread(gtc, ltc);
+}
+
+template <class Q>
+void SegQueueStallTest<Q>::init(GlobalTestConfig* gtc){
+    Rideable* ptr = gtc->allocRideable();
+    q = dynamic_cast<Q*>(ptr);
+    if (!q) {
+        errexit("SegQueueStallTest must be run on the segment queue it is built for.");
+    }
+    rec = dynamic_cast<Recoverable*>(ptr);
+    if (gtc->task_num < 2){
+        errexit("SegQueueStallTest needs at least 2 threads.");
+    }
+    stage.store(0);
+
+    /* set interval to inf so this won't be killed by timeout */
+    gtc->interval = numeric_limits<double>::max();
+}
+
+template <class Q>
+int SegQueueStallTest<Q>::execute(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+    int tid = ltc->tid;
+    if (tid == 1){
+        while (stage.load() != 1){}
+        // the index the empty dequeue would wait on is never published
+        q->stall_enqueue();
+        q->enqueue(42, tid);
+        stage.store(2);
+        return 1;
+    } else if (tid != 0){
+        return 0;
+    }
+
+    bool aborted = false;
+    try {
+        rec->_esys->tx_begin();
+        if (q->dequeue(tid).has_value()){
+            std::cout<<"dequeue from an empty queue returned a value."<<std::endl;
+            exit(1);
+        }
+        stage.store(1);
+        while (stage.load() != 2){}
+        rec->_esys->tx_end();
+    } catch (const pds::TransactionAborted& e){
+        aborted = true;
+    }
+    if (!aborted){
+        std::cout<<"empty dequeue committed after a later enqueue was published."<<std::endl;
+        exit(1);
+    }
+    // outside a transaction, the stalled cell is closed and skipped
+    auto res = q->dequeue(tid);
+    if (!res.has_value() || res.value() != 42){
+        std::cout<<"value enqueued past the stalled index not dequeued."<<std::endl;
+        exit(1);
+    }
+    std::cout<<"empty dequeue aborted as expected."<<std::endl;
+    return 2;
+}
+
+template <class Q>
+void SegQueueStallTest<Q>::cleanup(GlobalTestConfig* gtc){
+    delete q;
+}
+
+#endif
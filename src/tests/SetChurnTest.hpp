@@ -1,6 +1,3 @@
-// This test is obsolete
-#if 0 
-
 #ifndef SETCHURNTEST_HPP
 #define SETCHURNTEST_HPP
 
@@ -20,6 +17,11 @@ public:
 
 	inline T fromInt(uint64_t v);
 
+	virtual void parInit(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+		s->init_thread(gtc, ltc);
+		ChurnTest::parInit(gtc, ltc);
+	}
+
 	void allocRideable(GlobalTestConfig* gtc){
 		Rideable* ptr = gtc->allocRideable();
 		s = dynamic_cast<RSet<T>*>(ptr);
@@ -40,13 +42,17 @@ public:
 			// int stride = this->range/this->prefill;
 			int i = 0;
 			while(i<this->prefill){
-				K k = this->fromInt(i%range);
-				m->insert(k,0);
+				T k = this->fromInt(i%range);
+				s->insert(k,0);
 				i++;
 			}
 			if(gtc->verbose){
 				printf("Prefilled %d\n",i);
 			}
+			Recoverable* rec=dynamic_cast<Recoverable*>(s);
+			if(rec){
+				rec->sync();
+			}
 		}
 	}
 	void operation(uint64_t key, int op, int tid){
@@ -83,5 +89,4 @@ inline std::string SetChurnTest<std::string>::fromInt(uint64_t v){
 	return std::to_string(v);
 }
 
-#endif // SETCHURNTEST_HPP
-#endif // 0
\ No newline at end of file
+#endif // SETCHURNTEST_HPP
\ No newline at end of file
@@ -86,6 +86,7 @@ public:
             }
 
             ops++;
+            gtc->reportProgress(tid, ops);
             if (ops % 512 == 0){
                 now = std::chrono::high_resolution_clock::now();
             }
@@ -180,6 +181,7 @@ public:
             }
 
             ops++;
+            gtc->reportProgress(tid, ops);
             if (ops % 512 == 0){
                 now = std::chrono::high_resolution_clock::now();
             }
@@ -9,6 +9,7 @@
 #include "ConcurrentPrimitives.hpp"
 #include "Persistent.hpp"
 #include "TestConfig.hpp"
+#include "OpenLoop.hpp"
 #include "EpochSys.hpp"
 #include "RMap.hpp"
 #include "tpcc/TPCCMacro.hpp"
@@ -118,6 +119,12 @@ public:
         txn_manager._tdsl_txns = new padded<::tdsl::SkipListTransaction>[gtc->task_num];
         gtc->setUpTDSLTxns(reinterpret_cast<void*>(txn_manager._tdsl_txns));
 
+        // The longest transaction is a NewOrder with 15 items: 7 accesses
+        // plus 4 per item. Baselines with fixed-size logs size them by it.
+        if(!gtc->checkEnv("TxnSize")){
+            gtc->setEnv("TxnSize", std::to_string(7 + 4*15));
+        }
+
         TPCC_TABLE_LIST(TPCC_TABLE_INIT)
 
         doPrefill(gtc);
@@ -206,9 +213,17 @@ public:
         auto now = ::std::chrono::high_resolution_clock::now();
 
         while(::std::chrono::duration_cast<::std::chrono::microseconds>(time_up - now).count()>0){
+            if(ltc->open_loop && !ltc->open_loop->arrive()){
+                break;
+            }
+
             operation(r, tid);
 
             ops++;
+            if(ltc->open_loop){
+                ltc->open_loop->complete();
+            }
+            gtc->reportProgress(tid, ops);
             if (ops % 512 == 0){
                 now = ::std::chrono::high_resolution_clock::now();
             }
@@ -0,0 +1,73 @@
+#ifndef THREADCHURNTEST_HPP
+#define THREADCHURNTEST_HPP
+
+/*
+ * MapChurnTest on a Montage map while threads outside the harness come
+ * and go. Worker 0 runs no operations itself; it keeps starting batches
+ * of `extra` threads, each of which takes an EpochSys slot with
+ * register_thread(), runs `thread_ops` operations, and gives the slot
+ * back with unregister_thread(). The other workers churn as usual.
+ * MaxThreads defaults to -t plus `extra`.
+ */
+
+#include "MapChurnTest.hpp"
+#include "Recoverable.hpp"
+#include <thread>
+#include <vector>
+
+template <class K, class V>
+class ThreadChurnTest : public MapChurnTest<K,V>{
+public:
+	int extra;
+	int thread_ops;
+	pds::EpochSys* esys = nullptr;
+
+	ThreadChurnTest(int p_gets, int p_puts, int p_inserts, int p_removes, int range, int prefill, int extra, int thread_ops):
+		MapChurnTest<K,V>(p_gets, p_puts, p_inserts, p_removes, range, prefill), extra(extra), thread_ops(thread_ops){}
+
+	void init(GlobalTestConfig* gtc){
+		// slots for the extra threads; the map's EpochSys reads this
+		if(!gtc->checkEnv("MaxThreads")){
+			gtc->setEnv("MaxThreads", std::to_string(gtc->task_num + extra));
+		}
+		MapChurnTest<K,V>::init(gtc);
+		Recoverable* rec = dynamic_cast<Recoverable*>(this->m);
+		if(!rec){
+			errexit("ThreadChurnTest must be run on a Montage map.");
+		}
+		esys = rec->_esys;
+	}
+
+	int execute(GlobalTestConfig* gtc, LocalTestConfig* ltc){
+		if(ltc->tid != 0){
+			return MapChurnTest<K,V>::execute(gtc, ltc);
+		}
+		std::atomic<int> ops(0);
+		uint64_t seed = ltc->seed;
+		auto now = std::chrono::high_resolution_clock::now();
+		while(now < gtc->finish){
+			std::vector<std::thread> threads;
+			for(int i = 0; i<extra; i++){
+				threads.emplace_back([&, i]{
+					int tid = esys->register_thread();
+					std::mt19937_64 gen_k(seed + 2*i);
+					std::mt19937_64 gen_p(seed + 2*i + 1);
+					for(int j = 0; j<thread_ops; j++){
+						this->operation(gen_k()%this->range, gen_p()%100, tid);
+					}
+					esys->unregister_thread();
+					ops.fetch_add(thread_ops);
+				});
+			}
+			for(auto& t : threads){
+				t.join();
+			}
+			seed += 2*extra;
+			gtc->reportProgress(0, ops.load());
+			now = std::chrono::high_resolution_clock::now();
+		}
+		return ops.load();
+	}
+};
+
+#endif
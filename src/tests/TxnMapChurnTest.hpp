@@ -7,10 +7,12 @@
 
 #include "ChurnTest.hpp"
 #include "TestConfig.hpp"
+#include "OpenLoop.hpp"
 #include "RMap.hpp"
 #include "TxnMeta.hpp"
 
 #include <iostream>
+#include <vector>
 
 //KEY_SIZE and VAL_SIZE are only for string kv
 template <class K, class V, TxnType txn_type=TxnType::NBTC>
@@ -35,6 +37,8 @@ public:
 	size_t val_size = TESTS_VAL_SIZE;
 	const bool fix_sized_txn;
 	int max_op_per_txn;
+	// hand runs of gets to the map as one multi_get; set by -dMultiGet=1
+	bool multi_get = false;
 	TxnManager<txn_type> txn_manager;
 	std::string value_buffer; // for string kv only
 	TxnMapChurnTest(bool fix_sized_txn, int max_op_per_txn, int p_gets, int p_puts, int p_inserts, int p_removes, int range, int prefill):
@@ -65,6 +69,9 @@ public:
             value_buffer += (char)((i % 2 == 0 ? 'A' : 'a') + (gen_v() % 26));
         }
         value_buffer += '\0';
+		if(gtc->checkEnv("MultiGet")){
+			multi_get = gtc->getEnv("MultiGet") == "1";
+		}
 		ChurnTest::init(gtc);
 	}
 
@@ -94,6 +101,11 @@ public:
 		txn_manager._tdsl_txns = new padded<::tdsl::SkipListTransaction>[gtc->task_num];
         gtc->setUpTDSLTxns(reinterpret_cast<void*>(txn_manager._tdsl_txns));
 
+		// size the logs of LFTT and OneFile for our longest transaction
+		if(!gtc->checkEnv("TxnSize")){
+			gtc->setEnv("TxnSize", std::to_string(max_op_per_txn));
+		}
+
 		Rideable* ptr = gtc->allocRideable();
 		m = dynamic_cast<RMap<K, V>*>(ptr);
 		if (!m) {
@@ -146,10 +158,19 @@ public:
 
 		// atomic_thread_fence(std::memory_order_acq_rel);
 		//broker->threadInit(gtc,ltc);
+		// per-thread buffers for the longest transaction
+		std::vector<int> r(max_op_per_txn), p(max_op_per_txn);
+		std::vector<K> ks(max_op_per_txn);
+		std::vector<optional<V>> vs(max_op_per_txn);
 		auto now = std::chrono::high_resolution_clock::now();
 
 		while(std::chrono::duration_cast<std::chrono::microseconds>(time_up - now).count()>0){
+			if(ltc->open_loop && !ltc->open_loop->arrive()){
+				break;
+			}
 
+			// closed loop drops an aborted transaction and makes up the
+			// next one; open loop retries it as is, as the same arrival
 	        int retry = 0;
 			int sz = 0;
 			if (fix_sized_txn) {
@@ -157,20 +178,36 @@ public:
 			} else {
 				sz = abs((long)gen_txn_size()%max_op_per_txn)+1;
 			}
-			int r[sz], p[sz]; 
 			for(int i=0;i<sz;i++) {
 				r[i] = abs((long)gen_k()%range);
 				p[i] = abs((long)gen_p()%100);
 			}
-			// while (true){
+			while (true){
 				try {
 					do_tx(tid, [&] () {
-						for(int i=0;i<sz;i++)
-							operation(r[i], p[i], tid);
+						for(int i=0;i<sz;){
+							// with MultiGet, hand each run of gets to the map as one batch
+							int j=i;
+							while(multi_get && j<sz && p[j]<this->prop_gets) j++;
+							if(j-i>1){
+								multi_get_operation(&r[i], j-i, ks.data(), vs.data(), tid);
+							} else {
+								operation(r[i], p[i], tid);
+								j=i+1;
+							}
+							i=j;
+						}
 					}, sz);
 					ops++;
-					// break;
+					if(ltc->open_loop){
+						ltc->open_loop->complete();
+					}
+					gtc->reportProgress(tid, ops);
+					break;
 				} catch(const pds::TransactionAborted& e) {
+					if (!ltc->open_loop) {
+						break;
+					}
                 	if (retry>1000) {
 						errexit("Retry too many times!");
 						break;
@@ -178,7 +215,7 @@ public:
 						retry++;
 					}
 				}
-			// } // while(true)
+			} // while(true)
 			
 			if (ops % 512 == 0){
 				now = std::chrono::high_resolution_clock::now();
@@ -206,6 +243,13 @@ public:
 			m->remove(k,tid);
 		}
 	}
+	// ks and vs hold at least n entries
+	void multi_get_operation(const int* keys, int n, K* ks, optional<V>* vs, int tid){
+		for(int i=0;i<n;i++){
+			ks[i] = this->fromInt(keys[i]);
+		}
+		m->multi_get(ks, vs, n, tid);
+	}
 	void cleanup(GlobalTestConfig* gtc){
 		ChurnTest::cleanup(gtc);
 #ifndef PRONTO
@@ -228,6 +228,7 @@ public:
             operation(p, k1, k2, m_idx1, m_idx2, q_idx, tid);
             
             ops++;
+            gtc->reportProgress(tid, ops);
             if (ops % 512 == 0){
                 now = std::chrono::high_resolution_clock::now();
             }
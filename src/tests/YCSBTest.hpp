@@ -131,6 +131,7 @@ public:
         for (size_t i = 0; i < traces[tid]->size(); i++) {
             operation(traces[tid]->at(i), tid, gen_v()&true);
             ops++;
+            gtc->reportProgress(tid, ops);
         }
         return ops;
     }
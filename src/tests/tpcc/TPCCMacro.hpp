@@ -9,6 +9,7 @@
 
 #include "tpcc/inline_str.hpp"
 #include "RMap.hpp"
+#include "FastHash.hpp"
 
 namespace tpcc {
 template <typename T>
@@ -133,12 +134,9 @@ template <typename T>
   namespace std { \
     template <> \
     struct hash<typename ::tpcc::name::key> { \
-      hash<string_view> hash_fn; \
       size_t operator()(const typename ::tpcc::name::key &_k) const \
       { \
-        const char* k = reinterpret_cast<const char*>(&_k); \
-        string_view str(k, sizeof(::tpcc::name::key)); \
-        return hash_fn(str); \
+        return fast_hash_bytes<sizeof(::tpcc::name::key)>(&_k); \
       } \
     }; \
   }
@@ -0,0 +1,95 @@
+#ifndef FAST_HASH_HPP
+#define FAST_HASH_HPP
+
+// Fixed-width hashing and bucket mapping for the hash tables.
+//
+// std::hash<uint64_t> is the identity in libstdc++, and the generic
+// byte hash behind std::hash<string_view> is a length-agnostic loop.
+// The helpers below are specialized at compile time on the key width
+// (murmur3 finalizer for word-sized keys, a wyhash-style multiply-xor
+// over 8-byte words for small PODs such as the TPC-C composite keys),
+// so they are a handful of multiplies and fully unrolled.
+//
+// Bucket selection avoids the 64-bit division of `h % n`: a
+// power-of-two bucket count is masked, anything else goes through
+// Lemire's fastrange (the high half of h*n). fastrange consumes the
+// high bits of the hash, so it must be fed a well-mixed hash, which is
+// what FastHash<K> guarantees.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <functional>
+#include <type_traits>
+
+// MurmurHash3 64-bit finalizer.
+inline uint64_t fmix64(uint64_t k){
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// wyhash's multiply-and-fold.
+inline uint64_t mum64(uint64_t a, uint64_t b){
+    __uint128_t r = (__uint128_t)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+// Hash exactly N bytes at p. N is a compile-time constant, so the loop
+// and the tail cases are resolved by the compiler.
+template<size_t N>
+inline uint64_t fast_hash_bytes(const void* p){
+    static constexpr uint64_t s0 = 0xa0761d6478bd642fULL;
+    static constexpr uint64_t s1 = 0xe7037ed1a0b428dbULL;
+    const char* c = reinterpret_cast<const char*>(p);
+    uint64_t h = s0 ^ N;
+    size_t i = 0;
+    for (; i + 8 <= N; i += 8){
+        uint64_t w;
+        memcpy(&w, c + i, 8);
+        h = mum64(h ^ w, s1);
+    }
+    if constexpr (N % 8 != 0){
+        uint64_t w = 0;
+        memcpy(&w, c + i, N % 8);
+        h = mum64(h ^ w, s1);
+    }
+    return fmix64(h);
+}
+
+// Default hasher of the hash tables. Integral, enum and pointer keys
+// are mixed with fmix64; everything else defers to std::hash<K>, whose
+// specializations for such keys (strings, TPC-C keys) are expected to
+// already be well mixed.
+template<typename K>
+struct FastHash{
+    size_t operator()(const K& k) const{
+        if constexpr (std::is_integral<K>::value || std::is_enum<K>::value){
+            return fmix64((uint64_t)k);
+        } else if constexpr (std::is_pointer<K>::value){
+            return fmix64((uint64_t)(uintptr_t)k);
+        } else {
+            return std::hash<K>{}(k);
+        }
+    }
+};
+
+// Map a well-mixed hash to [0, n).
+inline size_t fastrange(uint64_t h, size_t n){
+    return (size_t)(((__uint128_t)h * n) >> 64);
+}
+
+template<size_t n>
+inline size_t bucket_of(uint64_t h){
+    static_assert(n > 0, "bucket count must be positive");
+    if constexpr ((n & (n - 1)) == 0){
+        return (size_t)(h & (n - 1));
+    } else {
+        return fastrange(h, n);
+    }
+}
+
+#endif
@@ -27,6 +27,7 @@
 #include <optional>
 
 #include "ConcurrentPrimitives.hpp"
+#include "FastHash.hpp"
 #include "RCUTracker.hpp"
 
 // amount: based on jemalloc's size class, we choose
@@ -169,7 +170,7 @@ public:
         }
         Node& operator*() const {
             assert(in_use_amount>curr_idx);
-            assert(curr_idx<amount-1);
+            assert(curr_idx<amount);
             return curr_slab->slab[curr_idx];
         }
         Node* operator->() {
@@ -177,7 +178,7 @@ public:
         }
         bool deleted(){
             assert(in_use_amount>curr_idx);
-            assert(curr_idx<amount-1);
+            assert(curr_idx<amount);
             return getMark(curr_slab->slab[curr_idx].next.ptr.load());
         }
         bool reached_end(){
@@ -197,13 +198,13 @@ public:
                 // curr_idx surpasses curr_slab end, but there
                 // might be a following slab available.
                 curr_slab = curr_slab->next.load();
-                in_use_amount = curr_slab->in_use_amount.load();
+                in_use_amount = curr_slab == nullptr ? 0 : curr_slab->in_use_amount.load();
                 curr_idx = 0;
             }
         }
     };
 private:
-    std::hash<K> hash_fn;
+    FastHash<K> hash_fn; // keys are aligned pointers; std::hash would leave most buckets empty
     static constexpr int idxSize=128;//number of buckets for hash table
     padded<MarkPtr>* buckets = new padded<MarkPtr>[idxSize]{};
     bool findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key);
@@ -311,7 +312,7 @@ void LockfreeSlabHashTable<K,V,amount>::reset(){
 
 template <class K, class V, int amount> 
 bool LockfreeSlabHashTable<K,V,amount>::findNode(MarkPtr* &prev, Node* &curr, Node* &next, K key){
-    size_t idx=hash_fn(key)%idxSize;
+    size_t idx=bucket_of<idxSize>(hash_fn(key));
     bool cmark=false;
     prev=&buckets[idx].ui;
     curr=getPtr(prev->ptr.load());
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <mutex>
+#include <iostream>
+
+#include "OpenLoop.hpp"
+#include "Recorder.hpp"
+#include "TestConfig.hpp"
+
+constexpr std::chrono::microseconds OpenLoop::SLEEP_SLACK;
+
+// latencies of the whole run, merged by report()
+static std::mutex merged_lock;
+static uint64_t merged_hist[OpenLoop::BUCKETS];
+static uint64_t merged_count = 0;
+static uint64_t merged_sum = 0;
+static uint64_t merged_max = 0;
+
+static const char* LATENCY_FIELDS[] = {
+	"lat_mean_us", "lat_p50_us", "lat_p90_us", "lat_p99_us", "lat_p999_us", "lat_max_us"
+};
+static const double PERCENTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+bool OpenLoop::enabled(GlobalTestConfig* gtc){
+	return gtc->checkEnv("TargetRate") && gtc->getEnv("TargetRate") != "0";
+}
+
+void OpenLoop::addFields(Recorder* recorder){
+	recorder->addGlobalField("offered_rate");
+	recorder->addGlobalField("achieved_rate");
+	for(const char* f : LATENCY_FIELDS){
+		recorder->addGlobalField(f);
+	}
+}
+
+uint64_t OpenLoop::bucketValue(int b){
+	if(b < (1<<SUB_BITS)){
+		return b;
+	}
+	int k = (b >> SUB_BITS) + SUB_BITS - 1;
+	uint64_t sub = b & ((1<<SUB_BITS) - 1);
+	uint64_t width = 1ull << (k - SUB_BITS);
+	return (((1ull<<SUB_BITS) + sub) << (k - SUB_BITS)) + (width - 1);
+}
+
+OpenLoop::OpenLoop(GlobalTestConfig* gtc, LocalTestConfig* ltc):
+	gen(ltc->seed), finish(gtc->finish){
+	double rate = std::stod(gtc->getEnv("TargetRate"));
+	if(rate <= 0){
+		errexit("TargetRate must be a positive number of operations per second.");
+	}
+	std::string arrivals = gtc->checkEnv("Arrivals") ? gtc->getEnv("Arrivals") : "poisson";
+	if(arrivals == "poisson"){
+		poisson = true;
+	} else if(arrivals == "fixed"){
+		poisson = false;
+	} else {
+		errexit(("unknown Arrivals schedule \"" + arrivals + "\", use poisson or fixed.").c_str());
+	}
+
+	// each thread takes an even share of the rate; Poisson arrivals on
+	// every thread add up to Poisson arrivals at the full rate
+	double thread_rate = rate / gtc->task_num;
+	gap = std::exponential_distribution<double>(thread_rate);
+	period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / thread_rate));
+	next = gtc->start;
+	if(!poisson){
+		// offset the threads' fixed schedules so that arrivals are evenly
+		// spaced over all threads, too
+		next += period * ltc->tid / gtc->task_num - period;
+	}
+}
+
+void OpenLoop::report(){
+	std::lock_guard<std::mutex> lk(merged_lock);
+	for(int i = 0; i<BUCKETS; i++){
+		merged_hist[i] += hist[i];
+	}
+	merged_count += count;
+	merged_sum += sum;
+	merged_max = std::max(merged_max, max);
+}
+
+void OpenLoop::summarize(GlobalTestConfig* gtc){
+	double offered = std::stod(gtc->getEnv("TargetRate"));
+	double achieved = gtc->total_operations / gtc->interval;
+	gtc->recorder->reportGlobalInfo("offered_rate", offered);
+	gtc->recorder->reportGlobalInfo("achieved_rate", achieved);
+
+	std::lock_guard<std::mutex> lk(merged_lock);
+	if(merged_count == 0){
+		// the test doesn't issue operations through OpenLoop
+		std::cerr<<"warning: "<<gtc->getTestName()<<" doesn't support TargetRate, ran closed-loop"<<std::endl;
+		for(const char* f : LATENCY_FIELDS){
+			gtc->recorder->reportGlobalInfo(f, std::string("NA"));
+		}
+		return;
+	}
+	gtc->recorder->reportGlobalInfo("lat_mean_us", (double)merged_sum / merged_count / 1000.0);
+	uint64_t seen = 0;
+	int p = 0, b = 0;
+	for(; b<BUCKETS && p<4; b++){
+		seen += merged_hist[b];
+		while(p<4 && seen >= PERCENTILES[p] * merged_count){
+			gtc->recorder->reportGlobalInfo(LATENCY_FIELDS[p+1],
+				std::min(bucketValue(b), merged_max) / 1000.0);
+			p++;
+		}
+	}
+	gtc->recorder->reportGlobalInfo("lat_max_us", merged_max / 1000.0);
+	if(gtc->verbose){
+		std::cout<<"offered rate: "<<offered<<" ops/sec, achieved: "<<achieved<<" ops/sec"<<std::endl;
+	}
+
+	std::fill(merged_hist, merged_hist + BUCKETS, 0);
+	merged_count = merged_sum = merged_max = 0;
+}
@@ -0,0 +1,113 @@
+#ifndef OPEN_LOOP_HPP
+#define OPEN_LOOP_HPP
+
+#include <chrono>
+#include <random>
+#include <thread>
+#include <stdint.h>
+
+class GlobalTestConfig;
+class LocalTestConfig;
+class Recorder;
+
+// Open-loop load, turned on with -dTargetRate=<ops/sec over all threads>.
+// Instead of issuing the next operation as soon as the last one returns,
+// each worker issues them at scheduled arrival times, -dArrivals=poisson
+// (default) or fixed, at TargetRate/-t ops/sec. A worker that falls
+// behind issues its backlog back to back, and latency is measured from
+// the scheduled arrival rather than from when the operation got to run,
+// so queueing delay isn't hidden (coordinated omission).
+//
+// Tests that support it wrap each operation in arrive() and complete()
+// when ltc->open_loop is set; see ChurnTest::execute.
+class OpenLoop{
+public:
+	typedef std::chrono::high_resolution_clock clock;
+
+	static bool enabled(GlobalTestConfig* gtc);
+	// add the rate and latency fields; call before threads start
+	static void addFields(Recorder* recorder);
+	// report offered vs achieved rate and the latency percentiles of all
+	// threads; call once after they have all called report() and
+	// gtc->interval is final
+	static void summarize(GlobalTestConfig* gtc);
+
+	// the schedule starts at gtc->start, so create it after that is set
+	OpenLoop(GlobalTestConfig* gtc, LocalTestConfig* ltc);
+	// merge this thread's latencies into the run's
+	void report();
+
+	// wait for the next arrival; false once it falls past gtc->finish.
+	// Until complete() is called, e.g. after an aborted transaction,
+	// the same arrival is returned again without waiting.
+	inline bool arrive(){
+		if(pending){
+			return true;
+		}
+		if(poisson){
+			next += std::chrono::duration_cast<clock::duration>(
+				std::chrono::duration<double>(gap(gen)));
+		} else {
+			next += period;
+		}
+		if(next >= finish){
+			return false;
+		}
+		auto now = clock::now();
+		if(next - now > SLEEP_SLACK){
+			std::this_thread::sleep_for(next - now - SLEEP_SLACK);
+		}
+		while(clock::now() < next){
+			__builtin_ia32_pause();
+		}
+		pending = true;
+		return true;
+	}
+	// the operation of the current arrival is done
+	inline void complete(){
+		record(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - next).count());
+		pending = false;
+	}
+
+	// log-linear latency buckets: exact below 16ns, then 16 per power of
+	// two, i.e., within 1/16 of the value
+	static const int SUB_BITS = 4;
+	static const int BUCKETS = (64 - SUB_BITS + 1) << SUB_BITS;
+	static inline int bucket(uint64_t ns){
+		if(ns < (1ull<<SUB_BITS)){
+			return ns;
+		}
+		int k = 63 - __builtin_clzll(ns);
+		return ((k - SUB_BITS + 1) << SUB_BITS) + ((ns >> (k - SUB_BITS)) & ((1<<SUB_BITS) - 1));
+	}
+	// the largest latency that falls into bucket b
+	static uint64_t bucketValue(int b);
+
+private:
+	// sleeping overshoots; sleep until this close and spin the rest
+	static constexpr std::chrono::microseconds SLEEP_SLACK{100};
+
+	bool poisson;
+	clock::duration period;
+	std::mt19937_64 gen;
+	std::exponential_distribution<double> gap;
+	clock::time_point next;
+	clock::time_point finish;
+	bool pending = false;
+
+	uint64_t hist[BUCKETS] = {};
+	uint64_t count = 0;
+	uint64_t sum = 0;
+	uint64_t max = 0;
+
+	inline void record(uint64_t ns){
+		hist[bucket(ns)]++;
+		count++;
+		sum += ns;
+		if(ns > max){
+			max = ns;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <atomic>
+#include <iostream>
+
+#include "PerfCounters.hpp"
+#include "Recorder.hpp"
+#include "TestConfig.hpp"
+
+#define HW_CACHE_MISS(cache) \
+	((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+const PerfCounters::Event PerfCounters::events[PerfCounters::EVENT_NUM] = {
+	{"perf_cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{"perf_instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{"perf_l1d_misses", PERF_TYPE_HW_CACHE, HW_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D)},
+	{"perf_llc_misses", PERF_TYPE_HW_CACHE, HW_CACHE_MISS(PERF_COUNT_HW_CACHE_LL)},
+	{"perf_branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+	{"perf_dtlb_misses", PERF_TYPE_HW_CACHE, HW_CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB)},
+};
+
+// print the unavailable events once, not once per thread
+static std::atomic<bool> warned(false);
+
+static int openEvent(uint32_t type, uint64_t config){
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	// more events than hardware counters get multiplexed; the times
+	// let report() scale the counts up
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	// this thread, on any cpu
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+bool PerfCounters::enabled(GlobalTestConfig* gtc){
+	return gtc->checkEnv("PerfCounters") && gtc->getEnv("PerfCounters") != "0";
+}
+
+void PerfCounters::addFields(Recorder* recorder){
+	for(int i = 0; i<EVENT_NUM; i++){
+		recorder->addThreadField(events[i].name, &PerfCounters::sumCounts);
+	}
+}
+
+PerfCounters::PerfCounters(){
+	std::string missing;
+	for(int i = 0; i<EVENT_NUM; i++){
+		fds[i] = openEvent(events[i].type, events[i].config);
+		if(fds[i] < 0){
+			missing += std::string(" ") + events[i].name + "(" + strerror(errno) + ")";
+		}
+	}
+	if(!missing.empty() && !warned.exchange(true)){
+		std::cerr<<"warning: hardware counters unavailable, reported as NA:"<<missing<<std::endl;
+	}
+}
+
+PerfCounters::~PerfCounters(){
+	for(int i = 0; i<EVENT_NUM; i++){
+		if(fds[i] >= 0){
+			close(fds[i]);
+		}
+	}
+}
+
+void PerfCounters::start(){
+	for(int i = 0; i<EVENT_NUM; i++){
+		if(fds[i] >= 0){
+			ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+}
+
+void PerfCounters::stop(){
+	for(int i = 0; i<EVENT_NUM; i++){
+		if(fds[i] >= 0){
+			ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+		}
+	}
+}
+
+void PerfCounters::report(Recorder* recorder, int tid){
+	for(int i = 0; i<EVENT_NUM; i++){
+		// value, time enabled, time running
+		uint64_t buf[3];
+		std::string val = "NA";
+		if(fds[i] >= 0 && read(fds[i], buf, sizeof(buf)) == sizeof(buf) && buf[2] > 0){
+			val = std::to_string((uint64_t)((double)buf[0] * buf[1] / buf[2]));
+		}
+		recorder->reportThreadInfo(events[i].name, val, tid);
+	}
+}
+
+std::string PerfCounters::sumCounts(std::list<std::string> list){
+	uint64_t sum = 0;
+	for(std::string s : list){
+		if(s.empty() || s == "NA"){
+			return "NA";
+		}
+		sum += std::stoull(s);
+	}
+	return std::to_string(sum);
+}
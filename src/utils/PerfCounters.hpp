@@ -0,0 +1,44 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <list>
+#include <string>
+#include <stdint.h>
+
+class Recorder;
+class GlobalTestConfig;
+
+// Hardware counters of one worker thread, through perf_event_open(2),
+// turned on with -dPerfCounters=1. Only the thread's own user-space
+// events are counted, which needs no privilege as long as
+// kernel.perf_event_paranoid is at most 2. Events the kernel or the CPU
+// can't count are reported as NA instead of failing the run.
+class PerfCounters{
+public:
+	static bool enabled(GlobalTestConfig* gtc);
+	// add the perf_* thread fields; call before threads start
+	static void addFields(Recorder* recorder);
+
+	// opens the events, disabled
+	PerfCounters();
+	~PerfCounters();
+	void start();
+	void stop();
+	// report counts since start() into the perf_* fields of tid
+	void report(Recorder* recorder, int tid);
+
+private:
+	struct Event{
+		const char* name;
+		uint32_t type;
+		uint64_t config;
+	};
+	static const int EVENT_NUM = 6;
+	static const Event events[EVENT_NUM];
+	int fds[EVENT_NUM];
+
+	// sum over threads, or NA if any thread couldn't count
+	static std::string sumCounts(std::list<std::string> list);
+};
+
+#endif
@@ -18,105 +18,325 @@ limitations under the License.
 
 
 
+
 #ifndef RCU_TRACKER_HPP
 #define RCU_TRACKER_HPP
 
-#include <queue>
-#include <list>
-#include <vector>
 #include <atomic>
-#include <functional>
+#include <string>
+#include <cassert>
+#include <cstdlib>
 #include "ConcurrentPrimitives.hpp"
+#include "HarnessUtils.hpp"
+#include "persist_utils.hpp"
 
 #include "BaseTracker.hpp"
 
 
-enum RCUType{type_RCU, type_QSBR};
+// type_RCU:  epoch-based; a thread reserves the epoch it starts an op in
+// type_QSBR: quiescent-state-based; a thread reserves the epoch it last
+//            ended an op in
+// type_IBR:  interval-based (2GE-IBR); a thread reserves [lower, upper],
+//            and upper is raised to the current era by protect() after
+//            each load. An object born in era b and retired in era r is
+//            kept only for threads whose interval meets [b, r], so a
+//            stalled thread no longer pins objects born after it stalled.
+//            Objects that aren't IBRNodes count as born in era 0.
+enum RCUType{type_RCU, type_QSBR, type_IBR};
+
+// Base for nodes that record the era they were born in, for type_IBR.
+// Every load of a pointer to one must be followed by protect() (and a
+// reload if it fails), or the node may be freed under the reader.
+struct IBRNode{
+	uint64_t birth_era = 0;
+};
 
 class RCUTracker: public BaseTracker{
+public:
+	// typed deleter: called as destruct(obj, ctx)
+	typedef void (*Destructor)(void* obj, void* ctx);
+
+	template<class T>
+	static void delete_obj(void* obj, void* ctx){
+		delete(static_cast<T*>(obj));
+	}
+
+	static RCUType parse_type(const std::string& s){
+		if (s == "RCU") return type_RCU;
+		if (s == "QSBR") return type_QSBR;
+		if (s == "IBR") return type_IBR;
+		errexit("unrecognized 'Reclaim' environment");
+		return type_RCU;
+	}
+
 private:
+	struct RCUInfo{
+		void* obj;
+		Destructor destruct;
+		void* ctx;
+	};
+
+	// Retired objects are kept in per-thread chains of fixed-size bags.
+	// A bag remembers the latest retire era and the earliest birth era of
+	// what it holds, so reclamation is decided a bag at a time.
+	struct LimboBag{
+		static const int CAPACITY = 128;
+		LimboBag* next;
+		uint64_t epoch;
+		uint64_t birth;
+		int cnt;
+		RCUInfo infos[CAPACITY];
+	};
+
+	struct LimboList{
+		// oldest bag; bags from head up to (not including) tail are full
+		LimboBag* head = nullptr;
+		// bag being filled
+		LimboBag* tail = nullptr;
+		// temporarily retired op, committed to the limbo list at end_op
+		LimboBag* temp = nullptr;
+		// empty bags for reuse
+		LimboBag* pool = nullptr;
+		uint64_t retire_counter = 0;
+		// era this thread last saw when it went to move the era on
+		uint64_t era = 0;
+		// era of this thread's last reservation scan
+		uint64_t scanned = UINT64_MAX;
+	};
+
 	int task_num;
+	// slots in use, if threads come and go; scans stop at slots->bound()
+	const SlotRegistry* slots = nullptr;
 	int freq;
 	int epochFreq;
 	bool collect;
 	RCUType type;
-	
-public:
-	struct RCUInfo{
-	public:
-		void* obj;
-		uint64_t epoch;
-		std::function<void(void*)> destruct;
-		RCUInfo(void* obj, uint64_t epoch, const std::function<void(void*)>& d):obj(obj), epoch(epoch), destruct(d){}
-	};
-	
-private:
+
+	// lower end of each thread's reservation; UINT64_MAX if none
 	paddedAtomic<uint64_t>* reservations;
-	padded<uint64_t>* retire_counters;
-	padded<uint64_t>* alloc_counters;
-	padded<std::list<RCUInfo>>* retired; 
-	// temporarily retired op, committed to 'retired' at end_op
-	padded<std::list<RCUInfo>>* temp_retired; 
-	// std::list<RCUInfo>* retired;
+	// upper end of each thread's reservation, for type_IBR
+	paddedAtomic<uint64_t>* uppers;
+	padded<LimboList>* limbo;
+	// bags left by threads that gave up their slot, adopted by the next
+	// thread to empty; chains are linked through their last bag's next
+	std::atomic<LimboBag*> orphans;
+
+	alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> epoch;
+	// no reservation is below this, as of some thread's last scan. A
+	// reservation is never taken below the era it is taken in, so a
+	// scan's result stays a valid bound after the scan.
+	alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> safe_epoch;
+
+	LimboBag* new_bag(LimboList& l){
+		LimboBag* b = l.pool;
+		if (b != nullptr){
+			l.pool = b->next;
+		} else {
+			b = static_cast<LimboBag*>(malloc(sizeof(LimboBag)));
+			if (b == nullptr){
+				errexit("RCUTracker: out of memory");
+			}
+		}
+		b->next = nullptr;
+		b->epoch = 0;
+		b->birth = UINT64_MAX;
+		b->cnt = 0;
+		return b;
+	}
+
+	void recycle_bag(LimboList& l, LimboBag* b){
+		b->next = l.pool;
+		l.pool = b;
+	}
+
+	static void free_bags(LimboBag* b){
+		while (b != nullptr){
+			LimboBag* next = b->next;
+			free(b);
+			b = next;
+		}
+	}
+
+	void push(LimboList& l, void* obj, Destructor d, void* ctx, uint64_t e, uint64_t birth){
+		LimboBag* b = l.tail;
+		if (b == nullptr){
+			b = l.head = l.tail = new_bag(l);
+		} else if (b->cnt == LimboBag::CAPACITY){
+			b->next = new_bag(l);
+			b = l.tail = b->next;
+		}
+		b->infos[b->cnt++] = {obj, d, ctx};
+		if (e > b->epoch) b->epoch = e;
+		if (birth < b->birth) b->birth = birth;
+	}
+
+	void push_temp(LimboList& l, void* obj, Destructor d, void* ctx, uint64_t birth){
+		LimboBag* b = l.temp;
+		if (b == nullptr || b->cnt == LimboBag::CAPACITY){
+			LimboBag* nb = new_bag(l);
+			nb->next = b;
+			b = l.temp = nb;
+		}
+		b->infos[b->cnt++] = {obj, d, ctx};
+		if (birth < b->birth) b->birth = birth;
+	}
+
+	// insert each orphaned bag in front of the first of l's bags from a
+	// later era, so that l stays oldest first; l.tail, the bag being
+	// filled, stays last
+	void adopt(LimboList& l){
+		LimboBag* chain = orphans.exchange(nullptr,std::memory_order_acq_rel);
+		if (chain == nullptr){
+			return;
+		}
+		if (l.tail == nullptr){
+			l.head = l.tail = new_bag(l);
+		}
+		while (chain != nullptr){
+			LimboBag* b = chain;
+			chain = b->next;
+			LimboBag** p = &l.head;
+			while (*p != l.tail && (*p)->epoch <= b->epoch){
+				p = &(*p)->next;
+			}
+			b->next = *p;
+			*p = b;
+		}
+	}
+
+	// one past the highest thread that may hold a reservation
+	int bound(){
+		return slots ? slots->bound() : task_num;
+	}
+
+	// Every epochFreq*bound() retires a thread moves the era on, unless
+	// another thread has done so since it last looked. The era line then
+	// takes about one RMW per period in all, not one per thread.
+	void retired(int tid){
+		LimboList& l = limbo[tid].ui;
+		uint64_t& cnt = l.retire_counter;
+		if(cnt%(epochFreq*bound())==0){
+			uint64_t e = epoch.load(std::memory_order_acquire);
+			if(e == l.era && epoch.compare_exchange_strong(e,e+1,std::memory_order_acq_rel)){
+				e++;
+			}
+			l.era = e;
+		}
+		if(collect && cnt%freq==0){
+			empty(tid);
+		}
+		cnt++;
+	}
+
+	// lowest reservation, capped at e, the era before the scan; it is
+	// published in safe_epoch for the other threads to reclaim by
+	uint64_t scan(uint64_t e){
+		uint64_t minEpoch = e;
+		int n = bound();
+		for (int i = 0; i<n; i++){
+			uint64_t res = reservations[i].ui.load(std::memory_order_seq_cst);
+			if(res<minEpoch){
+				minEpoch = res;
+			}
+		}
+		// a racing scan may store a lower bound over ours, which is
+		// still a valid one
+		if (minEpoch > safe_epoch.load(std::memory_order_relaxed)){
+			safe_epoch.store(minEpoch,std::memory_order_release);
+		}
+		return minEpoch;
+	}
 
-	std::atomic<uint64_t> epoch;
+	// can the objects in b be reached by any thread, under type_IBR?
+	bool reachable(const LimboBag* b){
+		int n = bound();
+		for (int i = 0; i<n; i++){
+			uint64_t lower = reservations[i].ui.load(std::memory_order_seq_cst);
+			if (lower > b->epoch) continue;
+			if (b->birth <= uppers[i].ui.load(std::memory_order_seq_cst)) return true;
+		}
+		return false;
+	}
 
 public:
-	~RCUTracker(){};
+	~RCUTracker(){
+		for (int i = 0; i<task_num; i++){
+			free_bags(limbo[i].ui.head);
+			free_bags(limbo[i].ui.temp);
+			free_bags(limbo[i].ui.pool);
+		}
+		free_bags(orphans.load());
+		delete[] limbo;
+		delete[] uppers;
+		delete[] reservations;
+	};
 	RCUTracker(int task_num, int epochFreq, int emptyFreq, RCUType type, bool collect): 
 	 BaseTracker(task_num),task_num(task_num),freq(emptyFreq),epochFreq(epochFreq),collect(collect),type(type){
-		retired = new padded<std::list<RCUTracker::RCUInfo>>[task_num];
-		temp_retired = new padded<std::list<RCUTracker::RCUInfo>>[task_num];
-		// retired = new std::list<RCUTracker::RCUInfo>[task_num];
+		limbo = new padded<LimboList>[task_num];
 		reservations = new paddedAtomic<uint64_t>[task_num];
-		retire_counters = new padded<uint64_t>[task_num];
-		// alloc_counters = new padded<uint64_t>[task_num];
+		uppers = new paddedAtomic<uint64_t>[task_num];
 		for (int i = 0; i<task_num; i++){
 			reservations[i].ui.store(UINT64_MAX,std::memory_order_release);
-			retired[i].ui.clear();
-			temp_retired[i].ui.clear();
-			// retired[i].clear();
+			uppers[i].ui.store(UINT64_MAX,std::memory_order_release);
 		}
+		orphans.store(nullptr,std::memory_order_release);
 		epoch.store(0,std::memory_order_release);
+		safe_epoch.store(0,std::memory_order_release);
 	}
 	RCUTracker(int task_num, int epochFreq, int emptyFreq) : RCUTracker(task_num,epochFreq,emptyFreq,type_RCU,true){}
 	RCUTracker(int task_num, int epochFreq, int emptyFreq, bool collect) : 
 		RCUTracker(task_num,epochFreq,emptyFreq,type_RCU,collect){}
 
+	// Threads are handed out of s rather than fixed at task_num, the
+	// number of slots; call before any thread starts.
+	void set_slots(const SlotRegistry* s){
+		slots = s;
+	}
+
 	void __attribute__ ((deprecated)) reserve(uint64_t e, int tid){
 		return start_op(tid);
 	}
-	
-	// void* alloc(int tid){
-	// 	alloc_counters[tid]=alloc_counters[tid]+1;
-	// 	if(alloc_counters[tid]%(epochFreq*task_num)==0){
-	// 		epoch.fetch_add(1,std::memory_order_acq_rel);
-	// 	}
-	// 	return (void*)malloc(sizeof(T));
-	// }
+
 	void start_op(int tid){
-		// Note the current last element for abort_op to undo limbo list
 		if (type == type_RCU){
 			uint64_t e = epoch.load(std::memory_order_acquire);
 			reservations[tid].ui.store(e,std::memory_order_seq_cst);
+		} else if (type == type_IBR){
+			uint64_t e = epoch.load(std::memory_order_acquire);
+			uppers[tid].ui.store(e,std::memory_order_seq_cst);
+			reservations[tid].ui.store(e,std::memory_order_seq_cst);
 		}
 	}
 	void end_op(int tid){
-		if (!temp_retired[tid].ui.empty()){
-			retired[tid].ui.splice(
-				retired[tid].ui.end(), 
-				temp_retired[tid].ui);
+		LimboList& l = limbo[tid].ui;
+		if (l.temp != nullptr){
+			uint64_t e = epoch.load(std::memory_order_acquire);
+			while (l.temp != nullptr){
+				LimboBag* b = l.temp;
+				l.temp = b->next;
+				for (int i = 0; i<b->cnt; i++){
+					push(l, b->infos[i].obj, b->infos[i].destruct, b->infos[i].ctx, e, b->birth);
+				}
+				recycle_bag(l, b);
+			}
 		}
-		assert(temp_retired[tid].ui.empty());
-		if (type == type_RCU){
-			reservations[tid].ui.store(UINT64_MAX,std::memory_order_seq_cst);
-		} else { //if type == TYPE_QSBR
+		if (type == type_QSBR){
 			uint64_t e = epoch.load(std::memory_order_acquire);
 			reservations[tid].ui.store(e,std::memory_order_seq_cst);
+		} else {
+			reservations[tid].ui.store(UINT64_MAX,std::memory_order_seq_cst);
+			if (type == type_IBR){
+				uppers[tid].ui.store(UINT64_MAX,std::memory_order_seq_cst);
+			}
 		}
 	}
 	void abort_op(int tid){
-		temp_retired[tid].ui.clear();
+		LimboList& l = limbo[tid].ui;
+		while (l.temp != nullptr){
+			LimboBag* b = l.temp;
+			l.temp = b->next;
+			recycle_bag(l, b);
+		}
 	}
 	void reserve(int tid){
 		start_op(tid);
@@ -126,100 +346,165 @@ public:
 	}
 
 	void check_temp_retire(int tid){
-		assert(temp_retired[tid].ui.empty());
+		assert(limbo[tid].ui.temp == nullptr);
 	}
 
+	// For a thread leaving its slot: its retired objects go to whichever
+	// thread empties next, and its reservation is dropped. tid must not be
+	// inside an op.
+	void handoff(int tid){
+		LimboList& l = limbo[tid].ui;
+		assert(l.temp == nullptr);
+		if (l.head != nullptr){
+			LimboBag* top = orphans.load(std::memory_order_acquire);
+			do{
+				l.tail->next = top;
+			} while(!orphans.compare_exchange_weak(top,l.head,std::memory_order_acq_rel));
+		}
+		free_bags(l.pool);
+		l.head = l.tail = l.pool = nullptr;
+		l.retire_counter = 0;
+		reservations[tid].ui.store(UINT64_MAX,std::memory_order_seq_cst);
+		uppers[tid].ui.store(UINT64_MAX,std::memory_order_seq_cst);
+	}
+
+	// Forget every retired object without destructing it. After a
+	// (simulated) crash their persistent parts belong to recovery.
+	// No thread may be inside an op.
+	void reset(){
+		for (int i = 0; i<task_num; i++){
+			LimboList& l = limbo[i].ui;
+			for (LimboBag* chain : {l.head, l.temp}){
+				while (chain != nullptr){
+					LimboBag* b = chain;
+					chain = b->next;
+					recycle_bag(l, b);
+				}
+			}
+			l.head = l.tail = l.temp = nullptr;
+			reservations[i].ui.store(UINT64_MAX,std::memory_order_release);
+			uppers[i].ui.store(UINT64_MAX,std::memory_order_release);
+		}
+		free_bags(orphans.exchange(nullptr,std::memory_order_acq_rel));
+	}
 
 	inline void incrementEpoch(){
 		epoch.fetch_add(1,std::memory_order_acq_rel);
 	}
-	
-	// void __attribute__ ((deprecated)) retire(T* obj, uint64_t e, int tid){
-	// 	return retire(obj,tid);
-	// }
-	
-	// void retire(T* obj, int tid){
-	// 	if(obj==NULL){return;}
-	// 	std::list<RCUInfo>* myTrash = &(retired[tid].ui);
-	// 	// for(auto it = myTrash->begin(); it!=myTrash->end(); it++){
-	// 	// 	assert(it->obj!=obj && "double retire error");
-	// 	// }
-			
-	// 	uint64_t e = epoch.load(std::memory_order_acquire);
-	// 	RCUInfo info = RCUInfo(obj,e);
-	// 	myTrash->push_back(info);
-	// 	if(collect && retire_counters[tid]%freq==0){
-	// 		empty(tid);
-	// 	}
-	// 	retire_counters[tid]=retire_counters[tid]+1;
-	// }
-	template<class T>
-	void retire(T* obj, int tid, const std::function<void(void*)>& d){
-		return retire((void*)obj,tid,d,&(retired[tid].ui));
+
+	// Under type_IBR, raises tid's upper reservation to the current era.
+	// Returns false if it had to: a pointer tid just loaded must then be
+	// loaded again before it is used.
+	bool protect(int tid){
+		if (type != type_IBR) return true;
+		uint64_t e = epoch.load(std::memory_order_acquire);
+		if (uppers[tid].ui.load(std::memory_order_relaxed) == e) return true;
+		uppers[tid].ui.store(e,std::memory_order_seq_cst);
+		return false;
 	}
-	void retire(void* obj, int tid, const std::function<void(void*)>& d, std::list<RCUInfo>* myTrash){
-		if(obj==NULL){return;}
 
-		// for(auto it = myTrash->begin(); it!=myTrash->end(); it++){
-		// 	assert(it->obj!=obj && "double retire error");
-		// }
-			
+	// era to stamp on a new IBRNode; it also covers the node in tid's own
+	// reservation
+	uint64_t alloc_era(int tid){
 		uint64_t e = epoch.load(std::memory_order_acquire);
-		RCUInfo info = RCUInfo(obj,e,d);
-		myTrash->push_back(info);
-		if(retire_counters[tid]%(epochFreq*task_num)==0){
-			epoch.fetch_add(1,std::memory_order_acq_rel);
-		}
-		if(collect && retire_counters[tid]%freq==0){
-			empty(tid);
+		if (type == type_IBR && uppers[tid].ui.load(std::memory_order_relaxed) != e){
+			uppers[tid].ui.store(e,std::memory_order_seq_cst);
 		}
-		retire_counters[tid]=retire_counters[tid]+1;
+		return e;
 	}
+
+	// protected load, for trackers used directly by a data structure
 	template<class T>
-	void retire(T* obj, int tid){
-		retire(
-			obj, 
-			tid, 
-			[](void* o){
-				delete(static_cast<T*>(o));
-			},
-			&(retired[tid].ui));
+	T* read(std::atomic<T*>& obj, int tid){
+		T* ret;
+		do {
+			ret = obj.load(std::memory_order_acquire);
+		} while (!protect(tid));
+		return ret;
+	}
+
+	void retire(void* obj, int tid, Destructor d, void* ctx, uint64_t birth=0){
+		if(obj==NULL){return;}
+		uint64_t e = epoch.load(std::memory_order_acquire);
+		push(limbo[tid].ui, obj, d, ctx, e, birth);
+		retired(tid);
 	}
 	template<class T>
-	void temp_retire(T* obj, int tid, const std::function<void(void*)>& d){
-		return retire(obj,tid,d,&(temp_retired[tid].ui));
+	void retire(T* obj, int tid, Destructor d, void* ctx, uint64_t birth=0){
+		return retire((void*)obj,tid,d,ctx,birth);
 	}
 	template<class T>
-	void temp_retire(T* obj, int tid){
-		retire(
-			obj, 
-			tid, 
-			[](void* o){
-				delete(static_cast<T*>(o));
-			},
-			&(temp_retired[tid].ui));
+	void retire(T* obj, int tid, uint64_t birth=0){
+		return retire((void*)obj,tid,&delete_obj<T>,nullptr,birth);
 	}
-	
+	// retire withdrawn by abort_op, or committed by end_op
+	void temp_retire(void* obj, int tid, Destructor d, void* ctx, uint64_t birth=0){
+		if(obj==NULL){return;}
+		push_temp(limbo[tid].ui, obj, d, ctx, birth);
+		retired(tid);
+	}
+	template<class T>
+	void temp_retire(T* obj, int tid, Destructor d, void* ctx, uint64_t birth=0){
+		return temp_retire((void*)obj,tid,d,ctx,birth);
+	}
+	template<class T>
+	void temp_retire(T* obj, int tid, uint64_t birth=0){
+		return temp_retire((void*)obj,tid,&delete_obj<T>,nullptr,birth);
+	}
+
+	// Reclaims the full bags of tid that no thread can reach any more.
+	// Oldest bags come first, so a call stops at the first bag still in
+	// use, except that under type_IBR it goes on past bags still reachable.
+	// Reservations are only scanned when safe_epoch holds back a
+	// bag from an earlier era, and at most once per era by each thread.
 	void empty(int tid){
-		uint64_t minEpoch = UINT64_MAX;
-		for (int i = 0; i<task_num; i++){
-			uint64_t res = reservations[i].ui.load(std::memory_order_seq_cst);
-			if(res<minEpoch){
-				minEpoch = res;
+		LimboList& l = limbo[tid].ui;
+		if (orphans.load(std::memory_order_relaxed) != nullptr){
+			adopt(l);
+		}
+		if (l.head == l.tail){
+			return;
+		}
+		uint64_t minEpoch = safe_epoch.load(std::memory_order_acquire);
+		bool scanned = false;
+		if (l.head->epoch >= minEpoch){
+			// no reservation is above the current era, so a bag of this
+			// era can't be freed yet
+			uint64_t e = epoch.load(std::memory_order_acquire);
+			if (l.head->epoch >= e || l.scanned == e){
+				return;
 			}
+			l.scanned = e;
+			minEpoch = scan(e);
+			scanned = true;
 		}
-		
-		// erase safe objects
-		std::list<RCUInfo>* myTrash = &(retired[tid].ui);
-		// std::list<RCUInfo>* myTrash = &(retired[tid]);
-
-		for (auto iterator = myTrash->begin(), end = myTrash->end(); iterator != end; ) {
-			RCUInfo& res = *iterator;
-			if(res.epoch<minEpoch){
-				res.destruct(res.obj);
-				iterator = myTrash->erase(iterator);
+		// unlink every bag to free before destructing any: a destructor
+		// may retire more objects, and so come back in here
+		LimboBag* dead = nullptr;
+		LimboBag** last = &dead;
+		LimboBag** p = &l.head;
+		while (*p != l.tail){
+			LimboBag* b = *p;
+			if (b->epoch < minEpoch || (type == type_IBR && scanned && !reachable(b))){
+				*p = b->next;
+				*last = b;
+				last = &b->next;
+			} else if (type == type_IBR && scanned){
+				// under IBR a stalled thread only holds back bags born
+				// before its upper reservation, so look past them
+				p = &b->next;
+			} else {
+				break;
+			}
+		}
+		*last = nullptr;
+		while (dead != nullptr){
+			LimboBag* b = dead;
+			dead = b->next;
+			for (int i = 0; i<b->cnt; i++){
+				b->infos[i].destruct(b->infos[i].obj, b->infos[i].ctx);
 			}
-			else{++iterator;}
+			recycle_bag(l, b);
 		}
 	}
 		
@@ -0,0 +1,89 @@
+#ifndef SIZE_CLASS_POOL_HPP
+#define SIZE_CLASS_POOL_HPP
+
+// A pool of fixed size classes for variable-sized transient objects,
+// e.g. skip list nodes whose tower length depends on their level.
+//
+// Each thread carves blocks of a class out of its own CHUNK_SIZE-aligned
+// chunks. The chunk header records the class, so free() needs only the
+// pointer, which lets a class-specific operator delete (and therefore
+// plain `delete` from the trackers) return blocks to the right list.
+// Freed blocks go to the freeing thread's list for that class; chunks
+// are never handed back to the system. Tag keeps pools of different
+// users apart.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <cassert>
+
+#include "HarnessUtils.hpp"
+
+template <class Tag, int CLASSES>
+class SizeClassPool{
+public:
+    static constexpr size_t CHUNK_SIZE = 1ULL << 20;
+    static constexpr size_t BLOCK_ALIGN = 16;
+private:
+    struct alignas(64) Chunk{
+        int cls;
+    };
+    struct Block{
+        Block* next;
+    };
+    struct Local{
+        Block* free_list[CLASSES] = {};
+        char* cur[CLASSES] = {};
+        char* end[CLASSES] = {};
+    };
+    static thread_local Local local;
+
+    static Chunk* new_chunk(int cls){
+        Chunk* c = static_cast<Chunk*>(aligned_alloc(CHUNK_SIZE, CHUNK_SIZE));
+        if (c == nullptr){
+            errexit("SizeClassPool: out of memory");
+        }
+        c->cls = cls;
+        return c;
+    }
+public:
+    static size_t round_size(size_t sz){
+        return (sz + BLOCK_ALIGN - 1) & ~(BLOCK_ALIGN - 1);
+    }
+
+    // sz must be the same for every call with the same cls
+    static void* alloc(int cls, size_t sz){
+        assert(cls >= 0 && cls < CLASSES);
+        Local& l = local;
+        Block* b = l.free_list[cls];
+        if (b != nullptr){
+            l.free_list[cls] = b->next;
+            return b;
+        }
+        sz = round_size(sz);
+        assert(sz + sizeof(Chunk) <= CHUNK_SIZE);
+        if (l.cur[cls] + sz > l.end[cls]){
+            Chunk* c = new_chunk(cls);
+            l.cur[cls] = reinterpret_cast<char*>(c) + sizeof(Chunk);
+            l.end[cls] = reinterpret_cast<char*>(c) + CHUNK_SIZE;
+        }
+        void* ret = l.cur[cls];
+        l.cur[cls] += sz;
+        return ret;
+    }
+
+    static void free(void* p){
+        if (p == nullptr) return;
+        Chunk* c = reinterpret_cast<Chunk*>(
+            reinterpret_cast<uintptr_t>(p) & ~(CHUNK_SIZE - 1));
+        Local& l = local;
+        Block* b = static_cast<Block*>(p);
+        b->next = l.free_list[c->cls];
+        l.free_list[c->cls] = b;
+    }
+};
+
+template <class Tag, int CLASSES>
+thread_local typename SizeClassPool<Tag, CLASSES>::Local SizeClassPool<Tag, CLASSES>::local;
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef STRIPED_LOCK_TABLE_HPP
+#define STRIPED_LOCK_TABLE_HPP
+
+// A fixed-size table of word-sized reader-writer locks, addressed by
+// key hash, for the abstract (semantic) locks of transactional
+// boosting. Keys whose hashes share a stripe share a lock, which only
+// costs some false conflicts; in exchange the table never grows and a
+// lock is a single CAS on its own cache line.
+//
+// Each lock word is
+//   [63:48] writer depth | [47:32] writer tid+1 | [31:0] reader count
+// The writer tag makes the locks re-entrant within a transaction: the
+// owner may lock again, shared or exclusive, and a thread whose shared
+// holds are the only ones on a stripe may upgrade it. Since two keys
+// of a transaction may land on one stripe, without this the
+// transaction would conflict with itself and abort forever. A writer
+// that finds other readers puts its tag with depth 0 to hold off new
+// readers while the old ones drain; another would-be upgrader then
+// gives way instead of waiting for it, so that two transactions that
+// read a key and then write it don't keep aborting each other.
+//
+// Locks are only ever tried, never waited for: boosting aborts the
+// transaction on a failed try, which rules out deadlock. A try backs
+// off for a short while on a conflicting holder before giving up.
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "ConcurrentPrimitives.hpp"
+#include "FastHash.hpp"
+
+template<size_t stripes=(1<<16)>
+class StripedLockTable{
+    static_assert((stripes & (stripes - 1)) == 0, "stripe count must be a power of two");
+
+    static constexpr uint64_t READER = 1ULL;
+    static constexpr uint64_t READER_MASK = 0xffffffffULL;
+    static constexpr int OWNER_SHIFT = 32;
+    static constexpr uint64_t OWNER_MASK = 0xffffULL;
+    static constexpr uint64_t DEPTH = 1ULL<<48;
+    // rereads of a conflicting lock word before a try fails; we yield
+    // in between, since the holder may be preempted
+    static constexpr int SPIN = 16;
+
+    padded<std::atomic<uint64_t>>* locks;
+    // stripes each thread holds shared, once per acquisition, so that
+    // it can tell whether all readers of a stripe are itself
+    padded<std::vector<size_t>>* shared_held;
+
+    static uint64_t owner_of(uint64_t w){
+        return (w >> OWNER_SHIFT) & OWNER_MASK;
+    }
+    static uint64_t tag_of(int tid){
+        assert((uint64_t)tid < OWNER_MASK);
+        return (uint64_t)tid + 1;
+    }
+    size_t held_count(size_t s, int tid){
+        auto& held = shared_held[tid].ui;
+        return std::count(held.begin(), held.end(), s);
+    }
+
+public:
+    StripedLockTable(int task_num){
+        locks = new padded<std::atomic<uint64_t>>[stripes]{};
+        shared_held = new padded<std::vector<size_t>>[task_num];
+    }
+    ~StripedLockTable(){
+        delete[] locks;
+        delete[] shared_held;
+    }
+
+    static size_t stripe_of(uint64_t h){
+        return bucket_of<stripes>(h);
+    }
+
+    bool try_lock(size_t s, int tid){
+        std::atomic<uint64_t>& l = locks[s].ui;
+        const uint64_t me = tag_of(tid);
+        const uint64_t mine = held_count(s, tid);
+        int spin = SPIN;
+        uint64_t w = l.load(std::memory_order_acquire);
+        while(true){
+            uint64_t owner = owner_of(w);
+            if (owner == me){
+                // nested acquisition; only we change owner and depth
+                if (l.compare_exchange_weak(w, w + DEPTH, std::memory_order_acq_rel)){
+                    return true;
+                }
+                continue;
+            }
+            if (owner != 0){
+                // if we read-lock the stripe, the owner may be waiting
+                // for us, so give way at once
+                if (mine > 0 || spin-- == 0) return false;
+                std::this_thread::yield();
+                w = l.load(std::memory_order_acquire);
+                continue;
+            }
+            // take the tag: as the lock if no one else reads, or else
+            // with depth 0, as an intent that holds off new readers
+            bool free = (w & READER_MASK) == mine;
+            uint64_t desired = w | (me << OWNER_SHIFT) | (free ? DEPTH : 0);
+            if (l.compare_exchange_weak(w, desired, std::memory_order_acq_rel)){
+                if (free) return true;
+                break;
+            }
+        }
+        // wait for the other readers to drain
+        while(true){
+            w = l.load(std::memory_order_acquire);
+            if ((w & READER_MASK) == mine){
+                l.fetch_add(DEPTH, std::memory_order_acq_rel);
+                return true;
+            }
+            if (spin-- == 0){
+                l.fetch_sub(me << OWNER_SHIFT, std::memory_order_release);
+                return false;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    bool try_lock_shared(size_t s, int tid){
+        std::atomic<uint64_t>& l = locks[s].ui;
+        const uint64_t me = tag_of(tid);
+        int spin = SPIN;
+        uint64_t w = l.load(std::memory_order_acquire);
+        while(true){
+            uint64_t owner = owner_of(w);
+            if (owner != 0 && owner != me){
+                if (spin-- == 0) return false;
+                std::this_thread::yield();
+                w = l.load(std::memory_order_acquire);
+                continue;
+            }
+            assert((w & READER_MASK) != READER_MASK);
+            if (l.compare_exchange_weak(w, w + READER, std::memory_order_acq_rel)){
+                shared_held[tid].ui.push_back(s);
+                return true;
+            }
+        }
+    }
+
+    void unlock(size_t s, int tid){
+        std::atomic<uint64_t>& l = locks[s].ui;
+        const uint64_t me = tag_of(tid);
+        uint64_t w = l.load(std::memory_order_relaxed);
+        assert(owner_of(w) == me);
+        if ((w >> 48) == 1){
+            // last exclusive hold; readers may still come and go
+            l.fetch_sub((me << OWNER_SHIFT) | DEPTH, std::memory_order_release);
+        } else {
+            l.fetch_sub(DEPTH, std::memory_order_release);
+        }
+    }
+
+    void unlock_shared(size_t s, int tid){
+        auto& held = shared_held[tid].ui;
+        auto pos = std::find(held.rbegin(), held.rend(), s);
+        assert(pos != held.rend());
+        held.erase((pos+1).base());
+        locks[s].ui.fetch_sub(READER, std::memory_order_release);
+    }
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <ctime>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "ThroughputSampler.hpp"
+#include "TestConfig.hpp"
+#include "EpochSys.hpp"
+#include "Recoverable.hpp"
+
+static const char* HEADER =
+	"run_start,rideable,test,thread_num,time_ms,ops,throughput,min_thread_ops,max_thread_ops,epoch,rss_kb";
+
+static const uint64_t NO_EPOCH = UINT64_MAX;
+
+bool ThroughputSampler::enabled(GlobalTestConfig* gtc){
+	return gtc->checkEnv("SampleInterval") && gtc->getEnv("SampleInterval") != "0";
+}
+
+ThroughputSampler::ThroughputSampler(GlobalTestConfig* gtc):
+	gtc(gtc), last(gtc->task_num, 0){
+	int ms = std::stoi(gtc->getEnv("SampleInterval"));
+	if(ms <= 0){
+		errexit("SampleInterval must be a positive number of milliseconds.");
+	}
+	interval = std::chrono::milliseconds(ms);
+	sample_rss = gtc->checkEnv("SampleRSS") && gtc->getEnv("SampleRSS") != "0";
+
+	if(gtc->checkEnv("SampleFile")){
+		file = gtc->getEnv("SampleFile");
+	} else if(!gtc->outFile.empty()){
+		file = gtc->outFile;
+		if(file.size() > 4 && file.compare(file.size()-4, 4, ".csv") == 0){
+			file.resize(file.size()-4);
+		}
+		file += "_samples.csv";
+	}
+
+	// the test's own EpochSys, or the first Montage rideable's
+	if(gtc->_preallocated_esys){
+		esys = reinterpret_cast<pds::EpochSys*>(gtc->_esys);
+	}
+	for(size_t i = 0; i<gtc->allocatedRideables.size() && !esys; i++){
+		if(Recoverable* r = dynamic_cast<Recoverable*>(gtc->allocatedRideables[i])){
+			esys = r->_esys;
+		}
+	}
+
+	gtc->progress = new paddedAtomic<uint64_t>[gtc->task_num];
+	for(int i = 0; i<gtc->task_num; i++){
+		gtc->progress[i].ui.store(0, std::memory_order_relaxed);
+	}
+}
+
+ThroughputSampler::~ThroughputSampler(){
+	delete[] gtc->progress;
+	gtc->progress = nullptr;
+}
+
+void ThroughputSampler::start(){
+	run_start = std::time(nullptr);
+	samples.clear();
+	samples.reserve(gtc->interval*1000/interval.count()+2);
+	running = true;
+	sampler = std::thread(&ThroughputSampler::run, this);
+}
+
+void ThroughputSampler::stop(){
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		running = false;
+	}
+	wakeup.notify_all();
+	sampler.join();
+	// the workers are done, so this one adds up to the recorded ops
+	sample();
+	output();
+}
+
+void ThroughputSampler::pin(){
+	// any PU no worker is bound to; share with the workers if none is left
+	hwloc_bitmap_t set = hwloc_bitmap_dup(hwloc_topology_get_topology_cpuset(gtc->topology));
+	for(int i = 0; i<gtc->task_num; i++){
+		hwloc_bitmap_andnot(set, set, gtc->affinities[i]->cpuset);
+	}
+	if(!hwloc_bitmap_iszero(set)){
+		hwloc_set_cpubind(gtc->topology, set, HWLOC_CPUBIND_THREAD);
+	} else if(gtc->verbose){
+		std::cout<<"throughput sampler shares PUs with the workers"<<std::endl;
+	}
+	hwloc_bitmap_free(set);
+}
+
+void ThroughputSampler::run(){
+	pin();
+	auto next = gtc->start + interval;
+	std::unique_lock<std::mutex> lk(lock);
+	while(!wakeup.wait_until(lk, next, [this]{ return !running; })){
+		sample();
+		next += interval;
+	}
+}
+
+void ThroughputSampler::sample(){
+	Sample s;
+	s.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::high_resolution_clock::now() - gtc->start).count();
+	s.ops = 0;
+	s.min_thread_ops = UINT64_MAX;
+	s.max_thread_ops = 0;
+	for(int i = 0; i<gtc->task_num; i++){
+		uint64_t ops = gtc->progress[i].ui.load(std::memory_order_relaxed);
+		s.ops += ops;
+		s.min_thread_ops = std::min(s.min_thread_ops, ops-last[i]);
+		s.max_thread_ops = std::max(s.max_thread_ops, ops-last[i]);
+		last[i] = ops;
+	}
+	s.epoch = esys ? esys->get_epoch() : NO_EPOCH;
+	s.rss_kb = -1;
+	if(sample_rss){
+		// second field of statm is resident pages
+		long size, resident;
+		FILE* f = fopen("/proc/self/statm", "r");
+		if(f && fscanf(f, "%ld %ld", &size, &resident) == 2){
+			s.rss_kb = resident*(sysconf(_SC_PAGESIZE)/1024);
+		}
+		if(f){
+			fclose(f);
+		}
+	}
+	samples.push_back(s);
+}
+
+void ThroughputSampler::output(){
+	std::ostringstream rows;
+	uint64_t prev_ms = 0, prev_ops = 0;
+	for(const Sample& s : samples){
+		double secs = (s.time_ms-prev_ms)/1000.0;
+		rows<<run_start<<","<<gtc->getRideableName()<<","<<gtc->getTestName()<<","<<gtc->task_num<<","
+			<<s.time_ms<<","<<s.ops<<","
+			<<(secs > 0 ? (uint64_t)((s.ops-prev_ops)/secs) : 0)<<","
+			<<s.min_thread_ops<<","<<s.max_thread_ops<<",";
+		if(s.epoch == NO_EPOCH){
+			rows<<"NA,";
+		} else {
+			rows<<s.epoch<<",";
+		}
+		if(s.rss_kb < 0){
+			rows<<"NA\n";
+		} else {
+			rows<<s.rss_kb<<"\n";
+		}
+		prev_ms = s.time_ms;
+		prev_ops = s.ops;
+	}
+
+	if(file.empty()){
+		std::cout<<HEADER<<"\n"<<rows.str();
+		return;
+	}
+	bool fresh = access(file.c_str(), F_OK) == -1;
+	if(!fresh){
+		std::ifstream in(file.c_str());
+		std::string line;
+		std::getline(in, line);
+		if(line != HEADER){
+			errexit(("Sample file "+file+"'s header does not match.").c_str());
+		}
+	}
+	std::ofstream f(file.c_str(), std::ios::app);
+	if(f.bad()){
+		errexit("Unable to open sample csv output file.");
+	}
+	if(fresh){
+		f<<HEADER<<"\n";
+	}
+	f<<rows.str();
+	if(gtc->verbose){
+		std::cout<<"Stored throughput samples in: "<<file<<std::endl;
+	}
+}
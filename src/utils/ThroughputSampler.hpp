@@ -0,0 +1,69 @@
+#ifndef THROUGHPUT_SAMPLER_HPP
+#define THROUGHPUT_SAMPLER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+class GlobalTestConfig;
+namespace pds{
+	class EpochSys;
+}
+
+// Throughput over time, turned on with -dSampleInterval=<ms>. A thread
+// pinned off the workers' PUs polls the running op counts the tests
+// publish through GlobalTestConfig::reportProgress() every interval, and
+// samples the global epoch of the Montage rideable, if any, and with
+// -dSampleRSS=1 the resident set size. Samples are kept in memory and
+// appended as CSV rows to -dSampleFile, by default <-o>_samples.csv next
+// to the results file, or printed when there's no -o.
+class ThroughputSampler{
+public:
+	static bool enabled(GlobalTestConfig* gtc);
+
+	// allocates gtc->progress; call after the test's init, so that the
+	// rideables and their EpochSys exist
+	ThroughputSampler(GlobalTestConfig* gtc);
+	// frees gtc->progress
+	~ThroughputSampler();
+	// start sampling; call once gtc->start is set
+	void start();
+	// take a last sample and write out the series; call after the
+	// workers are done
+	void stop();
+
+private:
+	struct Sample{
+		uint64_t time_ms;
+		uint64_t ops; // total since start
+		uint64_t min_thread_ops; // least any thread did since the last sample
+		uint64_t max_thread_ops; // most any thread did since the last sample
+		uint64_t epoch;
+		long rss_kb;
+	};
+
+	GlobalTestConfig* gtc;
+	pds::EpochSys* esys = nullptr;
+	std::chrono::milliseconds interval;
+	bool sample_rss = false;
+	std::string file;
+	long run_start = 0; // wall clock seconds, tells appended runs apart
+
+	std::thread sampler;
+	std::mutex lock;
+	std::condition_variable wakeup; // cuts the sleep short on stop()
+	bool running = false;
+	std::vector<Sample> samples;
+	std::vector<uint64_t> last; // per-thread ops at the last sample
+
+	void pin();
+	void run();
+	void sample();
+	void output();
+};
+
+#endif